@@ -0,0 +1,246 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Host command transport over a UNIX socket, for the emulator.
+ *
+ * The host (util/comm-sock.c) writes a protocol v3 request packet to the
+ * socket, and reads back the response packet; the packet headers tell both
+ * sides how much to read.  Each connection gets a thread, and their requests
+ * are passed to the EC one at a time.
+ *
+ * The socket is $EC_HOSTCMD_SOCKET, or the executable name followed by
+ * ".sock".
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "console.h"
+#include "hooks.h"
+#include "host_command.h"
+#include "host_test.h"
+#include "printf.h"
+#include "task.h"
+#include "test_util.h"
+#include "util.h"
+
+#define CPRINTS(format, args...) cprints(CC_HOSTCMD, format, ## args)
+
+/* Larger than real transports, so the host can use big requests */
+#define SOCK_PACKET_SIZE 1024
+
+static uint8_t request_buf[SOCK_PACKET_SIZE] __aligned(4);
+static uint8_t response_buf[SOCK_PACKET_SIZE] __aligned(4);
+static struct host_packet sock_packet;
+
+static pthread_t sock_thread;
+/* Held while a request is with the EC */
+static pthread_mutex_t packet_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t response_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t response_cond = PTHREAD_COND_INITIALIZER;
+static int response_ready;
+static volatile int packet_received;
+
+static char sock_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/* Read or write all of buf; returns 0 on success */
+static int sock_xfer(int fd, void *buf, int len, int is_write)
+{
+	uint8_t *p = buf;
+	int rv;
+
+	while (len) {
+		rv = is_write ? write(fd, p, len) : read(fd, p, len);
+		if (rv <= 0)
+			return -1;
+		p += rv;
+		len -= rv;
+	}
+
+	return 0;
+}
+
+static void sock_send_response(struct host_packet *pkt)
+{
+	pthread_mutex_lock(&response_mutex);
+	response_ready = 1;
+	pthread_cond_signal(&response_cond);
+	pthread_mutex_unlock(&response_mutex);
+}
+
+static void sock_packet_interrupt(void)
+{
+	packet_received = 1;
+	host_packet_receive(&sock_packet);
+}
+
+/*
+ * Serve one request; returns 0 on success, or non-zero to hang up.
+ *
+ * @param fd		Connection to the host.
+ * @param buf		Buffer for the request and then the response, of
+ *			SOCK_PACKET_SIZE bytes.
+ */
+static int sock_serve_request(int fd, uint8_t *buf)
+{
+	struct ec_host_request *r = (struct ec_host_request *)buf;
+	int response_size;
+
+	if (sock_xfer(fd, r, sizeof(*r), 0))
+		return -1;
+
+	/* Nothing to resync to if the host sends junk */
+	if (r->struct_version != EC_HOST_REQUEST_VERSION ||
+	    r->data_len > SOCK_PACKET_SIZE - sizeof(*r)) {
+		CPRINTS("socket: bad request header");
+		return -1;
+	}
+
+	if (sock_xfer(fd, r + 1, r->data_len, 0))
+		return -1;
+
+	pthread_mutex_lock(&packet_mutex);
+
+	memcpy(request_buf, buf, sizeof(*r) + r->data_len);
+	sock_packet.send_response = sock_send_response;
+
+	/* host_packet_receive() copies the request if it needs to */
+	sock_packet.request = request_buf;
+	sock_packet.request_temp = NULL;
+	sock_packet.request_max = SOCK_PACKET_SIZE;
+	sock_packet.request_size = host_request_expected_size(r);
+
+	sock_packet.response = response_buf;
+	sock_packet.response_max = SOCK_PACKET_SIZE;
+	sock_packet.response_size = 0;
+
+	sock_packet.driver_result = EC_RES_SUCCESS;
+
+	/*
+	 * The response may be sent from the interrupt itself, so do not hold
+	 * the mutex over it.  The interrupt is dropped if interrupts are
+	 * disabled; try again until it is taken.
+	 */
+	response_ready = 0;
+	packet_received = 0;
+	while (1) {
+		task_trigger_test_interrupt(sock_packet_interrupt);
+		if (packet_received)
+			break;
+		sched_yield();
+	}
+
+	pthread_mutex_lock(&response_mutex);
+	while (!response_ready)
+		pthread_cond_wait(&response_cond, &response_mutex);
+	pthread_mutex_unlock(&response_mutex);
+
+	response_size = sock_packet.response_size;
+	memcpy(buf, response_buf, response_size);
+
+	pthread_mutex_unlock(&packet_mutex);
+
+	return sock_xfer(fd, buf, response_size, 1);
+}
+
+static void *sock_serve_connection(void *arg)
+{
+	uint8_t buf[SOCK_PACKET_SIZE] __aligned(4);
+	int fd = (intptr_t)arg;
+
+	while (!sock_serve_request(fd, buf))
+		;
+	close(fd);
+
+	return NULL;
+}
+
+static void *sock_serve(void *arg)
+{
+	int listen_fd = (intptr_t)arg;
+	pthread_t thread;
+	int fd;
+
+	while (1) {
+		fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		if (pthread_create(&thread, NULL, sock_serve_connection,
+				   (void *)(intptr_t)fd)) {
+			close(fd);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+
+	return NULL;
+}
+
+static void sock_init(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	const char *path = getenv("EC_HOSTCMD_SOCKET");
+	int fd;
+
+	if (path)
+		strzcpy(sock_path, path, sizeof(sock_path));
+	else
+		snprintf(sock_path, sizeof(sock_path), "%s.sock",
+			 __get_prog_name());
+	strzcpy(addr.sun_path, sock_path, sizeof(addr.sun_path));
+
+	/* Not inherited on reboot, which execs the emulator again */
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		CPRINTS("socket: cannot create");
+		return;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	unlink(sock_path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(fd, 4)) {
+		CPRINTS("socket: cannot listen on %s", sock_path);
+		close(fd);
+		return;
+	}
+
+	pthread_create(&sock_thread, NULL, sock_serve, (void *)(intptr_t)fd);
+	CPRINTS("Host commands on %s", sock_path);
+}
+DECLARE_HOOK(HOOK_INIT, sock_init, HOOK_PRIO_DEFAULT);
+
+const char *host_command_sock_path(void)
+{
+	return sock_path;
+}
+
+/* Get protocol information */
+static enum ec_status
+sock_get_protocol_info(struct host_cmd_handler_args *args)
+{
+	struct ec_response_get_protocol_info *r = args->response;
+
+	memset(r, 0, sizeof(*r));
+	r->protocol_versions = BIT(3);
+	r->max_request_packet_size = SOCK_PACKET_SIZE;
+	r->max_response_packet_size = SOCK_PACKET_SIZE;
+
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_GET_PROTOCOL_INFO,
+		     sock_get_protocol_info,
+		     EC_VER_MASK(0));
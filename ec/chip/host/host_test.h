@@ -14,4 +14,7 @@
 /* Get emulator executable name */
 const char *__get_prog_name(void);
 
+/* Get the path of the host command socket, with CONFIG_HOSTCMD_SOCKET */
+const char *host_command_sock_path(void);
+
 #endif  /* __CROS_EC_HOST_TEST_H */
@@ -8,6 +8,7 @@
 #include <linux/limits.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static void get_storage_path(char *out)
@@ -15,6 +16,8 @@ static void get_storage_path(char *out)
 	char buf[PATH_MAX];
 	int sz;
 	char *current;
+	/* Lets concurrent runs of the same binary keep their state apart */
+	const char *dir = getenv("EC_PERSIST_DIR");
 
 	sz = readlink("/proc/self/exe", buf, PATH_MAX - 1);
 	buf[sz] = '\0';
@@ -26,7 +29,8 @@ static void get_storage_path(char *out)
 		current = strchr(current, '/');
 	}
 
-	snprintf(out, PATH_MAX - 1, "/dev/shm/EC_persist_%s", buf);
+	snprintf(out, PATH_MAX - 1, "%s/EC_persist_%s",
+		 dir ? dir : "/dev/shm", buf);
 	out[PATH_MAX - 1] = '\0';
 }
 
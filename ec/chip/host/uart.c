@@ -35,6 +35,9 @@ static char capture_buf[CONSOLE_CAPTURE_SIZE];
 static int capture_size;
 static int capture_enabled;
 
+/* Characters the UART may still send, or -1 for no limit */
+static int tx_quota = -1;
+
 void test_capture_console(int enabled)
 {
 	if (enabled == capture_enabled)
@@ -61,6 +64,11 @@ const char *test_get_captured_console(void)
 	return (const char *)capture_buf;
 }
 
+void test_set_uart_tx_quota(int quota)
+{
+	tx_quota = quota;
+}
+
 static void uart_interrupt(void)
 {
 	uart_process_input();
@@ -95,7 +103,7 @@ void uart_tx_flush(void)
 
 int uart_tx_ready(void)
 {
-	return 1;
+	return tx_quota != 0;
 }
 
 int uart_rx_available(void)
@@ -105,6 +113,8 @@ int uart_rx_available(void)
 
 void uart_write_char(char c)
 {
+	if (tx_quota > 0)
+		tx_quota--;
 	if (capture_enabled)
 		test_capture_char(c);
 	printf("%c", c);
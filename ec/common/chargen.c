@@ -78,7 +78,9 @@ static int command_chargen(int argc, char **argv)
 			 * Let's let other tasks run for a bit while buffer is
 			 * being drained a little.
 			 */
-			usleep(BUFFER_DRAIN_TIME_US/10);
+			if (putc_ != uart_putc ||
+			    uart_tx_wait(1) == EC_ERROR_BUSY)
+				usleep(BUFFER_DRAIN_TIME_US/10);
 
 			current_time = get_time();
 
@@ -115,6 +115,57 @@ static int split_words(char *input, int *argc, char **argv)
 	return EC_SUCCESS;
 }
 
+/*
+ * Set once the command table is known to be in case-insensitive name order.
+ * The linker sorts it by section name, which gives that order as long as
+ * command names are lower case; if one is not, lookups fall back to scanning
+ * the whole table.
+ */
+static int cmds_sorted;
+
+/**
+ * Find the commands whose names start with a prefix.
+ *
+ * @param prefix	Prefix to look for; case is ignored.
+ * @param len		Length of prefix.
+ * @param first		Destination for the first matching command.
+ * @param end		Destination for the end of the matching commands.
+ */
+static void find_prefix_range(const char *prefix, int len,
+			      const struct console_command **first,
+			      const struct console_command **end)
+{
+	const struct console_command *lo = __cmds, *hi = __cmds_end;
+	const struct console_command *mid;
+
+	if (!cmds_sorted) {
+		*first = __cmds;
+		*end = __cmds_end;
+		return;
+	}
+
+	/* First command not before the prefix */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strncasecmp(mid->name, prefix, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*first = lo;
+
+	/* First command after the prefix */
+	hi = __cmds_end;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strncasecmp(mid->name, prefix, len) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*end = lo;
+}
+
 /**
  * Find a command by name.
  *
@@ -126,12 +177,14 @@ static int split_words(char *input, int *argc, char **argv)
  *
  * @return A pointer to the command structure, or NULL if no match found.
  */
-static const struct console_command *find_command(char *name)
+test_export_static const struct console_command *find_command(char *name)
 {
-	const struct console_command *cmd, *match = NULL;
+	const struct console_command *cmd, *end, *match = NULL;
 	int match_length = strlen(name);
 
-	for (cmd = __cmds; cmd < __cmds_end; cmd++) {
+	find_prefix_range(name, match_length, &cmd, &end);
+
+	for (; cmd < end; cmd++) {
 		if (!strncasecmp(name, cmd->name, match_length)) {
 			if (match)
 				return NULL;
@@ -148,7 +201,6 @@ static const struct console_command *find_command(char *name)
 	return match;
 }
 
-
 static const char *const errmsgs[] = {
 	"OK",
 	"Unknown error",
@@ -169,7 +221,7 @@ static const char *const errmsgs[] = {
  *
  * @return EC_SUCCESS, or non-zero if error.
  */
-static int handle_command(char *input)
+test_export_static int handle_command(char *input)
 {
 	const struct console_command *cmd;
 	char *argv[MAX_ARGS_PER_COMMAND];
@@ -268,7 +320,20 @@ command_has_error:
 
 static void console_init(void)
 {
+	const struct console_command *cmd;
+
 	*input_buf = '\0';
+
+	cmds_sorted = 1;
+	for (cmd = __cmds + 1; cmd < __cmds_end; cmd++) {
+		if (strcasecmp(cmd[-1].name, cmd->name) >= 0) {
+			ccprintf("Console command '%s' out of order\n",
+				 cmd->name);
+			cmds_sorted = 0;
+			break;
+		}
+	}
+
 #ifdef CONFIG_EXPERIMENTAL_CONSOLE
 	ccprintf("Enhanced Console is enabled (v1.0.0); type HELP for help.\n");
 #else
@@ -457,6 +522,80 @@ static int handle_esc(int c)
 
 	return -1;
 }
+
+/* Append a character to the line, with the cursor at the end of it */
+static void append_char(int c)
+{
+	/* Leave room for terminating null */
+	if (input_len >= sizeof(input_buf) - 1)
+		return;
+
+	console_putc(c);
+	input_buf[input_len++] = c;
+	input_buf[input_len] = '\0';
+	input_pos = input_len;
+}
+
+/**
+ * Complete the command name being typed.
+ *
+ * Expands the name as far as all the matching commands agree, and adds a
+ * space after it once only one command matches.  If that adds nothing, lists
+ * the matching commands.
+ */
+static void complete_command(void)
+{
+	const struct console_command *cmd, *first, *end, *match = NULL;
+	int matches = 0;
+	int common = 0;
+	int i;
+
+	/* Only the command name is completed, from the end of the line */
+	if (input_pos != input_len)
+		return;
+	for (i = 0; i < input_len; i++)
+		if (isspace(input_buf[i]))
+			return;
+
+	find_prefix_range(input_buf, input_len, &first, &end);
+
+	/* Find how much all the matches have in common */
+	for (cmd = first; cmd < end; cmd++) {
+		if (strncasecmp(input_buf, cmd->name, input_len))
+			continue;
+		if (!matches++) {
+			match = cmd;
+			common = strlen(cmd->name);
+			continue;
+		}
+		for (i = input_len; i < common; i++)
+			if (tolower(cmd->name[i]) != tolower(match->name[i]))
+				break;
+		common = i;
+	}
+
+	if (!matches)
+		return;
+
+	if (common > input_len || matches == 1) {
+		for (i = input_len; i < common; i++)
+			append_char(match->name[i]);
+		if (matches == 1)
+			append_char(' ');
+		return;
+	}
+
+	/* Ambiguous; show the choices and reprint the line */
+	ccputs("\n");
+	for (cmd = first; cmd < end; cmd++) {
+		if (strncasecmp(input_buf, cmd->name, input_len))
+			continue;
+		ccprintf("%s  ", cmd->name);
+		cflush();
+	}
+	ccputs("\n" PROMPT);
+	ccputs(input_buf);
+}
 #endif /* !defined(CONFIG_EXPERIMENTAL_CONSOLE) */
 
 static void console_handle_char(int c)
@@ -572,6 +711,10 @@ static void console_handle_char(int c)
 		input_buf[input_len] = '\0';
 		break;
 
+	case '\t':
+		complete_command();
+		break;
+
 	case CTRL('L'):
 		/* Reprint current */
 		ccputs("\x0c" PROMPT);
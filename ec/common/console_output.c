@@ -6,6 +6,7 @@
 /* Console output module for Chrome EC */
 
 #include "console.h"
+#include "printf.h"
 #include "uart.h"
 #include "usb_console.h"
 #include "util.h"
@@ -40,6 +41,15 @@ BUILD_ASSERT(CC_CHANNEL_COUNT <= 8*sizeof(uint32_t));
 /*****************************************************************************/
 /* Channel-based console output */
 
+int console_channel_is_disabled(enum console_channel channel)
+{
+#ifdef CONFIG_CONSOLE_CHANNEL
+	return !(CC_MASK(channel) & channel_mask);
+#else
+	return 0;
+#endif
+}
+
 int cputs(enum console_channel channel, const char *outstr)
 {
 	int rv1, rv2;
@@ -78,8 +88,10 @@ int cprintf(enum console_channel channel, const char *format, ...)
 	return rv1 == EC_SUCCESS ? rv2 : rv1;
 }
 
+#ifndef CONFIG_CONSOLE_TOKENIZED
 int cprints(enum console_channel channel, const char *format, ...)
 {
+	char ts_str[PRINTF_TIMESTAMP_BUF_SIZE];
 	int r, rv;
 	va_list args;
 
@@ -89,7 +101,8 @@ int cprints(enum console_channel channel, const char *format, ...)
 		return EC_SUCCESS;
 #endif
 
-	rv = cprintf(channel, "[%pT ", PRINTF_TIMESTAMP_NOW);
+	snprintf_timestamp_now(ts_str, sizeof(ts_str));
+	rv = cprintf(channel, "[%s ", ts_str);
 
 	va_start(args, format);
 	r = uart_vprintf(format, args);
@@ -106,6 +119,7 @@ int cprints(enum console_channel channel, const char *format, ...)
 	r = cputs(channel, "]\n");
 	return r ? r : rv;
 }
+#endif /* !CONFIG_CONSOLE_TOKENIZED */
 
 void cflush(void)
 {
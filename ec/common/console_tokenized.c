@@ -0,0 +1,135 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Tokenized console output.
+ *
+ * Instead of formatting cprints() output, send the offset of its format string
+ * in .log_strings, the time and the raw arguments.  A line is:
+ *
+ *   '$' base64(varint token, varint time in us, varint argument types,
+ *              arguments...) '\n'
+ *
+ * Integers are zigzag varints, whatever their size, and strings a varint
+ * length followed by the characters.  Arguments which do not fit are left
+ * out, and strings are cut short, so the host can tell from the argument
+ * types what is missing.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "link_defs.h"
+#include "timer.h"
+#include "util.h"
+
+/* Largest tokenized line, before base64 encoding */
+#define TOKENIZED_MAX 48
+
+/* Small negative numbers get short varints too */
+#define ZIGZAG(v) (((uint64_t)(v) << 1) ^ ((v) >> 63))
+
+static const char base64[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Append a varint; returns the new end, or NULL if it does not fit */
+static uint8_t *put_varint(uint8_t *out, const uint8_t *end, uint64_t v)
+{
+	do {
+		if (out == end)
+			return NULL;
+		*out = v & 0x7f;
+		v >>= 7;
+		if (v)
+			*out |= 0x80;
+		out++;
+	} while (v);
+
+	return out;
+}
+
+static uint8_t *put_string(uint8_t *out, const uint8_t *end, const char *s)
+{
+	int len;
+
+	if (!s)
+		s = "(NULL)";
+
+	/* Cut strings short to leave room for the length */
+	len = strnlen(s, 127);
+	if (len > end - out - 1)
+		len = end - out - 1;
+	if (len < 0)
+		return NULL;
+
+	*out++ = len;
+	memcpy(out, s, len);
+
+	return out + len;
+}
+
+int cprints_tokenized(enum console_channel channel, const char *format,
+		      uint32_t arg_types, ...)
+{
+	uint8_t buf[TOKENIZED_MAX];
+	const uint8_t *end = buf + sizeof(buf);
+	/* '$', 4 characters for each 3 bytes, '\n' and null */
+	char line[1 + (TOKENIZED_MAX + 2) / 3 * 4 + 2];
+	uint8_t *out = buf, *next;
+	uint32_t types;
+	va_list args;
+	int64_t v;
+	char *p;
+	int i;
+
+	/* Skip the encoding if it would be dropped anyway */
+	if (console_channel_is_disabled(channel))
+		return EC_SUCCESS;
+
+	/* These always fit */
+	out = put_varint(out, end, format - __log_strings);
+	out = put_varint(out, end, get_time().val);
+	out = put_varint(out, end, arg_types);
+
+	va_start(args, arg_types);
+	for (types = arg_types; types; types >>= 2) {
+		switch (types & 3) {
+		case CONSOLE_ARG_STRING:
+			next = put_string(out, end, va_arg(args, const char *));
+			break;
+		case CONSOLE_ARG_INT64:
+			v = va_arg(args, int64_t);
+			next = put_varint(out, end, ZIGZAG(v));
+			break;
+		default:
+			v = va_arg(args, int32_t);
+			next = put_varint(out, end, ZIGZAG(v));
+			break;
+		}
+		if (!next)
+			break;
+		out = next;
+	}
+	va_end(args);
+
+	p = line;
+	*p++ = '$';
+	for (i = 0; i < out - buf; i += 3) {
+		uint32_t chunk = buf[i] << 16;
+
+		if (i + 1 < out - buf)
+			chunk |= buf[i + 1] << 8;
+		if (i + 2 < out - buf)
+			chunk |= buf[i + 2];
+
+		*p++ = base64[chunk >> 18];
+		*p++ = base64[(chunk >> 12) & 0x3f];
+		*p++ = i + 1 < out - buf ? base64[(chunk >> 6) & 0x3f] : '=';
+		*p++ = i + 2 < out - buf ? base64[chunk & 0x3f] : '=';
+	}
+	*p++ = '\n';
+	*p = '\0';
+
+	return cputs(channel, line);
+}
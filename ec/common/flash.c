@@ -13,6 +13,7 @@
 #include "host_command.h"
 #include "otp.h"
 #include "rwsig.h"
+#include "sha256.h"
 #include "shared_mem.h"
 #include "system.h"
 #include "util.h"
@@ -1344,6 +1345,71 @@ DECLARE_HOST_COMMAND(EC_CMD_FLASH_READ,
 		     flash_command_read,
 		     EC_VER_MASK(0));
 
+#ifdef CONFIG_HOSTCMD_FLASH_BLOCK_HASH
+/* Most flash to hash in one command, unless a single block is larger */
+#define FLASH_BLOCK_HASH_MAX_SIZE (64 * 1024)
+
+static struct sha256_ctx block_hash_ctx;
+
+static int flash_hash_block(int offset, int size)
+{
+#ifdef CONFIG_MAPPED_STORAGE
+	const char *data;
+
+	if (flash_dataptr(offset, size, 1, &data) < 0)
+		return EC_ERROR_INVAL;
+
+	flash_lock_mapped_storage(1);
+	SHA256_update(&block_hash_ctx, (const uint8_t *)data, size);
+	flash_lock_mapped_storage(0);
+#else
+	char buf[2 * SHA256_BLOCK_SIZE];
+	int len;
+
+	for (; size > 0; offset += len, size -= len) {
+		len = MIN(size, sizeof(buf));
+		if (flash_read(offset, len, buf))
+			return EC_ERROR_UNKNOWN;
+		SHA256_update(&block_hash_ctx, (const uint8_t *)buf, len);
+	}
+#endif
+	return EC_SUCCESS;
+}
+
+static enum ec_status
+flash_command_block_hash(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_flash_block_hash *p = args->params;
+	struct ec_response_flash_block_hash *r = args->response;
+	uint32_t offset = p->offset + EC_FLASH_REGION_START;
+	int count, i;
+
+	if (!p->block_size || p->block_size > CONFIG_FLASH_SIZE)
+		return EC_RES_INVALID_PARAM;
+
+	count = MIN(p->num_blocks, args->response_max / SHA256_DIGEST_SIZE);
+	count = MIN(count, MAX(FLASH_BLOCK_HASH_MAX_SIZE / p->block_size, 1));
+	if (!count || !flash_range_ok(offset, count * p->block_size, 1))
+		return EC_RES_INVALID_PARAM;
+
+	for (i = 0; i < count; i++) {
+		SHA256_init(&block_hash_ctx);
+		if (flash_hash_block(offset + i * p->block_size, p->block_size))
+			return EC_RES_ERROR;
+		memcpy(r->hash[i], SHA256_final(&block_hash_ctx),
+		       SHA256_DIGEST_SIZE);
+	}
+
+	args->response_size = count * SHA256_DIGEST_SIZE;
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_FLASH_BLOCK_HASH,
+		     flash_command_block_hash,
+		     EC_VER_MASK(0));
+BUILD_ASSERT(SHA256_DIGEST_SIZE == EC_FLASH_BLOCK_HASH_SIZE);
+#endif /* CONFIG_HOSTCMD_FLASH_BLOCK_HASH */
+
 /**
  * Flash write command
  *
@@ -69,10 +69,38 @@ static const struct hook_ptrs hook_list[] = {
 	{__hooks_usb_pd_connect, __hooks_usb_pd_connect_end},
 };
 
-/* Times for deferrable functions */
-static int defer_new_call;
 static int hook_task_started;
 
+/*
+ * Deferred call scheduler.
+ *
+ * hook_call_deferred() only stores the requested deadline in
+ * __deferred_until[] and flags the routine in the dirty bitmap, which keeps
+ * it lock-free and safe to call from interrupts.  The hook task then moves
+ * flagged routines in or out of a min-heap of armed routines, ordered by a
+ * private copy of their deadline, so that it never has to scan all of them.
+ *
+ * All of it lives in __deferred_sched, reserved by the linker script: the
+ * deadline of each routine, the heap of routine indexes, the heap index + 1 of
+ * each routine (0 if it is not in the heap) and the dirty bitmap.
+ */
+#define DEFERRED_DEADLINE (__deferred_sched)
+#define DEFERRED_HEAP ((uint16_t *)(DEFERRED_DEADLINE + DEFERRED_FUNCS_COUNT))
+#define DEFERRED_HEAP_POS (DEFERRED_HEAP + DEFERRED_FUNCS_COUNT)
+#define DEFERRED_DIRTY ((atomic_t *)(DEFERRED_HEAP_POS + DEFERRED_FUNCS_COUNT))
+#define DEFERRED_DIRTY_WORDS DIV_ROUND_UP(DEFERRED_FUNCS_COUNT, 32)
+
+static int deferred_heap_size;
+
+/* Slack allowed on deferred deadlines, so they can share a wakeup */
+test_export_static int deferred_slack_us = CONFIG_HOOK_DEFERRED_SLACK_US;
+
+/* When the hook task will wake up next, if nothing wakes it earlier */
+static volatile uint64_t hook_next_wake;
+
+/* Number of times the hook task woke up from sleeping */
+test_export_static uint32_t hook_task_wakeups;
+
 #ifdef CONFIG_HOOK_DEBUG
 /* Stats for hooks */
 static uint64_t max_hook_tick_delay;
@@ -105,40 +133,97 @@ static void record_hook_delay(uint64_t now, uint64_t last, uint64_t interval,
 		CPRINTS("Hook at interval %d us delayed by %d us",
 			(uint32_t)interval, (uint32_t)delayed);
 }
+
+static void record_deferred_call(struct deferred_stats *stats, uint64_t late,
+				 uint64_t time)
+{
+	uint32_t late_us = MIN(late, UINT32_MAX);
+	uint32_t run_us = MIN(time, UINT32_MAX);
+
+	stats->count++;
+	if (late_us > stats->max_late_us)
+		stats->max_late_us = late_us;
+	stats->avg_late_us = ((uint64_t)stats->avg_late_us * 7 + late_us) >> 3;
+	if (run_us > stats->max_run_us)
+		stats->max_run_us = run_us;
+	stats->avg_run_us = ((uint64_t)stats->avg_run_us * 7 + run_us) >> 3;
+}
+
+static void record_hook_run_time(struct hook_stats *stats, uint64_t time)
+{
+	uint32_t run_time = MIN(time, UINT32_MAX);
+
+	if (run_time > stats->max_us)
+		stats->max_us = run_time;
+	stats->avg_us = ((uint64_t)stats->avg_us * 7 + run_time) >> 3;
+}
 #endif
 
+/*
+ * Index of each type's first hook in __hooks_sorted, plus one past the last
+ * type's hooks, filled in by sort_hooks().
+ */
+static uint16_t hook_sorted_start[ARRAY_SIZE(hook_list) + 1];
+static int hooks_sorted;
+
+/*
+ * Sort the hooks of every type by priority into __hooks_sorted, so that
+ * hook_notify() is a single pass over them.  This is an insertion sort, which
+ * is stable: hooks of equal priority keep their link order, as before.
+ *
+ * Called from the first hook_notify(), which always happens before the other
+ * tasks are enabled (at the latest, for HOOK_INIT), so this cannot race.
+ */
+static void sort_hooks(void)
+{
+	const struct hook_data **sorted = __hooks_sorted;
+	const struct hook_data *p;
+	int type, count, i;
+
+	for (type = 0; type < ARRAY_SIZE(hook_list); type++) {
+		hook_sorted_start[type] = sorted - __hooks_sorted;
+
+		count = 0;
+		for (p = hook_list[type].start; p < hook_list[type].end; p++) {
+			for (i = count; i > 0; i--) {
+				if (sorted[i - 1]->priority <= p->priority)
+					break;
+				sorted[i] = sorted[i - 1];
+			}
+			sorted[i] = p;
+			count++;
+		}
+		sorted += count;
+	}
+	hook_sorted_start[type] = sorted - __hooks_sorted;
+
+	hooks_sorted = 1;
+}
+
 void hook_notify(enum hook_type type)
 {
-	const struct hook_data *start, *end, *p;
-	int count, called = 0;
-	int last_prio = HOOK_PRIO_FIRST - 1, prio;
+	int i, end;
 #ifdef CONFIG_HOOK_DEBUG
 	uint64_t start_time = get_time().val;
-	uint64_t run_time;
+	uint64_t hook_time, run_time;
 #endif
 
 	CPRINTS("hook notify %d", type);
 
-	start = hook_list[type].start;
-	end = hook_list[type].end;
-	count = end - start;
+	if (!hooks_sorted)
+		sort_hooks();
 
 	/* Call all the hooks in priority order */
-	while (called < count) {
-		/* Find the lowest remaining priority */
-		for (p = start, prio = HOOK_PRIO_LAST + 1; p < end; p++) {
-			if (p->priority < prio && p->priority > last_prio)
-				prio = p->priority;
-		}
-		last_prio = prio;
-
-		/* Call all the hooks with that priority */
-		for (p = start; p < end; p++) {
-			if (p->priority == prio) {
-				called++;
-				p->routine();
-			}
-		}
+	end = hook_sorted_start[type + 1];
+	for (i = hook_sorted_start[type]; i < end; i++) {
+#ifdef CONFIG_HOOK_DEBUG
+		hook_time = get_time().val;
+#endif
+		__hooks_sorted[i]->routine();
+#ifdef CONFIG_HOOK_DEBUG
+		record_hook_run_time(__hook_stats + i,
+				     get_time().val - hook_time);
+#endif
 	}
 
 #ifdef CONFIG_HOOK_DEBUG
@@ -149,31 +234,182 @@ void hook_notify(enum hook_type type)
 #endif
 }
 
+/*****************************************************************************/
+/* Deferred call heap, only touched by the hook task */
+
+static inline int deferred_before(int a, int b)
+{
+	return DEFERRED_DEADLINE[DEFERRED_HEAP[a]] <
+	       DEFERRED_DEADLINE[DEFERRED_HEAP[b]];
+}
+
+static void deferred_heap_swap(int a, int b)
+{
+	uint16_t i = DEFERRED_HEAP[a];
+
+	DEFERRED_HEAP[a] = DEFERRED_HEAP[b];
+	DEFERRED_HEAP[b] = i;
+	DEFERRED_HEAP_POS[DEFERRED_HEAP[a]] = a + 1;
+	DEFERRED_HEAP_POS[DEFERRED_HEAP[b]] = b + 1;
+}
+
+static void deferred_sift_up(int h)
+{
+	while (h > 0 && deferred_before(h, (h - 1) / 2)) {
+		deferred_heap_swap(h, (h - 1) / 2);
+		h = (h - 1) / 2;
+	}
+}
+
+static void deferred_sift_down(int h)
+{
+	int child;
+
+	while ((child = 2 * h + 1) < deferred_heap_size) {
+		if (child + 1 < deferred_heap_size &&
+		    deferred_before(child + 1, child))
+			child++;
+		if (!deferred_before(child, h))
+			break;
+		deferred_heap_swap(h, child);
+		h = child;
+	}
+}
+
+static void deferred_heap_remove(int i)
+{
+	int h = DEFERRED_HEAP_POS[i] - 1;
+
+	DEFERRED_HEAP_POS[i] = 0;
+	if (h == --deferred_heap_size)
+		return;
+
+	DEFERRED_HEAP[h] = DEFERRED_HEAP[deferred_heap_size];
+	DEFERRED_HEAP_POS[DEFERRED_HEAP[h]] = h + 1;
+	deferred_sift_up(h);
+	deferred_sift_down(h);
+}
+
+static void deferred_heap_insert(int i, uint64_t deadline)
+{
+	int h = deferred_heap_size++;
+
+	DEFERRED_DEADLINE[i] = deadline;
+	DEFERRED_HEAP[h] = i;
+	DEFERRED_HEAP_POS[i] = h + 1;
+	deferred_sift_up(h);
+}
+
+static int deferred_is_dirty(int i)
+{
+	return DEFERRED_DIRTY[i / 32] & BIT(i % 32);
+}
+
+/* Move routines armed or canceled since the last call in or out of the heap */
+static void deferred_update_heap(void)
+{
+	uint32_t dirty;
+	uint64_t deadline;
+	int w, i;
+
+	for (w = 0; w < DEFERRED_DIRTY_WORDS; w++) {
+		if (!DEFERRED_DIRTY[w])
+			continue;
+
+		dirty = atomic_clear(DEFERRED_DIRTY + w);
+		while (dirty) {
+			i = w * 32 + get_next_bit(&dirty);
+
+			if (DEFERRED_HEAP_POS[i])
+				deferred_heap_remove(i);
+
+			/*
+			 * If this races with hook_call_deferred(), the routine
+			 * is flagged again and fixed up on the next pass.
+			 */
+			deadline = __deferred_until[i];
+			if (deadline)
+				deferred_heap_insert(i, deadline);
+		}
+	}
+}
+
+static int deferred_any_dirty(void)
+{
+	int w;
+
+	for (w = 0; w < DEFERRED_DIRTY_WORDS; w++)
+		if (DEFERRED_DIRTY[w])
+			return 1;
+
+	return 0;
+}
+
+/* Call all deferred routines which are due at time t */
+static void deferred_run_due(uint64_t t)
+{
+	int i;
+#ifdef CONFIG_HOOK_DEBUG
+	uint64_t call_time;
+#endif
+
+	while (deferred_heap_size) {
+		i = DEFERRED_HEAP[0];
+		if (DEFERRED_DEADLINE[i] > t)
+			break;
+
+		/* Re-armed or canceled since; look at it on the next pass */
+		if (deferred_is_dirty(i))
+			break;
+
+		CPRINTS("hook call deferred 0x%pP",
+			__deferred_funcs[i].routine);
+		/*
+		 * Call deferred function.  Clear timer first, so it can
+		 * request itself be called later.
+		 */
+		deferred_heap_remove(i);
+		__deferred_until[i] = 0;
+#ifdef CONFIG_HOOK_DEBUG
+		call_time = get_time().val;
+#endif
+		__deferred_funcs[i].routine();
+#ifdef CONFIG_HOOK_DEBUG
+		record_deferred_call(__deferred_stats + i,
+				     call_time - DEFERRED_DEADLINE[i],
+				     get_time().val - call_time);
+#endif
+	}
+}
+
 int hook_call_deferred(const struct deferred_data *data, int us)
 {
 	int i = data - __deferred_funcs;
+	uint64_t deadline;
 
 	if (data < __deferred_funcs || data >= __deferred_funcs_end)
 		return EC_ERROR_INVAL;  /* Routine not registered */
 
 	if (us == -1) {
-		/* Cancel */
+		/* Cancel; the hook task will notice on its next wakeup */
 		__deferred_until[i] = 0;
-	} else {
-		/* Set alarm */
-		__deferred_until[i] = get_time().val + us;
-		/*
-		 * Flag that hook_call_deferred() has been called.  If the hook
-		 * task is already active, this will allow it to go through the
-		 * loop one more time before sleeping.
-		 */
-		defer_new_call = 1;
-
-		/* Wake task so it can re-sleep for the proper time */
-		if (hook_task_started)
-			task_wake(TASK_ID_HOOKS);
+		atomic_or(DEFERRED_DIRTY + i / 32, BIT(i % 32));
+		return EC_SUCCESS;
 	}
 
+	/* Set alarm */
+	deadline = get_time().val + us;
+	__deferred_until[i] = deadline;
+	atomic_or(DEFERRED_DIRTY + i / 32, BIT(i % 32));
+
+	/*
+	 * Only wake the hook task if it would otherwise sleep past the slack
+	 * window of this deadline.  If it is not sleeping, it sees the dirty
+	 * flag before it goes back to sleep.
+	 */
+	if (hook_task_started && deadline + deferred_slack_us < hook_next_wake)
+		task_wake(TASK_ID_HOOKS);
+
 	return EC_SUCCESS;
 }
 
@@ -194,22 +430,12 @@ void hook_task(void *u)
 
 	while (1) {
 		uint64_t t = get_time().val;
+		uint64_t deadline;
 		int next = 0;
-		int i;
 
 		/* Handle deferred routines */
-		for (i = 0; i < DEFERRED_FUNCS_COUNT; i++) {
-			if (__deferred_until[i] && __deferred_until[i] < t) {
-				CPRINTS("hook call deferred 0x%pP",
-					__deferred_funcs[i].routine);
-				/*
-				 * Call deferred function.  Clear timer first,
-				 * so it can request itself be called later.
-				 */
-				__deferred_until[i] = 0;
-				__deferred_funcs[i].routine();
-			}
-		}
+		deferred_update_heap();
+		deferred_run_due(t);
 
 		if (t - last_tick >= HOOK_TICK_INTERVAL) {
 #ifdef CONFIG_HOOK_DEBUG
@@ -241,26 +467,31 @@ void hook_task(void *u)
 		if (last_tick + HOOK_TICK_INTERVAL > t)
 			next = last_tick + HOOK_TICK_INTERVAL - t;
 
-		/* Wake earlier if needed by a deferred routine */
-		defer_new_call = 0;
-
-		for (i = 0; i < DEFERRED_FUNCS_COUNT && next > 0; i++) {
-			if (!__deferred_until[i])
-				continue;
-
-			if (__deferred_until[i] < t)
+		/*
+		 * Wake earlier if needed by a deferred routine, but no earlier
+		 * than the slack allows, so later deadlines within it are
+		 * handled by the same wakeup.
+		 */
+		deferred_update_heap();
+		if (deferred_heap_size && next > 0) {
+			deadline = DEFERRED_DEADLINE[DEFERRED_HEAP[0]] +
+				   deferred_slack_us;
+			if (deadline <= t)
 				next = 0;
-			else if (__deferred_until[i] - t < next)
-				next = __deferred_until[i] - t;
+			else if (deadline - t < next)
+				next = deadline - t;
 		}
+		hook_next_wake = t + next;
 
 		/*
 		 * If nothing is immediately pending, and hook_call_deferred()
-		 * hasn't been called since we started calculating next, sleep
+		 * hasn't been called since we last updated the heap, sleep
 		 * until the next event.
 		 */
-		if (next > 0 && !defer_new_call)
+		if (next > 0 && !deferred_any_dirty()) {
 			task_wait_event(next);
+			hook_task_wakeups++;
+		}
 	}
 }
 
@@ -280,7 +511,7 @@ static void print_hook_delay(uint32_t interval, uint32_t delay, uint32_t avg)
 
 static int command_stats(int argc, char **argv)
 {
-	int i;
+	int i, j;
 
 	ccprintf("HOOK_TICK:\n");
 	print_hook_delay(HOOK_TICK_INTERVAL, max_hook_tick_delay,
@@ -290,14 +521,50 @@ static int command_stats(int argc, char **argv)
 	print_hook_delay(SECOND, max_hook_second_delay, avg_hook_second_delay);
 
 	ccprintf("Max run time for each hook:\n");
-	for (i = 0; i < ARRAY_SIZE(hook_list); ++i)
+	for (i = 0; i < ARRAY_SIZE(hook_list); ++i) {
 		ccprintf("%3d:%6d us (Avg: %5d us)\n", i,
 			 (uint32_t)max_hook_run_time[i],
 			 (uint32_t)avg_hook_run_time[i]);
 
+		if (!hooks_sorted)
+			continue;
+
+		for (j = hook_sorted_start[i]; j < hook_sorted_start[i + 1];
+		     j++)
+			ccprintf("    %4d %pP:%6d us (Avg: %5d us)\n",
+				 __hooks_sorted[j]->priority,
+				 __hooks_sorted[j]->routine,
+				 __hook_stats[j].max_us,
+				 __hook_stats[j].avg_us);
+		cflush();
+	}
+
 	return EC_SUCCESS;
 }
 DECLARE_CONSOLE_COMMAND(hookstats, command_stats,
 			NULL,
 			"Print stats of hooks");
+
+static int command_deferred(int argc, char **argv)
+{
+	const struct deferred_stats *stats;
+	int i;
+
+	ccprintf("Hook task wakeups: %d, slack %d us, %d armed\n",
+		 hook_task_wakeups, deferred_slack_us, deferred_heap_size);
+	ccprintf("  Calls   Late max/avg us    Run max/avg us  Routine\n");
+	for (i = 0; i < DEFERRED_FUNCS_COUNT; i++) {
+		stats = __deferred_stats + i;
+		ccprintf("%7d %9d/%-7d %9d/%-7d %pP\n", stats->count,
+			 stats->max_late_us, stats->avg_late_us,
+			 stats->max_run_us, stats->avg_run_us,
+			 __deferred_funcs[i].routine);
+		cflush();
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(deferred, command_deferred,
+			NULL,
+			"Print stats of deferred calls");
 #endif
@@ -362,6 +362,55 @@ host_packet_bad:
 	host_packet_respond(&args0);
 }
 
+#ifdef CONFIG_HOSTCMD_HASH
+/* Fibonacci hashing of a command number to a slot of the hash table */
+#define HCMD_HASH(command, bits) \
+	(((uint32_t)(command) * 2654435769u) >> (32 - (bits)))
+
+/* log2 of the number of slots of the hash table, 0 until it is built */
+static int hcmd_hash_bits;
+
+/*
+ * Fill the hash table, with open addressing and linear probing.  Each slot
+ * holds the index of a host command plus one, so that 0 marks an empty slot.
+ * The table has at least 1.5 slots per host command, so probe sequences stay
+ * short, even for invalid command numbers.
+ */
+static void hcmd_hash_build(void)
+{
+	int bits = __fls(__hcmds_hash_end - __hcmds_hash);
+	uint32_t mask = BIT(bits) - 1;
+	const struct host_command *cmd;
+	uint32_t slot;
+
+	memset(__hcmds_hash, 0, sizeof(__hcmds_hash[0]) << bits);
+
+	for (cmd = __hcmds; cmd < __hcmds_end; cmd++) {
+		slot = HCMD_HASH(cmd->command, bits);
+		while (__hcmds_hash[slot])
+			slot = (slot + 1) & mask;
+		__hcmds_hash[slot] = cmd - __hcmds + 1;
+	}
+
+	hcmd_hash_bits = bits;
+}
+
+static const struct host_command *hcmd_hash_find(int command)
+{
+	int bits = hcmd_hash_bits;
+	uint32_t slot = HCMD_HASH(command, bits);
+	const struct host_command *cmd;
+
+	for (; __hcmds_hash[slot]; slot = (slot + 1) & (BIT(bits) - 1)) {
+		cmd = __hcmds + __hcmds_hash[slot] - 1;
+		if (cmd->command == command)
+			return cmd;
+	}
+
+	return NULL;
+}
+#endif
+
 /**
  * Find a command by command number.
  *
@@ -370,6 +419,12 @@ host_packet_bad:
  */
 static const struct host_command *find_host_command(int command)
 {
+#ifdef CONFIG_HOSTCMD_HASH
+	/* Until the host command task builds the hash table, search */
+	if (hcmd_hash_bits)
+		return hcmd_hash_find(command);
+#endif
+
 	if (IS_ENABLED(CONFIG_ZEPHYR)) {
 		/* TODO(b/172678200): shim host commands for Zephyr */
 		return NULL;
@@ -425,6 +480,10 @@ static void host_command_init(void)
 #ifdef CONFIG_SUPPRESSED_HOST_COMMANDS
 	suppressed_cmd_deadline.val = get_time().val + SUPPRESSED_CMD_INTERVAL;
 #endif
+
+#ifdef CONFIG_HOSTCMD_HASH
+	hcmd_hash_build();
+#endif
 }
 
 void host_command_task(void *u)
@@ -670,10 +729,25 @@ static void host_command_debug_request(struct host_cmd_handler_args *args)
 		CPRINTS("HC 0x%02x", args->command);
 }
 
+#ifdef CONFIG_HOSTCMD_STATS
+static void hcmd_record_stats(const struct host_command *cmd, uint32_t us)
+{
+	struct host_command_stats *stats = &__hcmd_stats[cmd - __hcmds];
+	int bucket = us ? MIN(__fls(us), EC_HOSTCMD_STATS_BUCKETS - 1) : 0;
+
+	stats->count++;
+	if (stats->histogram[bucket] < UINT16_MAX)
+		stats->histogram[bucket]++;
+}
+#endif
+
 uint16_t host_command_process(struct host_cmd_handler_args *args)
 {
 	const struct host_command *cmd;
 	int rv;
+#ifdef CONFIG_HOSTCMD_STATS
+	uint32_t start;
+#endif
 
 	if (hcdebug)
 		host_command_debug_request(args);
@@ -715,8 +789,15 @@ uint16_t host_command_process(struct host_cmd_handler_args *args)
 			rv = EC_RES_INVALID_COMMAND;
 		else if (!(EC_VER_MASK(args->version) & cmd->version_mask))
 			rv = EC_RES_INVALID_VERSION;
-		else
+		else {
+#ifdef CONFIG_HOSTCMD_STATS
+			start = get_time().le.lo;
 			rv = cmd->handler(args);
+			hcmd_record_stats(cmd, get_time().le.lo - start);
+#else
+			rv = cmd->handler(args);
+#endif
+		}
 	}
 
 	if (rv != EC_RES_SUCCESS)
@@ -729,6 +810,43 @@ uint16_t host_command_process(struct host_cmd_handler_args *args)
 	return rv;
 }
 
+#ifdef CONFIG_HOSTCMD_STATS
+static enum ec_status hostcmd_stats(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_hostcmd_stats *p = args->params;
+	struct ec_response_hostcmd_stats *r = args->response;
+	struct ec_hostcmd_stats_entry *entry;
+	struct host_command_stats *stats;
+	int total = __hcmds_end - __hcmds;
+	int i;
+
+	if (p->offset > total)
+		return EC_RES_INVALID_PARAM;
+
+	r->total = total;
+	r->count = MIN(total - p->offset,
+		       (args->response_max - sizeof(*r)) / sizeof(*entry));
+
+	for (i = 0; i < r->count; i++) {
+		entry = &r->entries[i];
+		stats = &__hcmd_stats[p->offset + i];
+
+		entry->command = __hcmds[p->offset + i].command;
+		entry->count = stats->count;
+		memcpy(entry->histogram, stats->histogram,
+		       sizeof(entry->histogram));
+
+		if (p->flags & EC_HOSTCMD_STATS_FLAG_CLEAR)
+			memset(stats, 0, sizeof(*stats));
+	}
+
+	args->response_size = sizeof(*r) + r->count * sizeof(*entry);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_HOSTCMD_STATS, hostcmd_stats, EC_VER_MASK(0));
+#endif
+
 #ifdef CONFIG_HOST_COMMAND_STATUS
 /* Returns current command status (busy or not) */
 static enum ec_status
@@ -0,0 +1,141 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Run several host commands from a single request */
+
+#include "common.h"
+#include "host_command.h"
+#include "util.h"
+
+/*
+ * Response buffer of the batched commands. Each command gets a buffer as big
+ * as a lone host packet, as handlers rarely check response_max; the response
+ * is then copied into the batch if it fits. It is not taken from shared
+ * memory, which batched commands may need themselves.
+ */
+static uint8_t scratch[EC_LPC_HOST_PACKET_SIZE] __aligned(4);
+
+/* Sum of the bytes of a request or response and its data */
+static uint8_t batch_checksum(const void *packet, int size)
+{
+	const uint8_t *p = packet;
+	uint8_t csum = 0;
+
+	while (size--)
+		csum += *p++;
+
+	return csum;
+}
+
+static void batch_send_response(struct host_cmd_handler_args *args)
+{
+	/* Responses go out with the whole batch */
+}
+
+/*
+ * Check the framing of a batched request; returns EC_RES_SUCCESS if it can be
+ * run.
+ */
+static enum ec_status batch_check_request(const uint8_t *in,
+					  const uint8_t *in_end)
+{
+	const struct ec_host_request *req =
+		(const struct ec_host_request *)in;
+	int size = in_end - in;
+
+	/* Padding of the previous request may go past the end */
+	if (size < (int)sizeof(*req) ||
+	    size < (int)sizeof(*req) + req->data_len)
+		return EC_RES_REQUEST_TRUNCATED;
+
+	if (req->struct_version != EC_HOST_REQUEST_VERSION)
+		return EC_RES_INVALID_HEADER;
+
+	if (batch_checksum(req, sizeof(*req) + req->data_len))
+		return EC_RES_INVALID_CHECKSUM;
+
+	if (req->command == EC_CMD_BATCH)
+		return EC_RES_INVALID_COMMAND;
+
+	return EC_RES_SUCCESS;
+}
+
+static enum ec_status host_command_batch(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_batch *p = args->params;
+	struct ec_response_batch *r = args->response;
+	const uint8_t *in = p->requests;
+	const uint8_t *in_end = (const uint8_t *)args->params +
+				args->params_size;
+	uint8_t *out = r->responses;
+	uint8_t *out_end = (uint8_t *)args->response + args->response_max;
+	const struct ec_host_request *req;
+	struct ec_host_response *resp;
+	struct host_cmd_handler_args sub;
+	enum ec_status result;
+	int i, stop;
+
+	if (args->params_size < sizeof(*p) || args->response_max < sizeof(*r))
+		return EC_RES_INVALID_PARAM;
+
+	for (i = 0; i < p->count; i++) {
+		if (out_end - out < EC_BATCH_ENTRY_SIZE(*resp, 0))
+			break;
+
+		req = (const struct ec_host_request *)in;
+		resp = (struct ec_host_response *)out;
+
+		sub.response_size = 0;
+		result = batch_check_request(in, in_end);
+		/* Past a badly framed request, the next one cannot be found */
+		stop = result != EC_RES_SUCCESS;
+
+		if (!stop) {
+			sub.send_response = batch_send_response;
+			sub.command = req->command;
+			sub.version = req->command_version;
+			sub.params = req + 1;
+			sub.params_size = req->data_len;
+			sub.response = scratch;
+			sub.response_max = MIN(args->response_max,
+					       sizeof(scratch));
+			sub.result = EC_RES_SUCCESS;
+			result = host_command_process(&sub);
+
+			if (result != EC_RES_SUCCESS) {
+				sub.response_size = 0;
+				stop = p->flags & EC_BATCH_FLAG_STOP_ON_ERROR;
+			} else if (out_end - out < EC_BATCH_ENTRY_SIZE(
+					 *resp, sub.response_size)) {
+				/* It ran, but its data does not fit */
+				result = EC_RES_RESPONSE_TOO_BIG;
+				sub.response_size = 0;
+				stop = 1;
+			}
+		}
+
+		resp->struct_version = EC_HOST_RESPONSE_VERSION;
+		resp->checksum = 0;
+		resp->result = result;
+		resp->data_len = sub.response_size;
+		resp->reserved = 0;
+		memcpy(resp + 1, scratch, sub.response_size);
+		resp->checksum = -batch_checksum(resp, sizeof(*resp) +
+						 sub.response_size);
+
+		out += EC_BATCH_ENTRY_SIZE(*resp, sub.response_size);
+		r->count++;
+
+		if (stop)
+			break;
+
+		in += EC_BATCH_ENTRY_SIZE(*req, req->data_len);
+	}
+
+	args->response_size = out - (uint8_t *)r;
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_BATCH, host_command_batch, EC_VER_MASK(0));
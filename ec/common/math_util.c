@@ -283,6 +283,103 @@ void rotate_inv(const intv3_t v, const mat33_fp_t R, intv3_t res)
 	res[2] = FP_TO_INT(fp_div(t[2], deter));
 }
 
+/* Batched version of the R == NULL case of rotate() and rotate_inv() */
+static void copy_batch(const intv3_batch_t v, const intv3_batch_t res, int n)
+{
+	int k;
+
+	for (k = X; k <= Z; k++)
+		if (v[k] != res[k])
+			memcpy(res[k], v[k], n * sizeof(int));
+}
+
+void rotate_batch(const intv3_batch_t v, const mat33_fp_t R,
+		  const intv3_batch_t res, int n)
+{
+	mat33_fp_t r;
+	int i;
+
+	if (R == NULL) {
+		copy_batch(v, res, n);
+		return;
+	}
+
+	/* Local copy, so the compiler knows results don't alias it */
+	memcpy(r, R, sizeof(r));
+
+	for (i = 0; i < n; i++) {
+		const fp_inter_t x = v[X][i], y = v[Y][i], z = v[Z][i];
+
+		res[X][i] = FP_TO_INT(x * r[0][0] + y * r[1][0] + z * r[2][0]);
+		res[Y][i] = FP_TO_INT(x * r[0][1] + y * r[1][1] + z * r[2][1]);
+		res[Z][i] = FP_TO_INT(x * r[0][2] + y * r[1][2] + z * r[2][2]);
+	}
+}
+
+void rotate_inv_batch(const intv3_batch_t v, const mat33_fp_t R,
+		      const intv3_batch_t res, int n)
+{
+	mat33_fp_t c;
+	fp_t deter;
+	int i;
+
+	if (R == NULL) {
+		copy_batch(v, res, n);
+		return;
+	}
+
+	/* Same cofactors and determinant as rotate_inv(), computed once */
+	c[0][0] = fp_mul(R[1][1], R[2][2]) - fp_mul(R[2][1], R[1][2]);
+	c[0][1] = fp_mul(R[1][0], R[2][2]) - fp_mul(R[1][2], R[2][0]);
+	c[0][2] = fp_mul(R[1][0], R[2][1]) - fp_mul(R[2][0], R[1][1]);
+	c[1][0] = fp_mul(R[0][1], R[2][2]) - fp_mul(R[0][2], R[2][1]);
+	c[1][1] = fp_mul(R[0][0], R[2][2]) - fp_mul(R[0][2], R[2][0]);
+	c[1][2] = fp_mul(R[0][0], R[2][1]) - fp_mul(R[2][0], R[0][1]);
+	c[2][0] = fp_mul(R[0][1], R[1][2]) - fp_mul(R[0][2], R[1][1]);
+	c[2][1] = fp_mul(R[0][0], R[1][2]) - fp_mul(R[1][0], R[0][2]);
+	c[2][2] = fp_mul(R[0][0], R[1][1]) - fp_mul(R[1][0], R[0][1]);
+
+	deter = fp_mul(R[0][0], c[0][0]) -
+		fp_mul(R[0][1], c[0][1]) +
+		fp_mul(R[0][2], c[0][2]);
+
+	for (i = 0; i < n; i++) {
+		const fp_inter_t x = v[X][i], y = v[Y][i], z = v[Z][i];
+
+		res[X][i] = FP_TO_INT(fp_div(x * c[0][0] - y * c[0][1] +
+					     z * c[0][2], deter));
+		res[Y][i] = FP_TO_INT(fp_div(-x * c[1][0] + y * c[1][1] -
+					     z * c[1][2], deter));
+		res[Z][i] = FP_TO_INT(fp_div(x * c[2][0] - y * c[2][1] +
+					     z * c[2][2], deter));
+	}
+}
+
+void vector_magnitude_batch(const intv3_batch_t v, int *res, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		res[i] = int_sqrtf((fp_inter_t)v[X][i] * v[X][i] +
+				   (fp_inter_t)v[Y][i] * v[Y][i] +
+				   (fp_inter_t)v[Z][i] * v[Z][i]);
+}
+
+void cross_product_batch(const intv3_batch_t v1, const intv3_batch_t v2,
+			 const intv3_batch_t v, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		const fp_inter_t x1 = v1[X][i], y1 = v1[Y][i], z1 = v1[Z][i];
+		const fp_inter_t x2 = v2[X][i], y2 = v2[Y][i], z2 = v2[Z][i];
+
+		v[X][i] = y1 * z2 - z1 * y2;
+		v[Y][i] = z1 * x2 - x1 * z2;
+		v[Z][i] = x1 * y2 - y1 * x2;
+	}
+}
+
 /* division that round to the nearest integer */
 int round_divide(int64_t dividend, int divisor)
 {
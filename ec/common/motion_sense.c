@@ -1308,6 +1308,19 @@ static enum ec_status host_cmd_motion_sense(struct host_cmd_handler_args *args)
 			&(args->response_size));
 		args->response_size += sizeof(out->fifo_read);
 		break;
+	case MOTIONSENSE_CMD_FIFO_READ_COMPACT:
+		if (!IS_ENABLED(CONFIG_ACCEL_FIFO))
+			return EC_RES_INVALID_PARAM;
+		out->fifo_read_compact.number_data =
+			motion_sense_fifo_read_compact(
+				args->response_max -
+					sizeof(out->fifo_read_compact),
+				in->fifo_read_compact.max_data_vector,
+				out->fifo_read_compact.data,
+				&out->fifo_read_compact.size);
+		args->response_size = sizeof(out->fifo_read_compact) +
+			out->fifo_read_compact.size;
+		break;
 	case MOTIONSENSE_CMD_FIFO_INT_ENABLE:
 		if (!IS_ENABLED(CONFIG_ACCEL_FIFO))
 			return EC_RES_INVALID_PARAM;
@@ -590,6 +590,135 @@ int motion_sense_fifo_read(int capacity_bytes, int max_count, void *out,
 	return count;
 }
 
+/**
+ * Compute the compact header sensor bits of an entry.
+ *
+ * @return The sensor bits, or -1 if the sensor number can't be encoded.
+ */
+static int compact_sensor(const struct ec_response_motion_sensor_data *data)
+{
+	if (data->sensor_num == 0xff)
+		return MOTIONSENSE_COMPACT_NO_SENSOR;
+	if (data->sensor_num >= MOTIONSENSE_COMPACT_NO_SENSOR)
+		return -1;
+	return data->sensor_num;
+}
+
+/**
+ * Check if a timestamp entry can be encoded without its flags, that is in a
+ * MOTIONSENSE_COMPACT_SAMPLE or MOTIONSENSE_COMPACT_TIMESTAMP record. Async
+ * events such as flushes are timestamps with extra flags.
+ */
+static bool
+is_compact_timestamp(const struct ec_response_motion_sensor_data *data)
+{
+	return data->flags == MOTIONSENSE_SENSOR_FLAG_TIMESTAMP;
+}
+
+/**
+ * Check if a data entry can be encoded without its flags, that is in a
+ * MOTIONSENSE_COMPACT_SAMPLE or MOTIONSENSE_COMPACT_DATA record.
+ */
+static bool is_compact_data(const struct ec_response_motion_sensor_data *data)
+{
+	return !(data->flags & ~MOTIONSENSE_SENSOR_FLAG_TABLET_MODE) &&
+	       data->sensor_num < MOTIONSENSE_COMPACT_NO_SENSOR;
+}
+
+int motion_sense_fifo_read_compact(int capacity_bytes, int max_count,
+				   void *out, uint16_t *out_size)
+{
+	uint8_t *buf = out;
+	uint32_t prev_ts = 0;
+	bool has_prev_ts = false;
+	int count, i, n, size = 0;
+
+	mutex_lock(&g_sensor_mutex);
+	count = MIN(queue_count(&fifo), max_count);
+
+	for (i = 0; i < count; i += n) {
+		/* The entry to encode and the one after it, if any */
+		struct ec_response_motion_sensor_data entries[2];
+		struct ec_response_motion_sensor_data *data = &entries[0];
+		struct ec_response_motion_sensor_data *next = NULL;
+		int32_t dt = 0;
+		int16_t dt16;
+		uint8_t header;
+		int sensor;
+		int len;
+
+		n = MIN(count - i, (int)ARRAY_SIZE(entries));
+		if (queue_peek_units(&fifo, entries, i, n) > 1)
+			next = &entries[1];
+		sensor = compact_sensor(data);
+
+		if (is_timestamp(data))
+			dt = data->timestamp - prev_ts;
+
+		n = 1;
+		if (is_compact_timestamp(data) && has_prev_ts && next &&
+		    is_compact_data(next) &&
+		    next->sensor_num == data->sensor_num &&
+		    dt >= INT16_MIN && dt <= INT16_MAX) {
+			n = 2;
+			header = MOTIONSENSE_COMPACT_SAMPLE | sensor;
+			len = 1 + sizeof(dt16) + sizeof(next->data);
+		} else if (is_compact_timestamp(data) && sensor >= 0) {
+			header = MOTIONSENSE_COMPACT_TIMESTAMP | sensor;
+			len = 1 + sizeof(data->timestamp);
+		} else if (is_compact_data(data)) {
+			header = MOTIONSENSE_COMPACT_DATA | sensor;
+			len = 1 + sizeof(data->data);
+		} else {
+			header = MOTIONSENSE_COMPACT_RAW;
+			len = 1 + sizeof(*data);
+		}
+
+		if (size + len > capacity_bytes)
+			break;
+
+		if (is_timestamp(data)) {
+			prev_ts = data->timestamp;
+			has_prev_ts = true;
+		}
+		/* The data entry of a sample carries the tablet mode flag */
+		if (n == 2)
+			data = next;
+		if ((header & MOTIONSENSE_COMPACT_TYPE_MASK) !=
+		    MOTIONSENSE_COMPACT_RAW &&
+		    (data->flags & MOTIONSENSE_SENSOR_FLAG_TABLET_MODE))
+			header |= MOTIONSENSE_COMPACT_TABLET_MODE;
+
+		buf[size++] = header;
+		switch (header & MOTIONSENSE_COMPACT_TYPE_MASK) {
+		case MOTIONSENSE_COMPACT_SAMPLE:
+			dt16 = dt;
+			memcpy(buf + size, &dt16, sizeof(dt16));
+			size += sizeof(dt16);
+			/* fallthrough */
+		case MOTIONSENSE_COMPACT_DATA:
+			memcpy(buf + size, data->data, sizeof(data->data));
+			size += sizeof(data->data);
+			break;
+		case MOTIONSENSE_COMPACT_TIMESTAMP:
+			memcpy(buf + size, &data->timestamp,
+			       sizeof(data->timestamp));
+			size += sizeof(data->timestamp);
+			break;
+		default:
+			memcpy(buf + size, data, sizeof(*data));
+			size += sizeof(*data);
+			break;
+		}
+	}
+
+	queue_advance_head(&fifo, i);
+	mutex_unlock(&g_sensor_mutex);
+	*out_size = size;
+
+	return i;
+}
+
 void motion_sense_fifo_reset(void)
 {
 	next_timestamp_initialized = 0;
@@ -31,19 +31,91 @@ static inline int divmod(uint32_t *n, int d)
 }
 #endif
 
+static const char lower_digits[] = "0123456789abcdef";
+static const char upper_digits[] = "0123456789ABCDEF";
+
+/* Each number from 0 to 99, as two decimal digits */
+static const char digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324"
+	"25262728293031323334353637383940414243444546474849"
+	"50515253545556575859606162636465666768697071727374"
+	"75767778798081828384858687888990919293949596979899";
+
 /**
- * Convert the lowest nibble of a number to hex
+ * Convert a number to decimal, two digits at a time.
  *
- * @param c	Number to extract lowest nibble from
+ * @param end	End of the buffer; digits are written backwards from here
+ * @param v	Number to convert
  *
- * @return The corresponding ASCII character ('0' - 'f').
+ * @return Pointer to the first digit.
  */
-static int hexdigit(int c)
+static char *uint32_to_dec(char *end, uint32_t v)
 {
-	/* Strip off just the last nibble */
-	c &= 0x0f;
+	const char *pair;
+
+	while (v >= 100) {
+		pair = digit_pairs + (v % 100) * 2;
+		v /= 100;
+		*(--end) = pair[1];
+		*(--end) = pair[0];
+	}
 
-	return c > 9 ? (c + 'a' - 10) : (c + '0');
+	if (v >= 10) {
+		pair = digit_pairs + v * 2;
+		*(--end) = pair[1];
+		*(--end) = pair[0];
+	} else {
+		*(--end) = '0' + v;
+	}
+
+	return end;
+}
+
+#ifndef NO_UINT64_SUPPORT
+/*
+ * 64-bit division is a library call on most ECs, so only use it to split the
+ * number into 9-digit pieces, and convert those with 32-bit arithmetic.
+ */
+static char *uint64_to_dec(char *end, uint64_t v)
+{
+	char *start;
+
+	while (v >> 32) {
+		start = uint32_to_dec(end, divmod(&v, 1000000000));
+		while (start > end - 9)
+			*(--start) = '0';
+		end = start;
+	}
+
+	return uint32_to_dec(end, v);
+}
+#else
+#define uint64_to_dec uint32_to_dec
+#endif
+
+/**
+ * Put a decimal point before the last digits of a number.
+ *
+ * @param start		First digit; the buffer must have room before it for
+ *			the decimal point and for zeros up to precision + 1
+ *			digits
+ * @param end		End of the digits
+ * @param precision	Number of digits after the decimal point
+ *
+ * @return Pointer to the new first character.
+ */
+static char *fixed_point(char *start, const char *end, int precision)
+{
+	int len = end - start;
+
+	for (; len <= precision; len++)
+		*(--start) = '0';
+
+	memmove(start - 1, start, len - precision);
+	start--;
+	start[len - precision] = '.';
+
+	return start;
 }
 
 /* Flags for vfnprintf() flags */
@@ -58,15 +130,63 @@ static int hexdigit(int c)
 #define PF_64BIT	BIT(3)  /* Number is 64-bit */
 #endif
 
+/* Where vfnprintf_bulk() sends its output */
+struct printf_sink {
+	int (*addchar)(void *context, int c);
+	int (*addstr)(void *context, const char *str, int len);
+	void *context;
+};
+
+/* Send a run of characters; returns non-zero if some were dropped */
+static int sink_str(const struct printf_sink *sink, const char *str, int len)
+{
+	if (sink->addstr)
+		return len ? sink->addstr(sink->context, str, len) : 0;
+
+	while (len--)
+		if (sink->addchar(sink->context, *str++))
+			return 1;
+
+	return 0;
+}
+
+/* Send a character repeated len times */
+static int sink_pad(const struct printf_sink *sink, char c, int len)
+{
+	char pad[16];
+	int n;
+
+	if (len <= 0)
+		return 0;
+
+	if (!sink->addstr) {
+		for (; len; len--)
+			if (sink->addchar(sink->context, c))
+				return 1;
+		return 0;
+	}
+
+	memset(pad, c, MIN(len, (int)sizeof(pad)));
+	for (; len > 0; len -= n) {
+		n = MIN(len, (int)sizeof(pad));
+		if (sink->addstr(sink->context, pad, n))
+			return 1;
+	}
+
+	return 0;
+}
+
 /*
  * Print the buffer as a string of bytes in hex.
  * Returns 0 on success or an error on failure.
  */
-static int print_hex_buffer(int (*addchar)(void *context, int c),
-			    void *context, const char *vstr, int precision,
+static int print_hex_buffer(const struct printf_sink *sink,
+			    const char *vstr, int precision,
 			    int pad_width, int flags)
 
 {
+	char hex[16];
+	int n;
 
 	/*
 	 * Divide pad_width instead of multiplying precision to avoid overflow
@@ -79,37 +199,40 @@ static int print_hex_buffer(int (*addchar)(void *context, int c),
 	else
 		pad_width = 0;
 
-	while (pad_width > 0 && !(flags & PF_LEFT)) {
-		if (addchar(context, flags & PF_PADZERO ? '0' : ' '))
-			return EC_ERROR_OVERFLOW;
-		pad_width--;
-	}
+	if (!(flags & PF_LEFT) &&
+	    sink_pad(sink, flags & PF_PADZERO ? '0' : ' ', pad_width))
+		return EC_ERROR_OVERFLOW;
 
-	for (; precision; precision--, vstr++) {
-		if (addchar(context, hexdigit(*vstr >> 4)) ||
-		    addchar(context, hexdigit(*vstr)))
+	while (precision) {
+		for (n = 0; n < sizeof(hex) && precision; precision--, vstr++) {
+			hex[n++] = lower_digits[(*vstr >> 4) & 0x0f];
+			hex[n++] = lower_digits[*vstr & 0x0f];
+		}
+		if (sink_str(sink, hex, n))
 			return EC_ERROR_OVERFLOW;
 	}
 
-	while (pad_width > 0 && (flags & PF_LEFT)) {
-		if (addchar(context, ' '))
-			return EC_ERROR_OVERFLOW;
-		pad_width--;
-	}
+	if ((flags & PF_LEFT) && sink_pad(sink, ' ', pad_width))
+		return EC_ERROR_OVERFLOW;
 
 	return EC_SUCCESS;
 }
 
-int vfnprintf(int (*addchar)(void *context, int c), void *context,
-	      const char *format, va_list args)
+int vfnprintf_bulk(int (*addchar)(void *context, int c),
+		   int (*addstr)(void *context, const char *str, int len),
+		   void *context, const char *format, va_list args)
 {
+	const struct printf_sink sink = { addchar, addstr, context };
 	/*
 	 * Longest uint64 in decimal = 20
 	 * Longest uint32 in binary  = 32
 	 * + sign bit
 	 * + terminating null
+	 * + one more, so that the longest fixed-point number ("-0." and
+	 *   31 digits) fits too
 	 */
-	char intbuf[34];
+	char intbuf[35];
+	const char *run;
 	int flags;
 	int pad_width;
 	int precision;
@@ -120,9 +243,12 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 		int c = *format++;
 		char sign = 0;
 
-		/* Copy normal characters */
+		/* Copy normal characters, a run at a time */
 		if (c != '%') {
-			if (addchar(context, c))
+			run = format - 1;
+			while (*format && *format != '%')
+				format++;
+			if (sink_str(&sink, run, format - run))
 				return EC_ERROR_OVERFLOW;
 			continue;
 		}
@@ -135,7 +261,7 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 
 		/* Send "%" for "%%" input */
 		if (c == '%' || c == '\0') {
-			if (addchar(context, '%'))
+			if (sink_str(&sink, "%", 1))
 				return EC_ERROR_OVERFLOW;
 
 			if (c == '\0')
@@ -146,8 +272,8 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 
 		/* Handle %c */
 		if (c == 'c') {
-			c = va_arg(args, int);
-			if (addchar(context, c))
+			intbuf[0] = va_arg(args, int);
+			if (sink_str(&sink, intbuf, 1))
 				return EC_ERROR_OVERFLOW;
 			continue;
 		}
@@ -296,8 +422,7 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 						ptrval;
 					int rc;
 
-					rc = print_hex_buffer(addchar,
-							      context,
+					rc = print_hex_buffer(&sink,
 							      hexbuf->buffer,
 							      hexbuf->size,
 							      0,
@@ -388,31 +513,39 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 
 			/*
 			 * Fixed-point precision must fit in our buffer.
-			 * Leave space for "0." and the terminating null.
+			 * Leave space for "0.", the sign and the terminating
+			 * null.
 			 */
-			if (precision > (int)(sizeof(intbuf) - 3))
-				precision = sizeof(intbuf) - 3;
+			if (precision > (int)(sizeof(intbuf) - 4))
+				precision = sizeof(intbuf) - 4;
 
-			/*
-			 * Handle digits to right of decimal for fixed point
-			 * numbers.
-			 */
-			for (vlen = 0; vlen < precision; vlen++)
-				*(--vstr) = '0' + divmod(&v, 10);
-			if (precision >= 0)
-				*(--vstr) = '.';
-
-			if (!v)
-				*(--vstr) = '0';
-
-			while (v) {
-				int digit = divmod(&v, base);
-				if (digit < 10)
-					*(--vstr) = '0' + digit;
-				else if (c == 'X')
-					*(--vstr) = 'A' + digit - 10;
-				else
-					*(--vstr) = 'a' + digit - 10;
+			if (base == 10) {
+				vstr = uint64_to_dec(vstr, v);
+
+				if (precision >= 0)
+					vstr = fixed_point(vstr,
+							   intbuf +
+							   sizeof(intbuf) - 1,
+							   precision);
+			} else {
+				const char *digits = c == 'X' ? upper_digits :
+								lower_digits;
+				int shift = base == 16 ? 4 : 1;
+
+				/*
+				 * Handle digits to right of decimal for fixed
+				 * point numbers.
+				 */
+				for (vlen = 0; vlen < precision; vlen++)
+					*(--vstr) = '0' + divmod(&v, 10);
+				if (precision >= 0)
+					*(--vstr) = '.';
+
+				/* Bases are powers of two, so just shift */
+				do {
+					*(--vstr) = digits[v & (base - 1)];
+					v >>= shift;
+				} while (v);
 			}
 
 			if (sign)
@@ -432,7 +565,6 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 		if (precision < 0) {
 			/* If precision is unset, print everything */
 			vlen = strlen(vstr);
-			precision = MAX(vlen, pad_width);
 		} else {
 			/*
 			 * If precision is set, ensure that we do not
@@ -441,32 +573,51 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 			vlen = strnlen(vstr, precision);
 		}
 
-
-		while (vlen < pad_width && !(flags & PF_LEFT)) {
-			if (addchar(context, flags & PF_PADZERO ? '0' : ' '))
-				return EC_ERROR_OVERFLOW;
-			vlen++;
-		}
-		while (--precision >= 0 && *vstr)
-			if (addchar(context, *vstr++))
-				return EC_ERROR_OVERFLOW;
-		while (vlen < pad_width && flags & PF_LEFT) {
-			if (addchar(context, ' '))
-				return EC_ERROR_OVERFLOW;
-			vlen++;
-		}
+		if (!(flags & PF_LEFT) &&
+		    sink_pad(&sink, flags & PF_PADZERO ? '0' : ' ',
+			     pad_width - vlen))
+			return EC_ERROR_OVERFLOW;
+		if (sink_str(&sink, vstr, vlen))
+			return EC_ERROR_OVERFLOW;
+		if ((flags & PF_LEFT) && sink_pad(&sink, ' ', pad_width - vlen))
+			return EC_ERROR_OVERFLOW;
 	}
 
 	/* If we're still here, we consumed all output */
 	return EC_SUCCESS;
 }
 
+int vfnprintf(int (*addchar)(void *context, int c), void *context,
+	      const char *format, va_list args)
+{
+	return vfnprintf_bulk(addchar, NULL, context, format, args);
+}
+
 /* Context for snprintf() */
 struct snprintf_context {
 	char *str;
 	int size;
 };
 
+/**
+ * Add a run of characters to the string context.
+ *
+ * @param context	Context receiving characters
+ * @param str		Characters to add
+ * @param len		Number of characters
+ * @return 0 if all characters added, 1 if some dropped because no space.
+ */
+static int snprintf_addstr(void *context, const char *str, int len)
+{
+	struct snprintf_context *ctx = (struct snprintf_context *)context;
+	int n = MIN(len, ctx->size);
+
+	memcpy(ctx->str, str, n);
+	ctx->str += n;
+	ctx->size -= n;
+	return n != len;
+}
+
 /**
  * Add a character to the string context.
  *
@@ -509,10 +660,49 @@ int vsnprintf(char *str, int size, const char *format, va_list args)
 	ctx.str = str;
 	ctx.size = size - 1;  /* Reserve space for terminating '\0' */
 
-	rv = vfnprintf(snprintf_addchar, &ctx, format, args);
+	rv = vfnprintf_bulk(snprintf_addchar, snprintf_addstr, &ctx, format,
+			    args);
 
 	/* Terminate string */
 	*ctx.str = '\0';
 
 	return (rv == EC_SUCCESS) ? (ctx.str - str) : -rv;
 }
+
+int snprintf_timestamp(char *str, int size, uint64_t timestamp)
+{
+#ifdef NO_UINT64_SUPPORT
+	if (!str || size <= 0)
+		return -EC_ERROR_INVAL;
+
+	*str = '\0';
+	return -EC_ERROR_UNIMPLEMENTED;
+#else
+	char buf[PRINTF_TIMESTAMP_BUF_SIZE];
+	char *end = buf + sizeof(buf) - 1;
+	char *start;
+	int len;
+
+	if (!str || size <= 0)
+		return -EC_ERROR_INVAL;
+
+	/* Same as "%pT", without going through the format parser */
+	if (IS_ENABLED(CONFIG_CONSOLE_VERBOSE)) {
+		start = fixed_point(uint64_to_dec(end, timestamp), end, 6);
+	} else {
+		divmod(&timestamp, 1000);
+		start = fixed_point(uint64_to_dec(end, timestamp), end, 3);
+	}
+
+	len = MIN(end - start, size - 1);
+	memcpy(str, start, len);
+	str[len] = '\0';
+
+	return len == end - start ? len : -EC_ERROR_OVERFLOW;
+#endif
+}
+
+int snprintf_timestamp_now(char *str, int size)
+{
+	return snprintf_timestamp(str, size, get_time().val);
+}
@@ -19,24 +19,64 @@ struct queue_policy const queue_policy_null = {
 	.remove = queue_action_null,
 };
 
+/*
+ * Head and tail accessors.  For single producer, single consumer queues the
+ * producer publishes units by storing the tail with release ordering, and the
+ * consumer frees them by storing the head with release ordering.  The other
+ * side loads them with acquire ordering, so that it never sees an index before
+ * the units it covers.  Other queues keep the plain volatile accesses and rely
+ * on their users for any locking.
+ */
+static inline size_t queue_head(struct queue const *q)
+{
+	if (q->flags & QUEUE_FLAG_SPSC)
+		return __atomic_load_n(&q->state->head, __ATOMIC_ACQUIRE);
+
+	return q->state->head;
+}
+
+static inline size_t queue_tail(struct queue const *q)
+{
+	if (q->flags & QUEUE_FLAG_SPSC)
+		return __atomic_load_n(&q->state->tail, __ATOMIC_ACQUIRE);
+
+	return q->state->tail;
+}
+
+static inline void queue_set_head(struct queue const *q, size_t head)
+{
+	if (q->flags & QUEUE_FLAG_SPSC)
+		__atomic_store_n(&q->state->head, head, __ATOMIC_RELEASE);
+	else
+		q->state->head = head;
+}
+
+static inline void queue_set_tail(struct queue const *q, size_t tail)
+{
+	if (q->flags & QUEUE_FLAG_SPSC)
+		__atomic_store_n(&q->state->tail, tail, __ATOMIC_RELEASE);
+	else
+		q->state->tail = tail;
+}
+
 void queue_init(struct queue const *q)
 {
 	ASSERT(q->policy);
 	ASSERT(q->policy->add);
 	ASSERT(q->policy->remove);
 
-	q->state->head = 0;
-	q->state->tail = 0;
+	queue_set_head(q, 0);
+	queue_set_tail(q, 0);
 }
 
 int queue_is_empty(struct queue const *q)
 {
-	return q->state->head == q->state->tail;
+	return queue_head(q) == queue_tail(q);
 }
 
 size_t queue_count(struct queue const *q)
 {
-	return q->state->tail - q->state->head;
+	return queue_tail(q) - queue_head(q);
 }
 
 size_t queue_space(struct queue const *q)
@@ -72,43 +112,127 @@ int queue_is_full(struct queue const *q)
 
 struct queue_chunk queue_get_write_chunk(struct queue const *q, size_t offset)
 {
-	size_t head = q->state->head & q->buffer_units_mask;
-	size_t tail = (q->state->tail + offset) & q->buffer_units_mask;
-	size_t last = (tail < head) ? head :   /* Wrapped        */
-			q->buffer_units;       /* Normal | Empty */
+	/*
+	 * Sample the free space only once, the consumer may be freeing units
+	 * concurrently if this is a single producer, single consumer queue.
+	 */
+	size_t space = queue_space(q);
+	size_t tail = (queue_tail(q) + offset) & q->buffer_units_mask;
 
 	/* Make sure that the offset doesn't exceed free space. */
-	if (queue_space(q) <= offset)
+	if (space <= offset)
 		return ((struct queue_chunk) {
 			.count = 0,
 			.buffer = NULL,
 		});
 
+	/* Stop at the head (Wrapped) or at the end of the buffer (Normal) */
 	return ((struct queue_chunk) {
-		.count = last - tail,
+		.count = MIN(space - offset, q->buffer_units - tail),
 		.buffer = q->buffer + (tail * q->unit_bytes),
 	});
 }
 
 struct queue_chunk queue_get_read_chunk(struct queue const *q)
 {
-	size_t head = q->state->head & q->buffer_units_mask;
-	size_t tail = q->state->tail & q->buffer_units_mask;
-	size_t last = (queue_is_empty(q) ? head : /* Empty          */
-		       ((head < tail) ? tail :    /* Normal         */
-			q->buffer_units));        /* Wrapped | Full */
+	/* As above, the producer may be adding units concurrently. */
+	size_t count = queue_count(q);
+	size_t head = queue_head(q) & q->buffer_units_mask;
 
+	/* Stop at the tail (Normal) or at the end of the buffer (Wrapped) */
 	return ((struct queue_chunk) {
-		.count = (last - head),
+		.count = MIN(count, q->buffer_units - head),
 		.buffer = q->buffer + (head * q->unit_bytes),
 	});
 }
 
+static struct queue_chunk_pair queue_split(struct queue const *q,
+					   size_t start, size_t count)
+{
+	size_t index = start & q->buffer_units_mask;
+	size_t first = MIN(count, q->buffer_units - index);
+
+	return ((struct queue_chunk_pair) {
+		.chunk = {
+			{
+				.count = first,
+				.buffer = q->buffer + index * q->unit_bytes,
+			},
+			{
+				.count = count - first,
+				.buffer = q->buffer,
+			},
+		},
+	});
+}
+
+struct queue_chunk_pair queue_get_write_chunks(struct queue const *q)
+{
+	return queue_split(q, queue_tail(q), queue_space(q));
+}
+
+struct queue_chunk_pair queue_get_read_chunks(struct queue const *q)
+{
+	return queue_split(q, queue_head(q), queue_count(q));
+}
+
+size_t queue_add_in_place(struct queue const *q,
+			  size_t count,
+			  size_t (*produce)(void *ctx, void *dest,
+					    size_t count),
+			  void *ctx)
+{
+	struct queue_chunk_pair chunks = queue_get_write_chunks(q);
+	size_t transfer = 0;
+	size_t done;
+	int i;
+
+	for (i = 0; i < 2 && transfer < count; i++) {
+		size_t want = MIN(count - transfer, chunks.chunk[i].count);
+
+		if (!want)
+			break;
+
+		done = produce(ctx, chunks.chunk[i].buffer, want);
+		transfer += done;
+		if (done < want)
+			break;
+	}
+
+	return queue_advance_tail(q, transfer);
+}
+
+size_t queue_remove_in_place(struct queue const *q,
+			     size_t count,
+			     size_t (*consume)(void *ctx, const void *src,
+					       size_t count),
+			     void *ctx)
+{
+	struct queue_chunk_pair chunks = queue_get_read_chunks(q);
+	size_t transfer = 0;
+	size_t done;
+	int i;
+
+	for (i = 0; i < 2 && transfer < count; i++) {
+		size_t want = MIN(count - transfer, chunks.chunk[i].count);
+
+		if (!want)
+			break;
+
+		done = consume(ctx, chunks.chunk[i].buffer, want);
+		transfer += done;
+		if (done < want)
+			break;
+	}
+
+	return queue_advance_head(q, transfer);
+}
+
 size_t queue_advance_head(struct queue const *q, size_t count)
 {
 	size_t transfer = MIN(count, queue_count(q));
 
-	q->state->head += transfer;
+	queue_set_head(q, queue_head(q) + transfer);
 
 	q->policy->remove(q->policy, transfer);
 
@@ -119,7 +243,7 @@ size_t queue_advance_tail(struct queue const *q, size_t count)
 {
 	size_t transfer = MIN(count, queue_space(q));
 
-	q->state->tail += transfer;
+	queue_set_tail(q, queue_tail(q) + transfer);
 
 	q->policy->add(q->policy, transfer);
 
@@ -128,7 +252,7 @@ size_t queue_advance_tail(struct queue const *q, size_t count)
 
 size_t queue_add_unit(struct queue const *q, const void *src)
 {
-	size_t tail = q->state->tail & q->buffer_units_mask;
+	size_t tail = queue_tail(q) & q->buffer_units_mask;
 
 	if (queue_space(q) == 0)
 		return 0;
@@ -154,7 +278,7 @@ size_t queue_add_memcpy(struct queue const *q,
 					size_t n))
 {
 	size_t transfer = MIN(count, queue_space(q));
-	size_t tail     = q->state->tail & q->buffer_units_mask;
+	size_t tail     = queue_tail(q) & q->buffer_units_mask;
 	size_t first    = MIN(transfer, q->buffer_units - tail);
 
 	memcpy(q->buffer + tail * q->unit_bytes,
@@ -191,7 +315,7 @@ static void queue_read_safe(struct queue const *q,
 
 size_t queue_remove_unit(struct queue const *q, void *dest)
 {
-	size_t head = q->state->head & q->buffer_units_mask;
+	size_t head = queue_head(q) & q->buffer_units_mask;
 
 	if (queue_count(q) == 0)
 		return 0;
@@ -217,7 +341,7 @@ size_t queue_remove_memcpy(struct queue const *q,
 					   size_t n))
 {
 	size_t transfer = MIN(count, queue_count(q));
-	size_t head     = q->state->head & q->buffer_units_mask;
+	size_t head     = queue_head(q) & q->buffer_units_mask;
 
 	queue_read_safe(q, dest, head, transfer, memcpy);
 
@@ -244,7 +368,7 @@ size_t queue_peek_memcpy(struct queue const *q,
 	size_t transfer  = MIN(count, available - i);
 
 	if (i < available) {
-		size_t head = (q->state->head + i) & q->buffer_units_mask;
+		size_t head = (queue_head(q) + i) & q->buffer_units_mask;
 
 		queue_read_safe(q, dest, head, transfer, memcpy);
 	}
@@ -257,11 +381,11 @@ void queue_begin(struct queue const *q, struct queue_iterator *it)
 	if (queue_is_empty(q))
 		it->ptr = NULL;
 	else
-		it->ptr = q->buffer + (q->state->head & q->buffer_units_mask) *
+		it->ptr = q->buffer + (queue_head(q) & q->buffer_units_mask) *
 			q->unit_bytes;
 	it->_state.offset = 0;
-	it->_state.head = q->state->head;
-	it->_state.tail = q->state->tail;
+	it->_state.head = queue_head(q);
+	it->_state.tail = queue_tail(q);
 }
 
 void queue_next(struct queue const *q, struct queue_iterator *it)
@@ -269,8 +393,8 @@ void queue_next(struct queue const *q, struct queue_iterator *it)
 	uint8_t *ptr = (uint8_t *)it->ptr;
 
 	/* Check if anything changed since the iterator was created. */
-	if (it->_state.head != q->state->head ||
-	    it->_state.tail != q->state->tail) {
+	if (it->_state.head != queue_head(q) ||
+	    it->_state.tail != queue_tail(q)) {
 		CPRINTS("Concurrent modification error, queue has changed while"
 			" iterating. The iterator is now invalid.");
 		it->ptr = NULL;
@@ -42,6 +42,7 @@ static int ge_mod(const struct rsa_public_key *key, const uint32_t *a)
 	return 1;  /* equal */
 }
 
+#ifndef CONFIG_RSA_OPTIMIZED
 /**
  * Montgomery c[] += a * b[] / R % mod
  */
@@ -68,6 +69,60 @@ static void mont_mul_add(const struct rsa_public_key *key,
 	if (A >> 32)
 		sub_mod(key, c);
 }
+#else
+BUILD_ASSERT(RSANUMWORDS % 2 == 0);
+
+/**
+ * Montgomery c[] += (a0 + a1 * 2^32) * b[] / R^2 % mod
+ *
+ * Equivalent to mont_mul_add(key, c, a0, b) followed by
+ * mont_mul_add(key, c, a1, b), but the second row consumes each word of the
+ * first as soon as it is produced, so c[] is only loaded and stored once for
+ * every two words of a.
+ */
+static void mont_mul_add2(const struct rsa_public_key *key,
+			  uint32_t *c,
+			  const uint32_t a0,
+			  const uint32_t a1,
+			  const uint32_t *b)
+{
+	uint64_t A = mula32(a0, b[0], c[0]);
+	uint32_t d0 = (uint32_t)A * key->n0inv;
+	uint64_t B = mula32(d0, key->n[0], A);
+	uint64_t C, D;
+	uint32_t d1;
+	uint32_t i;
+
+	/* First word of the intermediate row seeds the second reduction. */
+	A = mulaa32(a0, b[1], c[1], A >> 32);
+	B = mulaa32(d0, key->n[1], A, B >> 32);
+	C = mula32(a1, b[0], (uint32_t)B);
+	d1 = (uint32_t)C * key->n0inv;
+	D = mula32(d1, key->n[0], C);
+
+	for (i = 2; i < RSANUMWORDS; ++i) {
+		A = mulaa32(a0, b[i], c[i], A >> 32);
+		B = mulaa32(d0, key->n[i], A, B >> 32);
+		C = mulaa32(a1, b[i - 1], (uint32_t)B, C >> 32);
+		D = mulaa32(d1, key->n[i - 1], C, D >> 32);
+		c[i - 2] = (uint32_t)D;
+	}
+
+	/* Top of the intermediate row, including its carry bit. */
+	A = (A >> 32) + (B >> 32);
+
+	C = mulaa32(a1, b[i - 1], (uint32_t)A, C >> 32);
+	D = mulaa32(d1, key->n[i - 1], C, D >> 32);
+	c[i - 2] = (uint32_t)D;
+
+	A = (A >> 32) + (C >> 32) + (D >> 32);
+
+	c[i - 1] = (uint32_t)A;
+
+	if (A >> 32)
+		sub_mod(key, c);
+}
+#endif
 
 #ifdef CONFIG_RSA_EXPONENT_3
 /**
@@ -99,9 +154,15 @@ static void mont_mul_1(const struct rsa_public_key *key,
 	for (i = 0; i < RSANUMWORDS; ++i)
 		c[i] = 0;
 
+#ifdef CONFIG_RSA_OPTIMIZED
+	mont_mul_add2(key, c, 1, 0, a);
+	for (i = 2; i < RSANUMWORDS; ++i)
+		mont_mul_add_0(key, c, a);
+#else
 	mont_mul_add(key, c, 1, a);
 	for (i = 1; i < RSANUMWORDS; ++i)
 		mont_mul_add_0(key, c, a);
+#endif
 }
 #endif
 
@@ -117,8 +178,13 @@ static void mont_mul(const struct rsa_public_key *key,
 	for (i = 0; i < RSANUMWORDS; ++i)
 		c[i] = 0;
 
+#ifdef CONFIG_RSA_OPTIMIZED
+	for (i = 0; i < RSANUMWORDS; i += 2)
+		mont_mul_add2(key, c, a[i], a[i + 1], b);
+#else
 	for (i = 0; i < RSANUMWORDS; ++i)
 		mont_mul_add(key, c, a[i], b);
+#endif
 }
 
 /**
@@ -0,0 +1,290 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Software timers, kept in a hierarchical timer wheel.
+ *
+ * Time is counted in ticks of 2^WHEEL_SHIFT us.  Level 0 has one slot per tick
+ * for the next WHEEL_SLOTS ticks, and each higher level has slots
+ * WHEEL_SLOTS times as long.  A timer goes in the lowest level which reaches
+ * its deadline, and is moved down a level ("cascaded") when the wheel gets to
+ * the start of its slot, so arming, canceling and expiring a timer are all
+ * O(1).  Deadlines are kept exact: the wheel only decides which timers to look
+ * at, the timer interrupt is still programmed to the earliest deadline.
+ */
+
+#include "atomic.h"
+#include "common.h"
+#include "console.h"
+#include "task.h"
+#include "timer.h"
+#include "util.h"
+
+#define WHEEL_SHIFT 8
+#define WHEEL_SLOT_BITS 5
+#define WHEEL_SLOTS BIT(WHEEL_SLOT_BITS)
+#define WHEEL_LEVELS 4
+
+/* Shift from ticks to the slot numbers of a level */
+#define LEVEL_SHIFT(level) ((level) * WHEEL_SLOT_BITS)
+/* Longest delay the wheel can hold; timers beyond are clamped and cascaded */
+#define WHEEL_SPAN BIT_ULL(LEVEL_SHIFT(WHEEL_LEVELS))
+
+static struct sw_timer *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+/* Bitmap of the non-empty slots of each level */
+static uint32_t wheel_busy[WHEEL_LEVELS];
+/* Current tick; every timer of earlier ticks has expired */
+static uint64_t wheel_clk;
+static int armed_count;
+
+static inline uint32_t rotate_right(uint32_t x, int n)
+{
+	return n ? (x >> n) | (x << (32 - n)) : x;
+}
+
+static void wheel_insert(struct sw_timer *timer)
+{
+	uint64_t tick = timer->deadline >> WHEEL_SHIFT;
+	uint64_t delta;
+	int level;
+
+	if (tick < wheel_clk)
+		tick = wheel_clk;
+	delta = tick - wheel_clk;
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < BIT_ULL(LEVEL_SHIFT(level + 1)))
+			break;
+	if (delta >= WHEEL_SPAN)
+		tick = wheel_clk + WHEEL_SPAN - 1;
+
+	timer->level = level;
+	timer->slot = (tick >> LEVEL_SHIFT(level)) & (WHEEL_SLOTS - 1);
+
+	timer->next = wheel[level][timer->slot];
+	if (timer->next)
+		timer->next->pprev = &timer->next;
+	timer->pprev = &wheel[level][timer->slot];
+	*timer->pprev = timer;
+	wheel_busy[level] |= BIT(timer->slot);
+}
+
+static void wheel_remove(struct sw_timer *timer)
+{
+	*timer->pprev = timer->next;
+	if (timer->next)
+		timer->next->pprev = timer->pprev;
+	timer->pprev = NULL;
+
+	if (!wheel[timer->level][timer->slot])
+		wheel_busy[timer->level] &= ~BIT(timer->slot);
+}
+
+/* Take all the timers of a slot out of the wheel, into a list */
+static void wheel_detach(int level, int slot, struct sw_timer **list)
+{
+	*list = wheel[level][slot];
+	if (*list)
+		(*list)->pprev = list;
+	wheel[level][slot] = NULL;
+	wheel_busy[level] &= ~BIT(slot);
+}
+
+/*
+ * Return the next tick at which the wheel has work to do on a level: the
+ * tick of the first non-empty slot of level 0, or the tick at which the first
+ * non-empty slot of a higher level has to be cascaded.
+ */
+static uint64_t wheel_next_tick(int level)
+{
+	uint64_t base = wheel_clk >> LEVEL_SHIFT(level);
+	int first;
+
+	if (!level)
+		first = __builtin_ctz(rotate_right(wheel_busy[0],
+						   base & (WHEEL_SLOTS - 1)));
+	else
+		first = __builtin_ctz(rotate_right(wheel_busy[level],
+						   (base + 1) &
+						   (WHEEL_SLOTS - 1))) + 1;
+
+	return (base + first) << LEVEL_SHIFT(level);
+}
+
+static void arm_locked(struct sw_timer *timer, uint64_t deadline)
+{
+	if (timer->pprev)
+		wheel_remove(timer);
+	else if (!armed_count++)
+		/* Wheel was empty; it can jump to the present */
+		wheel_clk = get_time().val >> WHEEL_SHIFT;
+
+	timer->deadline = deadline;
+	wheel_insert(timer);
+}
+
+void sw_timer_init(struct sw_timer *timer,
+		   void (*callback)(struct sw_timer *timer))
+{
+	memset(timer, 0, sizeof(*timer));
+	timer->callback = callback;
+}
+
+void sw_timer_init_event(struct sw_timer *timer, task_id_t task,
+			 uint32_t event)
+{
+	memset(timer, 0, sizeof(*timer));
+	timer->task = task;
+	timer->event = event;
+}
+
+void sw_timer_arm(struct sw_timer *timer, timestamp_t deadline)
+{
+	uint32_t key = sw_timer_lock();
+
+	arm_locked(timer, deadline.val);
+	sw_timer_unlock(key);
+
+	sw_timer_reschedule(deadline);
+}
+
+void sw_timer_start(struct sw_timer *timer, uint32_t us)
+{
+	timestamp_t deadline = get_time();
+
+	deadline.val += us;
+	sw_timer_arm(timer, deadline);
+}
+
+void sw_timer_cancel(struct sw_timer *timer)
+{
+	uint32_t key = sw_timer_lock();
+
+	if (timer->pprev) {
+		wheel_remove(timer);
+		armed_count--;
+	}
+	sw_timer_unlock(key);
+}
+
+int sw_timer_is_armed(const struct sw_timer *timer)
+{
+	return timer->pprev != NULL;
+}
+
+void sw_timer_expire(timestamp_t now)
+{
+	uint64_t target = now.val >> WHEEL_SHIFT;
+	uint64_t tick, next;
+	struct sw_timer *list, *timer;
+	uint32_t key = sw_timer_lock();
+	int level, slot;
+
+	while (armed_count) {
+		/* Find the next tick with something to do */
+		next = -1ull;
+		for (level = 0; level < WHEEL_LEVELS; level++) {
+			if (!wheel_busy[level])
+				continue;
+			tick = wheel_next_tick(level);
+			if (tick < next)
+				next = tick;
+		}
+		if (next > target)
+			break;
+		wheel_clk = next;
+
+		/* Cascade the slots which start at this tick, top down */
+		for (level = WHEEL_LEVELS - 1; level > 0; level--) {
+			if (next & (BIT_ULL(LEVEL_SHIFT(level)) - 1))
+				continue;
+			slot = (next >> LEVEL_SHIFT(level)) & (WHEEL_SLOTS - 1);
+			if (!(wheel_busy[level] & BIT(slot)))
+				continue;
+
+			wheel_detach(level, slot, &list);
+			while (list) {
+				timer = list;
+				wheel_remove(timer);
+				wheel_insert(timer);
+			}
+		}
+
+		/* Expire the timers of this tick which are due */
+		wheel_detach(0, next & (WHEEL_SLOTS - 1), &list);
+		while (list) {
+			timer = list;
+			wheel_remove(timer);
+
+			if (timer->deadline > now.val) {
+				/* Later in the current tick */
+				wheel_insert(timer);
+				continue;
+			}
+
+			armed_count--;
+			if (timer->callback)
+				timer->callback(timer);
+			else
+				task_set_event(timer->task, timer->event);
+		}
+
+		if (next == target)
+			break;
+	}
+
+	if (!armed_count)
+		wheel_clk = target;
+
+	sw_timer_unlock(key);
+}
+
+uint64_t sw_timer_next_deadline(void)
+{
+	uint64_t deadline = -1ull;
+	uint64_t start, end;
+	const struct sw_timer *timer;
+	uint32_t key = sw_timer_lock();
+	int level, slot;
+
+	/* The earliest timer of each level is in its first non-empty slot */
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		if (!wheel_busy[level])
+			continue;
+
+		start = wheel_next_tick(level);
+		end = (start + BIT_ULL(LEVEL_SHIFT(level))) << WHEEL_SHIFT;
+		slot = (start >> LEVEL_SHIFT(level)) & (WHEEL_SLOTS - 1);
+		start <<= WHEEL_SHIFT;
+
+		for (timer = wheel[level][slot]; timer; timer = timer->next) {
+			/*
+			 * A timer clamped to the end of the wheel is due after
+			 * its slot, and may hide earlier timers in later
+			 * slots: wake up when it has to be cascaded instead.
+			 */
+			if (timer->deadline >= end)
+				deadline = MIN(deadline, start);
+			else
+				deadline = MIN(deadline, timer->deadline);
+		}
+	}
+
+	sw_timer_unlock(key);
+
+	return deadline;
+}
+
+void sw_timer_print_info(void)
+{
+	int level;
+
+	ccprintf("Software timers: %d armed, wheel at tick 0x%" PRIx64 "\n",
+		 armed_count, wheel_clk);
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		ccprintf("  Level %d (%6d us slots): busy 0x%08x\n", level,
+			 (int)BIT(WHEEL_SHIFT + LEVEL_SHIFT(level)),
+			 wheel_busy[level]);
+}
@@ -11,12 +11,17 @@
 #include <stdlib.h>
 #endif
 
+#ifdef EMU_BUILD
+#include <time.h>
+#endif
+
 #include "console.h"
 #include "hooks.h"
 #include "host_command.h"
 #include "system.h"
 #include "task.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
 struct test_util_tag {
@@ -173,6 +178,20 @@ uint32_t prng_no_seed(void)
 	return seed = prng(seed);
 }
 
+timestamp_t test_get_wall_time(void)
+{
+#ifdef EMU_BUILD
+	struct timespec ts;
+	timestamp_t t;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t.val = (uint64_t)ts.tv_sec * SECOND + ts.tv_nsec / 1000;
+	return t;
+#else
+	return get_time();
+#endif
+}
+
 static void restore_state(void)
 {
 	const struct test_util_tag *tag;
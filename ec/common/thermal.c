@@ -116,7 +116,7 @@ static int cc_Sensorinfo(int argc, char **argv)
 
 	return EC_SUCCESS;
 }
-DECLARE_CONSOLE_COMMAND(Sensorinfo, cc_Sensorinfo,
+DECLARE_CONSOLE_COMMAND(sensorinfo, cc_Sensorinfo,
 			NULL,
 			"Print Sensor info");
 
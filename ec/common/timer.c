@@ -63,6 +63,9 @@ void process_timers(int overflow)
 	uint32_t check_timer, running_t0;
 	timestamp_t next;
 	timestamp_t now;
+#ifdef CONFIG_SW_TIMER
+	timestamp_t deadline;
+#endif
 
 	if (!IS_ENABLED(CONFIG_HWTIMER_64BIT) && overflow)
 		clksrc_high++;
@@ -90,6 +93,13 @@ void process_timers(int overflow)
 		/* if there is a new timer, let's retry */
 		} while (timer_running & ~running_t0);
 
+#ifdef CONFIG_SW_TIMER
+		sw_timer_expire(now);
+		deadline.val = sw_timer_next_deadline();
+		if (deadline.le.hi == now.le.hi && deadline.le.lo < next.le.lo)
+			next.val = deadline.val;
+#endif
+
 		if (next.le.hi == 0xffffffff) {
 			/* no deadline to set */
 			__hw_clock_event_clear();
@@ -122,10 +132,18 @@ void udelay(unsigned us)
 }
 #endif
 
-int timer_arm(timestamp_t event, task_id_t tskid)
+/* Fire the timer interrupt now if event is before its programmed deadline */
+static void update_next_deadline(timestamp_t event)
 {
 	timestamp_t now = get_time();
 
+	if ((event.le.hi < now.le.hi) ||
+	    ((event.le.hi == now.le.hi) && (event.le.lo <= next_deadline)))
+		task_trigger_irq(timer_irq);
+}
+
+int timer_arm(timestamp_t event, task_id_t tskid)
+{
 	ASSERT(tskid < TASK_ID_COUNT);
 
 	if (timer_running & BIT(tskid))
@@ -135,13 +153,28 @@ int timer_arm(timestamp_t event, task_id_t tskid)
 	atomic_or(&timer_running, BIT(tskid));
 
 	/* Modify the next event if needed */
-	if ((event.le.hi < now.le.hi) ||
-	    ((event.le.hi == now.le.hi) && (event.le.lo <= next_deadline)))
-		task_trigger_irq(timer_irq);
+	update_next_deadline(event);
 
 	return EC_SUCCESS;
 }
 
+#ifdef CONFIG_SW_TIMER
+void sw_timer_reschedule(timestamp_t deadline)
+{
+	update_next_deadline(deadline);
+}
+
+uint32_t sw_timer_lock(void)
+{
+	return irq_lock();
+}
+
+void sw_timer_unlock(uint32_t key)
+{
+	irq_unlock(key);
+}
+#endif
+
 void timer_cancel(task_id_t tskid)
 {
 	ASSERT(tskid < TASK_ID_COUNT);
@@ -266,6 +299,10 @@ void timer_print_info(void)
 			cflush();
 		}
 	}
+
+#ifdef CONFIG_SW_TIMER
+	sw_timer_print_info();
+#endif
 }
 
 void timer_init(void)
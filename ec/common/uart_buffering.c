@@ -7,6 +7,7 @@
 
 #include <stdarg.h>
 
+#include "atomic.h"
 #include "common.h"
 #include "console.h"
 #include "hooks.h"
@@ -37,6 +38,18 @@ uint8_t console_cmd_flag;
 #define TX_BUF_DIFF(i, j) (((i) - (j)) & (CONFIG_UART_TX_BUF_SIZE - 1))
 #define RX_BUF_DIFF(i, j) (((i) - (j)) & (CONFIG_UART_RX_BUF_SIZE - 1))
 
+/*
+ * Transmit buffer levels: writers start the drain early when the buffer gets
+ * past the high watermark, and the drain wakes the tasks waiting for room once
+ * it is down to the low watermark.
+ */
+#define TX_HIGH_WATER (CONFIG_UART_TX_BUF_SIZE * 3 / 4)
+#define TX_LOW_WATER (CONFIG_UART_TX_BUF_SIZE / 4)
+
+/* Time to send the whole transmit buffer, at 10 bits per character */
+#define TX_DRAIN_TIME_US ((int)(10ULL * SECOND * CONFIG_UART_TX_BUF_SIZE / \
+				CONFIG_UART_BAUD_RATE))
+
 /* Check if both UART TX/RX buffer sizes are power of two. */
 BUILD_ASSERT((CONFIG_UART_TX_BUF_SIZE & (CONFIG_UART_TX_BUF_SIZE - 1)) == 0);
 BUILD_ASSERT((CONFIG_UART_RX_BUF_SIZE & (CONFIG_UART_RX_BUF_SIZE - 1)) == 0);
@@ -54,6 +67,13 @@ static volatile char tx_buf[CONFIG_UART_TX_BUF_SIZE]
 			__uncached __preserved_logs(tx_buf);
 static volatile int tx_buf_head __preserved_logs(tx_buf_head);
 static volatile int tx_buf_tail __preserved_logs(tx_buf_tail);
+/*
+ * Number of characters ever written to tx_buf, for EC_CMD_CONSOLE_READ v2.
+ * tx_buf_head is always this modulo the buffer size.
+ */
+static volatile uint32_t tx_buf_seq __preserved_logs(tx_buf_seq);
+/* tx_buf_seq after the write in progress, if any */
+static volatile uint32_t tx_buf_write_seq;
 static volatile char rx_buf[CONFIG_UART_RX_BUF_SIZE] __uncached;
 static volatile int rx_buf_head;
 static volatile int rx_buf_tail;
@@ -63,6 +83,14 @@ static int tx_last_snapshot_head;
 static int tx_next_snapshot_head;
 static int tx_checksum __preserved_logs(tx_checksum);
 
+/* Transmit statistics */
+static uint32_t tx_bytes_sent;
+static uint32_t tx_bytes_dropped;
+static int tx_max_fill;
+
+/* Bitmap of the tasks waiting for the transmit buffer to drain */
+static atomic_t tx_waiters;
+
 static int uart_buffer_calc_checksum(void)
 {
 	return tx_buf_head ^ tx_buf_tail;
@@ -73,35 +101,52 @@ void uart_init_buffer(void)
 {
 	if (tx_checksum != uart_buffer_calc_checksum() ||
 	    !IN_RANGE(tx_buf_head, 0, CONFIG_UART_TX_BUF_SIZE) ||
-	    !IN_RANGE(tx_buf_tail, 0, CONFIG_UART_TX_BUF_SIZE)) {
+	    !IN_RANGE(tx_buf_tail, 0, CONFIG_UART_TX_BUF_SIZE) ||
+	    TX_BUF_DIFF(tx_buf_seq, tx_buf_head)) {
 		tx_buf_head = 0;
 		tx_buf_tail = 0;
+		tx_buf_seq = 0;
 		tx_checksum = 0;
 	}
+	tx_buf_write_seq = tx_buf_seq;
+}
+
+/* Push a reader ahead of the head, if writing len characters would pass it */
+static void tx_buf_push_ahead(int *ptr, int head, int len)
+{
+	int ahead = TX_BUF_DIFF(*ptr, head);
+
+	if (ahead >= 1 && ahead <= len)
+		*ptr = TX_BUF_NEXT(head + len);
 }
 
 /**
- * Put a single character into the transmit buffer.
+ * Copy characters into the transmit buffer.
  *
- * Does not enable the transmit interrupt; assumes that happens elsewhere.
+ * Characters go in as one or two contiguous spans, depending on whether they
+ * wrap around the end of the buffer.  Does not enable the transmit interrupt,
+ * unless the buffer is past its high watermark.
  *
- * @param context	Context; ignored.
- * @param c		Character to write.
- * @return 0 if the character was transmitted, 1 if it was dropped.
+ * @param src		Characters to write.
+ * @param len		Number of characters.
+ * @return the number of characters written; the rest did not fit.
  */
-static int __tx_char_raw(void *context, int c)
+static int tx_buf_write(const char *src, int len)
 {
-	int tx_buf_next, tx_buf_new_tail;
+#ifdef CONFIG_POLLING_UART
+	int i;
 
-#if defined CONFIG_POLLING_UART
-	(void) tx_buf_next;
-	(void) tx_buf_new_tail;
-	uart_write_char(c);
+	for (i = 0; i < len; i++)
+		uart_write_char(src[i]);
 #else
+	int head = tx_buf_head;
+	int space = TX_BUF_DIFF(tx_buf_tail, TX_BUF_NEXT(head));
+	int span, fill;
 
-	tx_buf_next = TX_BUF_NEXT(tx_buf_head);
-	if (tx_buf_next == tx_buf_tail)
-		return 1;
+	if (len > space)
+		len = space;
+	if (!len)
+		return 0;
 
 	/*
 	 * If we do a READ_RECENT, the buffer may have wrapped around, and
@@ -111,34 +156,130 @@ static int __tx_char_raw(void *context, int c)
 	 * We also want to make sure that the next time we snapshot and want
 	 * to READ_RECENT, we don't start reading from a stale tail.
 	 */
-	tx_buf_new_tail = TX_BUF_NEXT(tx_buf_next);
-	if (tx_buf_next == tx_last_snapshot_head &&
-	    tx_last_snapshot_head != tx_snapshot_head)
-		tx_last_snapshot_head = tx_buf_new_tail;
-	if (tx_buf_next == tx_next_snapshot_head)
-		tx_next_snapshot_head = tx_buf_new_tail;
+	if (tx_last_snapshot_head != tx_snapshot_head)
+		tx_buf_push_ahead(&tx_last_snapshot_head, head, len);
+	tx_buf_push_ahead(&tx_next_snapshot_head, head, len);
+
+	tx_buf_write_seq = tx_buf_seq + len;
 
 #ifdef CONFIG_CONSOLE_COMMAND
-    if(console_cmd_flag == 0x00) {
-        tx_buf[tx_buf_head] = c;
-    }
-#else
-    tx_buf[tx_buf_head] = c;
+	if (console_cmd_flag == 0x00) {
 #endif
-	tx_buf_head = tx_buf_next;
+		if (len == 1) {
+			tx_buf[head] = *src;
+		} else {
+			span = MIN(len, CONFIG_UART_TX_BUF_SIZE - head);
+			memcpy((char *)tx_buf + head, src, span);
+			memcpy((char *)tx_buf, src + span, len - span);
+		}
+#ifdef CONFIG_CONSOLE_COMMAND
+	}
+#endif
+	tx_buf_head = (head + len) & (CONFIG_UART_TX_BUF_SIZE - 1);
+	tx_buf_seq += len;
 
 	if (IS_ENABLED(CONFIG_PRESERVE_LOGS))
 		tx_checksum = uart_buffer_calc_checksum();
+
+	fill = TX_BUF_DIFF(tx_buf_head, tx_buf_tail);
+	if (fill > tx_max_fill)
+		tx_max_fill = fill;
+
+	/* Start draining now, instead of when the whole output is in */
+	if (fill >= TX_HIGH_WATER)
+		uart_tx_start();
 #endif
+	return len;
+}
+
+/**
+ * Put characters into the transmit buffer, translating '\n' to '\r\n'.
+ *
+ * @param src		Characters to write.
+ * @param len		Number of characters.
+ * @param raw		Non-zero to skip the translation.
+ * @return 0 if all the characters were written, 1 if some were dropped.
+ */
+static int tx_buf_put(const char *src, int len, int raw)
+{
+	const char *nl;
+	int span, written;
+
+	while (len) {
+		nl = raw ? NULL : memchr(src, '\n', len);
+		span = nl ? nl - src : len;
+
+		written = tx_buf_write(src, span);
+		if (written < span) {
+			tx_bytes_dropped += len - written;
+			return 1;
+		}
+		if (nl && tx_buf_write("\r\n", 2) != 2) {
+			tx_bytes_dropped += len - span;
+			return 1;
+		}
+
+		span += nl ? 1 : 0;
+		src += span;
+		len -= span;
+	}
+
 	return 0;
 }
 
 static int __tx_char(void *context, int c)
 {
+	char ch = c;
+
 	/* Translate '\n' to '\r\n' */
-	if (c == '\n' && __tx_char_raw(NULL, '\r'))
-		return 1;
-	return __tx_char_raw(context, c);
+	if (c == '\n' ? tx_buf_write("\r\n", 2) == 2 :
+			tx_buf_write(&ch, 1) == 1)
+		return 0;
+
+	tx_bytes_dropped++;
+	return 1;
+}
+
+static int __tx_str(void *context, const char *str, int len)
+{
+	return tx_buf_put(str, len, 0);
+}
+
+/* Wake the tasks waiting for the transmit buffer to drain */
+static void tx_wake_waiters(void)
+{
+	uint32_t waiters = atomic_clear(&tx_waiters);
+
+	while (waiters) {
+		int id = __builtin_ctz(waiters);
+
+		waiters &= ~BIT(id);
+		task_set_event(id, TASK_EVENT_UART_TX);
+	}
+}
+
+/* Free characters which have been sent */
+static void tx_buf_consume(int len)
+{
+	tx_buf_tail = (tx_buf_tail + len) & (CONFIG_UART_TX_BUF_SIZE - 1);
+	tx_bytes_sent += len;
+
+	if (IS_ENABLED(CONFIG_PRESERVE_LOGS))
+		tx_checksum = uart_buffer_calc_checksum();
+
+	if (tx_waiters &&
+	    TX_BUF_DIFF(tx_buf_head, tx_buf_tail) <= TX_LOW_WATER)
+		tx_wake_waiters();
+}
+
+/*
+ * Length of the output which can be sent in one go from the tail: up to the
+ * head, or to the end of the buffer if the output wraps.
+ */
+static int tx_buf_span(int head)
+{
+	return (head >= tx_buf_tail ? head : CONFIG_UART_TX_BUF_SIZE) -
+	       tx_buf_tail;
 }
 
 #ifdef CONFIG_UART_TX_DMA
@@ -163,12 +304,8 @@ void uart_process_output(void)
 
 	/* If a previous DMA transfer completed, free up the buffer it used */
 	if (tx_dma_in_progress) {
-		tx_buf_tail = (tx_buf_tail + tx_dma_in_progress) &
-			(CONFIG_UART_TX_BUF_SIZE - 1);
+		tx_buf_consume(tx_dma_in_progress);
 		tx_dma_in_progress = 0;
-
-		if (IS_ENABLED(CONFIG_PRESERVE_LOGS))
-			tx_checksum = uart_buffer_calc_checksum();
 	}
 
 	/* Disable DMA-done interrupt if nothing to send */
@@ -177,13 +314,7 @@ void uart_process_output(void)
 		return;
 	}
 
-	/*
-	 * Get the largest contiguous block of output.  If the transmit buffer
-	 * wraps, only use the part before the wrap.
-	 */
-	tx_dma_in_progress = (head > tx_buf_tail ? head :
-			      CONFIG_UART_TX_BUF_SIZE) - tx_buf_tail;
-
+	tx_dma_in_progress = tx_buf_span(head);
 	uart_tx_dma_start((char *)(tx_buf + tx_buf_tail), tx_dma_in_progress);
 }
 
@@ -191,13 +322,22 @@ void uart_process_output(void)
 
 void uart_process_output(void)
 {
-	/* Copy output from buffer until TX fifo full or output buffer empty */
-	while (uart_tx_ready() && (tx_buf_head != tx_buf_tail)) {
-		uart_write_char(tx_buf[tx_buf_tail]);
-		tx_buf_tail = TX_BUF_NEXT(tx_buf_tail);
+	int head = tx_buf_head;
+	int span = tx_buf_span(head);
+	int sent;
 
-		if (IS_ENABLED(CONFIG_PRESERVE_LOGS))
-			tx_checksum = uart_buffer_calc_checksum();
+	/*
+	 * Copy output from buffer until TX fifo full or output buffer empty,
+	 * a contiguous span at a time, freeing each span at once.
+	 */
+	while (span) {
+		for (sent = 0; sent < span && uart_tx_ready(); sent++)
+			uart_write_char(tx_buf[tx_buf_tail + sent]);
+		tx_buf_consume(sent);
+
+		if (sent < span)
+			break;
+		span = tx_buf_span(head);
 	}
 
 	/* If output buffer is empty, disable transmit interrupt */
@@ -291,49 +431,34 @@ int uart_putc(int c)
 
 int uart_puts(const char *outstr)
 {
-	/* Put all characters in the output buffer */
-	while (*outstr) {
-		if (__tx_char(NULL, *outstr++) != 0)
-			break;
-	}
+	int rv = tx_buf_put(outstr, strlen(outstr), 0);
 
 	uart_tx_start();
 
-	/* Successful if we consumed all output */
-	return *outstr ? EC_ERROR_OVERFLOW : EC_SUCCESS;
+	return rv ? EC_ERROR_OVERFLOW : EC_SUCCESS;
 }
 
 int uart_put(const char *out, int len)
 {
-	/* Put all characters in the output buffer */
-	while (len--) {
-		if (__tx_char(NULL, *out++) != 0)
-			break;
-	}
+	int rv = tx_buf_put(out, len, 0);
 
 	uart_tx_start();
 
-	/* Successful if we consumed all output */
-	return len ? EC_ERROR_OVERFLOW : EC_SUCCESS;
+	return rv ? EC_ERROR_OVERFLOW : EC_SUCCESS;
 }
 
 int uart_put_raw(const char *out, int len)
 {
-	/* Put all characters in the output buffer */
-	while (len--) {
-		if (__tx_char_raw(NULL, *out++) != 0)
-			break;
-	}
+	int rv = tx_buf_put(out, len, 1);
 
 	uart_tx_start();
 
-	/* Successful if we consumed all output */
-	return len ? EC_ERROR_OVERFLOW : EC_SUCCESS;
+	return rv ? EC_ERROR_OVERFLOW : EC_SUCCESS;
 }
 
 int uart_vprintf(const char *format, va_list args)
 {
-	int rv = vfnprintf(__tx_char, NULL, format, args);
+	int rv = vfnprintf_bulk(__tx_char, __tx_str, NULL, format, args);
 
 	uart_tx_start();
 
@@ -351,6 +476,52 @@ int uart_printf(const char *format, ...)
 	return rv;
 }
 
+/**
+ * Wait until no more than fill characters are waiting to be sent.
+ *
+ * The drain side wakes the waiters each time it frees output while at or
+ * below the low watermark.
+ *
+ * @return EC_SUCCESS, or EC_ERROR_TIMEOUT if the buffer did not drain in the
+ * time it takes to send all of it.
+ */
+static int tx_wait(int fill)
+{
+	uint32_t bit = BIT(task_get_current());
+	uint32_t events;
+	int rv = EC_SUCCESS;
+
+	atomic_or(&tx_waiters, bit);
+
+	/* It may have drained before we were on the list */
+	if (TX_BUF_DIFF(tx_buf_head, tx_buf_tail) > fill) {
+		uart_tx_start();
+		events = task_wait_event_mask(TASK_EVENT_UART_TX,
+					      TX_DRAIN_TIME_US);
+		if (!(events & TASK_EVENT_UART_TX))
+			rv = EC_ERROR_TIMEOUT;
+	}
+
+	atomic_clear_bits(&tx_waiters, bit);
+
+	return rv;
+}
+
+int uart_tx_wait(int len)
+{
+	int fill = CONFIG_UART_TX_BUF_SIZE - 1 - MAX(len, 1);
+
+	if (in_interrupt_context() || !task_start_called())
+		return EC_ERROR_BUSY;
+
+	while (TX_BUF_DIFF(tx_buf_head, tx_buf_tail) > fill) {
+		if (tx_wait(MIN(fill, TX_LOW_WATER)) != EC_SUCCESS)
+			return EC_ERROR_TIMEOUT;
+	}
+
+	return EC_SUCCESS;
+}
+
 void uart_flush_output(void)
 {
 	/* If UART not initialized ignore flush request. */
@@ -366,6 +537,14 @@ void uart_flush_output(void)
 			 * we're in now.
 			 */
 			uart_process_output();
+		} else if (task_start_called()) {
+			/*
+			 * Sleep until the drain side wakes us; this also
+			 * (re-)enables the UART interrupt, in case we switched
+			 * from a context which was doing a printf() or puts()
+			 * but hadn't enabled it yet.
+			 */
+			tx_wait(0);
 		} else {
 			/*
 			 * It's possible we switched from a previous context
@@ -408,6 +587,13 @@ int uart_buffer_full(void)
 	return TX_BUF_NEXT(tx_buf_head) == tx_buf_tail;
 }
 
+void uart_get_tx_stats(struct uart_tx_stats *stats)
+{
+	stats->bytes_sent = tx_bytes_sent;
+	stats->bytes_dropped = tx_bytes_dropped;
+	stats->max_fill = tx_max_fill;
+}
+
 #ifdef CONFIG_UART_RX_DMA
 static void uart_rx_dma_init(void)
 {
@@ -429,9 +615,74 @@ DECLARE_HOST_COMMAND(EC_CMD_CONSOLE_SNAPSHOT,
 		     host_command_console_snapshot,
 		     EC_VER_MASK(0));
 
+/**
+ * Copy console output after a sequence number; see EC_CMD_CONSOLE_READ v2.
+ *
+ * This does not stop writers, but output they overwrite while it is copied
+ * is left out and reported as a gap.
+ */
+static enum ec_status console_read_seq(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_console_read_v2 *p = args->params;
+	struct ec_response_console_read_v2 *r = args->response;
+	uint32_t seq = p->seq;
+	uint32_t end, lost;
+	int len, pos, span;
+
+	if (args->response_max < sizeof(*r))
+		return EC_RES_INVALID_PARAM;
+
+	r->flags = 0;
+	memset(r->reserved, 0, sizeof(r->reserved));
+
+	/*
+	 * Only the last CONFIG_UART_TX_BUF_SIZE - 1 characters are still
+	 * there.  A seq past the end means the EC rebooted since.  The
+	 * subtraction wraps along with tx_buf_seq.  The reader is rewound no
+	 * further than seq 0, so a freshly booted EC doesn't hand out stale
+	 * buffer contents.
+	 */
+	end = tx_buf_seq;
+	if ((uint32_t)(end - seq) > CONFIG_UART_TX_BUF_SIZE - 1) {
+		seq = end - MIN(end, CONFIG_UART_TX_BUF_SIZE - 1);
+		r->flags |= EC_CONSOLE_READ_GAP;
+	}
+
+	len = MIN(end - seq, args->response_max - sizeof(*r));
+	pos = seq & (CONFIG_UART_TX_BUF_SIZE - 1);
+	span = MIN(len, CONFIG_UART_TX_BUF_SIZE - pos);
+	memcpy(r->data, (const char *)tx_buf + pos, span);
+	memcpy(r->data + span, (const char *)tx_buf, len - span);
+
+	/*
+	 * Drop what was overwritten in the meantime, or is being.  The
+	 * copy must be done before tx_buf_write_seq is read again.
+	 */
+	asm volatile("" ::: "memory");
+	end = tx_buf_write_seq;
+	if (end - seq > CONFIG_UART_TX_BUF_SIZE) {
+		lost = MIN(end - seq - CONFIG_UART_TX_BUF_SIZE, len);
+		memmove(r->data, r->data + lost, len - lost);
+		seq += lost;
+		len -= lost;
+		r->flags |= EC_CONSOLE_READ_GAP;
+	}
+
+	if (seq + len != tx_buf_seq)
+		r->flags |= EC_CONSOLE_READ_MORE;
+
+	r->seq = seq;
+	args->response_size = sizeof(*r) + len;
+
+	return EC_RES_SUCCESS;
+}
+
 static enum ec_status
 host_command_console_read(struct host_cmd_handler_args *args)
 {
+	if (args->version == 2)
+		return console_read_seq(args);
+
 	if (args->version == 0) {
 		/*
 		 * Prior versions of this command only support reading from
@@ -464,7 +715,7 @@ DECLARE_HOST_COMMAND(EC_CMD_CONSOLE_READ,
 #ifdef CONFIG_CONSOLE_ENABLE_READ_V1
 		     | EC_VER_MASK(1)
 #endif
-		     );
+		     | EC_VER_MASK(2));
 
 enum ec_status uart_console_read_buffer_init(void)
 {
@@ -541,6 +792,16 @@ int uart_console_read_buffer(uint8_t type,
 /*****************************************************************************/
 #ifdef CONFIG_CONSOLE_COMMAND
 /* Console commands */
+static void print_tx_stats(void)
+{
+    struct uart_tx_stats stats;
+
+    uart_get_tx_stats(&stats);
+    CPRINTF("TX: %u bytes sent, %u dropped, max fill %d/%d\n",
+            stats.bytes_sent, stats.bytes_dropped, stats.max_fill,
+            CONFIG_UART_TX_BUF_SIZE - 1);
+}
+
 static int command_console(int argc, char **argv)
 {
     int rv;
@@ -549,6 +810,13 @@ static int command_console(int argc, char **argv)
     char dest[size];
     int *tail;
 
+    if (argc > 1) {
+        if (strcasecmp(argv[1], "stats"))
+            return EC_ERROR_PARAM1;
+        print_tx_stats();
+        return EC_SUCCESS;
+    }
+
     console_cmd_flag = 0x01;
 
     rv = uart_console_read_buffer_init();
@@ -572,10 +840,12 @@ static int command_console(int argc, char **argv)
 
     console_cmd_flag = 0x00;
     CPUTS("\r-----uart buffer read done!!!\n");
+    print_tx_stats();
 
     return EC_SUCCESS;
 }
 DECLARE_CONSOLE_COMMAND(console, command_console,
-            NULL,
-            "Show the last output to the EC debug console");
+            "[stats]",
+            "Show the last output to the EC debug console, "
+            "and output statistics");
 #endif
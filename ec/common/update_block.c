@@ -0,0 +1,228 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Block encodings of the fw update protocol, shared with usb_updater2.
+ */
+
+#ifdef HOST_TOOLS_BUILD
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+
+#ifndef __packed
+#define __packed __attribute__((packed))
+#endif
+#else
+#include "byteorder.h"
+#include "common.h"
+#include "util.h"
+#endif
+
+#include "update_fw.h"
+
+static int fill_decode(const uint8_t *in, size_t in_size,
+		       uint8_t *out, size_t out_max, size_t *out_size)
+{
+	struct update_block_fill fill;
+	size_t size;
+
+	if (in_size != sizeof(fill))
+		return UPDATE_DATA_ERROR;
+
+	memcpy(&fill, in, sizeof(fill));
+	size = be16toh(fill.size);
+	if (!size || size > out_max)
+		return UPDATE_DATA_ERROR;
+
+	memset(out, fill.value, size);
+	*out_size = size;
+
+	return UPDATE_SUCCESS;
+}
+
+static int lz_decode(const uint8_t *in, size_t in_size,
+		     uint8_t *out, size_t out_max, size_t *out_size)
+{
+	size_t i = 0;
+	size_t o = 0;
+	size_t len, distance;
+
+	while (i < in_size) {
+		uint8_t token = in[i++];
+
+		if (!(token & UPDATE_LZ_MATCH)) {
+			len = token + 1;
+			if (len > in_size - i || len > out_max - o)
+				return UPDATE_DATA_ERROR;
+			memcpy(out + o, in + i, len);
+			i += len;
+			o += len;
+			continue;
+		}
+
+		len = (token & ~UPDATE_LZ_MATCH) + UPDATE_LZ_MIN_MATCH;
+		if (in_size - i < 2)
+			return UPDATE_DATA_ERROR;
+		distance = in[i] << 8 | in[i + 1];
+		i += 2;
+		if (!distance || distance > o || len > out_max - o)
+			return UPDATE_DATA_ERROR;
+
+		/* Byte by byte, as the copy may overlap what it produces. */
+		for (; len; len--, o++)
+			out[o] = out[o - distance];
+	}
+
+	if (!o)
+		return UPDATE_DATA_ERROR;
+	*out_size = o;
+
+	return UPDATE_SUCCESS;
+}
+
+int update_block_decode(int encoding, const uint8_t *in, size_t in_size,
+			uint8_t *out, size_t out_max, size_t *out_size)
+{
+	switch (encoding) {
+	case UPDATE_BLOCK_RAW:
+		if (in_size > out_max)
+			return UPDATE_DATA_ERROR;
+		memcpy(out, in, in_size);
+		*out_size = in_size;
+		return UPDATE_SUCCESS;
+	case UPDATE_BLOCK_FILL:
+		return fill_decode(in, in_size, out, out_max, out_size);
+	case UPDATE_BLOCK_LZ:
+		return lz_decode(in, in_size, out, out_max, out_size);
+	default:
+		return UPDATE_DATA_ERROR;
+	}
+}
+
+/* Returns the size of the fill block, or 0 if in is not a fill. */
+static size_t fill_encode(const uint8_t *in, size_t size, uint8_t *out)
+{
+	struct update_block_fill fill;
+	size_t i;
+
+	if (size > UINT16_MAX)
+		return 0;
+
+	for (i = 1; i < size; i++)
+		if (in[i] != in[0])
+			return 0;
+
+	fill.size = htobe16(size);
+	fill.value = in[0];
+	fill.reserved = 0;
+	memcpy(out, &fill, sizeof(fill));
+
+	return sizeof(fill);
+}
+
+/*
+ * Flush literals in[start..end) to out; returns the new output size, or 0 if
+ * they do not fit in out_max.
+ */
+static size_t lz_put_literals(const uint8_t *in, size_t start, size_t end,
+			      uint8_t *out, size_t o, size_t out_max)
+{
+	size_t len;
+
+	while (start < end) {
+		len = MIN(end - start, UPDATE_LZ_MATCH);
+		if (len + 1 > out_max - o)
+			return 0;
+		out[o++] = len - 1;
+		memcpy(out + o, in + start, len);
+		o += len;
+		start += len;
+	}
+
+	return o;
+}
+
+/*
+ * Greedy LZ compression, searching all of the window for the longest match:
+ * slow, but blocks are small, and only the host encodes them.
+ *
+ * Returns the size of the compressed block, or 0 if it would not be smaller
+ * than out_max.
+ */
+static size_t lz_encode(const uint8_t *in, size_t size, uint8_t *out,
+			size_t out_max)
+{
+	size_t literals = 0;
+	size_t o = 0;
+	size_t i = 0;
+
+	while (i < size) {
+		size_t max_len = MIN(size - i, UPDATE_LZ_MAX_MATCH);
+		size_t best_len = 0;
+		size_t best_distance = 0;
+		size_t max_distance = MIN(i, UPDATE_LZ_MAX_DISTANCE);
+		size_t distance, len;
+
+		for (distance = 1; distance <= max_distance &&
+				   best_len < max_len; distance++) {
+			for (len = 0; len < max_len; len++)
+				if (in[i + len] != in[i + len - distance])
+					break;
+			if (len > best_len) {
+				best_len = len;
+				best_distance = distance;
+			}
+		}
+
+		if (best_len < UPDATE_LZ_MIN_MATCH) {
+			i++;
+			continue;
+		}
+
+		o = lz_put_literals(in, literals, i, out, o, out_max);
+		if (!o && literals != i)
+			return 0;
+		if (3 > out_max - o)
+			return 0;
+		out[o++] = UPDATE_LZ_MATCH | (best_len - UPDATE_LZ_MIN_MATCH);
+		out[o++] = best_distance >> 8;
+		out[o++] = best_distance;
+		i += best_len;
+		literals = i;
+	}
+
+	o = lz_put_literals(in, literals, size, out, o, out_max);
+
+	return o;
+}
+
+size_t update_block_encode(uint32_t encodings, const uint8_t *in, size_t size,
+			   uint8_t *out, int *encoding)
+{
+	size_t len;
+
+	if ((encodings & BIT(UPDATE_BLOCK_FILL)) &&
+	    size > sizeof(struct update_block_fill)) {
+		len = fill_encode(in, size, out);
+		if (len) {
+			*encoding = UPDATE_BLOCK_FILL;
+			return len;
+		}
+	}
+
+	/* Only worth it if smaller than the block itself. */
+	if (encodings & BIT(UPDATE_BLOCK_LZ)) {
+		len = lz_encode(in, size, out, size - 1);
+		if (len) {
+			*encoding = UPDATE_BLOCK_LZ;
+			return len;
+		}
+	}
+
+	memcpy(out, in, size);
+	*encoding = UPDATE_BLOCK_RAW;
+
+	return size;
+}
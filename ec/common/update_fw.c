@@ -95,7 +95,7 @@ static uint8_t check_update_chunk(uint32_t block_offset, size_t body_size)
 		return UPDATE_SUCCESS;
 #endif
 
-	CPRINTF("%s:%d %x, %d section base %x top %x\n",
+	CPRINTF("%s:%d %x, %zu section base %x top %x\n",
 		__func__, __LINE__,
 		block_offset, body_size,
 		update_section.base_offset,
@@ -153,6 +153,19 @@ static int contents_allowed(uint32_t block_offset,
 	return 1;
 }
 
+/*
+ * Check if the flash at block_offset already holds the data. Only for EC
+ * flash: touchpad blocks go to touchpad_update_write(), and the touchpad
+ * flash cannot be read back here.
+ */
+static int flash_holds(uint32_t block_offset, size_t body_size,
+		       const void *update_data)
+{
+	return !memcmp(update_data,
+		       (void *)(block_offset + CONFIG_PROGRAM_MEMORY_BASE),
+		       body_size);
+}
+
 /*
  * Setup internal state (e.g. valid sections, and fill first response).
  *
@@ -249,8 +262,12 @@ void fw_update_command_handler(void *body,
 		 * TODO(b/36375666): The response size can be shorter depending
 		 * on which board-specific type of response we provide. This
 		 * may send trailing 0 bytes, which should be harmless.
+		 *
+		 * block_encodings and stream_window are left out, hosts which
+		 * do not stream do not expect them.
 		 */
-		*response_size = sizeof(*rpdu);
+		*response_size = offsetof(struct first_response_pdu,
+					  common.block_encodings);
 		rpdu->protocol_version = htobe16(UPDATE_PROTOCOL_VERSION);
 
 		/* Setup internal state (e.g. valid sections, and fill rpdu) */
@@ -299,8 +316,14 @@ void fw_update_command_handler(void *body,
 	}
 #endif
 
-	CPRINTF("update: 0x%x\n", block_offset + CONFIG_PROGRAM_MEMORY_BASE);
-	if (flash_physical_write(block_offset, body_size, update_data)
+	CPRINTF("update: 0x%x\n",
+		(uint32_t)(block_offset + CONFIG_PROGRAM_MEMORY_BASE));
+	/*
+	 * Skip writing blocks the flash already holds, such as padding in the
+	 * erased section.
+	 */
+	if (!flash_holds(block_offset, body_size, update_data) &&
+	    flash_physical_write(block_offset, body_size, update_data)
 	    != EC_SUCCESS) {
 		*error_code = UPDATE_WRITE_FAILURE;
 		CPRINTF("%s:%d update write error\n", __func__, __LINE__);
@@ -310,9 +333,7 @@ void fw_update_command_handler(void *body,
 	new_chunk_written(block_offset);
 
 	/* Verify that data was written properly. */
-	if (memcmp(update_data, (void *)
-		   (block_offset + CONFIG_PROGRAM_MEMORY_BASE),
-		   body_size)) {
+	if (!flash_holds(block_offset, body_size, update_data)) {
 		*error_code = UPDATE_VERIFY_ERROR;
 		CPRINTF("%s:%d update verification error\n",
 			__func__, __LINE__);
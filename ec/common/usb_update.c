@@ -9,6 +9,7 @@
 #include "consumer.h"
 #include "curve25519.h"
 #include "flash.h"
+#include "hooks.h"
 #include "queue_policies.h"
 #include "host_command.h"
 #include "rollback.h"
@@ -17,7 +18,10 @@
 #include "system.h"
 #include "uart.h"
 #include "update_fw.h"
+#include "usb_descriptor.h"
+#ifndef TEST_BUILD
 #include "usb-stream.h"
+#endif
 #include "util.h"
 
 #define CPRINTS(format, args...) cprints(CC_USB, format, ## args)
@@ -40,11 +44,29 @@
  * is usually one byte in size, the only exception is the connection
  * establishment phase where the return value is 16 bytes in size.
  *
+ * In a streaming update, the host does not wait for the return value of a
+ * block before sending the next ones. Blocks are reassembled into a ring of
+ * buffers instead, and programmed from a deferred routine, which sends the
+ * return values as the cumulative update_stream_ack.
+ *
+ * Blocks may also be sent in one of the encodings negotiated by the streaming
+ * start PDU; they are decoded into a separate buffer before being programmed.
+ *
  * In the end of the successful image transfer and programming, the host sends
  * the reset command, and the device reboots itself.
  */
 
 struct consumer const update_consumer;
+
+#ifdef TEST_BUILD
+/* Tests play the host, at the other end of the queues. */
+extern struct consumer const update_test_consumer;
+
+test_export_static struct queue const update_to_usb =
+	QUEUE_DIRECT(64, uint8_t, null_producer, update_test_consumer);
+test_export_static struct queue const usb_to_update =
+	QUEUE_DIRECT(64, uint8_t, null_producer, update_consumer);
+#else
 struct usb_stream_config const usb_update;
 
 static struct queue const update_to_usb = QUEUE_DIRECT(64, uint8_t,
@@ -65,6 +87,7 @@ USB_STREAM_CONFIG_FULL(usb_update,
 		       USB_MAX_PACKET_SIZE,
 		       usb_to_update,
 		       update_to_usb)
+#endif
 
 
 /* The receiver can be in one of the states below. */
@@ -75,11 +98,56 @@ enum rx_state {
 			      reset command. */
 };
 
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+#define UPDATE_BLOCK_COUNT CONFIG_UPDATE_STREAM_WINDOW
+/* The acks of a whole window must fit in the queue to the host. */
+BUILD_ASSERT(CONFIG_UPDATE_STREAM_WINDOW *
+	     sizeof(struct update_stream_ack) <= 64);
+#else
+#define UPDATE_BLOCK_COUNT 1
+#endif
+
+#ifdef CONFIG_UPDATE_BLOCK_ENCODING
+#define SUPPORTED_ENCODINGS UPDATE_BLOCK_ENCODINGS
+#else
+#define SUPPORTED_ENCODINGS 0
+#endif
+
 enum rx_state rx_state_ = rx_idle;
-static uint8_t block_buffer[sizeof(struct update_command) +
-			    CONFIG_UPDATE_PDU_SIZE];
+static uint8_t block_buffer[UPDATE_BLOCK_COUNT][sizeof(struct update_command) +
+						CONFIG_UPDATE_PDU_SIZE];
+/* The block being reassembled */
+static uint8_t *rx_block;
 static uint32_t block_size;
 static uint32_t block_index;
+static uint8_t rx_encoding;
+
+/* Block encodings the host may use, negotiated by the start PDU */
+static uint16_t block_encodings;
+
+#ifdef CONFIG_UPDATE_BLOCK_ENCODING
+/* Decoded block, as passed to the programmer */
+static uint8_t decode_buffer[sizeof(struct update_command) +
+			     CONFIG_UPDATE_PDU_SIZE];
+#endif
+
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+/*
+ * Streaming state: stream_window is the number of blocks in flight, 0 when
+ * not streaming. Blocks stream_tail up to stream_head (free running counts
+ * since the start PDU) are waiting to be programmed, in block_buffer[count %
+ * stream_window].
+ *
+ * Blocks are programmed from a deferred routine, and the USB stream calls
+ * update_out_handler() from one too, so all of this is only touched from the
+ * hook task.
+ */
+static uint32_t stream_window;
+static uint32_t stream_head;
+static uint32_t stream_tail;
+static uint32_t stream_block_len[CONFIG_UPDATE_STREAM_WINDOW];
+static uint8_t stream_block_encoding[CONFIG_UPDATE_STREAM_WINDOW];
+#endif
 
 #ifdef CONFIG_USB_PAIRING
 #define KEY_CONTEXT "device-identity"
@@ -162,7 +230,7 @@ static int fetch_transfer_start(struct consumer const *consumer, size_t count,
 	}
 
 	if (count != sizeof(struct update_frame_header)) {
-		CPRINTS("FW update: wrong first block, size %d", count);
+		CPRINTS("FW update: wrong first block, size %zu", count);
 		return 0;
 	}
 
@@ -188,7 +256,7 @@ static int try_vendor_command(struct consumer const *consumer, size_t count)
 		return 0;
 
 	if (be32toh(cmd_buffer->block_size) != count) {
-		CPRINTS("%s: problem: block size and count mismatch (%d != %d)",
+		CPRINTS("%s: problem: block size and count mismatch (%d != %zu)",
 			__func__, be32toh(cmd_buffer->block_size), count);
 		return 0;
 	}
@@ -407,12 +475,100 @@ static uint64_t prev_activity_timestamp;
  */
 static uint8_t  data_was_transferred;
 
+/*
+ * Pass a reassembled block to the programmer, decoding it first if needed;
+ * returns the programmer's return value.
+ */
+static uint8_t program_block(uint8_t *block, size_t size, int encoding)
+{
+	size_t resp_size;
+
+	/*
+	 * There was at least an attempt to program the flash, set the
+	 * flag.
+	 */
+	data_was_transferred = 1;
+
+#ifdef CONFIG_UPDATE_BLOCK_ENCODING
+	if (encoding != UPDATE_BLOCK_RAW) {
+		const size_t cmd_size = sizeof(struct update_command);
+
+		if (update_block_decode(encoding, block + cmd_size,
+					size - cmd_size,
+					decode_buffer + cmd_size,
+					CONFIG_UPDATE_PDU_SIZE, &size)) {
+			CPRINTS("FW update: bad encoded block");
+			return UPDATE_DATA_ERROR;
+		}
+		memcpy(decode_buffer, block, cmd_size);
+		block = decode_buffer;
+		size += cmd_size;
+	}
+#endif
+
+	fw_update_command_handler(block, size, &resp_size);
+
+	return block[0];
+}
+
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+static void stream_reset(uint32_t window)
+{
+	stream_window = window;
+	stream_head = 0;
+	stream_tail = 0;
+}
+
+/* Program the oldest block received, and acknowledge it. */
+static void stream_program_block(void)
+{
+	uint32_t slot = stream_tail % stream_window;
+	struct update_stream_ack ack;
+
+	ack.return_value = htobe32(program_block(block_buffer[slot],
+						 stream_block_len[slot],
+						 stream_block_encoding[slot]));
+	if (!ack.return_value)
+		stream_tail++;
+	ack.blocks_done = htobe32(stream_tail);
+	QUEUE_ADD_UNITS(&update_to_usb, &ack, sizeof(ack));
+
+	if (ack.return_value) {
+		CPRINTS("FW update: block %d failed", stream_tail);
+		stream_reset(0);
+		rx_state_ = rx_idle;
+		data_was_transferred = 0;
+	}
+}
+
+/*
+ * One block at a time, so that the USB stream gets to fetch the next packets
+ * in between.
+ */
+static void stream_program(void);
+DECLARE_DEFERRED(stream_program);
+
+static void stream_program(void)
+{
+	if (stream_tail == stream_head)
+		return;
+
+	stream_program_block();
+
+	if (stream_tail != stream_head)
+		hook_call_deferred(&stream_program_data, 0);
+}
+#endif
+
 /* Reply with an error to remote side, reset state. */
 static void send_error_reset(uint8_t resp_value)
 {
 	QUEUE_ADD_UNITS(&update_to_usb, &resp_value, 1);
 	rx_state_ = rx_idle;
 	data_was_transferred = 0;
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+	stream_reset(0);
+#endif
 }
 
 /* Called to deal with data from the host */
@@ -430,6 +586,9 @@ static void update_out_handler(struct consumer const *consumer, size_t count)
 	/* If timeout exceeds 5 seconds - let's start over. */
 	if ((delta_time > 5000000) && (rx_state_ != rx_idle)) {
 		rx_state_ = rx_idle;
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+		stream_reset(0);
+#endif
 		CPRINTS("FW update: recovering after timeout");
 	}
 
@@ -443,23 +602,42 @@ static void update_out_handler(struct consumer const *consumer, size_t count)
 		 */
 		union {
 			struct update_frame_header upfr;
+			struct update_stream_start stream_start;
 			struct {
 				uint32_t unused;
 				struct first_response_pdu startup_resp;
 			};
 		} u;
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+		uint16_t encodings = 0;
+		uint16_t window = 0;
+		int stream_start = 0;
+#endif
+		int start_valid;
 
 		/* Check is this is a channeled TPM extension command. */
 		if (try_vendor_command(consumer, count))
 			return;
 
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+		if (count == sizeof(u.stream_start)) {
+			QUEUE_REMOVE_UNITS(consumer->queue, &u.stream_start,
+					   count);
+			encodings = be16toh(u.stream_start.block_encodings);
+			window = be16toh(u.stream_start.window);
+			stream_start = 1;
+			start_valid = be32toh(u.upfr.block_size) == count;
+		} else
+#endif
+		start_valid = fetch_transfer_start(consumer, count, &u.upfr) &&
+			be32toh(u.upfr.block_size) ==
+				sizeof(struct update_frame_header);
+
 		/*
 		 * An update start PDU is a command without any payload, with
 		 * digest = 0, and base = 0.
 		 */
-		if (!fetch_transfer_start(consumer, count, &u.upfr) ||
-			be32toh(u.upfr.block_size) !=
-					sizeof(struct update_frame_header) ||
+		if (!start_valid ||
 				u.upfr.cmd.block_digest != 0 ||
 				u.upfr.cmd.block_base != 0) {
 			/*
@@ -473,14 +651,26 @@ static void update_out_handler(struct consumer const *consumer, size_t count)
 		}
 
 		CPRINTS("FW update: starting...");
-		fw_update_command_handler(&u.upfr.cmd, count -
-					   offsetof(struct update_frame_header,
-						    cmd),
-					   &resp_size);
+		fw_update_command_handler(&u.upfr.cmd,
+					  sizeof(struct update_command),
+					  &resp_size);
 
 		if (!u.startup_resp.return_value) {
 			rx_state_ = rx_outside_block;  /* We're in business. */
 			data_was_transferred = 0;   /* No data received yet. */
+			block_encodings = 0;
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+			stream_reset(MIN(window, CONFIG_UPDATE_STREAM_WINDOW));
+			if (stream_start) {
+				block_encodings = encodings &
+					SUPPORTED_ENCODINGS;
+				u.startup_resp.common.block_encodings =
+					htobe16(block_encodings);
+				u.startup_resp.common.stream_window =
+					htobe16(stream_window);
+				resp_size = sizeof(u.startup_resp);
+			}
+#endif
 		}
 
 		/* Let the host know what updater had to say. */
@@ -502,6 +692,16 @@ static void update_out_handler(struct consumer const *consumer, size_t count)
 			if (command == UPDATE_DONE) {
 				CPRINTS("FW update: done");
 
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+				/*
+				 * The host should have waited for all the
+				 * acks, but do not leave blocks behind.
+				 */
+				while (stream_tail != stream_head)
+					stream_program_block();
+				stream_reset(0);
+#endif
+
 				if (data_was_transferred) {
 					fw_update_complete();
 					data_was_transferred = 0;
@@ -525,34 +725,57 @@ static void update_out_handler(struct consumer const *consumer, size_t count)
 			return;
 		}
 
+		block_size = be32toh(upfr.block_size);
+		rx_encoding = block_size >> UPDATE_FRAME_ENCODING_SHIFT;
+		if (rx_encoding != UPDATE_BLOCK_RAW &&
+		    (rx_encoding >= 8 * sizeof(block_encodings) ||
+		     !(block_encodings & BIT(rx_encoding)))) {
+			CPRINTS("Invalid block encoding (%d).", rx_encoding);
+			send_error_reset(UPDATE_GEN_ERROR);
+			return;
+		}
+
 		/* Let's allocate a large enough buffer. */
-		block_size = be32toh(upfr.block_size) -
+		block_size = (block_size & UPDATE_FRAME_SIZE_MASK) -
 			offsetof(struct update_frame_header, cmd);
 
 		/*
 		 * Only update start PDU is allowed to have a size 0 payload.
 		 */
 		if (block_size <= sizeof(struct update_command) ||
-		    block_size > sizeof(block_buffer)) {
+		    block_size > sizeof(block_buffer[0])) {
 			CPRINTS("Invalid block size (%d).", block_size);
 			send_error_reset(UPDATE_GEN_ERROR);
 			return;
 		}
 
+		rx_block = block_buffer[0];
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+		if (stream_window) {
+			/* All the buffers are waiting to be programmed. */
+			if (stream_head - stream_tail == stream_window) {
+				CPRINTS("Stream window overrun.");
+				send_error_reset(UPDATE_GEN_ERROR);
+				return;
+			}
+			rx_block = block_buffer[stream_head % stream_window];
+		}
+#endif
+
 		/*
 		 * Copy the rest of the message into the block buffer to pass
 		 * to the updater.
 		 */
 		block_index = sizeof(upfr) -
 			offsetof(struct update_frame_header, cmd);
-		memcpy(block_buffer, &upfr.cmd, block_index);
+		memcpy(rx_block, &upfr.cmd, block_index);
 		block_size -= block_index;
 		rx_state_ = rx_inside_block;
 		return;
 	}
 
 	/* Must be inside block. */
-	QUEUE_REMOVE_UNITS(consumer->queue, block_buffer + block_index, count);
+	QUEUE_REMOVE_UNITS(consumer->queue, rx_block + block_index, count);
 	block_index += count;
 	block_size -= count;
 
@@ -569,20 +792,26 @@ static void update_out_handler(struct consumer const *consumer, size_t count)
 		return;	/* More to come. */
 	}
 
+	rx_state_ = rx_outside_block;
+
+#ifdef CONFIG_UPDATE_STREAM_WINDOW
+	/* Queue the block for programming, and go on receiving. */
+	if (stream_window) {
+		stream_block_len[stream_head % stream_window] = block_index;
+		stream_block_encoding[stream_head % stream_window] =
+			rx_encoding;
+		stream_head++;
+		hook_call_deferred(&stream_program_data, 0);
+		return;
+	}
+#endif
+
 	/*
 	 * Ok, the entire block has been received and reassembled, pass it to
 	 * the updater for verification and programming.
 	 */
-	fw_update_command_handler(block_buffer, block_index, &resp_size);
-
-	/*
-	 * There was at least an attempt to program the flash, set the
-	 * flag.
-	 */
-	data_was_transferred = 1;
-	resp_value = block_buffer[0];
+	resp_value = program_block(rx_block, block_index, rx_encoding);
 	QUEUE_ADD_UNITS(&update_to_usb, &resp_value, sizeof(resp_value));
-	rx_state_ = rx_outside_block;
 }
 
 struct consumer const update_consumer = {
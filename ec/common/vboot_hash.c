@@ -36,8 +36,17 @@ struct vboot_hash_tag {
 #define CHUNK_SIZE 1024       /* Bytes to hash per deferred call */
 #define WORK_INTERVAL_US 100  /* Delay between deferred calls */
 
-/* Check that CHUNK_SIZE fits in shared memory. */
-SHARED_MEM_CHECK_SIZE(CHUNK_SIZE);
+#ifdef CONFIG_VBOOT_HASH_ADAPTIVE
+#define MAX_CHUNK_SIZE CONFIG_VBOOT_HASH_MAX_CHUNK_SIZE
+BUILD_ASSERT(POWER_OF_TWO(MAX_CHUNK_SIZE) && MAX_CHUNK_SIZE >= CHUNK_SIZE);
+#else
+#define MAX_CHUNK_SIZE CHUNK_SIZE
+#endif
+
+/* Check that the largest chunk fits in shared memory. */
+#ifndef CONFIG_MAPPED_STORAGE
+SHARED_MEM_CHECK_SIZE(MAX_CHUNK_SIZE);
+#endif
 
 static uint32_t data_offset;
 static uint32_t data_size;
@@ -50,6 +59,21 @@ static int in_progress;
 
 static struct sha256_ctx ctx;
 
+/*
+ * Bytes hashed per chunk; only changes with CONFIG_VBOOT_HASH_ADAPTIVE, and
+ * starts over from CHUNK_SIZE with each hash.
+ */
+static int chunk_size = CHUNK_SIZE;
+
+/* Per-phase timing of the current (or last completed) hash */
+static struct {
+	timestamp_t start;
+	uint32_t total_us;
+	uint32_t read_us;
+	uint32_t hash_us;
+	uint32_t chunks;
+} timing;
+
 int vboot_hash_in_progress(void)
 {
 	return in_progress;
@@ -80,6 +104,7 @@ DECLARE_DEFERRED(vboot_hash_next_chunk);
 
 static int read_and_hash_chunk(int offset, int size)
 {
+	timestamp_t t0, t1;
 	char *buf;
 	int rv;
 
@@ -87,21 +112,28 @@ static int read_and_hash_chunk(int offset, int size)
 		return EC_SUCCESS;
 
 	rv = shared_mem_acquire(size, &buf);
-	if (rv == EC_ERROR_BUSY) {
+	if (rv != EC_SUCCESS && chunk_size > CHUNK_SIZE) {
+		/* Try again with a smaller buffer */
+		chunk_size = CHUNK_SIZE;
+		return EC_ERROR_BUSY;
+	} else if (rv == EC_ERROR_BUSY) {
 		/* Couldn't update hash right now; try again later */
-		hook_call_deferred(&vboot_hash_next_chunk_data,
-				   WORK_INTERVAL_US);
 		return rv;
 	} else if (rv != EC_SUCCESS) {
 		vboot_hash_abort();
 		return rv;
 	}
 
+	t0 = get_time();
 	rv = flash_read(offset, size, buf);
-	if (rv == EC_SUCCESS)
+	t1 = get_time();
+	timing.read_us += t1.val - t0.val;
+	if (rv == EC_SUCCESS) {
 		SHA256_update(&ctx, (const uint8_t *)buf, size);
-	else
+		timing.hash_us += get_time().val - t1.val;
+	} else {
 		vboot_hash_abort();
+	}
 
 	shared_mem_release(buf);
 	return rv;
@@ -115,33 +147,91 @@ static int read_and_hash_chunk(int offset, int size)
 #define SHA256_PRINT_SIZE 4
 #endif
 
-static void hash_next_chunk(size_t size)
+#ifdef CONFIG_VBOOT_HASH_ADAPTIVE
+/**
+ * Pick the next chunk size from the cost of the last chunk.
+ *
+ * Chunks double while a chunk takes less than half the time budget and
+ * halve when a chunk overruns it, so each deferred call stays close to
+ * CONFIG_VBOOT_HASH_CHUNK_US without starving other hooks.
+ */
+static void adapt_chunk_size(uint32_t us)
 {
+	if (us < CONFIG_VBOOT_HASH_CHUNK_US / 2 && chunk_size < MAX_CHUNK_SIZE)
+		chunk_size <<= 1;
+	else if (us > CONFIG_VBOOT_HASH_CHUNK_US && chunk_size > CHUNK_SIZE)
+		chunk_size >>= 1;
+}
+#endif
+
+/**
+ * Hash the next chunk.
+ *
+ * @return EC_SUCCESS, EC_ERROR_BUSY if the chunk has to be retried, or
+ * another error if the hash has to be aborted.
+ */
+static int hash_next_chunk(size_t size)
+{
+	__maybe_unused timestamp_t t0 = get_time();
+
 #ifdef CONFIG_MAPPED_STORAGE
 	flash_lock_mapped_storage(1);
 	SHA256_update(&ctx, (const uint8_t *)(CONFIG_MAPPED_STORAGE_BASE +
 					      data_offset + curr_pos), size);
 	flash_lock_mapped_storage(0);
+	timing.hash_us += get_time().val - t0.val;
 #else
-	if (read_and_hash_chunk(data_offset + curr_pos, size) != EC_SUCCESS)
-		return;
+	int rv = read_and_hash_chunk(data_offset + curr_pos, size);
+
+	if (rv != EC_SUCCESS)
+		return rv;
+#endif
+	timing.chunks++;
+
+#ifdef CONFIG_VBOOT_HASH_ADAPTIVE
+	adapt_chunk_size(get_time().val - t0.val);
 #endif
+	return EC_SUCCESS;
 }
 
-static void vboot_hash_all_chunks(void)
+static void vboot_hash_stop(void)
+{
+	in_progress = 0;
+	clock_enable_module(MODULE_FAST_CPU, 0);
+	vboot_hash_abort();
+}
+
+static void vboot_hash_finish(void)
+{
+	hash = SHA256_final(&ctx);
+	timing.total_us = get_time().val - timing.start.val;
+	CPRINTS("hash done %ph", HEX_BUF(hash, SHA256_PRINT_SIZE));
+}
+
+static int vboot_hash_all_chunks(void)
 {
 	do {
-		size_t size = MIN(CHUNK_SIZE, data_size - curr_pos);
-		hash_next_chunk(size);
+		size_t size = MIN(chunk_size, data_size - curr_pos);
+		int rv = hash_next_chunk(size);
+
+		/*
+		 * Nothing comes back to finish a blocking hash, so retry at
+		 * once if the chunk shrank, and give up if memory is busy.
+		 */
+		if (rv == EC_ERROR_BUSY && size > chunk_size)
+			continue;
+		if (rv != EC_SUCCESS) {
+			vboot_hash_stop();
+			return rv;
+		}
 		curr_pos += size;
 	} while (curr_pos < data_size);
 
-	hash = SHA256_final(&ctx);
-	CPRINTS("hash done %ph", HEX_BUF(hash, SHA256_PRINT_SIZE));
+	vboot_hash_finish();
 	in_progress = 0;
 	clock_enable_module(MODULE_FAST_CPU, 0);
 
-	return;
+	return EC_SUCCESS;
 }
 
 /**
@@ -150,24 +240,31 @@ static void vboot_hash_all_chunks(void)
 static void vboot_hash_next_chunk(void)
 {
 	int size;
+	int rv;
 
 	/* Handle abort */
 	if (want_abort) {
-		in_progress = 0;
-		clock_enable_module(MODULE_FAST_CPU, 0);
-		vboot_hash_abort();
+		vboot_hash_stop();
 		return;
 	}
 
 	/* Compute the next chunk of hash */
-	size = MIN(CHUNK_SIZE, data_size - curr_pos);
-	hash_next_chunk(size);
+	size = MIN(chunk_size, data_size - curr_pos);
+	rv = hash_next_chunk(size);
+	if (rv == EC_ERROR_BUSY) {
+		hook_call_deferred(&vboot_hash_next_chunk_data,
+				   WORK_INTERVAL_US);
+		return;
+	}
+	if (rv != EC_SUCCESS) {
+		vboot_hash_stop();
+		return;
+	}
 
 	curr_pos += size;
 	if (curr_pos >= data_size) {
 		/* Store the final hash */
-		hash = SHA256_final(&ctx);
-		CPRINTS("hash done %ph", HEX_BUF(hash, SHA256_PRINT_SIZE));
+		vboot_hash_finish();
 
 		in_progress = 0;
 
@@ -224,6 +321,9 @@ static int vboot_hash_start(uint32_t offset, uint32_t size,
 	hash = NULL;
 	want_abort = 0;
 	in_progress = 1;
+	chunk_size = CHUNK_SIZE;
+	memset(&timing, 0, sizeof(timing));
+	timing.start = get_time();
 
 	/* Restart the hash computation */
 	CPRINTS("hash start 0x%08x 0x%08x", offset, size);
@@ -231,11 +331,10 @@ static int vboot_hash_start(uint32_t offset, uint32_t size,
 	if (nonce_size)
 		SHA256_update(&ctx, nonce, nonce_size);
 
-	if (deferred)
-		hook_call_deferred(&vboot_hash_next_chunk_data, 0);
-	else
-		vboot_hash_all_chunks();
+	if (!deferred)
+		return vboot_hash_all_chunks();
 
+	hook_call_deferred(&vboot_hash_next_chunk_data, 0);
 	return EC_SUCCESS;
 }
 
@@ -321,6 +420,8 @@ int vboot_get_rw_hash(const uint8_t **dst)
 	int rv = vboot_hash_start(flash_get_rw_offset(system_get_active_copy()),
 				  get_rw_size(), NULL, 0, VBOOT_HASH_BLOCKING);
 	*dst = hash;
+	if (rv == EC_SUCCESS && !hash)
+		rv = EC_ERROR_UNKNOWN;
 	return rv;
 }
 
@@ -383,6 +484,11 @@ static int command_hash(int argc, char **argv)
 			ccprintf("%ph\n", HEX_BUF(hash, SHA256_DIGEST_SIZE));
 		else
 			ccprintf("(invalid)\n");
+		if (timing.chunks)
+			ccprintf("Time:   %d us (read %d us, hash %d us, "
+				 "%d chunks, last %d bytes)\n",
+				 timing.total_us, timing.read_us,
+				 timing.hash_us, timing.chunks, chunk_size);
 
 		return EC_SUCCESS;
 	}
@@ -455,6 +561,30 @@ static void fill_response(struct ec_response_vboot_hash *r,
 		r->status = EC_VBOOT_HASH_STATUS_NONE;
 }
 
+/* Fill in the version 1 response, which adds timing for the last hash */
+static void fill_response_v1(struct ec_response_vboot_hash_v1 *r,
+			     int request_offset)
+{
+	fill_response(&r->hash, request_offset);
+	r->total_us = timing.total_us;
+	r->read_us = timing.read_us;
+	r->hash_us = timing.hash_us;
+	r->chunks = timing.chunks;
+	r->chunk_size = chunk_size;
+}
+
+static void fill_response_version(struct host_cmd_handler_args *args,
+				  int request_offset)
+{
+	if (args->version == 1) {
+		fill_response_v1(args->response, request_offset);
+		args->response_size = sizeof(struct ec_response_vboot_hash_v1);
+	} else {
+		fill_response(args->response, request_offset);
+		args->response_size = sizeof(struct ec_response_vboot_hash);
+	}
+}
+
 /**
  * Start computing a hash, with validity checking on params.
  *
@@ -494,17 +624,15 @@ static enum ec_status
 host_command_vboot_hash(struct host_cmd_handler_args *args)
 {
 	const struct ec_params_vboot_hash *p = args->params;
-	struct ec_response_vboot_hash *r = args->response;
 	int rv;
 
 	switch (p->cmd) {
 	case EC_VBOOT_HASH_GET:
 		if (p->offset || p->size)
-			fill_response(r, p->offset);
+			fill_response_version(args, p->offset);
 		else
-			fill_response(r, data_offset);
+			fill_response_version(args, data_offset);
 
-		args->response_size = sizeof(*r);
 		return EC_RES_SUCCESS;
 
 	case EC_VBOOT_HASH_ABORT:
@@ -522,8 +650,7 @@ host_command_vboot_hash(struct host_cmd_handler_args *args)
 			while (in_progress)
 				usleep(1000);
 
-		fill_response(r, p->offset);
-		args->response_size = sizeof(*r);
+		fill_response_version(args, p->offset);
 		return EC_RES_SUCCESS;
 
 	default:
@@ -532,4 +659,4 @@ host_command_vboot_hash(struct host_cmd_handler_args *args)
 }
 DECLARE_HOST_COMMAND(EC_CMD_VBOOT_HASH,
 		     host_command_vboot_hash,
-		     EC_VER_MASK(0));
+		     EC_VER_MASK(0) | EC_VER_MASK(1));
@@ -23,6 +23,11 @@ pthread_t task_get_thread(task_id_t tskid);
  */
 task_id_t task_get_running(void);
 
+/**
+ * Returns the number of times the scheduler has resumed a task.
+ */
+uint64_t task_get_switch_count(void);
+
 /**
  * Initializes the interrupt semaphore and associates a signal handler with
  * SIGNAL_INTERRUPT.
@@ -38,11 +38,32 @@ struct task_args {
 	void *d;
 };
 
+/* Event and mutex waiter bitmaps are 32 bits wide */
+BUILD_ASSERT(TASK_ID_COUNT <= 32);
+
 static struct emu_task_t tasks[TASK_ID_COUNT];
 static pthread_cond_t scheduler_cond;
 static pthread_mutex_t run_lock;
 static task_id_t running_task_id;
 static int task_started;
+static uint64_t task_switches;
+
+/*
+ * Tasks which may have events pending. task_set_event() sets the bit after
+ * posting the event; the scheduler clears it when it resumes the task or
+ * finds the event already consumed, so a stale bit only costs a recheck.
+ */
+static atomic_t tasks_ready;
+
+/*
+ * Binary min-heap of the tasks waiting on a timeout, keyed on wake_time
+ * (ties go to the lower task ID). wake_heap_idx[] holds each task's heap
+ * index plus one, or 0 when the task is not queued. Only modified with
+ * run_lock held.
+ */
+static task_id_t wake_heap[TASK_ID_COUNT];
+static int wake_heap_idx[TASK_ID_COUNT];
+static int wake_heap_size;
 
 static sem_t interrupt_sem;
 static pthread_mutex_t interrupt_lock;
@@ -58,6 +79,7 @@ static int has_interrupt_generator = 1;
 static __thread task_id_t my_task_id = TASK_ID_INVALID;
 
 static void task_enable_all_tasks_callback(void);
+static task_id_t task_dispatch_next(void);
 
 #define TASK(n, r, d, s) void r(void *);
 CONFIG_TASK_LIST
@@ -201,6 +223,7 @@ pthread_t task_get_thread(task_id_t tskid)
 uint32_t task_set_event(task_id_t tskid, uint32_t event)
 {
 	atomic_or(&tasks[tskid].event, event);
+	atomic_or(&tasks_ready, BIT(tskid));
 	return 0;
 }
 
@@ -209,17 +232,112 @@ uint32_t *task_get_event_bitmap(task_id_t tskid)
 	return &tasks[tskid].event;
 }
 
+static int wake_before(task_id_t a, task_id_t b)
+{
+	if (tasks[a].wake_time.val != tasks[b].wake_time.val)
+		return tasks[a].wake_time.val < tasks[b].wake_time.val;
+	return a < b;
+}
+
+static void wake_heap_place(int i, task_id_t tid)
+{
+	wake_heap[i] = tid;
+	wake_heap_idx[tid] = i + 1;
+}
+
+static void wake_heap_sift(int i)
+{
+	task_id_t tid = wake_heap[i];
+	int child;
+
+	/* Move up while earlier than the parent */
+	while (i > 0 && wake_before(tid, wake_heap[(i - 1) / 2])) {
+		wake_heap_place(i, wake_heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+
+	/* Move down while later than the earliest child */
+	while ((child = 2 * i + 1) < wake_heap_size) {
+		if (child + 1 < wake_heap_size &&
+		    wake_before(wake_heap[child + 1], wake_heap[child]))
+			child++;
+		if (!wake_before(wake_heap[child], tid))
+			break;
+		wake_heap_place(i, wake_heap[child]);
+		i = child;
+	}
+
+	wake_heap_place(i, tid);
+}
+
+static void wake_heap_remove(task_id_t tid)
+{
+	int i = wake_heap_idx[tid] - 1;
+
+	if (i < 0)
+		return;
+
+	wake_heap_idx[tid] = 0;
+	if (i == --wake_heap_size)
+		return;
+
+	wake_heap[i] = wake_heap[wake_heap_size];
+	wake_heap_sift(i);
+}
+
+/**
+ * Set the time at which a task is woken with TASK_EVENT_TIMER.
+ *
+ * @param tid		Task to update
+ * @param wake_time	Absolute wake time, or ~0 for no timeout
+ */
+static void task_set_wake_time(task_id_t tid, uint64_t wake_time)
+{
+	tasks[tid].wake_time.val = wake_time;
+
+	if (wake_time == ~0ull) {
+		wake_heap_remove(tid);
+		return;
+	}
+
+	if (!wake_heap_idx[tid])
+		wake_heap_place(wake_heap_size++, tid);
+	wake_heap_sift(wake_heap_idx[tid] - 1);
+}
+
 uint32_t task_wait_event(int timeout_us)
 {
 	int tid = task_get_current();
+	int next;
 	int ret;
 	pthread_mutex_lock(&interrupt_lock);
 	if (timeout_us > 0)
-		tasks[tid].wake_time.val = get_time().val + timeout_us;
+		task_set_wake_time(tid, get_time().val + timeout_us);
 
-	/* Transfer control to scheduler */
-	pthread_cond_signal(&scheduler_cond);
-	pthread_cond_wait(&tasks[tid].resume, &run_lock);
+	if (!task_started) {
+		/* Transfer control to scheduler */
+		pthread_cond_signal(&scheduler_cond);
+		pthread_cond_wait(&tasks[tid].resume, &run_lock);
+	} else {
+		/*
+		 * Make the scheduling decision here and hand over to the
+		 * next task directly, which saves a round trip through the
+		 * scheduler thread, or keep running if that is us.
+		 */
+		next = task_dispatch_next();
+		if (next != tid) {
+			pthread_cond_signal(&tasks[next].resume);
+			pthread_cond_wait(&tasks[tid].resume, &run_lock);
+		} else if (!tasks[tid].event) {
+			/*
+			 * The idle task with nothing to do while the interrupt
+			 * generator is busy: spin through the scheduler thread
+			 * so the generator gets a chance to run.
+			 */
+			pthread_cond_signal(&scheduler_cond);
+			pthread_cond_wait(&tasks[tid].resume, &run_lock);
+		}
+	}
 
 	/* Resume */
 	ret = atomic_clear(&tasks[tid].event);
@@ -250,8 +368,7 @@ uint32_t task_wait_event_mask(uint32_t event_mask, int timeout_us)
 
 	/* Re-post any other events collected */
 	if (events & ~event_mask)
-		atomic_or(&tasks[task_get_current()].event,
-			  events & ~event_mask);
+		task_set_event(task_get_current(), events & ~event_mask);
 
 	return events & event_mask;
 }
@@ -309,6 +426,8 @@ void task_print_list(void)
 		ccprintf("%4d %-16s %08x\n", i, task_names[i], tasks[i].event);
 		cflush();
 	}
+
+	ccprintf("Task switches: %lld\n", (long long)task_switches);
 }
 
 int command_task_info(int argc, char **argv)
@@ -352,21 +471,58 @@ void wait_for_task_started_nosleep(void)
 	_wait_for_task_started(0);
 }
 
+uint64_t task_get_switch_count(void)
+{
+	return task_switches;
+}
+
 static task_id_t task_get_next_wake(void)
 {
-	int i;
-	timestamp_t min_time;
-	int which_task = TASK_ID_INVALID;
+	return wake_heap_size ? wake_heap[0] : TASK_ID_INVALID;
+}
 
-	min_time.val = ~0ull;
+/**
+ * Return the highest priority task that has an event pending or whose
+ * timeout has expired, or TASK_ID_INVALID if there is none.
+ */
+static task_id_t task_get_next_ready(timestamp_t now)
+{
+	uint32_t ready;
+	task_id_t tid;
 
-	for (i = TASK_ID_COUNT - 1; i >= 0; --i)
-		if (min_time.val >= tasks[i].wake_time.val) {
-			min_time.val = tasks[i].wake_time.val;
-			which_task = i;
-		}
+	/* Expired timeouts make their task ready */
+	while (wake_heap_size &&
+	       tasks[wake_heap[0]].wake_time.val <= now.val) {
+		tid = wake_heap[0];
+		wake_heap_remove(tid);
+		atomic_or(&tasks_ready, BIT(tid));
+	}
+
+	ready = tasks_ready;
+	while (ready) {
+		tid = __fls(ready);
+		ready &= ~BIT(tid);
 
-	return which_task;
+		/*
+		 * Only tasks with spawned threads are valid to be resumed;
+		 * leave the bit set for the others until they are.
+		 */
+		if (!tasks[tid].thread)
+			continue;
+
+		if (tasks[tid].event || now.val >= tasks[tid].wake_time.val)
+			return tid;
+
+		/*
+		 * Nothing pending: drop the bit, then check again in case
+		 * task_set_event() raced with us.
+		 */
+		atomic_clear_bits(&tasks_ready, BIT(tid));
+		if (tasks[tid].event)
+			return tid;
+	}
+
+	return TASK_ID_INVALID;
 }
 
 static int fast_forward(void)
@@ -382,6 +538,30 @@ static int fast_forward(void)
 	 *   2. When the next task wakes up
 	 */
 	int task_id = task_get_next_wake();
+#ifdef CONFIG_SW_TIMER
+	timestamp_t deadline;
+
+	/*
+	 * Software timers which expire before anything else happens are
+	 * handled here, as their callbacks may wake a task.
+	 */
+	while (!has_interrupt_generator || generator_sleeping) {
+		deadline.val = sw_timer_next_deadline();
+		if (deadline.val == -1ull ||
+		    (task_id != TASK_ID_INVALID &&
+		     tasks[task_id].wake_time.val <= deadline.val) ||
+		    (has_interrupt_generator &&
+		     generator_sleep_deadline.val <= deadline.val))
+			break;
+
+		force_time(deadline);
+		sw_timer_expire(deadline);
+		task_id = task_get_next_ready(deadline);
+		if (task_id != TASK_ID_INVALID)
+			return task_id;
+		task_id = task_get_next_wake();
+	}
+#endif
 
 	if (!has_interrupt_generator) {
 		if (task_id == TASK_ID_INVALID) {
@@ -411,37 +591,44 @@ int task_start_called(void)
 	return task_started;
 }
 
-void task_scheduler(void)
+/**
+ * Pick the next task to run and mark it as running. Must be called with
+ * run_lock held; the caller resumes the returned task.
+ */
+static task_id_t task_dispatch_next(void)
 {
 	int i;
 	timestamp_t now;
 
+	now = get_time();
+#ifdef CONFIG_SW_TIMER
+	sw_timer_expire(now);
+#endif
+	i = task_get_next_ready(now);
+	if (i == TASK_ID_INVALID)
+		i = fast_forward();
+
+	now = get_time();
+	if (now.val >= tasks[i].wake_time.val)
+		atomic_or(&tasks[i].event, TASK_EVENT_TIMER);
+	task_set_wake_time(i, ~0ull);
+	/* Events posted from here on will be seen on resume */
+	atomic_clear_bits(&tasks_ready, BIT(i));
+	running_task_id = i;
+	tasks[i].started = 1;
+	task_switches++;
+
+	return i;
+}
+
+void task_scheduler(void)
+{
+	int i;
+
 	task_started = 1;
 
 	while (1) {
-		now = get_time();
-		i = TASK_ID_COUNT - 1;
-		while (i >= 0) {
-			/*
-			 * Only tasks with spawned threads are valid to be
-			 * resumed.
-			 */
-			if (tasks[i].thread) {
-				if (tasks[i].event ||
-				    now.val >= tasks[i].wake_time.val)
-					break;
-			}
-			--i;
-		}
-		if (i < 0)
-			i = fast_forward();
-
-		now = get_time();
-		if (now.val >= tasks[i].wake_time.val)
-			tasks[i].event |= TASK_EVENT_TIMER;
-		tasks[i].wake_time.val = ~0ull;
-		running_task_id = i;
-		tasks[i].started = 1;
+		i = task_dispatch_next();
 		pthread_cond_signal(&tasks[i].resume);
 		pthread_cond_wait(&scheduler_cond, &run_lock);
 	}
@@ -495,6 +682,7 @@ int task_start(void)
 	tasks[i].event = TASK_EVENT_WAKE;
 	tasks[i].wake_time.val = ~0ull;
 	tasks[i].started = 0;
+	atomic_or(&tasks_ready, BIT(i));
 	pthread_cond_init(&tasks[i].resume, NULL);
 	pthread_create(&tasks[i].thread, NULL, _task_start_impl,
 		       (void *)(uintptr_t)i);
@@ -539,6 +727,7 @@ static void task_enable_all_tasks_callback(void)
 		tasks[i].event = TASK_EVENT_WAKE;
 		tasks[i].wake_time.val = ~0ull;
 		tasks[i].started = 0;
+		atomic_or(&tasks_ready, BIT(i));
 		pthread_cond_init(&tasks[i].resume, NULL);
 		pthread_create(&tasks[i].thread, NULL, _task_start_impl,
 			       (void *)(uintptr_t)i);
@@ -88,6 +88,27 @@ int timestamp_expired(timestamp_t deadline, const timestamp_t *now)
 	return ((int64_t)(now->val - deadline.val) >= 0);
 }
 
+#ifdef CONFIG_SW_TIMER
+/*
+ * The emulator expires software timers from its scheduler, which checks
+ * sw_timer_next_deadline() every time it picks a task, and only one task or
+ * the scheduler runs at a time; so there is nothing to reschedule or mask.
+ * Software timers must not be used from test interrupts.
+ */
+void sw_timer_reschedule(timestamp_t deadline)
+{
+}
+
+uint32_t sw_timer_lock(void)
+{
+	return 0;
+}
+
+void sw_timer_unlock(uint32_t key)
+{
+}
+#endif
+
 void timer_init(void)
 {
 	if (!time_set)
@@ -70,13 +70,40 @@ struct transfer_descriptor {
 /* Information about the target */
 static struct first_response_pdu targ;
 
+/* Default number of PDUs to ask to have in flight */
+#define DEFAULT_WINDOW 8
+
+/*
+ * Window asked for, and the one the target granted; 0 to send PDUs one at a
+ * time.
+ */
+static uint32_t max_window = DEFAULT_WINDOW;
+static uint32_t stream_window;
+
+/* PDUs sent, and programmed by the target, since the start PDU */
+static uint32_t stream_sent;
+static uint32_t stream_done;
+
+/*
+ * Block encodings the target accepted, unless raw_blocks is set, in which case
+ * none are asked for.
+ */
+static uint32_t block_encodings;
+static int raw_blocks;
+
+/* PDU size assumed by --benchmark, which has no target to ask */
+#define BENCHMARK_PDU_SIZE 1024
+/* Times each block is decoded by --benchmark, to time it */
+#define BENCHMARK_DECODE_RUNS 100
+
 static uint16_t protocol_version;
 static uint16_t header_type;
 static char *progname;
-static char *short_opts = "bd:efg:hjlnp:rsS:tuw";
+static char *short_opts = "bBd:efg:hjlnp:rRsS:tuwW:";
 static const struct option long_opts[] = {
 	/* name    hasarg *flag val */
 	{"binvers",	1,   NULL, 'b'},
+	{"benchmark",	0,   NULL, 'B'},
 	{"device",	1,   NULL, 'd'},
 	{"entropy",	0,   NULL, 'e'},
 	{"fwver",	0,   NULL, 'f'},
@@ -87,11 +114,13 @@ static const struct option long_opts[] = {
 	{"no_reset",	0,   NULL, 'n'},
 	{"tp_update",	1,   NULL, 'p'},
 	{"reboot",	0,   NULL, 'r'},
+	{"raw",		0,   NULL, 'R'},
 	{"stay_in_ro",	0,   NULL, 's'},
 	{"serial",	1,   NULL, 'S'},
 	{"tp_info",	0,   NULL, 't'},
 	{"unlock_rollback",	0,   NULL, 'u'},
 	{"unlock_rw",	0,   NULL, 'w'},
+	{"window",	1,   NULL, 'W'},
 	{},
 };
 
@@ -114,6 +143,10 @@ static void usage(int errs)
 	       "\n"
 	       "  -b,--binvers             Report versions of image's "
 				"RW and RO, do not update\n"
+	       "  -B,--benchmark           Report how the image would be "
+				"sent, and the time\n"
+	       "                           to decode its blocks, do not "
+				"update\n"
 	       "  -d,--device  VID:PID     USB device (default %04x:%04x)\n"
 	       "  -e,--entropy             Add entropy to device secret\n"
 	       "  -f,--fwver               Report running firmware versions.\n"
@@ -123,12 +156,15 @@ static void usage(int errs)
 	       "  -l,--follow_log          Get console log\n"
 	       "  -p,--tp_update file      Update touchpad FW\n"
 	       "  -r,--reboot              Tell EC to reboot\n"
+	       "  -R,--raw                 Do not compress blocks\n"
 	       "  -s,--stay_in_ro          Tell EC to stay in RO\n"
 	       "  -S,--serial              Device serial number\n"
 	       "  -t,--tp_info             Get touchpad information\n"
 	       "  -u,--unlock_rollback     Tell EC to unlock the rollback region\n"
 	       "  -w,--unlock_rw           Tell EC to unlock the RW region\n"
-	       "\n", progname, VID, PID);
+	       "  -W,--window <n>          Blocks in flight during the update\n"
+	       "                           (default %d, 0 for one at a time)\n"
+	       "\n", progname, VID, PID, DEFAULT_WINDOW);
 
 	exit(errs ? update_error : noop);
 }
@@ -488,14 +524,11 @@ static void usb_findit(uint16_t vid, uint16_t pid,
 	printf("READY\n-------\n");
 }
 
-static int transfer_block(struct usb_endpoint *uep,
-			  struct update_frame_header *ufh,
-			  uint8_t *transfer_data_ptr, size_t payload_size)
+static void send_block(struct usb_endpoint *uep,
+		       struct update_frame_header *ufh,
+		       uint8_t *transfer_data_ptr, size_t payload_size)
 {
 	size_t transfer_size;
-	uint32_t reply;
-	int actual;
-	int r;
 
 	/* First send the header. */
 	xfer(uep, ufh, sizeof(*ufh), NULL, 0, 0);
@@ -509,6 +542,17 @@ static int transfer_block(struct usb_endpoint *uep,
 		transfer_data_ptr += chunk_size;
 		transfer_size += chunk_size;
 	}
+}
+
+static int transfer_block(struct usb_endpoint *uep,
+			  struct update_frame_header *ufh,
+			  uint8_t *transfer_data_ptr, size_t payload_size)
+{
+	uint32_t reply;
+	int actual;
+	int r;
+
+	send_block(uep, ufh, transfer_data_ptr, payload_size);
 
 	/* Now get the reply. */
 	r = libusb_bulk_transfer(uep->devh, uep->ep_num | 0x80,
@@ -532,6 +576,110 @@ static int transfer_block(struct usb_endpoint *uep,
 	return 0;
 }
 
+/*
+ * Wait for the target to acknowledge more streamed blocks. Each ack covers
+ * all the blocks before it, several of them may come in one transfer.
+ */
+static void stream_wait_ack(struct usb_endpoint *uep)
+{
+	struct update_stream_ack acks[USB_MAX_PACKET_SIZE /
+				      sizeof(struct update_stream_ack)];
+	int actual;
+	size_t i;
+	int r;
+
+	r = libusb_bulk_transfer(uep->devh, uep->ep_num | 0x80,
+				 (void *)acks, sizeof(acks), &actual, 5000);
+	if (r) {
+		USB_ERROR("libusb_bulk_transfer", r);
+		shut_down(uep);
+	}
+
+	if (actual < (int)sizeof(acks[0])) {
+		fprintf(stderr, "%s:%d, only received %d bytes\n",
+			__FILE__, __LINE__, actual);
+		shut_down(uep);
+	}
+
+	for (i = 0; i < actual / sizeof(acks[0]); i++) {
+		if (acks[i].return_value) {
+			fprintf(stderr, "Error: status %#x after %d blocks\n",
+				be32toh(acks[i].return_value),
+				be32toh(acks[i].blocks_done));
+			exit(update_error);
+		}
+		stream_done = be32toh(acks[i].blocks_done);
+	}
+}
+
+/*
+ * Check if a block is all 0xff. Such blocks need not be sent, as the whole
+ * section is erased when its first block is programmed.
+ */
+static int block_is_erased(const uint8_t *data, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		if (data[i] != 0xff)
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Encode a block to send to section_addr, if the target accepts encodings,
+ * and prepare its frame header; returns the size of the payload.
+ */
+static size_t prepare_block(struct update_frame_header *ufh,
+			    const uint8_t *data, size_t size,
+			    uint32_t section_addr, uint8_t *payload)
+{
+	int encoding = UPDATE_BLOCK_RAW;
+
+	if (block_encodings)
+		size = update_block_encode(block_encodings, data, size,
+					   payload, &encoding);
+	else
+		memcpy(payload, data, size);
+
+	ufh->block_size = htobe32((size + sizeof(struct update_frame_header)) |
+				  encoding << UPDATE_FRAME_ENCODING_SHIFT);
+	ufh->cmd.block_base = htobe32(section_addr);
+	ufh->cmd.block_digest = 0;
+
+	return size;
+}
+
+/*
+ * Send a block, waiting for its response, or only for a free slot when
+ * streaming.
+ */
+static void send_pdu(struct transfer_descriptor *td,
+		     struct update_frame_header *ufh,
+		     uint8_t *payload, size_t payload_size, size_t data_len)
+{
+	int max_retries;
+
+	if (stream_window) {
+		while (stream_sent - stream_done >= stream_window)
+			stream_wait_ack(&td->uep);
+		send_block(&td->uep, ufh, payload, payload_size);
+		stream_sent++;
+		return;
+	}
+
+	for (max_retries = 10; max_retries; max_retries--)
+		if (!transfer_block(&td->uep, ufh, payload, payload_size))
+			break;
+
+	if (!max_retries) {
+		fprintf(stderr, "Failed to transfer block, %zd to go\n",
+			data_len);
+		exit(update_error);
+	}
+}
+
 /**
  * Transfer an image section (typically RW or RO).
  *
@@ -539,7 +687,7 @@ static int transfer_block(struct usb_endpoint *uep,
  * data_ptr     - pointer at the section base in the image
  * section_addr - address of the section in the target memory space
  * data_len     - section size
- * smart_update - non-zero to enable the smart trailing of 0xff.
+ * smart_update - non-zero to skip the blocks of 0xff, which are erased.
  */
 static void transfer_section(struct transfer_descriptor *td,
 			     uint8_t *data_ptr,
@@ -547,11 +695,13 @@ static void transfer_section(struct transfer_descriptor *td,
 			     size_t data_len,
 			     uint8_t smart_update)
 {
+	uint8_t payload[targ.common.maximum_pdu_size];
+	uint32_t section_base = section_addr;
+	size_t wire_size = 0;
+
 	/*
 	 * Actually, we can skip trailing chunks of 0xff, as the entire
 	 * section space must be erased before the update is attempted.
-	 *
-	 * FIXME: We can be smarter than this and skip blocks within the image.
 	 */
 	if (smart_update)
 		while (data_len && (data_ptr[data_len - 1] == 0xff))
@@ -559,36 +709,123 @@ static void transfer_section(struct transfer_descriptor *td,
 
 	printf("sending 0x%zx bytes to %#x\n", data_len, section_addr);
 	while (data_len) {
+		struct update_frame_header ufh;
 		size_t payload_size;
-		uint32_t block_base;
-		int max_retries;
 
-		/* prepare the header to prepend to the block. */
 		payload_size = MIN(data_len, targ.common.maximum_pdu_size);
 
-		block_base = htobe32(section_addr);
+		/* The first block is always sent, it erases the section. */
+		if (!smart_update || section_addr == section_base ||
+		    !block_is_erased(data_ptr, payload_size)) {
+			size_t size = prepare_block(&ufh, data_ptr,
+						    payload_size,
+						    section_addr, payload);
 
-		struct update_frame_header ufh;
+			send_pdu(td, &ufh, payload, size, data_len);
+			wire_size += sizeof(ufh) + size;
+		}
 
-		ufh.block_size = htobe32(payload_size +
-					sizeof(struct update_frame_header));
-		ufh.cmd.block_base = block_base;
-		ufh.cmd.block_digest = 0;
-		for (max_retries = 10; max_retries; max_retries--)
-			if (!transfer_block(&td->uep, &ufh,
-						data_ptr, payload_size))
-				break;
+		data_len -= payload_size;
+		data_ptr += payload_size;
+		section_addr += payload_size;
+	}
 
-		if (!max_retries) {
-			fprintf(stderr,
-				"Failed to transfer block, %zd to go\n",
-				data_len);
-			exit(update_error);
+	/* Wait for the blocks still in flight to be programmed. */
+	while (stream_sent != stream_done)
+		stream_wait_ack(&td->uep);
+
+	printf("sent 0x%zx bytes\n", wire_size);
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * Go through a section as transfer_section() would, and report the bytes it
+ * would send, and the time the blocks take to decode.
+ */
+static void benchmark_section(const char *name, const uint8_t *data_ptr,
+			      size_t data_len, uint8_t smart_update)
+{
+	uint8_t payload[BENCHMARK_PDU_SIZE];
+	uint8_t decoded[BENCHMARK_PDU_SIZE];
+	size_t encoded[UPDATE_BLOCK_LZ + 1] = { 0 };
+	size_t section_len = data_len;
+	uint32_t section_addr = 0;
+	size_t blocks = 0;
+	size_t wire_size = 0;
+	uint64_t decode_ns = 0;
+	uint64_t max_ns = 0;
+
+	if (smart_update)
+		while (data_len && (data_ptr[data_len - 1] == 0xff))
+			data_len--;
+
+	while (data_len) {
+		struct update_frame_header ufh;
+		size_t payload_size, size, decoded_size;
+		uint64_t start, ns;
+		int encoding;
+		int i;
+
+		payload_size = MIN(data_len, BENCHMARK_PDU_SIZE);
+
+		if (!smart_update || !section_addr ||
+		    !block_is_erased(data_ptr, payload_size)) {
+			size = prepare_block(&ufh, data_ptr, payload_size,
+					     section_addr, payload);
+			encoding = be32toh(ufh.block_size) >>
+				UPDATE_FRAME_ENCODING_SHIFT;
+
+			start = get_time_ns();
+			for (i = 0; i < BENCHMARK_DECODE_RUNS; i++)
+				if (update_block_decode(encoding, payload,
+						size, decoded,
+						sizeof(decoded),
+						&decoded_size) ||
+				    decoded_size != payload_size) {
+					fprintf(stderr,
+						"%s: cannot decode block %#x\n",
+						name, section_addr);
+					exit(update_error);
+				}
+			ns = (get_time_ns() - start) / BENCHMARK_DECODE_RUNS;
+
+			if (memcmp(decoded, data_ptr, payload_size)) {
+				fprintf(stderr, "%s: block %#x decodes wrong\n",
+					name, section_addr);
+				exit(update_error);
+			}
+
+			debug("%s: %#x: encoding %d, %zu bytes, %llu ns\n",
+			      name, section_addr, encoding, size,
+			      (unsigned long long)ns);
+			blocks++;
+			encoded[encoding]++;
+			wire_size += sizeof(ufh) + size;
+			decode_ns += ns;
+			if (ns > max_ns)
+				max_ns = ns;
 		}
+
 		data_len -= payload_size;
 		data_ptr += payload_size;
 		section_addr += payload_size;
 	}
+
+	printf("%s: 0x%zx bytes, %zu blocks sent: %zu raw, %zu fill, %zu lz\n",
+	       name, section_len, blocks, encoded[UPDATE_BLOCK_RAW],
+	       encoded[UPDATE_BLOCK_FILL], encoded[UPDATE_BLOCK_LZ]);
+	printf("%s: 0x%zx bytes on the wire (%zu%%), decoding takes "
+	       "%llu ns/block (max %llu)\n",
+	       name, wire_size, section_len ? wire_size * 100 / section_len : 0,
+	       (unsigned long long)(blocks ? decode_ns / blocks : 0),
+	       (unsigned long long)max_ns);
 }
 
 /*
@@ -767,7 +1004,7 @@ static void setup_connection(struct transfer_descriptor *td)
 	/* Send start request. */
 	printf("start\n");
 
-	struct update_frame_header ufh;
+	struct update_stream_start start;
 	uint8_t inbuf[td->uep.chunk_len];
 	int actual = 0;
 
@@ -779,10 +1016,24 @@ static void setup_connection(struct transfer_descriptor *td)
 		printf("flush\n");
 	}
 
-	memset(&ufh, 0, sizeof(ufh));
-	ufh.block_size = htobe32(sizeof(ufh));
-	do_xfer(&td->uep, &ufh, sizeof(ufh), &start_resp,
-		sizeof(start_resp), 1, &rxed_size);
+	memset(&start, 0, sizeof(start));
+	if (max_window || !raw_blocks) {
+		start.header.block_size = htobe32(sizeof(start));
+		start.block_encodings =
+			htobe16(raw_blocks ? 0 : UPDATE_BLOCK_ENCODINGS);
+		start.window = htobe16(max_window);
+		do_xfer(&td->uep, &start, sizeof(start), &start_resp,
+			sizeof(start_resp), 1, &rxed_size);
+
+		/* Targets which do not stream reply with a one byte error. */
+		if (rxed_size == 1)
+			printf("streaming not supported\n");
+	}
+	if ((!max_window && raw_blocks) || rxed_size == 1) {
+		start.header.block_size = htobe32(sizeof(start.header));
+		do_xfer(&td->uep, &start.header, sizeof(start.header),
+			&start_resp, sizeof(start_resp), 1, &rxed_size);
+	}
 
 	/* We got something. Check for errors in response */
 	if (rxed_size < 8) {
@@ -828,12 +1079,24 @@ static void setup_connection(struct transfer_descriptor *td)
 	targ.common.min_rollback = be32toh(start_resp.rpdu.common.min_rollback);
 	targ.common.key_version = be32toh(start_resp.rpdu.common.key_version);
 
+	stream_window = 0;
+	block_encodings = 0;
+	if (rxed_size >= sizeof(start_resp.rpdu)) {
+		stream_window = be16toh(start_resp.rpdu.common.stream_window);
+		block_encodings =
+			be16toh(start_resp.rpdu.common.block_encodings);
+	}
+	stream_sent = 0;
+	stream_done = 0;
+
 	printf("maximum PDU size: %d\n", targ.common.maximum_pdu_size);
 	printf("Flash protection status: %04x\n", targ.common.flash_protection);
 	printf("version: %32s\n", targ.common.version);
 	printf("key_version: %d\n", targ.common.key_version);
 	printf("min_rollback: %d\n", targ.common.min_rollback);
 	printf("offset: writable at %#x\n", td->offset);
+	printf("stream window: %d\n", stream_window);
+	printf("block encodings: %#x\n", block_encodings);
 
 	pick_sections(td);
 }
@@ -1048,6 +1311,7 @@ int main(int argc, char *argv[])
 	size_t j;
 	int transferred_sections = 0;
 	int binary_vers = 0;
+	int benchmark = 0;
 	int show_fw_ver = 0;
 	int no_reset_request = 0;
 	int touchpad_update = 0;
@@ -1073,6 +1337,9 @@ int main(int argc, char *argv[])
 		case 'b':
 			binary_vers = 1;
 			break;
+		case 'B':
+			benchmark = 1;
+			break;
 		case 'd':
 			if (!parse_vidpid(optarg, &vid, &pid)) {
 				printf("Invalid argument: \"%s\"\n", optarg);
@@ -1119,6 +1386,9 @@ int main(int argc, char *argv[])
 		case 'r':
 			extra_command = UPDATE_EXTRA_CMD_IMMEDIATE_RESET;
 			break;
+		case 'R':
+			raw_blocks = 1;
+			break;
 		case 's':
 			extra_command = UPDATE_EXTRA_CMD_STAY_IN_RO;
 			break;
@@ -1136,6 +1406,9 @@ int main(int argc, char *argv[])
 		case 'w':
 			extra_command = UPDATE_EXTRA_CMD_UNLOCK_RW;
 			break;
+		case 'W':
+			max_window = strtoul(optarg, NULL, 0);
+			break;
 		case 0:				/* auto-handled option */
 			break;
 		case '?':
@@ -1179,6 +1452,18 @@ int main(int argc, char *argv[])
 			printf("Ignoring binary image %s\n", argv[optind]);
 	}
 
+	if (benchmark && data) {
+		block_encodings = raw_blocks ? 0 : UPDATE_BLOCK_ENCODINGS;
+		if (touchpad_update)
+			benchmark_section("TP", data, data_len, 0);
+		else
+			for (j = 0; j < ARRAY_SIZE(sections); j++)
+				benchmark_section(sections[j].name,
+						  data + sections[j].offset,
+						  sections[j].size, 1);
+		exit(noop);
+	}
+
 	usb_findit(vid, pid, serialno, &td.uep);
 
 	setup_connection(&td);
@@ -1461,6 +1461,13 @@
 /* Provide common core code to handle the operating system timers. */
 #define CONFIG_COMMON_TIMER
 
+/*
+ * Software timers (struct sw_timer): any number of timers with callbacks or
+ * task events, kept in a hierarchical timer wheel and expired from the timer
+ * interrupt.
+ */
+#undef CONFIG_SW_TIMER
+
 /*****************************************************************************/
 
 /*
@@ -1518,6 +1525,18 @@
 /* Enable verbose output to UART console and extra timestamp print precision. */
 #define CONFIG_CONSOLE_VERBOSE
 
+/*
+ * Send cprints() output tokenized instead of as text.  Format strings are kept
+ * in the .log_strings section of the ELF file, outside the image, and each
+ * line only carries the offset of its format string, a timestamp and the raw
+ * arguments, base64 encoded on a line starting with '$'.  Use util/ec3po
+ * (tokenized_log.py, or the console's --elf option) with the matching ELF
+ * file to turn those back into text.
+ *
+ * cprints() formats must then be string literals, with at most 12 arguments.
+ */
+#undef CONFIG_CONSOLE_TOKENIZED
+
 /*****************************************************************************/
 /* Support for EC-EC communication */
 
@@ -2107,6 +2126,27 @@
  */
 #undef CONFIG_HOSTCMD_SECTION_SORTED
 
+/*
+ * Match host commands to their handlers through a hash table built at init,
+ * at the cost of about 6 bytes of RAM per host command.  This takes
+ * precedence over CONFIG_HOSTCMD_SECTION_SORTED.
+ */
+#undef CONFIG_HOSTCMD_HASH
+
+/*
+ * Count the calls to each host command and keep a histogram of how long its
+ * handler takes, for EC_CMD_HOSTCMD_STATS.  Costs 36 bytes of RAM per host
+ * command.
+ */
+#undef CONFIG_HOSTCMD_STATS
+
+/*
+ * Support EC_CMD_BATCH, which runs several host commands from a single
+ * request, to save the host the transport overhead of each.  Batched
+ * responses are built in shared memory.
+ */
+#undef CONFIG_HOSTCMD_BATCH
+
 /*
  * Host command parameters and response are 32-bit aligned.  This generates
  * much more efficient code on ARM.
@@ -2137,6 +2177,13 @@
  */
 #undef CONFIG_HOSTCMD_FLASH_SPI_INFO
 
+/*
+ * Support EC_CMD_FLASH_BLOCK_HASH, which returns the SHA-256 of flash blocks
+ * so that the host only rewrites the blocks which changed ("ectool
+ * flashupdate").
+ */
+#undef CONFIG_HOSTCMD_FLASH_BLOCK_HASH
+
 /*
  * For ECs where the host command interface is I2C, peripheral
  * address which the EC will respond to.
@@ -2222,6 +2269,13 @@
 /* Enable debugging and profiling statistics for hook functions */
 #undef CONFIG_HOOK_DEBUG
 
+/*
+ * How late deferred functions may be called, in microseconds.  The hook task
+ * sleeps until the first deadline plus this slack, so deadlines which are
+ * close together are handled by a single wakeup.
+ */
+#define CONFIG_HOOK_DEFERRED_SLACK_US 0
+
 /*****************************************************************************/
 /* CRC configuration */
 
@@ -2231,6 +2285,15 @@
 /* Enable the software routine for CRC computation */
 #undef CONFIG_SW_CRC
 
+/*
+ * Process 4 (or 8) bytes per step in the software CRC-32 routine using
+ * slicing tables. Each extra table costs 1 KB of flash on top of the default
+ * 1 KB byte-wise table, so slice-by-4 needs 4 KB and slice-by-8 needs 8 KB.
+ * Boards short on flash should leave both undefined.
+ */
+#undef CONFIG_SW_CRC_SLICE_BY_4
+#undef CONFIG_SW_CRC_SLICE_BY_8
+
 /*****************************************************************************/
 
 /* Enable system hibernate */
@@ -2852,6 +2915,12 @@
 /* Support host command interface over HECI */
 #undef CONFIG_HOSTCMD_HECI
 
+/*
+ * Support host command interface over a UNIX socket, on the emulator; see
+ * chip/host/host_command_sock.c and util/comm-sock.c.
+ */
+#undef CONFIG_HOSTCMD_SOCKET
+
 /*
  * EC supports x86 host communication with AP. This can either be through LPC
  * or eSPI. The CONFIG_HOSTCMD_X86 will get automatically defined if either
@@ -3303,7 +3372,9 @@
 
 /*
  * Adjust the compiler optimization flags for the RSA code to get a speed-up
- * at the expense of a small code size delta.
+ * at the expense of a small code size delta. This also makes the Montgomery
+ * multiplication process two words of the multiplier per pass over the
+ * accumulator, halving its loads and stores.
  */
 #undef CONFIG_RSA_OPTIMIZED
 
@@ -3386,6 +3457,27 @@
 /* Unroll some loops in SHA256_transform for better performance. */
 #undef CONFIG_SHA256_UNROLLED
 
+/*
+ * Fully unroll the rounds and message schedule in SHA256_transform. Faster
+ * than CONFIG_SHA256_UNROLLED, at the cost of a few KB of flash.
+ */
+#undef CONFIG_SHA256_FULLY_UNROLLED
+
+/*
+ * When hashing several blocks at once, expand the message schedule of the
+ * next block while running the rounds of the current one. Needs 256 more
+ * bytes of stack in SHA256_transform. Can be combined with the unrolled
+ * variants.
+ */
+#undef CONFIG_SHA256_INTERLEAVED
+
+/*
+ * Use the x86 SHA extensions in SHA256_transform when the CPU has them,
+ * falling back to the software transform otherwise. Emulator (host) builds
+ * only.
+ */
+#undef CONFIG_SHA256_X86_SHA_NI
+
 /* Emulate the CLZ (Count Leading Zeros) in software for CPU lacking support */
 #undef CONFIG_SOFTWARE_CLZ
 
@@ -4763,6 +4855,16 @@
 /* Support computing hash of code for verified boot */
 #undef CONFIG_VBOOT_HASH
 
+/*
+ * Size the chunks hashed per deferred call from the measured cost of the
+ * previous chunk, aiming for CONFIG_VBOOT_HASH_CHUNK_US per call. Chunks grow
+ * from 1 KB up to CONFIG_VBOOT_HASH_MAX_CHUNK_SIZE, which must be a power of
+ * two and, on boards without mapped storage, fit in shared memory.
+ */
+#undef CONFIG_VBOOT_HASH_ADAPTIVE
+#define CONFIG_VBOOT_HASH_CHUNK_US 1000
+#define CONFIG_VBOOT_HASH_MAX_CHUNK_SIZE 8192
+
 /* Support for secure temporary storage for verified boot */
 #undef CONFIG_VSTORE
 
@@ -4863,6 +4965,21 @@
 /* PDU size for fw update over USB (or TPM). */
 #define CONFIG_UPDATE_PDU_SIZE 1024
 
+/*
+ * Number of PDUs the host may have in flight during a streaming fw update
+ * over USB. Each one takes a PDU sized buffer; they are programmed from a
+ * deferred routine while the next ones are received. If undefined, PDUs are
+ * sent and programmed one at a time.
+ */
+#undef CONFIG_UPDATE_STREAM_WINDOW
+
+/*
+ * Accept PDUs for fw update over USB which are compressed, or fill whole
+ * blocks with a single value, when the host asks for it in the streaming
+ * start PDU. Takes a PDU sized buffer to decode them in.
+ */
+#undef CONFIG_UPDATE_BLOCK_ENCODING
+
 /*
  * If defined, charge_get_state returns a special status if battery is
  * discharging and battery is nearly full.
@@ -5774,6 +5891,11 @@
 #error "CONFIG_DPTF_MULTI_PROFILE can be set only when CONFIG_DPTF is set."
 #endif /* CONFIG_DPTF_MULTI_PROFILE && !CONFIG_DPTF */
 
+#if defined(CONFIG_UPDATE_BLOCK_ENCODING) && \
+	!defined(CONFIG_UPDATE_STREAM_WINDOW)
+#error "CONFIG_UPDATE_BLOCK_ENCODING requires CONFIG_UPDATE_STREAM_WINDOW."
+#endif
+
 /*
  * Define the timeout in milliseconds between when the EC receives a suspend
  * command and when the EC times out and asserts wake because the sleep signal
@@ -5849,6 +5971,10 @@
 #define CONFIG_SHA256
 #endif
 
+#ifdef CONFIG_HOSTCMD_FLASH_BLOCK_HASH
+#define CONFIG_SHA256
+#endif
+
 #ifdef CONFIG_SMBUS_PEC
 #define CONFIG_CRC8
 #endif
@@ -102,6 +102,15 @@ enum console_channel {
 /* Mask to use to enable all channels */
 #define CC_ALL			0xffffffffU
 
+/**
+ * Check if a console channel is disabled.
+ *
+ * @param channel	Output channel
+ *
+ * @return non-zero if output to the channel is dropped.
+ */
+int console_channel_is_disabled(enum console_channel channel);
+
 /**
  * Put a string to the console channel.
  *
@@ -135,6 +144,90 @@ int cprintf(enum console_channel channel, const char *format, ...);
 __attribute__((__format__(__printf__, 2, 3)))
 int cprints(enum console_channel channel, const char *format, ...);
 
+#ifdef CONFIG_CONSOLE_TOKENIZED
+/* Types of tokenized arguments, two bits each */
+#define CONSOLE_ARG_END		0
+#define CONSOLE_ARG_INT32	1
+#define CONSOLE_ARG_INT64	2
+#define CONSOLE_ARG_STRING	3
+
+#define CONSOLE_IS_STRING(arg, type)					\
+	(__builtin_types_compatible_p(typeof((arg) + 0), type *) ||	\
+	 __builtin_types_compatible_p(typeof((arg) + 0), const type *))
+
+#define CONSOLE_ARG_TYPE(arg)						\
+	(CONSOLE_IS_STRING(arg, char) ||				\
+	 CONSOLE_IS_STRING(arg, unsigned char) ? CONSOLE_ARG_STRING :	\
+	 sizeof((arg) + 0) == sizeof(uint64_t) ?			\
+	 CONSOLE_ARG_INT64 : CONSOLE_ARG_INT32)
+
+#define CONSOLE_ARG_COUNT(...)						\
+	CONSOLE_ARG_COUNT_(_, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, \
+			   3, 2, 1, 0)
+#define CONSOLE_ARG_COUNT_(_, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10,	\
+			   a11, a12, n, ...) n
+
+#define CONSOLE_ARG_TYPES_0() CONSOLE_ARG_END
+#define CONSOLE_ARG_TYPES_1(a) CONSOLE_ARG_TYPE(a)
+#define CONSOLE_ARG_TYPES_2(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_1(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_3(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_2(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_4(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_3(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_5(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_4(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_6(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_5(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_7(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_6(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_8(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_7(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_9(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_8(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_10(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_9(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_11(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_10(__VA_ARGS__) << 2)
+#define CONSOLE_ARG_TYPES_12(a, ...)					\
+	(CONSOLE_ARG_TYPE(a) | CONSOLE_ARG_TYPES_11(__VA_ARGS__) << 2)
+
+/* Types of all the arguments, first one in the lowest bits */
+#define CONSOLE_ARG_TYPES(...)						\
+	CONCAT2(CONSOLE_ARG_TYPES_, CONSOLE_ARG_COUNT(__VA_ARGS__))(__VA_ARGS__)
+
+/*
+ * Format string, in a section which is not loaded; the arguments are only
+ * checked against it.
+ */
+#define CONSOLE_LOG_STRING(format, args...) ({				\
+	static const char __log_str[]					\
+		__attribute__((section(".log_strings"))) = format;	\
+	(void)sizeof(cprints_check_format(format, ## args));		\
+	__log_str; })
+
+/**
+ * Print tokenized output with timestamp; see CONFIG_CONSOLE_TOKENIZED.
+ *
+ * @param channel	Output channel
+ * @param format	Format string in .log_strings; never read, its offset
+ *			is the token
+ * @param arg_types	CONSOLE_ARG_TYPES() of the arguments
+ *
+ * @return non-zero if output was truncated.
+ */
+int cprints_tokenized(enum console_channel channel, const char *format,
+		      uint32_t arg_types, ...);
+
+/* Only used to check the arguments against the format; never called */
+__attribute__((__format__(__printf__, 1, 2)))
+int cprints_check_format(const char *format, ...);
+
+#define cprints(channel, format, args...)				\
+	cprints_tokenized(channel, CONSOLE_LOG_STRING(format, ## args),	\
+			  CONSOLE_ARG_TYPES(args), ## args)
+#endif /* CONFIG_CONSOLE_TOKENIZED */
+
 /**
  * Flush the console output for all channels.
  */
@@ -34,8 +34,33 @@ void crc32_ctx_hash16(uint32_t *ctx, uint16_t val);
 
 void crc32_ctx_hash8(uint32_t *ctx, uint8_t val);
 
+/**
+ * Hash a buffer into a CRC-32 context.
+ *
+ * Uses the multi-byte slicing tables when CONFIG_SW_CRC_SLICE_BY_4 or
+ * CONFIG_SW_CRC_SLICE_BY_8 is defined; buf does not need to be aligned.
+ *
+ * @param ctx	CRC-32 context
+ * @param buf	Data to hash
+ * @param size	Number of bytes in buf
+ */
+void crc32_ctx_hash(uint32_t *ctx, const void *buf, int size);
+
 uint32_t crc32_ctx_result(uint32_t *ctx);
 
+/**
+ * Combine the CRC-32 of two consecutive segments.
+ *
+ * This lets segments of a buffer be hashed independently (for example as
+ * they come off different flash banks) and merged afterwards.
+ *
+ * @param crc1	Result of crc32_ctx_result() for the first segment
+ * @param crc2	Result of crc32_ctx_result() for the second segment
+ * @param len2	Length of the second segment in bytes
+ * @return CRC-32 of the first segment followed by the second segment
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, int len2);
+
 #endif /* CONFIG_HW_CRC */
 
 #endif /* __CROS_EC_CRC_H */
@@ -1680,6 +1680,8 @@ enum ec_feature_code {
 	 * mux.
 	 */
 	EC_FEATURE_TYPEC_MUX_REQUIRE_AP_ACK = 43,
+	/* EC_CMD_BATCH runs several host commands from one request */
+	EC_FEATURE_HOST_BATCH = 44,
 };
 
 #define EC_FEATURE_MASK_0(event_code) BIT(event_code % 32)
@@ -2156,6 +2158,34 @@ struct ec_response_sysinfo {
 	uint32_t flags;			/**< enum sysinfo_flags */
 } __ec_align4;
 
+/*
+ * Get the SHA-256 hashes of consecutive flash blocks, so the host can tell
+ * which blocks differ from its image without reading them back.
+ *
+ * The EC may hash fewer blocks than asked for, to fit in the response or to
+ * keep the command short, but always at least one; the response size tells
+ * how many were hashed.
+ */
+#define EC_CMD_FLASH_BLOCK_HASH 0x001D
+
+#define EC_FLASH_BLOCK_HASH_SIZE 32
+
+/**
+ * struct ec_params_flash_block_hash - Parameters for the block hash command.
+ * @offset: Byte offset of the first block.
+ * @block_size: Size of each block in bytes.
+ * @num_blocks: Number of blocks to hash.
+ */
+struct ec_params_flash_block_hash {
+	uint32_t offset;
+	uint32_t block_size;
+	uint32_t num_blocks;
+} __ec_align4;
+
+struct ec_response_flash_block_hash {
+	uint8_t hash[0][EC_FLASH_BLOCK_HASH_SIZE];
+} __ec_align4;
+
 /*****************************************************************************/
 /* PWM commands */
 
@@ -2648,6 +2678,19 @@ struct ec_response_vboot_hash {
 	uint8_t hash_digest[64]; /* Hash digest data */
 } __ec_align4;
 
+/*
+ * Version 1 of the response adds timing for the current (or last completed)
+ * hash, so the host can see where RW hash time goes.
+ */
+struct ec_response_vboot_hash_v1 {
+	struct ec_response_vboot_hash hash;
+	uint32_t total_us;       /* Time from start to final digest */
+	uint32_t read_us;        /* Time spent reading flash */
+	uint32_t hash_us;        /* Time spent in SHA-256 */
+	uint32_t chunks;         /* Number of chunks hashed */
+	uint32_t chunk_size;     /* Size of the last chunk, in bytes */
+} __ec_align4;
+
 enum ec_vboot_hash_cmd {
 	EC_VBOOT_HASH_GET = 0,       /* Get current hash status */
 	EC_VBOOT_HASH_ABORT = 1,     /* Abort calculating current hash */
@@ -2820,6 +2863,12 @@ enum motionsense_command {
 	 */
 	MOTIONSENSE_CMD_GET_ACTIVITY = 20,
 
+	/*
+	 * Return a portion of the fifo, in the compact format described by
+	 * struct ec_response_motion_sense_fifo_compact.
+	 */
+	MOTIONSENSE_CMD_FIFO_READ_COMPACT = 21,
+
 	/* Number of motionsense sub-commands. */
 	MOTIONSENSE_NUM_CMDS
 };
@@ -2939,6 +2988,49 @@ struct ec_response_motion_sense_fifo_data {
 	struct ec_response_motion_sensor_data data[0];
 } __ec_todo_packed;
 
+/*
+ * Compact fifo format, used by MOTIONSENSE_CMD_FIFO_READ_COMPACT.
+ *
+ * data[] holds a sequence of variable length records, each starting with a
+ * header byte. The top bits of the header give the record type, the low bits
+ * the sensor number (MOTIONSENSE_COMPACT_NO_SENSOR stands for 0xff). Fields
+ * following the header are little endian and not aligned.
+ *
+ * SAMPLE: int16_t dt, int16_t data[3]
+ *	A timestamp entry for the sensor, followed by a data entry of that
+ *	sensor. The timestamp is dt us after the previous timestamp of this
+ *	response, so the first timestamp of a response is never a SAMPLE.
+ * DATA: int16_t data[3]
+ *	A data entry, without timestamp.
+ * TIMESTAMP: uint32_t timestamp
+ *	A timestamp entry.
+ * RAW: struct ec_response_motion_sensor_data
+ *	Any other entry, as returned by MOTIONSENSE_CMD_FIFO_READ. The sensor
+ *	number bits of the header are unused.
+ *
+ * MOTIONSENSE_COMPACT_TABLET_MODE in a SAMPLE or DATA header stands for
+ * MOTIONSENSE_SENSOR_FLAG_TABLET_MODE in the flags of the data entry; the
+ * flags are otherwise 0.
+ *
+ * With tight timestamps, a sample takes 9 bytes instead of 16.
+ */
+#define MOTIONSENSE_COMPACT_TYPE_MASK		0xc0
+#define MOTIONSENSE_COMPACT_SAMPLE		0x00
+#define MOTIONSENSE_COMPACT_DATA		0x40
+#define MOTIONSENSE_COMPACT_TIMESTAMP		0x80
+#define MOTIONSENSE_COMPACT_RAW			0xc0
+#define MOTIONSENSE_COMPACT_TABLET_MODE		BIT(5)
+#define MOTIONSENSE_COMPACT_SENSOR_MASK		0x1f
+#define MOTIONSENSE_COMPACT_NO_SENSOR		0x1f
+
+struct ec_response_motion_sense_fifo_compact {
+	/* Number of fifo entries encoded in data[] */
+	uint16_t number_data;
+	/* Number of bytes used in data[] */
+	uint16_t size;
+	uint8_t data[0];
+} __ec_todo_packed;
+
 /* List supported activity recognition */
 enum motionsensor_activity {
 	MOTIONSENSE_ACTIVITY_RESERVED = 0,
@@ -3121,14 +3213,17 @@ struct ec_params_motion_sense {
 		/* Used for MOTIONSENSE_CMD_FIFO_INFO */
 		/* (no params) */
 
-		/* Used for MOTIONSENSE_CMD_FIFO_READ */
+		/*
+		 * Used for MOTIONSENSE_CMD_FIFO_READ and
+		 * MOTIONSENSE_CMD_FIFO_READ_COMPACT
+		 */
 		struct __ec_todo_unpacked {
 			/*
 			 * Number of expected vector to return.
 			 * EC may return less or 0 if none available.
 			 */
 			uint32_t max_data_vector;
-		} fifo_read;
+		} fifo_read, fifo_read_compact;
 
 		/* Used for MOTIONSENSE_CMD_SET_ACTIVITY */
 		struct ec_motion_sense_activity set_activity;
@@ -3323,6 +3418,8 @@ struct ec_response_motion_sense {
 
 		struct ec_response_motion_sense_fifo_data fifo_read;
 
+		struct ec_response_motion_sense_fifo_compact fifo_read_compact;
+
 		struct ec_response_online_calibration_data online_calib_read;
 
 		struct __ec_todo_packed {
@@ -4508,6 +4605,15 @@ struct ec_params_charge_control {
  *
  * Response is null-terminated string.  Empty string, if there is no more
  * remaining output.
+ *
+ * Version 2 does not use snapshots.  Every byte of console output has a
+ * sequence number, counting from 0 when the buffer was last cleared, and the
+ * host asks for the output after the last byte it has seen.  The response
+ * holds as much of it as fits, not null-terminated; the host passes
+ * seq + the number of data bytes in the next request.  If some of the
+ * requested output is gone, because the buffer has wrapped around or the EC
+ * has rebooted, the response starts at the oldest output left instead and
+ * sets EC_CONSOLE_READ_GAP.
  */
 #define EC_CMD_CONSOLE_READ 0x0098
 
@@ -4520,6 +4626,22 @@ struct ec_params_console_read_v1 {
 	uint8_t subcmd; /* enum ec_console_read_subcmd */
 } __ec_align1;
 
+struct ec_params_console_read_v2 {
+	uint32_t seq; /* Sequence number of the first byte wanted */
+} __ec_align4;
+
+/* Output between the requested and the returned seq was lost */
+#define EC_CONSOLE_READ_GAP BIT(0)
+/* There is more output than fit in the response */
+#define EC_CONSOLE_READ_MORE BIT(1)
+
+struct ec_response_console_read_v2 {
+	uint32_t seq; /* Sequence number of data[0] */
+	uint8_t flags; /* EC_CONSOLE_READ_* */
+	uint8_t reserved[3];
+	char data[0];
+} __ec_align4;
+
 /*****************************************************************************/
 
 /*
@@ -6998,6 +7120,75 @@ enum pchg_state {
 	[PCHG_STATE_CHARGING] = "CHARGING", \
 	}
 
+/*
+ * Call counts and latency histograms of the host commands.  Returns as many
+ * host commands as fit in the response, starting from index offset in the
+ * EC's table of host commands; call again with a larger offset until total
+ * is reached.
+ */
+#define EC_CMD_HOSTCMD_STATS 0x0136
+
+#define EC_HOSTCMD_STATS_BUCKETS 16
+
+/* Clear the statistics of the returned host commands */
+#define EC_HOSTCMD_STATS_FLAG_CLEAR BIT(0)
+
+struct ec_params_hostcmd_stats {
+	uint16_t offset;
+	uint16_t flags;			/* EC_HOSTCMD_STATS_FLAG_* */
+} __ec_align2;
+
+struct ec_hostcmd_stats_entry {
+	uint16_t command;
+	uint16_t reserved;
+	uint32_t count;			/* Number of calls */
+	/*
+	 * Number of calls which took [2^i, 2^(i+1)) us, except bucket 0 which
+	 * also has calls under 1 us and the last bucket which has all the
+	 * longer calls.  Buckets saturate at 0xffff.
+	 */
+	uint16_t histogram[EC_HOSTCMD_STATS_BUCKETS];
+} __ec_align4;
+
+struct ec_response_hostcmd_stats {
+	uint16_t total;			/* Number of host commands */
+	uint16_t count;			/* Number of entries which follow */
+	struct ec_hostcmd_stats_entry entries[];
+} __ec_align4;
+
+/*
+ * Run several host commands back to back, from one request.  The params hold
+ * count requests, each a struct ec_host_request followed by its data, like a
+ * single request over the packet interface.  The response holds a struct
+ * ec_host_response for each request which was run, followed by its data.
+ * Each request and response is padded to a multiple of 4 bytes.
+ *
+ * Requests run in order until all have run, one fails with
+ * EC_BATCH_FLAG_STOP_ON_ERROR set, or the next response does not fit; the
+ * response count says how many ran.  Batches do not nest.
+ */
+#define EC_CMD_BATCH 0x0137
+
+/* Stop at the first request which does not return EC_RES_SUCCESS */
+#define EC_BATCH_FLAG_STOP_ON_ERROR BIT(0)
+
+/* Size of a batched request or response, with its padding */
+#define EC_BATCH_ENTRY_SIZE(hdr, data_len) \
+	((sizeof(hdr) + (data_len) + 3) & ~3)
+
+struct ec_params_batch {
+	uint8_t count;
+	uint8_t flags;			/* EC_BATCH_FLAG_* */
+	uint16_t reserved;
+	uint8_t requests[];
+} __ec_align4;
+
+struct ec_response_batch {
+	uint8_t count;
+	uint8_t reserved[3];
+	uint8_t responses[];
+} __ec_align4;
+
 /*****************************************************************************/
 
 /* switch FingerPrint USB connection to MCU/CPU */
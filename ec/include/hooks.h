@@ -292,6 +292,21 @@ struct hook_data {
 	int priority;
 };
 
+/* Per-hook run time statistics, kept with CONFIG_HOOK_DEBUG */
+struct hook_stats {
+	uint32_t max_us;
+	uint32_t avg_us;
+};
+
+/* Per-routine deferred call statistics, kept with CONFIG_HOOK_DEBUG */
+struct deferred_stats {
+	uint32_t count;
+	uint32_t max_late_us;
+	uint32_t avg_late_us;
+	uint32_t max_run_us;
+	uint32_t avg_run_us;
+};
+
 /**
  * Call all the hook routines of a specified type.
  *
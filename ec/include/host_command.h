@@ -128,6 +128,12 @@ struct host_command {
 	int version_mask;
 };
 
+/* Per host command statistics, kept with CONFIG_HOSTCMD_STATS */
+struct host_command_stats {
+	uint32_t count;
+	uint16_t histogram[EC_HOSTCMD_STATS_BUCKETS];
+};
+
 #ifdef CONFIG_HOST_EVENT64
 typedef uint64_t host_event_t;
 #define HOST_EVENT_CPRINTS(str, e)	CPRINTS("%s 0x%016" PRIx64, str, e)
@@ -19,6 +19,10 @@
 extern const struct console_command __cmds[];
 extern const struct console_command __cmds_end[];
 
+/* Format strings of tokenized console output; not loaded on the EC */
+extern const char __log_strings[];
+extern const char __log_strings_end[];
+
 /* Extension commands. */
 extern const void *__extension_cmds;
 extern const void *__extension_cmds_end;
@@ -87,11 +91,21 @@ extern const struct hook_data __hooks_usb_pd_disconnect_end[];
 extern const struct hook_data __hooks_usb_pd_connect[];
 extern const struct hook_data __hooks_usb_pd_connect_end[];
 
+/* Hooks sorted by type and priority, and their run time statistics */
+extern const struct hook_data *__hooks_sorted[];
+extern const struct hook_data *__hooks_sorted_end[];
+extern struct hook_stats __hook_stats[];
+extern struct hook_stats __hook_stats_end[];
+
 /* Deferrable functions and firing times*/
 extern const struct deferred_data __deferred_funcs[];
 extern const struct deferred_data __deferred_funcs_end[];
 extern uint64_t __deferred_until[];
 extern uint64_t __deferred_until_end[];
+extern uint64_t __deferred_sched[];
+extern uint64_t __deferred_sched_end[];
+extern struct deferred_stats __deferred_stats[];
+extern struct deferred_stats __deferred_stats_end[];
 
 /* I2C fake devices for unit testing */
 extern const struct test_i2c_xfer __test_i2c_xfer[];
@@ -100,6 +114,10 @@ extern const struct test_i2c_xfer __test_i2c_xfer_end[];
 /* Host commands */
 extern const struct host_command __hcmds[];
 extern const struct host_command __hcmds_end[];
+extern uint16_t __hcmds_hash[];
+extern uint16_t __hcmds_hash_end[];
+extern struct host_command_stats __hcmd_stats[];
+extern struct host_command_stats __hcmd_stats_end[];
 
 /* MKBP events */
 extern const struct mkbp_event_source __mkbp_evt_srcs[];
@@ -151,6 +151,12 @@ typedef fp_t mat33_fp_t[3][3];
 /* Integer vector */
 typedef int intv3_t[3];
 
+/*
+ * Batch of integer vectors, stored as a structure of arrays: one array per
+ * coordinate, indexed by X, Y and Z like intv3_t.
+ */
+typedef int *intv3_batch_t[3];
+
 /* For vectors, define which coordinates are in which location. */
 enum {
 	X, Y, Z, W
@@ -220,6 +226,28 @@ void rotate(const intv3_t v, const mat33_fp_t R, intv3_t res);
  */
 void rotate_inv(const intv3_t v, const mat33_fp_t R, intv3_t res);
 
+/**
+ * Find the magnitude of a vector.
+ */
+int vector_magnitude(const intv3_t v);
+
+/*
+ * Batched versions of the functions above, for n vectors at a time.
+ *
+ * They give the same results as calling the single vector function on each
+ * vector in turn, but work down each coordinate array in a tight loop, with
+ * the matrix loaded and, for rotate_inv_batch(), inverted only once. This
+ * lets the compiler keep the matrix in registers and vectorize the loop.
+ * Results may be written over the inputs.
+ */
+void rotate_batch(const intv3_batch_t v, const mat33_fp_t R,
+		  const intv3_batch_t res, int n);
+void rotate_inv_batch(const intv3_batch_t v, const mat33_fp_t R,
+		      const intv3_batch_t res, int n);
+void vector_magnitude_batch(const intv3_batch_t v, int *res, int n);
+void cross_product_batch(const intv3_batch_t v1, const intv3_batch_t v2,
+			 const intv3_batch_t v, int n);
+
 /**
  * Divide dividend by divisor and round it to the nearest integer.
  */
@@ -102,6 +102,19 @@ int motion_sense_fifo_over_thres(void);
 int motion_sense_fifo_read(int capacity_bytes, int max_count, void *out,
 			   uint16_t *out_size);
 
+/**
+ * Read available committed entries from the fifo, in the compact format of
+ * struct ec_response_motion_sense_fifo_compact.
+ *
+ * @param capacity_bytes The number of bytes available to be written to `out`.
+ * @param max_count The maximum number of entries to be read.
+ * @param out The target to encode the data into.
+ * @param out_size The number of bytes written to `out`.
+ * @return The number of entries encoded into `out`.
+ */
+int motion_sense_fifo_read_compact(int capacity_bytes, int max_count,
+				   void *out, uint16_t *out_size);
+
 /**
  * Reset the internal data structures of the motion sense fifo.
  */
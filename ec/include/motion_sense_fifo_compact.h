@@ -0,0 +1,103 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Decoder for MOTIONSENSE_CMD_FIFO_READ_COMPACT responses */
+
+#ifndef __CROS_EC_MOTION_SENSE_FIFO_COMPACT_H
+#define __CROS_EC_MOTION_SENSE_FIFO_COMPACT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ec_commands.h"
+
+/**
+ * Expand the records of a compact fifo read back into fifo entries.
+ *
+ * See the MOTIONSENSE_COMPACT_* record layout in ec_commands.h.
+ *
+ * @param buf		The data of a compact fifo response.
+ * @param size		The number of bytes in buf.
+ * @param out		Where to write the expanded entries.
+ * @param max_count	The number of entries out can hold.
+ * @return The number of entries written, or -1 if buf is malformed or
+ *	   does not fit in out.
+ */
+static inline int motion_sense_fifo_decode_compact(
+	const uint8_t *buf, int size,
+	struct ec_response_motion_sensor_data *out, int max_count)
+{
+	struct ec_response_motion_sensor_data *vector = out;
+	uint32_t prev_ts = 0;
+	int16_t dt;
+	int pos = 0;
+
+	while (pos < size) {
+		uint8_t header = buf[pos++];
+		uint8_t type = header & MOTIONSENSE_COMPACT_TYPE_MASK;
+		uint8_t sensor = header & MOTIONSENSE_COMPACT_SENSOR_MASK;
+		uint8_t flags = (header & MOTIONSENSE_COMPACT_TABLET_MODE) ?
+			MOTIONSENSE_SENSOR_FLAG_TABLET_MODE : 0;
+		const uint8_t *p = buf + pos;
+		int len, n = 1;
+
+		switch (type) {
+		case MOTIONSENSE_COMPACT_SAMPLE:
+			len = sizeof(dt) + sizeof(vector->data);
+			n = 2;
+			break;
+		case MOTIONSENSE_COMPACT_DATA:
+			len = sizeof(vector->data);
+			break;
+		case MOTIONSENSE_COMPACT_TIMESTAMP:
+			len = sizeof(vector->timestamp);
+			break;
+		default:
+			len = sizeof(*vector);
+			break;
+		}
+		if (pos + len > size || vector + n > out + max_count)
+			return -1;
+		pos += len;
+
+		if (sensor == MOTIONSENSE_COMPACT_NO_SENSOR)
+			sensor = 0xff;
+
+		memset(vector, 0, n * sizeof(*vector));
+		switch (type) {
+		case MOTIONSENSE_COMPACT_SAMPLE:
+			memcpy(&dt, p, sizeof(dt));
+			p += sizeof(dt);
+			prev_ts += dt;
+			vector->flags = MOTIONSENSE_SENSOR_FLAG_TIMESTAMP;
+			vector->sensor_num = sensor;
+			vector->timestamp = prev_ts;
+			vector++;
+			/* fallthrough */
+		case MOTIONSENSE_COMPACT_DATA:
+			vector->flags = flags;
+			vector->sensor_num = sensor;
+			memcpy(vector->data, p, sizeof(vector->data));
+			break;
+		case MOTIONSENSE_COMPACT_TIMESTAMP:
+			vector->flags = MOTIONSENSE_SENSOR_FLAG_TIMESTAMP;
+			vector->sensor_num = sensor;
+			memcpy(&vector->timestamp, p,
+			       sizeof(vector->timestamp));
+			prev_ts = vector->timestamp;
+			break;
+		default:
+			memcpy(vector, p, sizeof(*vector));
+			if (vector->flags & MOTIONSENSE_SENSOR_FLAG_TIMESTAMP)
+				prev_ts = vector->timestamp;
+			break;
+		}
+		vector++;
+	}
+
+	return vector - out;
+}
+
+#endif /* __CROS_EC_MOTION_SENSE_FIFO_COMPACT_H */
@@ -76,6 +76,28 @@
 __stdlib_compat int vfnprintf(int (*addchar)(void *context, int c),
 			      void *context, const char *format, va_list args);
 
+/**
+ * Print formatted output to a function, a run of characters at a time.
+ *
+ * Like vfnprintf(), but literal text, padding and converted fields are passed
+ * to addstr() in one call each, which is much cheaper for outputs which can
+ * copy them in bulk.
+ *
+ * @param addchar	Function to be called for each character, if addstr
+ *			is NULL.
+ * @param addstr	Function to be called for each run of characters, or
+ *			NULL.  Should return 0 if all the characters were
+ *			accepted or non-zero if some were dropped due to
+ *			overflow.
+ * @param context	Context pointer to pass to addchar() and addstr()
+ * @param format	Format string (see above for acceptable formats)
+ * @param args		Parameters
+ * @return EC_SUCCESS, or EC_ERROR_OVERFLOW if the output was truncated.
+ */
+int vfnprintf_bulk(int (*addchar)(void *context, int c),
+		   int (*addstr)(void *context, const char *str, int len),
+		   void *context, const char *format, va_list args);
+
 /**
  * Print formatted outut to a string.
  *
@@ -106,4 +128,29 @@ __stdlib_compat int vsnprintf(char *str, int size, const char *format,
 
 #endif  /* !HIDE_EC_STDLIB */
 
+/* Size of a buffer for any timestamp printed by snprintf_timestamp() */
+#define PRINTF_TIMESTAMP_BUF_SIZE 22
+
+/**
+ * Print a timestamp to a string, as "%pT" would.
+ *
+ * This skips parsing a format string, for the timestamp prefix of every
+ * cprints() line.
+ *
+ * @param str		Destination string
+ * @param size		Size of destination in bytes
+ * @param timestamp	Timestamp in us
+ * @return The string length written to str, or a negative value on error.
+ */
+int snprintf_timestamp(char *str, int size, uint64_t timestamp);
+
+/**
+ * Print the current time to a string, as "%pT" would.
+ *
+ * @param str		Destination string
+ * @param size		Size of destination in bytes
+ * @return The string length written to str, or a negative value on error.
+ */
+int snprintf_timestamp_now(char *str, int size);
+
 #endif  /* __CROS_EC_PRINTF_H */
@@ -46,6 +46,23 @@ extern struct queue_policy const queue_policy_null;
 
 #define QUEUE_NULL(SIZE, TYPE) QUEUE(SIZE, TYPE, queue_policy_null)
 
+/*
+ * A single producer, single consumer queue is one where a single context
+ * (such as an interrupt handler) only ever adds units, and a single other
+ * context (such as a task) only ever removes them.  The head and tail are then
+ * loaded with acquire and stored with release ordering, so that units are
+ * written before the producer publishes them and read before the consumer
+ * frees them.  Neither side needs to mask interrupts or take a lock, as long
+ * as the queue policy callbacks are safe to run from both contexts.
+ *
+ * QUEUE_SPSC and QUEUE_SPSC_NULL are drop-in replacements for QUEUE and
+ * QUEUE_NULL.
+ */
+#define QUEUE_SPSC(SIZE, TYPE, POLICY) \
+	QUEUE_FLAGS(SIZE, TYPE, POLICY, QUEUE_FLAG_SPSC)
+
+#define QUEUE_SPSC_NULL(SIZE, TYPE) QUEUE_SPSC(SIZE, TYPE, queue_policy_null)
+
 /*
  * RAM state for a queue.
  */
@@ -79,14 +96,18 @@ struct queue {
 	size_t  buffer_units_mask; /* size of buffer (in units) - 1*/
 	size_t  unit_bytes;   /* size of unit   (in byte) */
 	uint8_t *buffer;
+	uint32_t flags;       /* QUEUE_FLAG_* */
 };
 
+/* Single producer, single consumer queue; see QUEUE_SPSC */
+#define QUEUE_FLAG_SPSC BIT(0)
+
 /*
  * Convenience macro for construction of a Queue along with its backing buffer
  * and state structure.  This macro creates a compound literal that can be used
  * to statically initialize a queue.
  */
-#define QUEUE(SIZE, TYPE, POLICY)				\
+#define QUEUE_FLAGS(SIZE, TYPE, POLICY, FLAGS)			\
 	((struct queue) {					\
 		.state        = &((struct queue_state){}),	\
 		.policy       = &POLICY,			\
@@ -94,8 +115,11 @@ struct queue {
 		.buffer_units_mask = SIZE - 1,			\
 		.unit_bytes   = sizeof(TYPE),			\
 		.buffer       = (uint8_t *) &((TYPE[SIZE]){}),	\
+		.flags        = FLAGS,				\
 	})
 
+#define QUEUE(SIZE, TYPE, POLICY) QUEUE_FLAGS(SIZE, TYPE, POLICY, 0)
+
 /* Initialize the queue to empty state. */
 void queue_init(struct queue const *q);
 
@@ -184,6 +208,51 @@ struct queue_chunk queue_get_write_chunk(struct queue const *q, size_t offset);
  */
 struct queue_chunk queue_get_read_chunk(struct queue const *q);
 
+/*
+ * Scatter-gather queue access.  A queue_chunk_pair describes a region of the
+ * queue as up to two chunks: chunk[0] runs up to the end of the queue buffer,
+ * and chunk[1] holds the part that wraps around to its start (count is 0 when
+ * nothing wraps).  Together they cover the whole region, so a caller can hand
+ * both to a DMA engine or copy routine in one go.  The same rules as for the
+ * single chunk functions apply: call queue_advance_tail/queue_advance_head
+ * with the number of units actually written or read.
+ */
+struct queue_chunk_pair {
+	struct queue_chunk chunk[2];
+};
+
+/* Return all the free space of the queue, starting at the tail. */
+struct queue_chunk_pair queue_get_write_chunks(struct queue const *q);
+
+/* Return all the units stored in the queue, starting at the head. */
+struct queue_chunk_pair queue_get_read_chunks(struct queue const *q);
+
+/*
+ * Fill up to count units of free space directly in the queue buffer.  The
+ * produce callback is called once per contiguous chunk with a pointer into
+ * the queue buffer and the number of units that fit there, and returns how
+ * many units it wrote; writing fewer stops the transfer.  The tail is then
+ * advanced by the total, which is returned.
+ */
+size_t queue_add_in_place(struct queue const *q,
+			  size_t count,
+			  size_t (*produce)(void *ctx, void *dest,
+					    size_t count),
+			  void *ctx);
+
+/*
+ * Hand up to count units from the head of the queue directly to a consumer,
+ * such as a USB endpoint or a host command response buffer, without staging
+ * them in between.  The consume callback is called once per contiguous chunk
+ * and returns how many units it took; taking fewer stops the transfer.  The
+ * head is then advanced by the total, which is returned.
+ */
+size_t queue_remove_in_place(struct queue const *q,
+			     size_t count,
+			     size_t (*consume)(void *ctx, const void *src,
+					       size_t count),
+			     void *ctx);
+
 /*
  * Move the queue head pointer forward count units.  This discards count
  * elements from the head of the queue.  It will only discard up to the total
@@ -32,7 +32,7 @@
 #define TASK_EVENT_I2C_COMPLETION(port) \
 				(1 << ((port) + 20))
 #define TASK_EVENT_I2C_IDLE	(TASK_EVENT_I2C_COMPLETION(0))
-#define TASK_EVENT_MAX_I2C	6
+#define TASK_EVENT_MAX_I2C	5
 #ifdef I2C_PORT_COUNT
 #if (I2C_PORT_COUNT > TASK_EVENT_MAX_I2C)
 #error "Too many i2c ports for i2c events"
@@ -43,6 +43,9 @@
 #define TASK_EVENT_PS2_DONE	BIT(21)
 #endif
 
+/* UART transmit buffer drained, see uart_tx_wait() */
+#define TASK_EVENT_UART_TX	BIT(25)
+
 /* DMA transmit complete event */
 #define TASK_EVENT_DMA_TC       BIT(26)
 /* ADC interrupt handler event */
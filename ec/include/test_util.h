@@ -229,6 +229,12 @@ void test_capture_console(int enabled);
 /* Get captured console output */
 const char *test_get_captured_console(void);
 
+/*
+ * Limit how many characters the emulated UART sends before it stops being
+ * ready, to make it slower than the console; -1 for no limit.
+ */
+void test_set_uart_tx_quota(int quota);
+
 /*
  * Flush emulator status. Must be called before emulator reboots or
  * exits.
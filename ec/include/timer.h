@@ -52,6 +52,105 @@ int timer_arm(timestamp_t tstamp, task_id_t tskid);
  */
 void timer_cancel(task_id_t tskid);
 
+/**
+ * Software timer, for modules which need any number of timeouts.
+ *
+ * Armed timers are kept in a hierarchical timer wheel (CONFIG_SW_TIMER), and
+ * the timer interrupt is programmed to the earliest deadline among them and
+ * the task timers.  When a timer expires, its callback is called from the
+ * timer interrupt, or if it has none, its event is set on its task.
+ *
+ * The fields are private to common/sw_timer.c; use sw_timer_init() or
+ * sw_timer_init_event() before anything else.
+ */
+struct sw_timer {
+	struct sw_timer *next;
+	/* Link to this timer in its list, or NULL if not armed */
+	struct sw_timer **pprev;
+	uint64_t deadline;
+	uint8_t level;
+	uint8_t slot;
+	task_id_t task;
+	uint32_t event;
+	void (*callback)(struct sw_timer *timer);
+};
+
+/**
+ * Initialize a software timer which calls a routine when it expires.
+ *
+ * @param timer		Timer to initialize
+ * @param callback	Routine called from interrupt context on expiry
+ */
+void sw_timer_init(struct sw_timer *timer,
+		   void (*callback)(struct sw_timer *timer));
+
+/**
+ * Initialize a software timer which sets task events when it expires.
+ *
+ * @param timer		Timer to initialize
+ * @param task		Task to wake
+ * @param event		Event bits to set, for example TASK_EVENT_CUSTOM_BIT(0)
+ */
+void sw_timer_init_event(struct sw_timer *timer, task_id_t task,
+			 uint32_t event);
+
+/**
+ * Arm a software timer, or move its deadline if it is already armed.
+ *
+ * May be called from the timer's own callback to make it periodic.
+ *
+ * @param timer		Timer to arm
+ * @param deadline	Expiration timestamp
+ */
+void sw_timer_arm(struct sw_timer *timer, timestamp_t deadline);
+
+/**
+ * Arm a software timer to expire in a number of microseconds from now.
+ */
+void sw_timer_start(struct sw_timer *timer, uint32_t us);
+
+/**
+ * Cancel a software timer.  Does nothing if it is not armed.
+ */
+void sw_timer_cancel(struct sw_timer *timer);
+
+/**
+ * Return non-zero if a software timer is armed and has not expired yet.
+ */
+int sw_timer_is_armed(const struct sw_timer *timer);
+
+/**
+ * Call the software timers which expired at or before now.
+ *
+ * Only for timer drivers, from the timer interrupt or equivalent.
+ */
+void sw_timer_expire(timestamp_t now);
+
+/**
+ * Return the earliest deadline of the armed software timers, or -1 if none.
+ *
+ * Only for timer drivers.
+ */
+uint64_t sw_timer_next_deadline(void);
+
+/**
+ * Let the timer driver know that a software timer was armed, so it can fire
+ * its interrupt earlier if needed.  Provided by the timer driver.
+ */
+void sw_timer_reschedule(timestamp_t deadline);
+
+/**
+ * Mask whatever may expire or arm software timers concurrently.  Provided by
+ * the timer driver; must nest.
+ */
+uint32_t sw_timer_lock(void);
+void sw_timer_unlock(uint32_t key);
+
+/**
+ * Print the state of the software timer wheel, for timerinfo.
+ */
+void sw_timer_print_info(void);
+
 /**
  * Check if a timestamp has passed / expired
  *
@@ -116,6 +215,15 @@ static inline void sleep(unsigned sec)
  */
 timestamp_t get_time(void);
 
+#ifdef TEST_BUILD
+/*
+ * Returns the time to use for benchmarks. The emulator's get_time() is virtual
+ * and only advances when it is called, so this reads the host's monotonic
+ * clock there, and is get_time() everywhere else. Implemented in test_util.c.
+ */
+timestamp_t test_get_wall_time(void);
+#endif
+
 /**
  * Force the current value of the system timer.
  *
@@ -86,9 +86,41 @@ int uart_vprintf(const char *format, va_list args);
 
 /**
  * Flush output.  Blocks until UART has transmitted all output.
+ *
+ * From a task, sleeps until the transmit buffer has drained instead of
+ * spinning.
  */
 void uart_flush_output(void);
 
+/**
+ * Wait for room in the output buffer.
+ *
+ * Sleeps until the buffer has drained to its low watermark, or further if
+ * that still leaves less than len characters of room.
+ *
+ * @param len		Room needed, in characters
+ * @return EC_SUCCESS, EC_ERROR_TIMEOUT if the buffer did not drain in time,
+ * or EC_ERROR_BUSY if not called from a task.
+ */
+int uart_tx_wait(int len);
+
+/* Output statistics, since boot */
+struct uart_tx_stats {
+	/* Characters handed to the UART */
+	uint32_t bytes_sent;
+	/* Characters dropped as the output buffer was full */
+	uint32_t bytes_dropped;
+	/* Most characters waiting in the output buffer at once */
+	int max_fill;
+};
+
+/**
+ * Get output statistics.
+ *
+ * @param stats		Filled with the statistics
+ */
+void uart_get_tx_stats(struct uart_tx_stats *stats);
+
 /*
  * Input functions
  *
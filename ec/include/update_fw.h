@@ -31,6 +31,21 @@
  *
  * The connection establishment response is described by the
  * first_response_pdu structure below.
+ *
+ * If the host starts the connection with an update_stream_start PDU instead,
+ * and the EC supports it, the transfer is streamed: the host may send up to
+ * stream_window PDUs (from the first response) before their responses come
+ * back. The EC then responds with an update_stream_ack as each PDU has been
+ * programmed. Each one covers all the PDUs before it, so they may be
+ * coalesced by the USB transfers. EC images which do not support streaming
+ * respond to update_stream_start with a one byte error, and the host starts
+ * over with the usual start PDU.
+ *
+ * update_stream_start also lists the block encodings the host would like to
+ * use, and the first response the ones the EC accepted. The payload of a PDU
+ * can then be sent in one of those encodings, given in the top byte of the
+ * frame block_size; the EC decodes it back into a full PDU before it is
+ * programmed.
  */
 
 #define UPDATE_PROTOCOL_VERSION 6
@@ -144,10 +159,78 @@ struct first_response_pdu {
 
 			/* RO public key version */
 			uint32_t key_version;
+
+			/*
+			 * Only sent in response to an update_stream_start
+			 * PDU: block encodings the host may use (BIT() of
+			 * enum update_block_encoding), and number of PDUs it
+			 * may have in flight.
+			 */
+			uint16_t block_encodings;
+			uint16_t stream_window;
 		} common;
 	};
 };
 
+/*
+ * Start PDU of a streaming update: a start PDU (no payload, digest = 0,
+ * base = 0) followed by the block encodings the host would like to use, and
+ * the number of PDUs it is willing to have in flight (0 to send them one at a
+ * time).
+ */
+struct update_stream_start {
+	struct update_frame_header header;
+	uint16_t block_encodings;
+	uint16_t window;
+};
+
+/* Response to a PDU of a streaming update. */
+struct update_stream_ack {
+	/* UPDATE_SUCCESS, or the error which ended the transfer */
+	uint32_t return_value;
+	/* Number of PDUs programmed since the start PDU */
+	uint32_t blocks_done;
+};
+
+/*
+ * Encodings of the payload of a PDU, in the top byte of the frame block_size
+ * (the frame size, including the encoded payload, is in the rest).
+ */
+#define UPDATE_FRAME_SIZE_MASK 0x00ffffff
+#define UPDATE_FRAME_ENCODING_SHIFT 24
+
+enum update_block_encoding {
+	/* The payload is the data to program. */
+	UPDATE_BLOCK_RAW = 0,
+	/* The payload is a struct update_block_fill. */
+	UPDATE_BLOCK_FILL = 1,
+	/*
+	 * The payload is LZ compressed, as a sequence of:
+	 * - a byte below UPDATE_LZ_MATCH, followed by that many plus one
+	 *   literal bytes.
+	 * - a byte with UPDATE_LZ_MATCH set, followed by a 16 bit big endian
+	 *   distance: copy the data that far back, for the low bits of the
+	 *   first byte plus UPDATE_LZ_MIN_MATCH bytes. The copy may overlap
+	 *   the data it produces, which encodes runs.
+	 */
+	UPDATE_BLOCK_LZ = 2,
+};
+
+/* Encodings this code can decode */
+#define UPDATE_BLOCK_ENCODINGS (BIT(UPDATE_BLOCK_FILL) | BIT(UPDATE_BLOCK_LZ))
+
+#define UPDATE_LZ_MATCH 0x80
+#define UPDATE_LZ_MIN_MATCH 4
+#define UPDATE_LZ_MAX_MATCH (UPDATE_LZ_MIN_MATCH + UPDATE_LZ_MATCH - 1)
+#define UPDATE_LZ_MAX_DISTANCE 0xffff
+
+/* Payload of a block with all bytes set to value, e.g. erased padding. */
+struct update_block_fill {
+	uint16_t size;		/* Size of the block, big endian */
+	uint8_t value;
+	uint8_t reserved;
+};
+
 enum first_response_pdu_header_type {
 	UPDATE_HEADER_TYPE_CR50 = 0, /* Must be 0 for backwards compatibility */
 	UPDATE_HEADER_TYPE_COMMON = 1,
@@ -245,6 +328,36 @@ void fw_update_complete(void);
 /* Verify integrity of the PDU received. */
 int update_pdu_valid(struct update_command *cmd_body, size_t cmd_size);
 
+/**
+ * Decode the payload of a PDU.
+ *
+ * @param encoding	Encoding of the payload (enum update_block_encoding).
+ * @param in		Encoded payload.
+ * @param in_size	Size of the encoded payload.
+ * @param out		Buffer for the decoded payload.
+ * @param out_max	Size of out.
+ * @param out_size	Set to the size of the decoded payload.
+ *
+ * @return UPDATE_SUCCESS, or UPDATE_DATA_ERROR if the payload is corrupted or
+ * does not fit in out.
+ */
+int update_block_decode(int encoding, const uint8_t *in, size_t in_size,
+			uint8_t *out, size_t out_max, size_t *out_size);
+
+/**
+ * Encode the payload of a PDU, in the smallest of the encodings allowed.
+ *
+ * @param encodings	Encodings allowed, BIT() of enum update_block_encoding.
+ * @param in		Payload.
+ * @param size		Size of the payload.
+ * @param out		Buffer for the encoded payload, of size bytes.
+ * @param encoding	Set to the encoding used.
+ *
+ * @return Size of the encoded payload.
+ */
+size_t update_block_encode(uint32_t encodings, const uint8_t *in, size_t size,
+			   uint8_t *out, int *encoding);
+
 /* Various update command return values. */
 enum {
 	UPDATE_SUCCESS = 0,
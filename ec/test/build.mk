@@ -26,7 +26,10 @@ test-list-host += charge_manager_drp_charging
 test-list-host += charge_ramp
 test-list-host += compile_time_macros
 test-list-host += console_edit
+test-list-host += console_tokenized
 test-list-host += crc
+test-list-host += crc_slice_by_4
+test-list-host += crc_slice_by_8
 test-list-host += entropy
 test-list-host += extpwr_gpio
 test-list-host += fan
@@ -37,8 +40,11 @@ test-list-host += fpsensor
 test-list-host += fpsensor_crypto
 test-list-host += fpsensor_state
 test-list-host += gyro_cal
+test-list-host += hook_deferred
 test-list-host += hooks
 test-list-host += host_command
+test-list-host += host_command_hash
+test-list-host += host_command_sock
 test-list-host += i2c_bitbang
 test-list-host += inductive_charging
 test-list-host += interrupt
@@ -65,18 +71,30 @@ test-list-host += pingpong
 test-list-host += power_button
 test-list-host += printf
 test-list-host += queue
+test-list-host += queue_spsc
 test-list-host += rsa
+test-list-host += rsa_3072
+test-list-host += rsa_optimized
 test-list-host += rsa3
+test-list-host += rsa3_3072
+test-list-host += rsa3_optimized
 test-list-host += rtc
 test-list-host += sbs_charging_v2
 test-list-host += sha256
 test-list-host += sha256_unrolled
+test-list-host += sha256_fully_unrolled
+test-list-host += sha256_interleaved
+test-list-host += sha256_x86_sha_ni
+test-list-host += sha256_vboot_hash
 test-list-host += shmalloc
 test-list-host += static_if
 test-list-host += static_if_error
+test-list-host += sw_timer
 test-list-host += system
+test-list-host += task_switch
 test-list-host += thermal
 test-list-host += timer_dos
+test-list-host += uart_stress
 test-list-host += uptime
 test-list-host += usb_common
 test-list-host += usb_pd_int
@@ -99,9 +117,12 @@ test-list-host += usb_pe_drp_old
 test-list-host += usb_pe_drp_old_noextended
 test-list-host += usb_pe_drp
 test-list-host += usb_pe_drp_noextended
+test-list-host += usb_update
 test-list-host += utils
 test-list-host += utils_str
 test-list-host += vboot
+test-list-host += vboot_hash
+test-list-host += vboot_hash_adaptive
 test-list-host += x25519
 test-list-host += stillness_detector
 endif
@@ -136,7 +157,10 @@ charge_manager_drp_charging-y=charge_manager.o
 charge_ramp-y+=charge_ramp.o
 compile_time_macros-y=compile_time_macros.o
 console_edit-y=console_edit.o
+console_tokenized-y=console_tokenized.o
 crc-y=crc.o
+crc_slice_by_4-y=crc.o
+crc_slice_by_8-y=crc.o
 entropy-y=entropy.o
 extpwr_gpio-y=extpwr_gpio.o
 fan-y=fan.o
@@ -147,8 +171,11 @@ fpsensor-y=fpsensor.o
 fpsensor_crypto-y=fpsensor_crypto.o
 fpsensor_state-y=fpsensor_state.o
 gyro_cal-y=gyro_cal.o gyro_cal_init_for_test.o
+hook_deferred-y=hook_deferred.o
 hooks-y=hooks.o
 host_command-y=host_command.o
+host_command_hash-y=host_command.o
+host_command_sock-y=host_command_sock.o
 i2c_bitbang-y=i2c_bitbang.o
 inductive_charging-y=inductive_charging.o
 interrupt-y=interrupt.o
@@ -160,7 +187,7 @@ kb_scan-y=kb_scan.o
 lid_sw-y=lid_sw.o
 lightbar-y=lightbar.o
 mag_cal-y=mag_cal.o
-math_util-y=math_util.o
+math_util-y=math_util.o motion_angle_data_literals.o
 motion_angle-y=motion_angle.o motion_angle_data_literals.o motion_common.o
 motion_angle_tablet-y=motion_angle_tablet.o motion_angle_data_literals_tablet.o motion_common.o
 motion_lid-y=motion_lid.o
@@ -176,24 +203,36 @@ power_button-y=power_button.o
 powerdemo-y=powerdemo.o
 printf-y=printf.o
 queue-y=queue.o
+queue_spsc-y=queue_spsc.o
 rollback-y=rollback.o
 rollback_entropy-y=rollback_entropy.o
 rsa-y=rsa.o
+rsa_3072-y=rsa.o
+rsa_optimized-y=rsa.o
 rsa3-y=rsa.o
+rsa3_3072-y=rsa.o
+rsa3_optimized-y=rsa.o
 rtc-y=rtc.o
 scratchpad-y=scratchpad.o
 sbs_charging-y=sbs_charging.o
 sbs_charging_v2-y=sbs_charging_v2.o
 sha256-y=sha256.o
 sha256_unrolled-y=sha256.o
+sha256_fully_unrolled-y=sha256.o
+sha256_interleaved-y=sha256.o
+sha256_x86_sha_ni-y=sha256.o
+sha256_vboot_hash-y=sha256.o
 shmalloc-y=shmalloc.o
 static_if-y=static_if.o
 stm32f_rtc-y=stm32f_rtc.o
 stress-y=stress.o
+sw_timer-y=sw_timer.o
 system-y=system.o
+task_switch-y=task_switch.o
 thermal-y=thermal.o
 timer_calib-y=timer_calib.o
 timer_dos-y=timer_dos.o
+uart_stress-y=uart_stress.o
 uptime-y=uptime.o
 usb_common-y=usb_common_test.o fake_battery.o
 usb_pd_int-y=usb_pd_int.o
@@ -222,9 +261,12 @@ usb_tcpmv2_compliance-y=usb_tcpmv2_compliance.o usb_tcpmv2_compliance_common.o \
 	usb_tcpmv2_td_pd_src3_e26.o \
 	usb_tcpmv2_td_pd_snk3_e12.o \
 	usb_tcpmv2_td_pd_other.o
+usb_update-y=usb_update.o
 utils-y=utils.o
 utils_str-y=utils_str.o
 vboot-y=vboot.o
+vboot_hash-y=vboot_hash.o
+vboot_hash_adaptive-y=vboot_hash.o
 float-y=fp.o
 fp-y=fp.o
 x25519-y=x25519.o
@@ -7,10 +7,15 @@
 
 #include "common.h"
 #include "console.h"
+#include "link_defs.h"
 #include "test_util.h"
 #include "timer.h"
 #include "util.h"
 
+/* From common/console.c */
+const struct console_command *find_command(char *name);
+int handle_command(char *input);
+
 static int cmd_1_call_cnt;
 static int cmd_2_call_cnt;
 
@@ -273,6 +278,131 @@ static int test_output_channel(void)
 	return EC_SUCCESS;
 }
 
+static int test_tab_complete(void)
+{
+	cmd_1_call_cnt = 0;
+	cmd_2_call_cnt = 0;
+
+	/* Expands to what test1 and test2 have in common */
+	UART_INJECT("tes\t1\n");
+	msleep(30);
+	TEST_ASSERT(cmd_1_call_cnt == 1 && cmd_2_call_cnt == 0);
+
+	/* A unique name is completed, and arguments can follow */
+	UART_INJECT("histo\t\n");
+	msleep(30);
+	test_capture_console(1);
+	UART_INJECT("test2\t\n");
+	msleep(30);
+	test_capture_console(0);
+	TEST_ASSERT(compare_multiline_string(test_get_captured_console(),
+					     "test2 \n> ") == 0);
+	TEST_CHECK(cmd_1_call_cnt == 1 && cmd_2_call_cnt == 1);
+}
+
+static int test_tab_list(void)
+{
+	test_capture_console(1);
+	UART_INJECT("test\t\b\b\b\b\n");
+	msleep(30);
+	test_capture_console(0);
+	TEST_ASSERT(compare_multiline_string(test_get_captured_console(),
+					     "test\n"
+					     "test1  test2  \n"
+					     "> test\b \b\b \b\b \b\b \b\n"
+					     "> ") == 0);
+
+	return EC_SUCCESS;
+}
+
+/* The lookup, as a plain scan of the command table */
+static const struct console_command *scan_command(const char *name)
+{
+	const struct console_command *cmd, *match = NULL;
+	int len = strlen(name);
+
+	for (cmd = __cmds; cmd < __cmds_end; cmd++) {
+		if (strncasecmp(name, cmd->name, len))
+			continue;
+		if (cmd->name[len] == '\0')
+			return cmd;
+		if (match)
+			return NULL;
+		match = cmd;
+	}
+
+	return match;
+}
+
+static int test_lookup(void)
+{
+	const struct console_command *cmd;
+	char name[32];
+	int len, i;
+
+	for (cmd = __cmds; cmd < __cmds_end; cmd++) {
+		/* Every prefix, in either case */
+		len = strlen(cmd->name);
+		TEST_ASSERT(len < sizeof(name));
+		for (i = 1; i <= len; i++) {
+			strzcpy(name, cmd->name, i + 1);
+			TEST_ASSERT(find_command(name) == scan_command(name));
+			if (name[0] >= 'a' && name[0] <= 'z')
+				name[0] += 'A' - 'a';
+			TEST_ASSERT(find_command(name) == scan_command(name));
+		}
+		TEST_ASSERT(find_command(name) == cmd);
+
+		/* Past the end, and between neighbours */
+		strzcpy(name, cmd->name, sizeof(name));
+		name[len] = '~';
+		name[len + 1] = '\0';
+		TEST_ASSERT(find_command(name) == NULL);
+		name[len] = '\0';
+		name[len - 1]--;
+		TEST_ASSERT(find_command(name) == scan_command(name));
+	}
+
+	TEST_ASSERT(find_command("") == scan_command(""));
+	TEST_ASSERT(find_command("!") == NULL);
+
+	return EC_SUCCESS;
+}
+
+#define BENCH_LINES 24000
+
+static int test_lookup_rate(void)
+{
+	static const char *const lines[] = {
+		"test1 a b c", "TEST2", "tes", "notacommand", "test2 x y",
+		"  test1 # comment",
+	};
+	char line[CONFIG_CONSOLE_INPUT_LINE_SIZE];
+	timestamp_t start;
+	uint64_t elapsed;
+	int i;
+
+	cmd_1_call_cnt = 0;
+	cmd_2_call_cnt = 0;
+
+	start = test_get_wall_time();
+	for (i = 0; i < BENCH_LINES; i++) {
+		strzcpy(line, lines[i % ARRAY_SIZE(lines)], sizeof(line));
+		handle_command(line);
+	}
+	elapsed = test_get_wall_time().val - start.val;
+
+	ccprintf("%d commands, %d lines in %" PRId64 " us: %" PRId64
+		 " lines/s\n",
+		 (int)(__cmds_end - __cmds), BENCH_LINES, elapsed,
+		 BENCH_LINES * (uint64_t)SECOND / (elapsed + 1));
+
+	TEST_EQ(cmd_1_call_cnt, BENCH_LINES / 3, "%d");
+	TEST_EQ(cmd_2_call_cnt, BENCH_LINES / 3, "%d");
+
+	return EC_SUCCESS;
+}
+
 void run_test(int argc, char **argv)
 {
 	test_reset();
@@ -290,6 +420,10 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_history_stash);
 	RUN_TEST(test_history_list);
 	RUN_TEST(test_output_channel);
+	RUN_TEST(test_tab_complete);
+	RUN_TEST(test_tab_list);
+	RUN_TEST(test_lookup);
+	RUN_TEST(test_lookup_rate);
 
 	test_print_result();
 }
@@ -0,0 +1,174 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test tokenized cprints() output.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "link_defs.h"
+#include "test_util.h"
+#include "util.h"
+
+/* Decoded line */
+static uint8_t line[64];
+static int line_len;
+static int line_pos;
+
+static int base64_value(char c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 26;
+	if (c >= '0' && c <= '9')
+		return c - '0' + 52;
+	if (c == '+')
+		return 62;
+	if (c == '/')
+		return 63;
+	return -1;
+}
+
+/* Capture the output of the last cprints() and decode it */
+static int capture_line(void)
+{
+	const char *s;
+	uint32_t chunk;
+	int i, v;
+
+	cflush();
+	test_capture_console(0);
+	s = test_get_captured_console();
+
+	TEST_ASSERT(*s++ == '$');
+	line_len = 0;
+	line_pos = 0;
+	while (*s && *s != '\r' && *s != '\n') {
+		chunk = 0;
+		for (i = 0; i < 4; i++) {
+			v = base64_value(s[i]);
+			TEST_ASSERT(v >= 0 || s[i] == '=');
+			chunk = chunk << 6 | (v < 0 ? 0 : v);
+		}
+		for (i = 0; i < 3 && s[i + 1] != '='; i++) {
+			TEST_ASSERT(line_len < sizeof(line));
+			line[line_len++] = chunk >> (16 - i * 8);
+		}
+		s += 4;
+	}
+	TEST_ASSERT(!strncmp(s, "\r\n", 3));
+
+	return EC_SUCCESS;
+}
+
+static uint64_t get_varint(void)
+{
+	uint64_t v = 0;
+	int shift = 0;
+
+	while (line_pos < line_len) {
+		v |= (uint64_t)(line[line_pos] & 0x7f) << shift;
+		shift += 7;
+		if (!(line[line_pos++] & 0x80))
+			break;
+	}
+
+	return v;
+}
+
+static int64_t get_signed(void)
+{
+	uint64_t v = get_varint();
+
+	return (v >> 1) ^ -(v & 1);
+}
+
+/* Check the token, and skip the time */
+static int check_header(const char *format, uint32_t arg_types)
+{
+	uint64_t token = get_varint();
+
+	TEST_ASSERT(token < __log_strings_end - __log_strings);
+	TEST_ASSERT(!strncmp(__log_strings + token, format,
+			     strlen(format) + 1));
+	get_varint();
+	TEST_EQ((uint32_t)get_varint(), arg_types, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_arguments(void)
+{
+	const char *str = "abc";
+	int64_t big = -(1ll << 40);
+
+	test_capture_console(1);
+	cprints(CC_SYSTEM, "ints %d %u %" PRId64, -5, 300, big);
+	TEST_ASSERT(capture_line() == EC_SUCCESS);
+
+	TEST_ASSERT(check_header("ints %d %u %" PRId64,
+				 CONSOLE_ARG_INT32 |
+				 CONSOLE_ARG_INT32 << 2 |
+				 CONSOLE_ARG_INT64 << 4) == EC_SUCCESS);
+	TEST_EQ((int)get_signed(), -5, "%d");
+	TEST_EQ((int)get_signed(), 300, "%d");
+	TEST_ASSERT(get_signed() == big);
+	TEST_EQ(line_pos, line_len, "%d");
+
+	test_capture_console(1);
+	cprints(CC_SYSTEM, "str %s", str);
+	TEST_ASSERT(capture_line() == EC_SUCCESS);
+
+	TEST_ASSERT(check_header("str %s", CONSOLE_ARG_STRING) == EC_SUCCESS);
+	TEST_EQ((int)get_varint(), 3, "%d");
+	TEST_ASSERT(!memcmp(line + line_pos, "abc", 3));
+	TEST_EQ(line_pos + 3, line_len, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_no_arguments(void)
+{
+	test_capture_console(1);
+	cprints(CC_SYSTEM, "no arguments");
+	TEST_ASSERT(capture_line() == EC_SUCCESS);
+
+	TEST_ASSERT(check_header("no arguments", 0) == EC_SUCCESS);
+	TEST_EQ(line_pos, line_len, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_long_string(void)
+{
+	static const char long_str[] =
+		"0123456789012345678901234567890123456789012345678901234567";
+	int len;
+
+	test_capture_console(1);
+	cprints(CC_SYSTEM, "%s %d", long_str, 7);
+	TEST_ASSERT(capture_line() == EC_SUCCESS);
+
+	/* The string is cut short, and the integer after it left out */
+	TEST_ASSERT(check_header("%s %d", CONSOLE_ARG_STRING |
+				 CONSOLE_ARG_INT32 << 2) == EC_SUCCESS);
+	len = get_varint();
+	TEST_ASSERT(len > 0 && len < strlen(long_str));
+	TEST_ASSERT(!memcmp(line + line_pos, long_str, len));
+	TEST_EQ(line_pos + len, line_len, "%d");
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_arguments);
+	RUN_TEST(test_no_arguments);
+	RUN_TEST(test_long_string);
+
+	test_print_result();
+}
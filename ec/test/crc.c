@@ -10,8 +10,11 @@
 #include "crc.h"
 #include "crc8.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
+static uint8_t buf[4096] __aligned(8);
+
 // test that static version matches context version
 static int test_static_version(void)
 {
@@ -64,6 +67,110 @@ static int test_kat0(void)
 	return EC_SUCCESS;
 }
 
+static uint32_t crc32_bytewise(const uint8_t *p, int size)
+{
+	uint32_t crc;
+	int i;
+
+	crc32_ctx_init(&crc);
+	for (i = 0; i < size; ++i)
+		crc32_ctx_hash8(&crc, p[i]);
+
+	return crc32_ctx_result(&crc);
+}
+
+// test that buffer hashing matches byte at a time for any alignment
+static int test_buffer(void)
+{
+	uint32_t crc;
+	int offset, len;
+
+	for (offset = 0; offset < 8; offset++) {
+		for (len = 0; len < 64; len++) {
+			crc32_ctx_init(&crc);
+			crc32_ctx_hash(&crc, buf + offset, len);
+			TEST_EQ(crc32_ctx_result(&crc),
+				crc32_bytewise(buf + offset, len), "0x%08x");
+		}
+	}
+
+	crc32_ctx_init(&crc);
+	crc32_ctx_hash(&crc, buf + 3, sizeof(buf) - 3);
+	TEST_EQ(crc32_ctx_result(&crc),
+		crc32_bytewise(buf + 3, sizeof(buf) - 3), "0x%08x");
+
+	return EC_SUCCESS;
+}
+
+static int test_kat_buffer(void)
+{
+	uint32_t crc;
+	const char input[] = "The quick brown fox jumps over the lazy dog";
+
+	crc32_ctx_init(&crc);
+	crc32_ctx_hash(&crc, input, strlen(input));
+	TEST_ASSERT(crc32_ctx_result(&crc) == 0x414fa339);
+
+	return EC_SUCCESS;
+}
+
+static int test_combine(void)
+{
+	uint32_t whole, crc1, crc2;
+	const int len1 = 1000;
+	const int len2 = sizeof(buf) - len1;
+
+	whole = crc32_bytewise(buf, sizeof(buf));
+	crc1 = crc32_bytewise(buf, len1);
+	crc2 = crc32_bytewise(buf + len1, len2);
+
+	TEST_EQ(crc32_combine(crc1, crc2, len2), whole, "0x%08x");
+	TEST_EQ(crc32_combine(whole, crc32_bytewise(buf, 0), 0), whole,
+		"0x%08x");
+
+	return EC_SUCCESS;
+}
+
+static void print_speed(const char *name, int bytes, timestamp_t t0,
+			timestamp_t t1)
+{
+	uint64_t us = t1.val - t0.val;
+
+	ccprintf("%s: %d bytes in %lld us (%lld MB/s)\n", name, bytes,
+		 (long long)us, us ? (long long)(bytes / us) : -1LL);
+}
+
+static void test_crc32_speed(void)
+{
+	const int iterations = 256;
+	uint32_t crc;
+	timestamp_t t0, t1;
+	int i, j;
+
+	t0 = test_get_wall_time();
+	for (i = 0; i < iterations; i++) {
+		crc32_ctx_init(&crc);
+		for (j = 0; j < sizeof(buf); j++)
+			crc32_ctx_hash8(&crc, buf[j]);
+	}
+	t1 = test_get_wall_time();
+	print_speed("CRC-32 byte", iterations * sizeof(buf), t0, t1);
+
+	t0 = test_get_wall_time();
+	for (i = 0; i < iterations; i++) {
+		crc32_ctx_init(&crc);
+		crc32_ctx_hash(&crc, buf, sizeof(buf));
+	}
+	t1 = test_get_wall_time();
+#if defined(CONFIG_SW_CRC_SLICE_BY_8)
+	print_speed("CRC-32 slice-by-8", iterations * sizeof(buf), t0, t1);
+#elif defined(CONFIG_SW_CRC_SLICE_BY_4)
+	print_speed("CRC-32 slice-by-4", iterations * sizeof(buf), t0, t1);
+#else
+	print_speed("CRC-32 buffer", iterations * sizeof(buf), t0, t1);
+#endif
+}
+
 static int test_cros_crc8(void)
 {
 	uint8_t buffer[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 8 };
@@ -78,12 +185,23 @@ static int test_cros_crc8(void)
 
 void run_test(int argc, char **argv)
 {
+	int i;
+
 	test_reset();
 
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7 + (i >> 8);
+
 	RUN_TEST(test_static_version);
 	RUN_TEST(test_8);
 	RUN_TEST(test_kat0);
+	RUN_TEST(test_buffer);
+	RUN_TEST(test_kat_buffer);
+	RUN_TEST(test_combine);
 	RUN_TEST(test_cros_crc8);
 
+	/* do not check result, just as a benchmark */
+	test_crc32_speed();
+
 	test_print_result();
 }
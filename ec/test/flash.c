@@ -11,6 +11,7 @@
 #include "gpio.h"
 #include "hooks.h"
 #include "host_command.h"
+#include "sha256.h"
 #include "system.h"
 #include "task.h"
 #include "test_util.h"
@@ -346,6 +347,57 @@ static int test_op_failure(void)
 	return EC_SUCCESS;
 }
 
+static int test_block_hash(void)
+{
+	struct ec_params_flash_block_hash params;
+	uint8_t hash[2][EC_FLASH_BLOCK_HASH_SIZE];
+	struct sha256_ctx ctx;
+	uint8_t *expected;
+	uint32_t offset;
+	int i;
+
+	offset = system_is_in_rw() ? CONFIG_RO_STORAGE_OFF :
+				     CONFIG_RW_STORAGE_OFF;
+
+#ifdef EMU_BUILD
+	mock_is_running_img = 0;
+#endif
+
+	/* An erased block, and one with data in it */
+	VERIFY_ERASE(offset, 2 * CONFIG_FLASH_ERASE_SIZE);
+	VERIFY_WRITE(offset + CONFIG_FLASH_ERASE_SIZE, strlen(testdata),
+		     testdata);
+
+	/* More blocks than fit in the response, which only gets two */
+	params.offset = offset;
+	params.block_size = CONFIG_FLASH_ERASE_SIZE;
+	params.num_blocks = 4;
+	TEST_ASSERT(test_send_host_command(EC_CMD_FLASH_BLOCK_HASH, 0,
+					   &params, sizeof(params),
+					   hash, sizeof(hash)) ==
+		    EC_RES_SUCCESS);
+
+	for (i = 0; i < 2; i++) {
+		SHA256_init(&ctx);
+		SHA256_update(&ctx, (const uint8_t *)CONFIG_PROGRAM_MEMORY_BASE +
+			      offset + i * CONFIG_FLASH_ERASE_SIZE,
+			      CONFIG_FLASH_ERASE_SIZE);
+		expected = SHA256_final(&ctx);
+		TEST_ASSERT_ARRAY_EQ(hash[i], expected, SHA256_DIGEST_SIZE);
+	}
+	TEST_ASSERT(memcmp(hash[0], hash[1], sizeof(hash[0])));
+
+	/* Blocks past the end of flash */
+	params.offset = CONFIG_FLASH_SIZE - CONFIG_FLASH_ERASE_SIZE;
+	params.num_blocks = 2;
+	TEST_ASSERT(test_send_host_command(EC_CMD_FLASH_BLOCK_HASH, 0,
+					   &params, sizeof(params),
+					   hash, sizeof(hash)) ==
+		    EC_RES_INVALID_PARAM);
+
+	return EC_SUCCESS;
+}
+
 static int test_flash_info(void)
 {
 	struct ec_response_flash_info_1 resp;
@@ -454,6 +506,7 @@ static void run_test_step1(void)
 	RUN_TEST(test_overwrite_current);
 	RUN_TEST(test_overwrite_other);
 	RUN_TEST(test_op_failure);
+	RUN_TEST(test_block_hash);
 	RUN_TEST(test_flash_info);
 	RUN_TEST(test_region_info);
 	RUN_TEST(test_write_protect);
@@ -0,0 +1,182 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test the deferred call scheduler of the hook task.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "hooks.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+/* From common/hooks.c */
+extern uint32_t hook_task_wakeups;
+extern int deferred_slack_us;
+
+static int call_log[4];
+static int call_log_len;
+
+static void log_call(int id)
+{
+	if (call_log_len < ARRAY_SIZE(call_log))
+		call_log[call_log_len] = id;
+	call_log_len++;
+}
+
+static void order_a(void)
+{
+	log_call(0);
+}
+DECLARE_DEFERRED(order_a);
+
+static void order_b(void)
+{
+	log_call(1);
+}
+DECLARE_DEFERRED(order_b);
+
+static void order_c(void)
+{
+	log_call(2);
+}
+DECLARE_DEFERRED(order_c);
+
+/*
+ * Synthetic load: routines which keep re-arming themselves, at slightly
+ * different periods, like charge ramp, PD and sensor polling do.
+ */
+#define LOAD_COUNT 8
+#define LOAD_PERIOD_US(n) ((n) * 700 + 3 * MSEC)
+
+static int load_running;
+static int load_calls;
+
+#define LOAD_ROUTINE(n)							\
+	static void load_##n(void);					\
+	DECLARE_DEFERRED(load_##n);					\
+	static void load_##n(void)					\
+	{								\
+		load_calls++;						\
+		if (load_running)					\
+			hook_call_deferred(&load_##n##_data,		\
+					   LOAD_PERIOD_US(n));		\
+	}
+
+LOAD_ROUTINE(0)
+LOAD_ROUTINE(1)
+LOAD_ROUTINE(2)
+LOAD_ROUTINE(3)
+LOAD_ROUTINE(4)
+LOAD_ROUTINE(5)
+LOAD_ROUTINE(6)
+LOAD_ROUTINE(7)
+
+static const struct deferred_data *const load_data[LOAD_COUNT] = {
+	&load_0_data, &load_1_data, &load_2_data, &load_3_data,
+	&load_4_data, &load_5_data, &load_6_data, &load_7_data,
+};
+
+static int test_deadline_order(void)
+{
+	deferred_slack_us = 0;
+	call_log_len = 0;
+
+	/* Armed in the opposite order of their deadlines */
+	hook_call_deferred(&order_c_data, 30 * MSEC);
+	hook_call_deferred(&order_b_data, 20 * MSEC);
+	hook_call_deferred(&order_a_data, 10 * MSEC);
+	msleep(50);
+
+	TEST_EQ(call_log_len, 3, "%d");
+	TEST_EQ(call_log[0], 0, "%d");
+	TEST_EQ(call_log[1], 1, "%d");
+	TEST_EQ(call_log[2], 2, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_rearm_and_cancel(void)
+{
+	deferred_slack_us = 0;
+	call_log_len = 0;
+
+	hook_call_deferred(&order_a_data, 10 * MSEC);
+	hook_call_deferred(&order_b_data, 20 * MSEC);
+	hook_call_deferred(&order_c_data, 30 * MSEC);
+
+	/* Move a after c, and drop b */
+	hook_call_deferred(&order_a_data, 40 * MSEC);
+	hook_call_deferred(&order_b_data, -1);
+	msleep(60);
+
+	TEST_EQ(call_log_len, 2, "%d");
+	TEST_EQ(call_log[0], 2, "%d");
+	TEST_EQ(call_log[1], 0, "%d");
+
+	/* Canceling something which is not armed is harmless */
+	TEST_EQ(hook_call_deferred(&order_b_data, -1), EC_SUCCESS, "%d");
+	msleep(10);
+	TEST_EQ(call_log_len, 2, "%d");
+
+	return EC_SUCCESS;
+}
+
+/* Run the synthetic load for a second, and return the hook task wakeups */
+static int run_load(int slack_us, int *calls)
+{
+	uint32_t wakeups;
+	int i;
+
+	deferred_slack_us = slack_us;
+	load_calls = 0;
+	load_running = 1;
+	wakeups = hook_task_wakeups;
+
+	for (i = 0; i < LOAD_COUNT; i++)
+		hook_call_deferred(load_data[i], LOAD_PERIOD_US(i));
+	msleep(1000);
+
+	load_running = 0;
+	for (i = 0; i < LOAD_COUNT; i++)
+		hook_call_deferred(load_data[i], -1);
+
+	*calls = load_calls;
+	return hook_task_wakeups - wakeups;
+}
+
+static int test_wakeups(void)
+{
+	int calls, coalesced_calls;
+	int wakeups, coalesced_wakeups;
+
+	wakeups = run_load(0, &calls);
+	coalesced_wakeups = run_load(CONFIG_HOOK_DEFERRED_SLACK_US,
+				     &coalesced_calls);
+
+	ccprintf("no slack:     %d calls/s, %d wakeups/s\n", calls, wakeups);
+	ccprintf("%4d us slack: %d calls/s, %d wakeups/s\n",
+		 CONFIG_HOOK_DEFERRED_SLACK_US, coalesced_calls,
+		 coalesced_wakeups);
+
+	TEST_ASSERT(calls > 0);
+	TEST_ASSERT(coalesced_calls > 0);
+	/* Routines share wakeups, and more of them with the slack */
+	TEST_ASSERT(coalesced_wakeups < coalesced_calls);
+	TEST_ASSERT(coalesced_wakeups < wakeups);
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_deadline_order);
+	RUN_TEST(test_rearm_and_cancel);
+	RUN_TEST(test_wakeups);
+
+	test_print_result();
+}
@@ -8,6 +8,7 @@
 #include "common.h"
 #include "console.h"
 #include "hooks.h"
+#include "link_defs.h"
 #include "test_util.h"
 #include "timer.h"
 #include "util.h"
@@ -66,6 +67,68 @@ static const struct deferred_data non_deferred_func_data = {
 	non_deferred_func
 };
 
+/*
+ * Many hooks of one type, declared in an order unrelated to their priority.
+ * Each one is numbered 1xxxx with base 4 digits, from 10000 to 13333.
+ */
+#define ORDER_HOOK_FIRST 10000
+#define ORDER_HOOK_COUNT 256
+#define ORDER_HOOK_PRIO(n) (((n) * 7919) % 1000 + HOOK_PRIO_FIRST)
+
+static int order_log[ORDER_HOOK_COUNT];
+static int order_log_len;
+static int order_calls;
+
+static void record_order(int n)
+{
+	if (order_log_len < ORDER_HOOK_COUNT)
+		order_log[order_log_len] = n;
+	order_log_len++;
+}
+
+#define ORDER_HOOK(n)							\
+	static void order_hook_##n(void)				\
+	{								\
+		if (order_calls++ < ORDER_HOOK_COUNT)			\
+			record_order(n);				\
+	}								\
+	DECLARE_HOOK(HOOK_USB_PD_CONNECT, order_hook_##n,		\
+		     ORDER_HOOK_PRIO(n))
+#define ORDER_HOOK4(n) \
+	ORDER_HOOK(n##0); ORDER_HOOK(n##1); ORDER_HOOK(n##2); ORDER_HOOK(n##3)
+#define ORDER_HOOK16(n) \
+	ORDER_HOOK4(n##0); ORDER_HOOK4(n##1); ORDER_HOOK4(n##2); ORDER_HOOK4(n##3)
+#define ORDER_HOOK64(n) ORDER_HOOK16(n##0); ORDER_HOOK16(n##1); \
+	ORDER_HOOK16(n##2); ORDER_HOOK16(n##3)
+
+ORDER_HOOK64(10);
+ORDER_HOOK64(11);
+ORDER_HOOK64(12);
+ORDER_HOOK64(13);
+
+/*
+ * Hooks of two priorities, interleaved, odd ones first.  Hooks of equal
+ * priority must still run in the order they are linked in.
+ */
+static int stable_log[6];
+static int stable_log_len;
+
+#define STABLE_HOOK(n, prio)						\
+	static void stable_hook_##n(void)				\
+	{								\
+		if (stable_log_len < ARRAY_SIZE(stable_log))		\
+			stable_log[stable_log_len] = n;			\
+		stable_log_len++;					\
+	}								\
+	DECLARE_HOOK(HOOK_USB_PD_DISCONNECT, stable_hook_##n, prio)
+
+STABLE_HOOK(0, HOOK_PRIO_DEFAULT);
+STABLE_HOOK(1, HOOK_PRIO_FIRST);
+STABLE_HOOK(2, HOOK_PRIO_DEFAULT);
+STABLE_HOOK(3, HOOK_PRIO_FIRST);
+STABLE_HOOK(4, HOOK_PRIO_DEFAULT);
+STABLE_HOOK(5, HOOK_PRIO_FIRST);
+
 static int test_init_hook(void)
 {
 	TEST_ASSERT(init_hook_count == 1);
@@ -105,6 +168,120 @@ static int test_priority(void)
 	return EC_SUCCESS;
 }
 
+/*
+ * How hook_notify() used to find the hooks to call: rescan all of them for
+ * each distinct priority.  Kept as the reference for the order of hooks of
+ * equal priority, which is their link order, and as a baseline for the
+ * benchmark.
+ */
+static void notify_by_rescan(const struct hook_data *start,
+			     const struct hook_data *end)
+{
+	const struct hook_data *p;
+	int count = end - start, called = 0;
+	int last_prio = HOOK_PRIO_FIRST - 1, prio;
+
+	while (called < count) {
+		for (p = start, prio = HOOK_PRIO_LAST + 1; p < end; p++) {
+			if (p->priority < prio && p->priority > last_prio)
+				prio = p->priority;
+		}
+		last_prio = prio;
+
+		for (p = start; p < end; p++) {
+			if (p->priority == prio) {
+				called++;
+				p->routine();
+			}
+		}
+	}
+}
+
+static int test_notify_order(void)
+{
+	static uint8_t seen[13334 - ORDER_HOOK_FIRST];
+	static int rescan_log[ORDER_HOOK_COUNT];
+	int i, n;
+
+	order_calls = 0;
+	order_log_len = 0;
+	hook_notify(HOOK_USB_PD_CONNECT);
+
+	TEST_EQ(order_log_len, ORDER_HOOK_COUNT, "%d");
+	for (i = 0; i < ORDER_HOOK_COUNT; i++) {
+		n = order_log[i];
+		TEST_ASSERT(n >= ORDER_HOOK_FIRST &&
+			    n < ORDER_HOOK_FIRST + ARRAY_SIZE(seen));
+		TEST_ASSERT(!seen[n - ORDER_HOOK_FIRST]);
+		seen[n - ORDER_HOOK_FIRST] = 1;
+
+		if (i > 0)
+			TEST_ASSERT(ORDER_HOOK_PRIO(order_log[i - 1]) <=
+				    ORDER_HOOK_PRIO(n));
+	}
+
+	/* Some priorities collide; those hooks must run in link order too */
+	memcpy(rescan_log, order_log, sizeof(rescan_log));
+	order_calls = 0;
+	order_log_len = 0;
+	notify_by_rescan(__hooks_usb_pd_connect, __hooks_usb_pd_connect_end);
+	TEST_ASSERT_ARRAY_EQ(order_log, rescan_log, ORDER_HOOK_COUNT);
+
+	return EC_SUCCESS;
+}
+
+static int test_notify_equal_priority(void)
+{
+	int expected[ARRAY_SIZE(stable_log)];
+	int i;
+
+	stable_log_len = 0;
+	notify_by_rescan(__hooks_usb_pd_disconnect,
+			 __hooks_usb_pd_disconnect_end);
+	TEST_EQ(stable_log_len, (int)ARRAY_SIZE(expected), "%d");
+	memcpy(expected, stable_log, sizeof(expected));
+	for (i = 0; i < ARRAY_SIZE(expected); i++)
+		TEST_EQ(expected[i] & 1, i < ARRAY_SIZE(expected) / 2, "%d");
+
+	stable_log_len = 0;
+	hook_notify(HOOK_USB_PD_DISCONNECT);
+
+	TEST_EQ(stable_log_len, (int)ARRAY_SIZE(expected), "%d");
+	TEST_ASSERT_ARRAY_EQ(stable_log, expected, ARRAY_SIZE(expected));
+
+	return EC_SUCCESS;
+}
+
+/*
+ * CONFIG_HOOK_DEBUG makes hook_notify() print and time each call, which the
+ * rescan doesn't, so only benchmark without it.
+ */
+#ifndef CONFIG_HOOK_DEBUG
+static int test_notify_benchmark(void)
+{
+	const int iterations = 1000;
+	timestamp_t t0, t1, t2;
+	int i;
+
+	t0 = test_get_wall_time();
+	for (i = 0; i < iterations; i++)
+		notify_by_rescan(__hooks_usb_pd_connect,
+				 __hooks_usb_pd_connect_end);
+	t1 = test_get_wall_time();
+	for (i = 0; i < iterations; i++)
+		hook_notify(HOOK_USB_PD_CONNECT);
+	t2 = test_get_wall_time();
+
+	/* do not check result, just as a benchmark */
+	ccprintf("%d hooks: rescan %lld ns, sorted %lld ns per notify\n",
+		 (int)(__hooks_usb_pd_connect_end - __hooks_usb_pd_connect),
+		 (long long)(t1.val - t0.val) * 1000 / iterations,
+		 (long long)(t2.val - t1.val) * 1000 / iterations);
+
+	return EC_SUCCESS;
+}
+#endif
+
 static int test_deferred(void)
 {
 	deferred_call_count = 0;
@@ -166,6 +343,11 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_init_hook);
 	RUN_TEST(test_ticks);
 	RUN_TEST(test_priority);
+	RUN_TEST(test_notify_order);
+	RUN_TEST(test_notify_equal_priority);
+#ifndef CONFIG_HOOK_DEBUG
+	RUN_TEST(test_notify_benchmark);
+#endif
 	RUN_TEST(test_deferred);
 	RUN_TEST(test_repeating_deferred);
 
@@ -8,6 +8,8 @@
 #include "common.h"
 #include "console.h"
 #include "host_command.h"
+#include "link_defs.h"
+#include "shared_mem.h"
 #include "task.h"
 #include "test_util.h"
 #include "timer.h"
@@ -300,6 +302,280 @@ static int test_hostcmd_clears_unused_data(void)
 	return EC_SUCCESS;
 }
 
+static int test_hostcmd_dispatch_all(void)
+{
+	struct ec_params_get_cmd_versions_v1 p;
+	struct ec_response_get_cmd_versions r;
+	const struct host_command *cmd;
+	int command, found;
+
+	/* Every host command is found, with its own versions */
+	for (cmd = __hcmds; cmd < __hcmds_end; cmd++) {
+		p.cmd = cmd->command;
+		TEST_EQ(test_send_host_command(EC_CMD_GET_CMD_VERSIONS, 1,
+					       &p, sizeof(p), &r, sizeof(r)),
+			EC_RES_SUCCESS, "%d");
+		TEST_EQ(r.version_mask, cmd->version_mask, "0x%x");
+	}
+
+	/* And nothing else is; sample, as each miss is logged */
+	for (command = 0; command <= UINT16_MAX; command += 97) {
+		found = 0;
+		for (cmd = __hcmds; cmd < __hcmds_end; cmd++)
+			found |= cmd->command == command;
+		if (found)
+			continue;
+
+		p.cmd = command;
+		TEST_EQ(test_send_host_command(EC_CMD_GET_CMD_VERSIONS, 1,
+					       &p, sizeof(p), &r, sizeof(r)),
+			EC_RES_INVALID_PARAM, "%d");
+	}
+
+	return EC_SUCCESS;
+}
+
+#ifdef CONFIG_HOSTCMD_STATS
+static int test_hostcmd_stats(void)
+{
+	struct ec_params_hostcmd_stats p = {
+		.flags = EC_HOSTCMD_STATS_FLAG_CLEAR,
+	};
+	struct ec_params_hello hello_p = { .in_data = 0x11223344 };
+	struct ec_response_hello hello_r;
+	uint8_t buf[BUFFER_SIZE];
+	struct ec_response_hostcmd_stats *r = (void *)buf;
+	struct ec_hostcmd_stats_entry *entry;
+	int i, bucket, calls, hello_calls = -1;
+
+	/* Clear everything, a page at a time */
+	for (p.offset = 0; ; p.offset += r->count) {
+		TEST_EQ(test_send_host_command(EC_CMD_HOSTCMD_STATS, 0,
+					       &p, sizeof(p), buf, sizeof(buf)),
+			EC_RES_SUCCESS, "%d");
+		TEST_ASSERT(r->count > 0);
+		if (p.offset + r->count == r->total)
+			break;
+	}
+
+	for (i = 0; i < 10; i++)
+		TEST_EQ(test_send_host_command(EC_CMD_HELLO, 0,
+					       &hello_p, sizeof(hello_p),
+					       &hello_r, sizeof(hello_r)),
+			EC_RES_SUCCESS, "%d");
+
+	p.flags = 0;
+	for (p.offset = 0; p.offset < r->total; p.offset += r->count) {
+		TEST_EQ(test_send_host_command(EC_CMD_HOSTCMD_STATS, 0,
+					       &p, sizeof(p), buf, sizeof(buf)),
+			EC_RES_SUCCESS, "%d");
+
+		for (i = 0; i < r->count; i++) {
+			entry = &r->entries[i];
+			if (entry->command != EC_CMD_HELLO)
+				continue;
+
+			hello_calls = entry->count;
+			calls = 0;
+			for (bucket = 0; bucket < EC_HOSTCMD_STATS_BUCKETS;
+			     bucket++)
+				calls += entry->histogram[bucket];
+			TEST_EQ(calls, hello_calls, "%d");
+		}
+	}
+	TEST_EQ(hello_calls, 10, "%d");
+
+	/* Offsets past the end are rejected */
+	p.offset = r->total + 1;
+	TEST_EQ(test_send_host_command(EC_CMD_HOSTCMD_STATS, 0, &p, sizeof(p),
+				       buf, sizeof(buf)),
+		EC_RES_INVALID_PARAM, "%d");
+
+	return EC_SUCCESS;
+}
+#endif
+
+static uint8_t batch_buf[BUFFER_SIZE] __aligned(4);
+static int batch_len;
+
+static void batch_start(uint8_t flags)
+{
+	struct ec_params_batch *b = (struct ec_params_batch *)batch_buf;
+
+	memset(batch_buf, 0, sizeof(batch_buf));
+	b->flags = flags;
+	batch_len = sizeof(*b);
+}
+
+static struct ec_host_request *batch_add(int command, int version,
+					 const void *params, int size)
+{
+	struct ec_params_batch *b = (struct ec_params_batch *)batch_buf;
+	struct ec_host_request *r =
+		(struct ec_host_request *)(batch_buf + batch_len);
+
+	r->struct_version = EC_HOST_REQUEST_VERSION;
+	r->command = command;
+	r->command_version = version;
+	r->data_len = size;
+	memcpy(r + 1, params, size);
+	r->checksum = calculate_checksum((const char *)r, sizeof(*r) + size);
+
+	batch_len += EC_BATCH_ENTRY_SIZE(*r, size);
+	b->count++;
+
+	return r;
+}
+
+static int batch_send(void *resp, int resp_size)
+{
+	return test_send_host_command(EC_CMD_BATCH, 0, batch_buf, batch_len,
+				      resp, resp_size);
+}
+
+/* Return the i-th response of a batch, checking its header */
+static const struct ec_host_response *batch_response(const void *resp, int i)
+{
+	const struct ec_response_batch *b = resp;
+	const uint8_t *p = b->responses;
+	const struct ec_host_response *r = (const void *)p;
+
+	for (; i > 0; i--) {
+		p += EC_BATCH_ENTRY_SIZE(*r, r->data_len);
+		r = (const struct ec_host_response *)p;
+	}
+
+	if (r->struct_version != EC_HOST_RESPONSE_VERSION ||
+	    calculate_checksum((const char *)r, sizeof(*r) + r->data_len))
+		return NULL;
+
+	return r;
+}
+
+static int test_hostcmd_batch(void)
+{
+	struct ec_params_hello hello_p;
+	struct ec_params_get_cmd_versions_v1 versions_p = {
+		.cmd = EC_CMD_HELLO,
+	};
+	const struct ec_response_batch *b = (const void *)resp_buf;
+	const struct ec_host_response *r;
+	const struct ec_response_hello *hello_r;
+	const struct ec_response_get_cmd_versions *versions_r;
+	int flags;
+
+	for (flags = 0; flags <= EC_BATCH_FLAG_STOP_ON_ERROR; flags++) {
+		batch_start(flags);
+		hello_p.in_data = 0x11223344;
+		batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+		batch_add(EC_CMD_GET_CMD_VERSIONS, 1, &versions_p,
+			  sizeof(versions_p));
+		batch_add(0x7fff, 0, NULL, 0);
+		hello_p.in_data = 0x01020304;
+		batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+
+		TEST_EQ(batch_send(resp_buf, sizeof(resp_buf)),
+			EC_RES_SUCCESS, "%d");
+		TEST_EQ(b->count, flags ? 3 : 4, "%d");
+
+		r = batch_response(b, 0);
+		TEST_ASSERT(r);
+		TEST_EQ(r->result, EC_RES_SUCCESS, "%d");
+		TEST_EQ(r->data_len, (int)sizeof(*hello_r), "%d");
+		hello_r = (const void *)(r + 1);
+		TEST_EQ(hello_r->out_data, 0x12243648, "0x%x");
+
+		r = batch_response(b, 1);
+		TEST_ASSERT(r);
+		TEST_EQ(r->result, EC_RES_SUCCESS, "%d");
+		versions_r = (const void *)(r + 1);
+		TEST_EQ(versions_r->version_mask, EC_VER_MASK(0), "0x%x");
+
+		r = batch_response(b, 2);
+		TEST_ASSERT(r);
+		TEST_EQ(r->result, EC_RES_INVALID_COMMAND, "%d");
+		TEST_EQ(r->data_len, 0, "%d");
+
+		if (flags & EC_BATCH_FLAG_STOP_ON_ERROR)
+			continue;
+
+		r = batch_response(b, 3);
+		TEST_ASSERT(r);
+		TEST_EQ(r->result, EC_RES_SUCCESS, "%d");
+		hello_r = (const void *)(r + 1);
+		TEST_EQ(hello_r->out_data, 0x02040608, "0x%x");
+	}
+
+	return EC_SUCCESS;
+}
+
+static int test_hostcmd_batch_errors(void)
+{
+	struct ec_params_hello hello_p = { .in_data = 0 };
+	const struct ec_response_batch *b = (const void *)resp_buf;
+	struct ec_host_request *req;
+	uint8_t small[sizeof(*b) + 2 * sizeof(struct ec_host_response) +
+		      sizeof(struct ec_response_hello)] __aligned(4);
+
+	/* Batches do not nest */
+	batch_start(0);
+	batch_add(EC_CMD_BATCH, 0, NULL, 0);
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	TEST_EQ(batch_send(resp_buf, sizeof(resp_buf)), EC_RES_SUCCESS, "%d");
+	TEST_EQ(b->count, 1, "%d");
+	TEST_EQ(batch_response(b, 0)->result, EC_RES_INVALID_COMMAND, "%d");
+
+	/* A bad request ends the batch */
+	batch_start(0);
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	req = batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	req->checksum++;
+	TEST_EQ(batch_send(resp_buf, sizeof(resp_buf)), EC_RES_SUCCESS, "%d");
+	TEST_EQ(b->count, 2, "%d");
+	TEST_EQ(batch_response(b, 1)->result, EC_RES_INVALID_CHECKSUM, "%d");
+
+	/* So does a truncated one */
+	batch_start(0);
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	batch_len -= 2;
+	TEST_EQ(batch_send(resp_buf, sizeof(resp_buf)), EC_RES_SUCCESS, "%d");
+	TEST_EQ(b->count, 1, "%d");
+	TEST_EQ(batch_response(b, 0)->result, EC_RES_REQUEST_TRUNCATED, "%d");
+
+	/* Responses which do not fit are reported as such, and end it */
+	batch_start(0);
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	TEST_EQ(batch_send(small, sizeof(small)), EC_RES_SUCCESS, "%d");
+	b = (const void *)small;
+	TEST_EQ(b->count, 2, "%d");
+	TEST_EQ(batch_response(b, 0)->result, EC_RES_SUCCESS, "%d");
+	TEST_EQ(batch_response(b, 1)->result, EC_RES_RESPONSE_TOO_BIG, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_hostcmd_batch_shared_mem(void)
+{
+	struct ec_params_hello hello_p = { .in_data = 0 };
+	const struct ec_response_batch *b = (const void *)resp_buf;
+	char *buf;
+
+	/* Batches still run while shared memory is in use */
+	TEST_EQ(shared_mem_acquire(16, &buf), EC_SUCCESS, "%d");
+	batch_start(0);
+	batch_add(EC_CMD_HELLO, 0, &hello_p, sizeof(hello_p));
+	TEST_EQ(batch_send(resp_buf, sizeof(resp_buf)), EC_RES_SUCCESS, "%d");
+	shared_mem_release(buf);
+
+	TEST_EQ(b->count, 1, "%d");
+	TEST_EQ(batch_response(b, 0)->result, EC_RES_SUCCESS, "%d");
+
+	return EC_SUCCESS;
+}
+
 void run_test(int argc, char **argv)
 {
 	wait_for_task_started();
@@ -315,6 +591,13 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_hostcmd_invalid_checksum);
 	RUN_TEST(test_hostcmd_reuse_response_buffer);
 	RUN_TEST(test_hostcmd_clears_unused_data);
+	RUN_TEST(test_hostcmd_dispatch_all);
+#ifdef CONFIG_HOSTCMD_STATS
+	RUN_TEST(test_hostcmd_stats);
+#endif
+	RUN_TEST(test_hostcmd_batch);
+	RUN_TEST(test_hostcmd_batch_errors);
+	RUN_TEST(test_hostcmd_batch_shared_mem);
 
 	test_print_result();
 }
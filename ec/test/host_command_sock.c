@@ -0,0 +1,209 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test the host command socket of the emulator.
+ */
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "host_command.h"
+#include "host_test.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+/* Number of hello commands to time */
+#define HELLO_COUNT 1000
+
+static int client_fd = -1;
+
+/* Request sent by the client thread, and the last response to it */
+static struct {
+	uint8_t out[64];
+	int out_len;
+	uint8_t in[64];
+	int in_len;
+	int count;
+	volatile int done;
+} xfer;
+
+static int sock_read(void *buf, int len)
+{
+	uint8_t *p = buf;
+	int rv;
+
+	while (len) {
+		rv = recv(client_fd, p, len, 0);
+		if (rv <= 0)
+			return -1;
+		p += rv;
+		len -= rv;
+	}
+
+	return 0;
+}
+
+static void *client_thread(void *arg)
+{
+	struct ec_host_response *r = (struct ec_host_response *)xfer.in;
+	int i;
+
+	xfer.in_len = -1;
+	for (i = 0; i < xfer.count; i++) {
+		if (send(client_fd, xfer.out, xfer.out_len, 0) !=
+		    xfer.out_len ||
+		    sock_read(r, sizeof(*r)) ||
+		    r->data_len > sizeof(xfer.in) - sizeof(*r) ||
+		    sock_read(r + 1, r->data_len))
+			break;
+	}
+	if (i == xfer.count)
+		xfer.in_len = sizeof(*r) + r->data_len;
+
+	xfer.done = 1;
+	return NULL;
+}
+
+/*
+ * Send the request count times from another thread, as blocking in this task
+ * would keep the host command task from running.
+ */
+static int client_xfer(int count)
+{
+	pthread_t thread;
+
+	xfer.count = count;
+	xfer.done = 0;
+	pthread_create(&thread, NULL, client_thread, NULL);
+	while (!xfer.done)
+		msleep(1);
+	pthread_join(thread, NULL);
+
+	return xfer.in_len;
+}
+
+static void build_request(int command, const void *params, int size)
+{
+	struct ec_host_request *r = (struct ec_host_request *)xfer.out;
+	uint8_t sum = 0;
+	int i;
+
+	r->struct_version = EC_HOST_REQUEST_VERSION;
+	r->checksum = 0;
+	r->command = command;
+	r->command_version = 0;
+	r->reserved = 0;
+	r->data_len = size;
+	memcpy(r + 1, params, size);
+
+	xfer.out_len = sizeof(*r) + size;
+	for (i = 0; i < xfer.out_len; i++)
+		sum += xfer.out[i];
+	r->checksum = -sum;
+}
+
+static int check_response(int result, int data_len)
+{
+	struct ec_host_response *r = (struct ec_host_response *)xfer.in;
+	uint8_t sum = 0;
+	int i;
+
+	TEST_EQ(xfer.in_len, (int)sizeof(*r) + data_len, "%d");
+	TEST_EQ(r->struct_version, EC_HOST_RESPONSE_VERSION, "%d");
+	TEST_EQ(r->result, result, "%d");
+	for (i = 0; i < xfer.in_len; i++)
+		sum += xfer.in[i];
+	TEST_EQ(sum, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_hello(void)
+{
+	struct ec_params_hello p = { .in_data = 0xa0b0c0d0 };
+	struct ec_response_hello *r =
+		(struct ec_response_hello *)(xfer.in +
+					     sizeof(struct ec_host_response));
+
+	build_request(EC_CMD_HELLO, &p, sizeof(p));
+	client_xfer(1);
+	TEST_ASSERT(check_response(EC_RES_SUCCESS, sizeof(*r)) == EC_SUCCESS);
+	TEST_EQ(r->out_data, 0xa1b2c3d4, "0x%x");
+
+	return EC_SUCCESS;
+}
+
+static int test_protocol_info(void)
+{
+	struct ec_response_get_protocol_info *r =
+		(struct ec_response_get_protocol_info *)
+		(xfer.in + sizeof(struct ec_host_response));
+
+	build_request(EC_CMD_GET_PROTOCOL_INFO, NULL, 0);
+	client_xfer(1);
+	TEST_ASSERT(check_response(EC_RES_SUCCESS, sizeof(*r)) == EC_SUCCESS);
+	TEST_EQ(r->protocol_versions, BIT(3), "%d");
+	TEST_ASSERT(r->max_request_packet_size >= 256);
+	TEST_ASSERT(r->max_response_packet_size >= 256);
+
+	return EC_SUCCESS;
+}
+
+static int test_bad_checksum(void)
+{
+	struct ec_params_hello p = { .in_data = 1 };
+
+	build_request(EC_CMD_HELLO, &p, sizeof(p));
+	xfer.out[1]++;
+	client_xfer(1);
+	TEST_ASSERT(check_response(EC_RES_INVALID_CHECKSUM, 0) == EC_SUCCESS);
+
+	/* Still in step with the host */
+	return test_hello();
+}
+
+static int test_hello_rate(void)
+{
+	struct ec_params_hello p = { .in_data = 0 };
+	timestamp_t start, end;
+
+	build_request(EC_CMD_HELLO, &p, sizeof(p));
+	start = test_get_wall_time();
+	TEST_ASSERT(client_xfer(HELLO_COUNT) > 0);
+	end = test_get_wall_time();
+
+	ccprintf("%d hello commands in %d us\n", HELLO_COUNT,
+		 (int)(end.val - start.val));
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	test_reset();
+
+	strzcpy(addr.sun_path, host_command_sock_path(),
+		sizeof(addr.sun_path));
+	client_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (client_fd < 0 ||
+	    connect(client_fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		ccprintf("Cannot connect to %s\n", addr.sun_path);
+		test_fail();
+		return;
+	}
+
+	RUN_TEST(test_hello);
+	RUN_TEST(test_protocol_info);
+	RUN_TEST(test_bad_checksum);
+	RUN_TEST(test_hello_rate);
+
+	test_print_result();
+}
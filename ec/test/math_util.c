@@ -9,8 +9,10 @@
 #include <stdio.h>
 #include "common.h"
 #include "math_util.h"
+#include "motion_common.h"
 #include "motion_sense.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
 /*****************************************************************************/
@@ -78,12 +80,165 @@ static int test_rotate(void)
 	return EC_SUCCESS;
 }
 
+/*
+ * Base and lid vectors from kAccelerometerLaptopModeTestData, scaled so that
+ * 1g is 1 << 14, in structure of arrays layout.
+ */
+#define BATCH_MAX_SAMPLES 256
+
+static int base_xyz[3][BATCH_MAX_SAMPLES];
+static int lid_xyz[3][BATCH_MAX_SAMPLES];
+static int batch_samples;
+
+static const intv3_batch_t base = {
+	base_xyz[X], base_xyz[Y], base_xyz[Z]
+};
+static const intv3_batch_t lid = {
+	lid_xyz[X], lid_xyz[Y], lid_xyz[Z]
+};
+
+static void load_batch_samples(void)
+{
+	const float *data = kAccelerometerLaptopModeTestData;
+	int i, k;
+
+	batch_samples = MIN(BATCH_MAX_SAMPLES,
+			    kAccelerometerLaptopModeTestDataLength / 6);
+	for (i = 0; i < batch_samples; i++, data += 6) {
+		for (k = X; k <= Z; k++) {
+			base_xyz[k][i] = data[k] * (1 << 14);
+			lid_xyz[k][i] = data[3 + k] * (1 << 14);
+		}
+	}
+}
+
+static int test_batch_matches_scalar(void)
+{
+	static int out_xyz[3][BATCH_MAX_SAMPLES];
+	static int mag[BATCH_MAX_SAMPLES];
+	const intv3_batch_t out = { out_xyz[X], out_xyz[Y], out_xyz[Z] };
+	intv3_t v, w, expected;
+	int i, k, m;
+
+	load_batch_samples();
+
+	for (m = 0; m < ARRAY_SIZE(test_matrices); m++) {
+		rotate_batch(base, test_matrices[m], out, batch_samples);
+		for (i = 0; i < batch_samples; i++) {
+			for (k = X; k <= Z; k++)
+				v[k] = base[k][i];
+			rotate(v, test_matrices[m], expected);
+			for (k = X; k <= Z; k++)
+				TEST_EQ(out[k][i], expected[k], "%d");
+		}
+
+		/* In place, back to where we started */
+		rotate_inv_batch(out, test_matrices[m], out, batch_samples);
+		for (i = 0; i < batch_samples; i++) {
+			for (k = X; k <= Z; k++)
+				v[k] = base[k][i];
+			rotate(v, test_matrices[m], w);
+			rotate_inv(w, test_matrices[m], expected);
+			for (k = X; k <= Z; k++)
+				TEST_EQ(out[k][i], expected[k], "%d");
+		}
+	}
+
+	/* No matrix means no rotation */
+	rotate_batch(lid, NULL, out, batch_samples);
+	for (k = X; k <= Z; k++)
+		TEST_ASSERT_ARRAY_EQ(out[k], lid[k], batch_samples);
+
+	vector_magnitude_batch(lid, mag, batch_samples);
+	cross_product_batch(base, lid, out, batch_samples);
+	for (i = 0; i < batch_samples; i++) {
+		for (k = X; k <= Z; k++) {
+			v[k] = base[k][i];
+			w[k] = lid[k][i];
+		}
+		TEST_EQ(mag[i], vector_magnitude(w), "%d");
+		cross_product(v, w, expected);
+		for (k = X; k <= Z; k++)
+			TEST_EQ(out[k][i], expected[k], "%d");
+	}
+
+	return EC_SUCCESS;
+}
+
+#define BATCH_ROUNDS 200
+
+static int test_batch_benchmark(void)
+{
+	static int base_out_xyz[3][BATCH_MAX_SAMPLES];
+	static int lid_out_xyz[3][BATCH_MAX_SAMPLES];
+	static int mag[BATCH_MAX_SAMPLES];
+	const intv3_batch_t base_out = {
+		base_out_xyz[X], base_out_xyz[Y], base_out_xyz[Z]
+	};
+	const intv3_batch_t lid_out = {
+		lid_out_xyz[X], lid_out_xyz[Y], lid_out_xyz[Z]
+	};
+	/* A typical standard reference frame matrix */
+	const fp_t (*R)[3] = test_matrices[0];
+	timestamp_t t0, t1, t2;
+	intv3_t v, w;
+	int64_t samples;
+	int i, k, r;
+
+	load_batch_samples();
+	samples = (int64_t)batch_samples * BATCH_ROUNDS;
+
+	/*
+	 * Per lid/base sample pair: rotate both into the standard reference
+	 * frame, rotate the lid back, then the magnitude and cross product
+	 * used for the lid angle.
+	 */
+	t0 = test_get_wall_time();
+	for (r = 0; r < BATCH_ROUNDS; r++) {
+		for (i = 0; i < batch_samples; i++) {
+			for (k = X; k <= Z; k++) {
+				v[k] = base[k][i];
+				w[k] = lid[k][i];
+			}
+			rotate(v, R, v);
+			rotate(w, R, w);
+			rotate_inv(w, R, w);
+			mag[i] = vector_magnitude(w);
+			cross_product(v, w, v);
+			for (k = X; k <= Z; k++) {
+				base_out[k][i] = v[k];
+				lid_out[k][i] = w[k];
+			}
+		}
+	}
+	t1 = test_get_wall_time();
+	for (r = 0; r < BATCH_ROUNDS; r++) {
+		rotate_batch(base, R, base_out, batch_samples);
+		rotate_batch(lid, R, lid_out, batch_samples);
+		rotate_inv_batch(lid_out, R, lid_out, batch_samples);
+		vector_magnitude_batch(lid_out, mag, batch_samples);
+		cross_product_batch(base_out, lid_out, base_out,
+				    batch_samples);
+	}
+	t2 = test_get_wall_time();
+
+	/* do not check result, just as a benchmark */
+	ccprintf("%d samples x %d: scalar %lld samples/s, "
+		 "batched %lld samples/s\n", batch_samples, BATCH_ROUNDS,
+		 (long long)(samples * SECOND / MAX(t1.val - t0.val, 1)),
+		 (long long)(samples * SECOND / MAX(t2.val - t1.val, 1)));
+
+	return EC_SUCCESS;
+}
+
 void run_test(int argc, char **argv)
 {
 	test_reset();
 
 	RUN_TEST(test_acos);
 	RUN_TEST(test_rotate);
+	RUN_TEST(test_batch_matches_scalar);
+	RUN_TEST(test_batch_benchmark);
 
 	test_print_result();
 }
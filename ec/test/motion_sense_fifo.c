@@ -7,6 +7,7 @@
 
 #include "stdio.h"
 #include "motion_sense_fifo.h"
+#include "motion_sense_fifo_compact.h"
 #include "test_util.h"
 #include "util.h"
 #include "hwtimer.h"
@@ -343,6 +344,173 @@ static int test_commit_non_data_or_timestamp_entries(void)
 	return EC_SUCCESS;
 }
 
+/* Stage samples of both sensors, an ODR change and a long gap */
+static void stage_compact_pattern(void)
+{
+	struct ec_response_motion_sensor_data sample;
+	uint32_t time = 1000;
+	int i;
+
+	motion_sensors[BASE].oversampling_ratio = 1;
+	motion_sensors[LID].oversampling_ratio = 1;
+
+	for (i = 0; i < 20; i++) {
+		memset(&sample, 0, sizeof(sample));
+		sample.sensor_num = i % 2 ? LID : BASE;
+		sample.data[0] = i;
+		sample.data[1] = -i * 100;
+		sample.data[2] = 0x7fff - i;
+		if (i == 10)
+			motion_sense_fifo_insert_async_event(
+				motion_sensors + LID, ASYNC_EVENT_ODR);
+		/* Too long a gap for a 16-bit delta */
+		if (i == 15)
+			time += 100000;
+		motion_sense_fifo_stage_data(
+			&sample, motion_sensors + sample.sensor_num, 3, time);
+		motion_sense_fifo_commit_data();
+		time += 1250;
+	}
+}
+
+static int test_read_compact(void)
+{
+	static struct ec_response_motion_sensor_data expected[64];
+	static uint8_t compact[sizeof(expected)];
+	uint16_t size;
+	int count, i, n;
+
+	stage_compact_pattern();
+	count = motion_sense_fifo_read(sizeof(expected), ARRAY_SIZE(expected),
+				       expected, &data_bytes_read);
+	TEST_EQ(count, 41, "%d");
+
+	motion_sense_fifo_reset();
+	stage_compact_pattern();
+
+	/* Read in small pieces to cover records cut at the end */
+	for (i = 0; i < count; i += n) {
+		n = motion_sense_fifo_read_compact(13, CONFIG_ACCEL_FIFO_SIZE,
+						   compact, &size);
+		TEST_ASSERT(n > 0);
+		TEST_ASSERT(size <= 13);
+		TEST_EQ(motion_sense_fifo_decode_compact(
+				compact, size, data + i, ARRAY_SIZE(data) - i),
+			n, "%d");
+	}
+	TEST_EQ(i, count, "%d");
+
+	for (i = 0; i < count; i++) {
+		TEST_EQ(data[i].flags, expected[i].flags, "0x%x");
+		TEST_EQ(data[i].sensor_num, expected[i].sensor_num, "%d");
+		/* The ODR event is timestamped with the hardware clock */
+		if (expected[i].flags & MOTIONSENSE_SENSOR_FLAG_ODR)
+			continue;
+		if (expected[i].flags & MOTIONSENSE_SENSOR_FLAG_TIMESTAMP)
+			TEST_EQ(data[i].timestamp, expected[i].timestamp,
+				"%u");
+		else
+			TEST_ASSERT_ARRAY_EQ(data[i].data, expected[i].data,
+					     ARRAY_SIZE(expected[i].data));
+	}
+
+	/* All of it fits at once, in less than two thirds of the size */
+	motion_sense_fifo_reset();
+	stage_compact_pattern();
+	TEST_EQ(motion_sense_fifo_read_compact(sizeof(compact),
+					       CONFIG_ACCEL_FIFO_SIZE, compact,
+					       &size), count, "%d");
+	ccprintf("%d entries: %d bytes, %d bytes compact\n", count,
+		 count * (int)sizeof(expected[0]), size);
+	TEST_ASSERT(size * 3 < count * sizeof(expected[0]) * 2);
+
+	return EC_SUCCESS;
+}
+
+typedef int (*fifo_read_func)(int capacity_bytes, int max_count, void *out,
+			      uint16_t *out_size);
+
+/*
+ * Response size available to a motion sense command over a 256-byte host
+ * packet, as on LPC.
+ */
+#define HOST_RESPONSE_MAX (256 - sizeof(struct ec_host_response))
+#define FIFO_RATE_HZ 400
+#define AP_READ_PERIOD_MS 100
+
+/*
+ * Stream one second of FIFO_RATE_HZ samples from both sensors, with the AP
+ * draining the fifo every AP_READ_PERIOD_MS, as it would on a fifo threshold
+ * interrupt.
+ */
+static void fifo_stream(fifo_read_func read, int header_bytes,
+			int *commands, int *bytes)
+{
+	static uint8_t response[HOST_RESPONSE_MAX];
+	struct ec_response_motion_sensor_data sample = {};
+	uint32_t time = 0;
+	uint16_t size;
+	int tick, count;
+
+	motion_sensors[BASE].oversampling_ratio = 1;
+	motion_sensors[LID].oversampling_ratio = 1;
+	*commands = 0;
+	*bytes = 0;
+
+	for (tick = 1; tick <= FIFO_RATE_HZ; tick++) {
+		time += SECOND / FIFO_RATE_HZ;
+
+		sample.sensor_num = BASE;
+		sample.data[0] = tick;
+		motion_sense_fifo_stage_data(&sample, motion_sensors + BASE, 3,
+					     time);
+		sample.sensor_num = LID;
+		sample.data[1] = -tick;
+		motion_sense_fifo_stage_data(&sample, motion_sensors + LID, 3,
+					     time + 100);
+		motion_sense_fifo_commit_data();
+
+		if (tick % (FIFO_RATE_HZ * AP_READ_PERIOD_MS / 1000))
+			continue;
+
+		/* Like ectool, read until the EC returns no data */
+		do {
+			count = read(sizeof(response) - header_bytes,
+				     CONFIG_ACCEL_FIFO_SIZE, response, &size);
+			*commands += 1;
+			*bytes += header_bytes + size;
+		} while (count);
+	}
+}
+
+static int test_read_compact_bandwidth(void)
+{
+	const int samples = 2 * FIFO_RATE_HZ;
+	int commands, bytes, compact_commands, compact_bytes;
+
+	fifo_stream(motion_sense_fifo_read,
+		    sizeof(struct ec_response_motion_sense_fifo_data),
+		    &commands, &bytes);
+	motion_sense_fifo_reset();
+	fifo_stream(motion_sense_fifo_read_compact,
+		    sizeof(struct ec_response_motion_sense_fifo_compact),
+		    &compact_commands, &compact_bytes);
+
+	/* do not check result, just as a benchmark */
+	ccprintf("%d samples/s, %d-byte responses: "
+		 "%d.%02d bytes/sample, %d commands/s; "
+		 "compact %d.%02d bytes/sample, %d commands/s\n",
+		 samples, (int)HOST_RESPONSE_MAX,
+		 bytes / samples, bytes * 100 / samples % 100, commands,
+		 compact_bytes / samples, compact_bytes * 100 / samples % 100,
+		 compact_commands);
+
+	TEST_ASSERT(compact_bytes < bytes);
+	TEST_ASSERT(compact_commands < commands);
+
+	return EC_SUCCESS;
+}
+
 void before_test(void)
 {
 	motion_sense_fifo_commit_data();
@@ -372,6 +540,8 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_spread_data_by_collection_rate);
 	RUN_TEST(test_spread_double_commit_same_timestamp);
 	RUN_TEST(test_commit_non_data_or_timestamp_entries);
+	RUN_TEST(test_read_compact);
+	RUN_TEST(test_read_compact_bandwidth);
 
 	test_print_result();
 }
@@ -8,8 +8,10 @@
 #include <stddef.h>
 
 #include "common.h"
+#include "console.h"
 #include "printf.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
 #define INIT_VALUE 0x5E
@@ -178,10 +180,33 @@ test_static int test_vsnprintf_int(void)
 	T(expect_success("4294967295", "%u",   -1));
 	T(expect_success("18446744073709551615", "%llu", (uint64_t)-1));
 
+	T(expect_success("9",         "%u",      9));
+	T(expect_success("10",        "%u",      10));
+	T(expect_success("99",        "%u",      99));
+	T(expect_success("100",       "%u",      100));
+	T(expect_success("-2147483648", "%d",   -2147483647 - 1));
+	T(expect_success("4294967296", "%llu",  (uint64_t)1 << 32));
+	T(expect_success("1000000000000000000", "%llu",
+			 1000000000000000000ULL));
+	T(expect_success("-9223372036854775808", "%lld",
+			 (int64_t)1 << 63));
+	T(expect_success("12345678901.234567", "%.6lld",
+			 12345678901234567LL));
+	T(expect_success("0.000000000000000000000000000001", "%.30d", 1));
+	/* Precision is capped at 31 digits, sign included */
+	T(expect_success("0.0000000000000000000000000000001", "%.31d", 1));
+	T(expect_success("-0.0000000000000000000000000000001", "%.31d", -1));
+	T(expect_success("0.0000000000000000000000000000001", "%.32d", 1));
+	T(expect_success("                   123", "%22d", 123));
+	T(expect_success("0000000000000000000123", "%022d", 123));
+	T(expect_success("123                   ", "%-22d", 123));
+
 	T(expect_success("0",         "%x",     0));
 	T(expect_success("0",         "%X",     0));
 	T(expect_success("5e",        "%x",     0X5E));
 	T(expect_success("5E",        "%X",     0X5E));
+	T(expect_success("fedcba9876543210", "%llx", 0xfedcba9876543210ULL));
+	T(expect_success("FEDCBA9876543210", "%llX", 0xfedcba9876543210ULL));
 
 	/*
 	 * %l is deprecated on 32-bit systems (see crbug.com/984041), but is
@@ -222,6 +247,9 @@ test_static int test_vsnprintf_pointers(void)
 	val = 0x5E;
 	T(expect_success("1011110",   "%pb",     BINARY_VALUE(val, 0)));
 	T(expect_success("0000000001011110", "%pb", BINARY_VALUE(val, 16)));
+	/* Fixed point digits are decimal, the rest is binary */
+	T(expect_success("1001.4",    "%.1pb",   BINARY_VALUE(val, 0)));
+	T(expect_success("0.094",     "%.3pb",   BINARY_VALUE(val, 0)));
 	val = 0x12345678;
 	T(expect_success("10010001101000101011001111000", "%pb",
 			 BINARY_VALUE(val, 0)));
@@ -280,13 +308,44 @@ test_static int test_vsnprintf_timestamps(void)
 	return EC_SUCCESS;
 }
 
+test_static int test_snprintf_timestamp(void)
+{
+	char buf[PRINTF_TIMESTAMP_BUF_SIZE];
+	char expect[PRINTF_TIMESTAMP_BUF_SIZE];
+	static const uint64_t stamps[] = {
+		0, 123456, 9999999000000, 0xffffffff, (uint64_t)-1,
+	};
+	int i;
+
+	/* Matches "%pT" for any timestamp, including the longest */
+	for (i = 0; i < ARRAY_SIZE(stamps); i++) {
+		TEST_ASSERT(snprintf(expect, sizeof(expect), "%pT",
+				     &stamps[i]) > 0);
+		TEST_EQ(snprintf_timestamp(buf, sizeof(buf), stamps[i]),
+			(int)strlen(expect), "%d");
+		TEST_ASSERT_ARRAY_EQ(buf, expect, strlen(expect) + 1);
+	}
+
+	TEST_EQ(snprintf_timestamp(buf, 4, 123456), -EC_ERROR_OVERFLOW, "%d");
+	TEST_ASSERT_ARRAY_EQ(buf, "0.1", 4);
+	TEST_EQ(snprintf_timestamp(buf, 0, 123456), -EC_ERROR_INVAL, "%d");
+
+	return EC_SUCCESS;
+}
+
 test_static int test_vsnprintf_hexdump(void)
 {
 	const char bytes[] = {0x00, 0x5E};
+	const char long_bytes[] = {
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+		0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x00, 0x11,
+	};
 
 	T(expect_success("005e",      "%ph",      HEX_BUF(bytes, 2)));
 	T(expect_success("",          "%ph",      HEX_BUF(bytes, 0)));
 	T(expect_success("00",        "%ph",      HEX_BUF(bytes, 1)));
+	T(expect_success("00112233445566778899aabbccddeeff0011",
+			 "%ph",      HEX_BUF(long_bytes, 18)));
 	return EC_SUCCESS;
 }
 
@@ -294,6 +353,54 @@ test_static int test_vsnprintf_combined(void)
 {
 	T(expect_success("abc",       "%c%s",    'a', "bc"));
 	T(expect_success("12\tbc",    "%d\t%s",  12, "bc"));
+	T(expect_success("a%b%%c",    "a%%b%%%%c"));
+	T(expect_success("x=5ERROR",  "x=%d%q y=%d", 5, 6));
+
+	/* Output is cut at the size limit, partway through a run */
+	T(expect(EC_ERROR_OVERFLOW, "PD C0 src ca",
+		 false, 13, "PD C0 src cap %d", 5));
+	T(expect(EC_ERROR_OVERFLOW, "v=   ",
+		 false, 6, "v=%8d", 5));
+	return EC_SUCCESS;
+}
+
+/*
+ * Benchmark the formatter on lines like the ones the EC logs most, so that
+ * logging stays cheap enough for hot paths.
+ */
+static void time_format(const char *name, const char *format, ...)
+{
+	const int iterations = 20000;
+	char buf[128];
+	timestamp_t t0, t1;
+	va_list args;
+	int i;
+
+	t0 = test_get_wall_time();
+	for (i = 0; i < iterations; i++) {
+		va_start(args, format);
+		vsnprintf(buf, sizeof(buf), format, args);
+		va_end(args);
+	}
+	t1 = test_get_wall_time();
+
+	ccprintf("%-10s %5d ns/call: %s\n", name,
+		 (int)((t1.val - t0.val) * 1000 / iterations), buf);
+}
+
+test_static int test_vsnprintf_speed(void)
+{
+	uint64_t ts = 123456789012ULL;
+
+	time_format("timestamp", "[%pT ", &ts);
+	time_format("literal", "USB charge port %d: supplier changed\n", 1);
+	time_format("ints", "C%d: %d mV %d mA, max %d mW",
+		    1, 20000, 3250, 65000);
+	time_format("hex", "reg 0x%02x = 0x%08x", 0x1c, 0xdeadbeef);
+	time_format("64-bit", "%lld bytes in %lld us",
+		    0x123456789aLL, 987654321LL);
+	time_format("padded", "%-16s|%8d|%-8s|", "battery", 42, "ok");
+
 	return EC_SUCCESS;
 }
 
@@ -307,8 +414,10 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_vsnprintf_chars);
 	RUN_TEST(test_vsnprintf_strings);
 	RUN_TEST(test_vsnprintf_timestamps);
+	RUN_TEST(test_snprintf_timestamp);
 	RUN_TEST(test_vsnprintf_hexdump);
 	RUN_TEST(test_vsnprintf_combined);
+	RUN_TEST(test_vsnprintf_speed);
 
 	test_print_result();
 }
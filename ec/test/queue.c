@@ -16,6 +16,14 @@
 static struct queue const test_queue8 = QUEUE_NULL(8, char);
 static struct queue const test_queue2 = QUEUE_NULL(2, int16_t);
 
+struct unit16 {
+	uint8_t data[16];
+};
+
+static struct queue const bench_queue1 = QUEUE_NULL(256, uint8_t);
+static struct queue const bench_queue4 = QUEUE_NULL(256, uint32_t);
+static struct queue const bench_queue16 = QUEUE_NULL(256, struct unit16);
+
 static int test_queue8_empty(void)
 {
 	char tmp = 1;
@@ -410,6 +418,189 @@ static int test_queue8_iterate_next_reset_on_change(void)
 	return EC_SUCCESS;
 }
 
+static int test_queue8_chunk_pair(void)
+{
+	static uint8_t const data[3] = {1, 2, 3};
+	struct queue_chunk_pair chunks;
+
+	/* Move near the end of the queue and wrap the tail */
+	TEST_ASSERT(queue_advance_tail(&test_queue8, 6) == 6);
+	TEST_ASSERT(queue_advance_head(&test_queue8, 6) == 6);
+	TEST_ASSERT(queue_add_units(&test_queue8, data, 3) == 3);
+
+	/* Both read segments are returned at once */
+	chunks = queue_get_read_chunks(&test_queue8);
+	TEST_ASSERT(chunks.chunk[0].count == 2);
+	TEST_ASSERT(chunks.chunk[0].buffer == test_queue8.buffer + 6);
+	TEST_ASSERT(chunks.chunk[1].count == 1);
+	TEST_ASSERT(chunks.chunk[1].buffer == test_queue8.buffer);
+	TEST_ASSERT_ARRAY_EQ((uint8_t *)chunks.chunk[0].buffer, data, 2);
+	TEST_ASSERT(((uint8_t *)chunks.chunk[1].buffer)[0] == 3);
+
+	/* The free space does not wrap */
+	chunks = queue_get_write_chunks(&test_queue8);
+	TEST_ASSERT(chunks.chunk[0].count == 5);
+	TEST_ASSERT(chunks.chunk[0].buffer == test_queue8.buffer + 1);
+	TEST_ASSERT(chunks.chunk[1].count == 0);
+
+	/* Once the data is read, the free space wraps */
+	TEST_ASSERT(queue_advance_head(&test_queue8, 3) == 3);
+	chunks = queue_get_write_chunks(&test_queue8);
+	TEST_ASSERT(chunks.chunk[0].count == 7);
+	TEST_ASSERT(chunks.chunk[1].count == 1);
+	chunks = queue_get_read_chunks(&test_queue8);
+	TEST_ASSERT(chunks.chunk[0].count == 0);
+	TEST_ASSERT(chunks.chunk[1].count == 0);
+
+	return EC_SUCCESS;
+}
+
+struct copy_ctx {
+	uint8_t *ptr;
+	size_t limit;
+};
+
+static size_t produce_copy(void *ctx, void *dest, size_t count)
+{
+	struct copy_ctx *c = ctx;
+
+	count = MIN(count, c->limit);
+	memcpy(dest, c->ptr, count);
+	c->ptr += count;
+	c->limit -= count;
+	return count;
+}
+
+static size_t consume_copy(void *ctx, const void *src, size_t count)
+{
+	struct copy_ctx *c = ctx;
+
+	count = MIN(count, c->limit);
+	memcpy(c->ptr, src, count);
+	c->ptr += count;
+	c->limit -= count;
+	return count;
+}
+
+static int test_queue8_in_place(void)
+{
+	static uint8_t const data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	uint8_t out[8];
+	struct copy_ctx ctx;
+
+	/* Start in the middle so the transfers wrap */
+	TEST_ASSERT(queue_advance_tail(&test_queue8, 5) == 5);
+	TEST_ASSERT(queue_advance_head(&test_queue8, 5) == 5);
+
+	ctx.ptr = (uint8_t *)data;
+	ctx.limit = sizeof(data);
+	TEST_ASSERT(queue_add_in_place(&test_queue8, 6, produce_copy,
+				       &ctx) == 6);
+	TEST_ASSERT(queue_count(&test_queue8) == 6);
+
+	/* A producer that stops early only adds what it wrote */
+	ctx.limit = 1;
+	TEST_ASSERT(queue_add_in_place(&test_queue8, 2, produce_copy,
+				       &ctx) == 1);
+	TEST_ASSERT(queue_count(&test_queue8) == 7);
+
+	/* Same for a consumer */
+	ctx.ptr = out;
+	ctx.limit = 4;
+	TEST_ASSERT(queue_remove_in_place(&test_queue8, 8, consume_copy,
+					  &ctx) == 4);
+	ctx.limit = sizeof(out);
+	TEST_ASSERT(queue_remove_in_place(&test_queue8, 8, consume_copy,
+					  &ctx) == 3);
+	TEST_ASSERT_ARRAY_EQ(out, data, 7);
+	TEST_ASSERT(queue_is_empty(&test_queue8));
+
+	return EC_SUCCESS;
+}
+
+#define BENCH_BYTES (1024 * 1024)
+#define BENCH_BURST 64
+
+static uint8_t bench_src[BENCH_BURST * sizeof(struct unit16)];
+static uint8_t bench_staging[BENCH_BURST * sizeof(struct unit16)];
+static uint32_t bench_sum;
+
+static void checksum(const void *data, size_t bytes)
+{
+	const uint8_t *p = data;
+
+	while (bytes--)
+		bench_sum += *p++;
+}
+
+static size_t produce_bench(void *ctx, void *dest, size_t count)
+{
+	struct queue const *q = ctx;
+
+	memcpy(dest, bench_src, count * q->unit_bytes);
+	return count;
+}
+
+static size_t consume_bench(void *ctx, const void *src, size_t count)
+{
+	struct queue const *q = ctx;
+
+	checksum(src, count * q->unit_bytes);
+	return count;
+}
+
+/*
+ * Stream BENCH_BYTES through a queue in bursts, checksumming what comes out,
+ * one unit at a time, through a staging buffer, and directly from the queue.
+ */
+static void bench_queue(struct queue const *q)
+{
+	size_t units = BENCH_BYTES / q->unit_bytes;
+	timestamp_t t0, t1, t2, t3;
+	size_t i, j;
+
+	queue_init(q);
+
+	t0 = test_get_wall_time();
+	for (i = 0; i < units; i += BENCH_BURST) {
+		for (j = 0; j < BENCH_BURST; j++)
+			queue_add_unit(q, bench_src + j * q->unit_bytes);
+		for (j = 0; j < BENCH_BURST; j++) {
+			queue_remove_unit(q, bench_staging);
+			checksum(bench_staging, q->unit_bytes);
+		}
+	}
+
+	t1 = test_get_wall_time();
+	for (i = 0; i < units; i += BENCH_BURST) {
+		queue_add_units(q, bench_src, BENCH_BURST);
+		queue_remove_units(q, bench_staging, BENCH_BURST);
+		checksum(bench_staging, BENCH_BURST * q->unit_bytes);
+	}
+
+	t2 = test_get_wall_time();
+	for (i = 0; i < units; i += BENCH_BURST) {
+		queue_add_in_place(q, BENCH_BURST, produce_bench, (void *)q);
+		queue_remove_in_place(q, BENCH_BURST, consume_bench, (void *)q);
+	}
+	t3 = test_get_wall_time();
+
+	ccprintf("%2d-byte units: unit %lld us, memcpy %lld us, "
+		 "direct %lld us\n", (int)q->unit_bytes,
+		 (long long)(t1.val - t0.val), (long long)(t2.val - t1.val),
+		 (long long)(t3.val - t2.val));
+}
+
+static int test_queue_throughput(void)
+{
+	/* do not check result, just as a benchmark */
+	bench_queue(&bench_queue1);
+	bench_queue(&bench_queue4);
+	bench_queue(&bench_queue16);
+
+	return EC_SUCCESS;
+}
+
 void before_test(void)
 {
 	queue_init(&test_queue2);
@@ -437,6 +628,9 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_queue8_iterate_next);
 	RUN_TEST(test_queue2_iterate_next_full);
 	RUN_TEST(test_queue8_iterate_next_reset_on_change);
+	RUN_TEST(test_queue8_chunk_pair);
+	RUN_TEST(test_queue8_in_place);
+	RUN_TEST(test_queue_throughput);
 
 	test_print_result();
 }
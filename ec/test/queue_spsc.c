@@ -0,0 +1,209 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Stress test single producer, single consumer queues between an interrupt
+ * handler and a task, without masking interrupts on either side.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "queue.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+/* Units carry a check word, so that torn or stale reads are caught too */
+struct spsc_unit {
+	uint32_t seq;
+	uint32_t check;
+};
+
+#define SPSC_CHECK(seq) ((seq) ^ 0xa5a5a5a5)
+
+/* Small, so that both sides keep wrapping and hitting full/empty */
+static struct queue const spsc_queue = QUEUE_SPSC_NULL(16, struct spsc_unit);
+
+#define TOTAL_UNITS 100000
+
+enum spsc_mode {
+	SPSC_IDLE,
+	SPSC_ISR_PRODUCES,
+	SPSC_ISR_CONSUMES,
+};
+
+static volatile enum spsc_mode mode;
+
+/*
+ * Units moved so far; each is only updated by its own side of the queue, the
+ * task polls both to know when it is done.
+ */
+static volatile uint32_t produced;
+static volatile uint32_t consumed;
+static volatile int has_error;
+static int isr_count;
+
+/* Direct access callbacks; ctx points at the sequence number of dest/src */
+static size_t fill_units(void *ctx, void *dest, size_t count)
+{
+	uint32_t *seq = ctx;
+	struct spsc_unit *unit = dest;
+	size_t i;
+
+	for (i = 0; i < count; i++, unit++, (*seq)++) {
+		unit->seq = *seq;
+		unit->check = SPSC_CHECK(*seq);
+	}
+
+	return count;
+}
+
+static size_t check_units(void *ctx, const void *src, size_t count)
+{
+	uint32_t *seq = ctx;
+	const struct spsc_unit *unit = src;
+	size_t i;
+
+	for (i = 0; i < count; i++, unit++, (*seq)++)
+		if (unit->seq != *seq || unit->check != SPSC_CHECK(*seq))
+			has_error = 1;
+
+	return count;
+}
+
+/*
+ * Move up to count units in or out, rotating through the single unit, bulk
+ * copy and direct access paths so that all of them race against the other
+ * side.
+ */
+static void produce(int count, int path)
+{
+	struct spsc_unit units[8];
+	uint32_t seq = produced;
+
+	count = MIN(count, TOTAL_UNITS - produced);
+	if (!count)
+		return;
+
+	switch (path % 3) {
+	case 0:
+		fill_units(&seq, units, 1);
+		produced += queue_add_unit(&spsc_queue, units);
+		break;
+	case 1:
+		count = MIN(count, ARRAY_SIZE(units));
+		fill_units(&seq, units, count);
+		produced += queue_add_units(&spsc_queue, units, count);
+		break;
+	default:
+		produced += queue_add_in_place(&spsc_queue, count,
+					       fill_units, &seq);
+		break;
+	}
+}
+
+static void consume(int count, int path)
+{
+	struct spsc_unit units[8];
+	uint32_t seq = consumed;
+	size_t removed;
+
+	switch (path % 3) {
+	case 0:
+		removed = queue_remove_unit(&spsc_queue, units);
+		check_units(&seq, units, removed);
+		break;
+	case 1:
+		count = MIN(count, ARRAY_SIZE(units));
+		removed = queue_remove_units(&spsc_queue, units, count);
+		check_units(&seq, units, removed);
+		break;
+	default:
+		removed = queue_remove_in_place(&spsc_queue, count,
+						check_units, &seq);
+		break;
+	}
+
+	consumed += removed;
+}
+
+static void spsc_isr(void)
+{
+	int r = prng_no_seed();
+
+	isr_count++;
+
+	if (mode == SPSC_ISR_PRODUCES)
+		produce((r & 7) + 1, r >> 3);
+	else if (mode == SPSC_ISR_CONSUMES)
+		consume((r & 7) + 1, r >> 3);
+}
+
+void interrupt_generator(void)
+{
+	while (1) {
+		udelay(prng_no_seed() % 20 + 1);
+		task_trigger_test_interrupt(spsc_isr);
+	}
+}
+
+/* Run the task side until every unit has gone through the queue */
+static int run_stress(enum spsc_mode isr_mode)
+{
+	timestamp_t deadline = get_time();
+	uint32_t i = 0;
+
+	deadline.val += 100 * SECOND;
+	isr_count = 0;
+	mode = isr_mode;
+
+	while (consumed < TOTAL_UNITS && !has_error &&
+	       !timestamp_expired(deadline, NULL)) {
+		if (isr_mode == SPSC_ISR_PRODUCES)
+			consume(i % 8 + 1, i);
+		else if (produced < TOTAL_UNITS)
+			produce(i % 8 + 1, i);
+		i++;
+	}
+
+	mode = SPSC_IDLE;
+
+	ccprintf("%d units, %d interrupts\n", consumed, isr_count);
+
+	TEST_ASSERT(!has_error);
+	TEST_EQ(produced, TOTAL_UNITS, "%d");
+	TEST_EQ(consumed, TOTAL_UNITS, "%d");
+	TEST_ASSERT(queue_is_empty(&spsc_queue));
+
+	return EC_SUCCESS;
+}
+
+static int test_isr_to_task(void)
+{
+	return run_stress(SPSC_ISR_PRODUCES);
+}
+
+static int test_task_to_isr(void)
+{
+	return run_stress(SPSC_ISR_CONSUMES);
+}
+
+void before_test(void)
+{
+	mode = SPSC_IDLE;
+	queue_init(&spsc_queue);
+	produced = 0;
+	consumed = 0;
+	has_error = 0;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_isr_to_task);
+	RUN_TEST(test_task_to_isr);
+
+	test_print_result();
+}
@@ -9,20 +9,46 @@
 #include "common.h"
 #include "rsa.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
-#ifdef TEST_RSA3
+#ifdef CONFIG_RSA_EXPONENT_3
+#define RSA_EXPONENT "3"
 #if CONFIG_RSA_KEY_SIZE == 3072
 #include "rsa3072-3.h"
 #else
 #include "rsa2048-3.h"
 #endif
 #else
+#define RSA_EXPONENT "F4"
+#if CONFIG_RSA_KEY_SIZE == 3072
+#include "rsa3072-F4.h"
+#else
 #include "rsa2048-F4.h"
 #endif
+#endif
+
+#define BENCHMARK_ROUNDS 100
 
 static uint32_t rsa_workbuf[3 * RSANUMBYTES/4];
 
+static void benchmark(void)
+{
+	timestamp_t t0, t1;
+	int i;
+
+	t0 = test_get_wall_time();
+	for (i = 0; i < BENCHMARK_ROUNDS; i++)
+		/* do not check result, just as a benchmark */
+		rsa_verify(rsa_key, sig, hash, rsa_workbuf);
+	t1 = test_get_wall_time();
+
+	ccprintf("RSA-%d exponent %s%s: %d us/verify\n", CONFIG_RSA_KEY_SIZE,
+		 RSA_EXPONENT, IS_ENABLED(CONFIG_RSA_OPTIMIZED) ?
+		 " (optimized)" : "",
+		 (int)((t1.val - t0.val) / BENCHMARK_ROUNDS));
+}
+
 void run_test(int argc, char **argv)
 {
 	int good;
@@ -53,6 +79,8 @@ void run_test(int argc, char **argv)
 	}
 	ccprintf("RSA verify FAILED (as expected)\n");
 
+	benchmark();
+
 	test_pass();
 }
 
@@ -0,0 +1,140 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * RSA 3072 with F4 exponent public key and verification.
+ * Private key in rsa3072-F4.pem.
+ */
+
+/* First generate a key:
+ * # openssl genrsa -out key.pem 3072
+ * # openssl rsa -in key.pem -pubout > key.pub
+ * Then dump the key: sudo emerge vboot_reference
+ * # /usr/bin/dumpRSAPublicKey -pub key.pub | xxd -i
+ */
+const uint8_t rsa_data[] = {
+	0x60, 0x00, 0x00, 0x00, 0x8f, 0x31, 0x0a, 0xb8, 0x91, 0x32, 0xb4, 0x54,
+	0xe0, 0x2f, 0xe7, 0xed, 0x57, 0x27, 0xbf, 0xeb, 0x85, 0x8e, 0x5a, 0x26,
+	0x28, 0x98, 0xa7, 0xf5, 0x20, 0xb3, 0xd1, 0x8f, 0xc6, 0x87, 0xd7, 0x07,
+	0x63, 0x09, 0xac, 0xf9, 0xf5, 0x7e, 0xd3, 0x31, 0xae, 0x52, 0x1a, 0x11,
+	0xda, 0xbc, 0x2a, 0x77, 0xc0, 0xa9, 0x21, 0xec, 0x9b, 0xb3, 0x4d, 0x26,
+	0x88, 0x52, 0x61, 0x1d, 0x1f, 0x87, 0x02, 0x99, 0xb6, 0x2b, 0xce, 0x9a,
+	0x89, 0xb4, 0x61, 0x56, 0xca, 0x6b, 0xf2, 0x2e, 0x51, 0xc5, 0x96, 0x14,
+	0x0c, 0x9c, 0xe3, 0x77, 0x4b, 0x37, 0xdb, 0xf1, 0xd5, 0xf7, 0x9c, 0x98,
+	0x56, 0xd4, 0x7c, 0xf0, 0x28, 0x6d, 0x12, 0x49, 0xff, 0x7a, 0x1c, 0xf7,
+	0x15, 0x00, 0x75, 0xf9, 0xa9, 0x6e, 0x3d, 0xe5, 0x20, 0xbe, 0x72, 0x27,
+	0x7d, 0xb1, 0xf6, 0x9d, 0x0f, 0xa4, 0xa2, 0x50, 0x50, 0x6f, 0x4b, 0x31,
+	0x7b, 0x78, 0xbc, 0x5a, 0xb4, 0xe5, 0x3f, 0x03, 0xe6, 0xa9, 0x0b, 0x37,
+	0x32, 0x9c, 0x14, 0x53, 0x5c, 0x05, 0x75, 0x11, 0xf9, 0x70, 0xab, 0x30,
+	0x79, 0x28, 0xb8, 0x5a, 0xd5, 0x3f, 0x89, 0xe5, 0xe3, 0xcb, 0x36, 0x53,
+	0xaf, 0x20, 0x56, 0xb8, 0x70, 0xfa, 0xec, 0x73, 0xb8, 0xdf, 0x36, 0x8f,
+	0xbc, 0xa2, 0xf2, 0x6a, 0x65, 0xaa, 0x5e, 0x5a, 0x8b, 0xba, 0x19, 0xee,
+	0x2c, 0xa9, 0x60, 0xd2, 0x83, 0x0d, 0x1c, 0xfe, 0xf8, 0xb4, 0xe0, 0x96,
+	0x1d, 0x83, 0x2a, 0x6a, 0x03, 0x0a, 0x1a, 0x98, 0xf1, 0x30, 0x8c, 0xbf,
+	0x4b, 0xd8, 0xbd, 0x4e, 0xe3, 0xac, 0x88, 0x70, 0x49, 0x21, 0xb7, 0xf9,
+	0xfd, 0xdc, 0x37, 0x36, 0x67, 0x8b, 0x84, 0x87, 0x33, 0x84, 0x64, 0xd5,
+	0x1a, 0x87, 0xb2, 0xd2, 0xb2, 0x67, 0xd5, 0x78, 0x27, 0xf5, 0x76, 0xc7,
+	0xd5, 0xfe, 0x1f, 0x56, 0xe4, 0x49, 0xbc, 0x86, 0x17, 0x88, 0x3e, 0x66,
+	0xbd, 0xaf, 0x3c, 0xca, 0x90, 0xf7, 0x77, 0x28, 0xe5, 0xd6, 0x4f, 0x56,
+	0xbd, 0xdd, 0xe2, 0x14, 0x36, 0xa7, 0x04, 0x1e, 0xd7, 0xbf, 0xec, 0x59,
+	0x47, 0xa6, 0x8e, 0xe2, 0xbc, 0xf2, 0x49, 0x15, 0x4d, 0x52, 0xf9, 0xa3,
+	0x45, 0x16, 0xdb, 0xe7, 0x81, 0xc3, 0xe0, 0x83, 0x00, 0x03, 0x22, 0x21,
+	0x80, 0xd5, 0x09, 0xcc, 0x25, 0x8f, 0xd5, 0x61, 0x98, 0x66, 0x10, 0x3e,
+	0xbb, 0xd4, 0x3c, 0x81, 0xae, 0x73, 0x57, 0x0c, 0xa1, 0xd8, 0xfd, 0xed,
+	0x6d, 0x4b, 0x5f, 0x8d, 0x90, 0xb8, 0xf7, 0x6f, 0x6a, 0x7b, 0xf0, 0x36,
+	0x95, 0x73, 0xcf, 0xa8, 0x12, 0xbc, 0x1c, 0xf8, 0x99, 0x38, 0xc4, 0xc6,
+	0x95, 0x52, 0xb9, 0x55, 0x48, 0x88, 0x31, 0x13, 0x6d, 0xe3, 0x5f, 0xe0,
+	0x59, 0x3c, 0x3b, 0x79, 0xfd, 0x5b, 0x90, 0x46, 0x73, 0x0b, 0x2a, 0x85,
+	0xc8, 0x6b, 0x28, 0x6b, 0x7e, 0xaa, 0x4d, 0xae, 0x03, 0x49, 0xd2, 0x32,
+	0x90, 0x54, 0x44, 0x86, 0x30, 0xb2, 0x9d, 0xaf, 0x64, 0x52, 0x9e, 0xf6,
+	0xf6, 0x02, 0xba, 0x5d, 0xe1, 0x37, 0x37, 0xa0, 0xd9, 0x1f, 0x6a, 0xc5,
+	0xa0, 0xeb, 0xdb, 0x1e, 0x09, 0x4a, 0xdd, 0x7b, 0xbd, 0x5e, 0x6d, 0xac,
+	0x5f, 0xfb, 0xea, 0x4d, 0x49, 0xd8, 0x61, 0x61, 0xd8, 0x1a, 0xc4, 0xdc,
+	0x47, 0xc3, 0x8b, 0x59, 0x9e, 0x63, 0x55, 0x7d, 0x1b, 0xc2, 0xb6, 0x00,
+	0x78, 0x09, 0xf8, 0x03, 0x0c, 0x68, 0x68, 0x6f, 0x06, 0x94, 0xe2, 0xf6,
+	0x00, 0xa2, 0x18, 0x19, 0x0a, 0x3b, 0x42, 0x3e, 0x40, 0x71, 0x84, 0x59,
+	0x29, 0xe3, 0x28, 0x43, 0x88, 0x74, 0xe8, 0x83, 0x83, 0x51, 0x77, 0x6c,
+	0x7f, 0x67, 0x4f, 0x6a, 0x5b, 0x7d, 0xa0, 0x22, 0xda, 0x9f, 0x92, 0x6f,
+	0x17, 0x31, 0xbe, 0xbf, 0x23, 0xa4, 0xa4, 0x7b, 0xb3, 0xa6, 0xc9, 0x83,
+	0xde, 0xfe, 0x7d, 0xe6, 0x33, 0xfe, 0x7f, 0xa1, 0x54, 0xc4, 0x1e, 0x7e,
+	0xa8, 0xde, 0x2c, 0x3c, 0x1e, 0x8d, 0xfb, 0x7c, 0x65, 0x35, 0xec, 0xca,
+	0xef, 0x33, 0xd9, 0xc8, 0xc9, 0x8a, 0x5a, 0x48, 0x57, 0xec, 0xa1, 0xb0,
+	0xf4, 0xac, 0x2f, 0x5f, 0xd1, 0x62, 0x7c, 0x77, 0x74, 0x66, 0x9e, 0x7d,
+	0x1b, 0xaf, 0x91, 0x64, 0x30, 0x61, 0x9b, 0x7d, 0xd1, 0xe6, 0x97, 0x86,
+	0xa4, 0xef, 0xd1, 0x8e, 0xde, 0x0d, 0xcf, 0x0b, 0xdd, 0xa5, 0x5e, 0x51,
+	0xf1, 0x48, 0xca, 0xbb, 0xb4, 0xc5, 0x1a, 0x65, 0x9f, 0x3e, 0x61, 0x10,
+	0xd6, 0xe5, 0x37, 0x1f, 0xe6, 0xa1, 0x60, 0x02, 0xe3, 0xae, 0x6d, 0xfd,
+	0xc5, 0xb0, 0x6b, 0x3c, 0xd4, 0xaa, 0x69, 0xf1, 0xa2, 0xa2, 0x6b, 0xb3,
+	0x66, 0x8e, 0x5f, 0x5f, 0x11, 0x05, 0x17, 0x6c, 0x68, 0x0c, 0x93, 0xb7,
+	0x09, 0xd6, 0xe3, 0xeb, 0x1d, 0x50, 0x7a, 0x1e, 0x9e, 0xdd, 0xc0, 0x97,
+	0x8f, 0xf8, 0x87, 0x61, 0x58, 0xa1, 0x87, 0xf1, 0x5b, 0x4e, 0x42, 0xcb,
+	0x40, 0xda, 0x76, 0x8e, 0x41, 0x78, 0xc3, 0xf0, 0x81, 0x0b, 0x4a, 0xfb,
+	0xdf, 0xce, 0xa1, 0x6d, 0x8c, 0xd6, 0xce, 0xbd, 0x25, 0x6e, 0xa4, 0x7d,
+	0x55, 0xbc, 0x73, 0xb3, 0x96, 0x8d, 0x70, 0xf2, 0x16, 0x3d, 0xc4, 0x0f,
+	0xcc, 0x71, 0xf4, 0x49, 0x63, 0x74, 0x3b, 0x09, 0xa8, 0xe0, 0xa4, 0x0a,
+	0xb0, 0xf0, 0x77, 0xc8, 0x8b, 0x3d, 0xa0, 0x80, 0x8e, 0xcd, 0xd9, 0x63,
+	0x9d, 0x58, 0x07, 0xd4, 0x69, 0x04, 0xfd, 0x20, 0x1d, 0x67, 0x30, 0x19,
+	0x07, 0xfe, 0x8f, 0x48, 0x88, 0x17, 0xba, 0x65, 0x1a, 0x58, 0x5a, 0x56,
+	0x29, 0x2d, 0x19, 0xe3, 0x01, 0x7c, 0x51, 0x33, 0x56, 0x4e, 0x4d, 0xec,
+	0x5c, 0x26, 0x7e, 0x47, 0x78, 0xed, 0xa8, 0xfb, 0xf9, 0x6f, 0xe8, 0x23,
+	0xa7, 0xf2, 0xfe, 0x1e, 0xb2, 0x15, 0x7a, 0x78,
+};
+
+const struct rsa_public_key *rsa_key = (struct rsa_public_key *)rsa_data;
+BUILD_ASSERT(sizeof(*rsa_key) == sizeof(rsa_data));
+
+/* SHA-256 sum to verify:
+ * # sha256sum README.md | sed -e 's/\(..\)/0x\1, /mg'
+ */
+const uint8_t hash[] = {
+	0xc7, 0xc3, 0xd0, 0xa3, 0x7e, 0xbd, 0x50, 0xe8, 0x3c, 0xb3, 0x5b, 0xed,
+	0x02, 0xf9, 0x8f, 0x97, 0xf8, 0xb5, 0x23, 0x43, 0x74, 0xda, 0x0a, 0x24,
+	0xdb, 0x04, 0xe4, 0x1e, 0xbd, 0x43, 0x02, 0xdc
+};
+
+/* Incorrect hash to test the negative case */
+const uint8_t hash_wrong[] = {
+	0x61, 0x1b, 0xd2, 0x44, 0xc7, 0x18, 0xa7, 0x2d, 0x0f, 0x2d, 0x3d, 0x0f,
+	0xe3, 0xb3, 0xc5, 0xe4, 0x12, 0xc2, 0x7b, 0x1e, 0x05, 0x2c, 0x6f, 0xad,
+	0xc4, 0xac, 0x71, 0x55, 0xe8, 0x80, 0x5c, 0x38
+};
+
+/* Generate signature using openssl:
+ * openssl dgst -sha256 -sign test/rsa3072-F4.pem README.md | xxd -i
+ */
+const uint8_t sig[] = {
+	0x45, 0x79, 0xed, 0x89, 0x19, 0x1c, 0x42, 0x0d, 0x3f, 0xbc, 0xfa, 0xc1,
+	0xa9, 0xd9, 0xd7, 0x35, 0x12, 0x2c, 0xe1, 0x89, 0xaf, 0x24, 0x0f, 0x82,
+	0xbc, 0x70, 0x8b, 0xaf, 0x5d, 0xee, 0x02, 0x41, 0xae, 0x3e, 0xe5, 0x8e,
+	0xbe, 0x3e, 0xe0, 0xea, 0x31, 0xec, 0xb5, 0x09, 0xc5, 0xe6, 0xe9, 0xd8,
+	0xb3, 0x03, 0x99, 0x42, 0x13, 0x65, 0x15, 0x25, 0xcf, 0x50, 0x95, 0x3c,
+	0xf3, 0x78, 0x81, 0xee, 0xbf, 0x76, 0xf5, 0x0b, 0x7e, 0xcf, 0xc3, 0xf7,
+	0x60, 0xc9, 0x8b, 0xf9, 0x57, 0x8e, 0x1c, 0xdb, 0x3f, 0xc4, 0xbe, 0x48,
+	0x5e, 0x52, 0xcf, 0xe2, 0xa3, 0xae, 0xad, 0xa6, 0x87, 0xb2, 0xcf, 0xd7,
+	0xbc, 0x31, 0xa9, 0x97, 0xbe, 0xa8, 0xfa, 0xee, 0x65, 0xe5, 0xcd, 0x54,
+	0x35, 0x6d, 0x9b, 0x34, 0x98, 0x74, 0xc5, 0x8a, 0x31, 0x95, 0xbe, 0x70,
+	0x10, 0x7e, 0xe4, 0x4d, 0x0e, 0xee, 0x03, 0x5b, 0x6d, 0xa9, 0xef, 0xf0,
+	0xd6, 0x7a, 0x9f, 0x1b, 0xa1, 0x72, 0x4b, 0x90, 0xc8, 0xdc, 0x16, 0x44,
+	0x86, 0x73, 0x56, 0x2b, 0x91, 0x38, 0x4e, 0x62, 0x4b, 0x7a, 0x53, 0xbc,
+	0x3d, 0x5a, 0xdb, 0xa8, 0xe4, 0xd9, 0x01, 0xff, 0x4c, 0x71, 0xbb, 0xa9,
+	0x04, 0x37, 0x5e, 0xba, 0xae, 0x30, 0x2e, 0x79, 0xd9, 0x4b, 0x1e, 0x22,
+	0xa3, 0x86, 0xeb, 0x37, 0x47, 0x82, 0x55, 0x61, 0xb0, 0x6f, 0xe4, 0x27,
+	0xe1, 0x86, 0xf7, 0x84, 0x1d, 0xbc, 0x59, 0xc9, 0xfd, 0x40, 0xd2, 0xde,
+	0xf7, 0xa1, 0x14, 0xc9, 0xd5, 0x0f, 0xaf, 0xfb, 0x8b, 0xfb, 0xa2, 0x2f,
+	0xb8, 0xde, 0xa5, 0x14, 0x49, 0x38, 0x5f, 0x1a, 0x85, 0xf7, 0x90, 0xea,
+	0x92, 0x27, 0x43, 0x18, 0x43, 0x89, 0x02, 0x79, 0x4c, 0x10, 0x70, 0x12,
+	0x25, 0xdb, 0x75, 0x07, 0x5f, 0xf7, 0x5d, 0xad, 0x8c, 0x9f, 0x33, 0x79,
+	0xf6, 0x41, 0xd3, 0x1f, 0xc5, 0xb2, 0x94, 0xda, 0x5e, 0x83, 0x02, 0xcb,
+	0x5a, 0x30, 0x77, 0xe9, 0x38, 0xb3, 0xce, 0x20, 0x94, 0x7d, 0xbb, 0xd6,
+	0x01, 0xdc, 0xb2, 0xc0, 0x42, 0xb5, 0xa0, 0x3a, 0x90, 0x80, 0x23, 0xbb,
+	0x4a, 0x95, 0x6d, 0xb5, 0x00, 0xc9, 0xef, 0x35, 0xac, 0xdf, 0x5d, 0xce,
+	0xe1, 0xba, 0xc2, 0x59, 0xd6, 0xfc, 0x07, 0x87, 0x76, 0x2e, 0xe5, 0xaa,
+	0x1b, 0x46, 0xfb, 0xa9, 0xeb, 0x48, 0xfe, 0xaa, 0x0a, 0x66, 0xb8, 0x0e,
+	0x6e, 0x84, 0x94, 0x9a, 0x92, 0x04, 0x94, 0x9c, 0xad, 0xaf, 0x6c, 0xfb,
+	0x4c, 0x12, 0x1a, 0x6b, 0xae, 0x22, 0xad, 0xc0, 0xd9, 0xe8, 0xfb, 0xfe,
+	0xcf, 0x81, 0xb6, 0x47, 0xe0, 0xba, 0x78, 0xe7, 0x13, 0xaf, 0x48, 0x8b,
+	0x3d, 0x3f, 0x69, 0x85, 0x55, 0x53, 0xe0, 0xb7, 0x8f, 0x39, 0xd5, 0x06,
+	0x5a, 0xaa, 0x9f, 0xac, 0x2a, 0x2a, 0x54, 0x59, 0x73, 0xda, 0x77, 0xe5,
+	/* Padding */
+	0x00
+};
@@ -8,8 +8,11 @@
 #include "console.h"
 #include "common.h"
 #include "sha256.h"
+#include "system.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
+#include "vboot_hash.h"
 
 /* Short Msg from NIST FIPS 180-4 (Len = 8) */
 static const uint8_t sha256_8_input[] = {
@@ -172,6 +175,67 @@ static int test_hmac(const uint8_t *key, int key_len,
 	return 1;
 }
 
+#if defined(CONFIG_SHA256_X86_SHA_NI)
+#define SHA256_VARIANT "x86 SHA-NI"
+#elif defined(CONFIG_SHA256_INTERLEAVED)
+#define SHA256_VARIANT "interleaved"
+#elif defined(CONFIG_SHA256_FULLY_UNROLLED)
+#define SHA256_VARIANT "fully unrolled"
+#elif defined(CONFIG_SHA256_UNROLLED)
+#define SHA256_VARIANT "unrolled"
+#else
+#define SHA256_VARIANT "rolled"
+#endif
+
+/* Same chunk size as vboot_hash_all_chunks() */
+#define SPEED_CHUNK_SIZE 1024
+
+static void print_speed(const char *name, int size, timestamp_t t0,
+			timestamp_t t1)
+{
+	uint64_t ns = (t1.val - t0.val) * 1000;
+
+	ccprintf("%s (%s): %d bytes in %lld us, %lld ns/KB\n", name,
+		 SHA256_VARIANT, size, (long long)(ns / 1000),
+		 size ? (long long)(ns * 1024 / size) : -1LL);
+}
+
+static void test_sha256_speed(void)
+{
+	const uint8_t *image = (const uint8_t *)(CONFIG_MAPPED_STORAGE_BASE +
+						 CONFIG_EC_WRITABLE_STORAGE_OFF +
+						 CONFIG_RW_STORAGE_OFF);
+	struct sha256_ctx ctx;
+	timestamp_t t0, t1;
+	int pos;
+
+	/* Full RW image, hashed chunk by chunk like vboot_hash does */
+	t0 = test_get_wall_time();
+	SHA256_init(&ctx);
+	for (pos = 0; pos < CONFIG_RW_SIZE; pos += SPEED_CHUNK_SIZE)
+		SHA256_update(&ctx, image + pos,
+			      MIN(SPEED_CHUNK_SIZE, CONFIG_RW_SIZE - pos));
+	SHA256_final(&ctx);
+	t1 = test_get_wall_time();
+	print_speed("SHA256 RW image", CONFIG_RW_SIZE, t0, t1);
+
+#ifdef CONFIG_VBOOT_HASH
+	{
+		const uint8_t *digest;
+
+		/* Let the hash started by vboot_hash_init() finish first */
+		while (vboot_hash_in_progress())
+			msleep(10);
+
+		t0 = test_get_wall_time();
+		vboot_get_rw_hash(&digest);
+		t1 = test_get_wall_time();
+		print_speed("vboot_get_rw_hash",
+			    system_get_image_used(EC_IMAGE_RW), t0, t1);
+	}
+#endif
+}
+
 void run_test(int argc, char **argv)
 {
 	ccprintf("Testing short message (8 bytes)\n");
@@ -216,5 +280,8 @@ void run_test(int argc, char **argv)
 	 * 64 bytes keys.
 	 */
 
+	/* do not check result, just as a benchmark */
+	test_sha256_speed();
+
 	test_pass();
 }
@@ -0,0 +1,301 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test software timers.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+/* period between 500us and 128ms */
+#define PERIOD_US(num) (((num % 256) + 1) * 500)
+
+#define TEST_TIME (3 * SECOND)
+
+/* Callback timers, recording when they fire */
+#define CB_TIMERS 64
+
+static struct sw_timer cb_timer[CB_TIMERS];
+static uint64_t cb_deadline[CB_TIMERS];
+static uint64_t cb_fired_at[CB_TIMERS];
+static int cb_fired[CB_TIMERS];
+static int cb_order[CB_TIMERS];
+static int cb_count;
+
+static void record_fire(struct sw_timer *timer)
+{
+	int i = timer - cb_timer;
+
+	cb_fired_at[i] = get_time().val;
+	cb_fired[i]++;
+	if (cb_count < CB_TIMERS)
+		cb_order[cb_count] = i;
+	cb_count++;
+}
+
+static void arm_cb_timers(uint32_t seed, uint32_t max_us)
+{
+	uint64_t now = get_time().val;
+	int i;
+
+	cb_count = 0;
+	for (i = 0; i < CB_TIMERS; i++) {
+		seed = prng(seed);
+		cb_deadline[i] = now + seed % max_us + 1;
+		cb_fired[i] = 0;
+		sw_timer_init(&cb_timer[i], record_fire);
+		sw_timer_arm(&cb_timer[i], (timestamp_t)cb_deadline[i]);
+	}
+}
+
+static int check_fired(int i)
+{
+	TEST_EQ(cb_fired[i], 1, "%d");
+	TEST_ASSERT(cb_fired_at[i] >= cb_deadline[i]);
+	TEST_ASSERT(!sw_timer_is_armed(&cb_timer[i]));
+
+	return EC_SUCCESS;
+}
+
+static int test_expiry_order(void)
+{
+	int i;
+
+	arm_cb_timers(0x1234, 2 * SECOND);
+	msleep(2100);
+
+	TEST_EQ(cb_count, CB_TIMERS, "%d");
+	for (i = 0; i < CB_TIMERS; i++)
+		TEST_ASSERT(check_fired(i) == EC_SUCCESS);
+	for (i = 1; i < CB_TIMERS; i++)
+		TEST_ASSERT(cb_deadline[cb_order[i - 1]] <=
+			    cb_deadline[cb_order[i]]);
+
+	return EC_SUCCESS;
+}
+
+static int test_cancel_and_rearm(void)
+{
+	uint64_t now;
+	int i;
+
+	arm_cb_timers(0x5678, SECOND);
+
+	/* Cancel the odd ones, push a third of the even ones back */
+	now = get_time().val;
+	for (i = 0; i < CB_TIMERS; i++) {
+		if (i & 1) {
+			sw_timer_cancel(&cb_timer[i]);
+			TEST_ASSERT(!sw_timer_is_armed(&cb_timer[i]));
+		} else if (i % 3 == 0) {
+			cb_deadline[i] = now + 1200 * MSEC + i * MSEC;
+			sw_timer_arm(&cb_timer[i], (timestamp_t)cb_deadline[i]);
+		}
+	}
+	/* Canceling twice is harmless */
+	sw_timer_cancel(&cb_timer[1]);
+
+	msleep(1100);
+	for (i = 0; i < CB_TIMERS; i += 2)
+		if (i % 3)
+			TEST_ASSERT(check_fired(i) == EC_SUCCESS);
+		else
+			TEST_EQ(cb_fired[i], 0, "%d");
+
+	msleep(CB_TIMERS + 200);
+	for (i = 0; i < CB_TIMERS; i++)
+		if (i & 1)
+			TEST_EQ(cb_fired[i], 0, "%d");
+		else
+			TEST_ASSERT(check_fired(i) == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+static int test_long_deadlines(void)
+{
+	/* From one tick of the wheel to beyond what it can hold */
+	static const uint32_t delay_ms[] = {
+		1, 50, 1000, 30000, 200000, 400000, 1000000,
+	};
+	uint64_t now = get_time().val;
+	int i;
+
+	cb_count = 0;
+	for (i = 0; i < ARRAY_SIZE(delay_ms); i++) {
+		cb_deadline[i] = now + delay_ms[i] * (uint64_t)MSEC;
+		cb_fired[i] = 0;
+		sw_timer_init(&cb_timer[i], record_fire);
+		sw_timer_arm(&cb_timer[i], (timestamp_t)cb_deadline[i]);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(delay_ms); i++) {
+		msleep(cb_deadline[i] / MSEC - get_time().val / MSEC + 1);
+		TEST_EQ(cb_count, i + 1, "%d");
+		TEST_ASSERT(check_fired(i) == EC_SUCCESS);
+		/* Timers fire on time, not at the next cascade */
+		TEST_ASSERT(cb_fired_at[i] - cb_deadline[i] < MSEC);
+	}
+
+	return EC_SUCCESS;
+}
+
+static int test_far_timer_hides_none(void)
+{
+	uint64_t now = get_time().val;
+
+	cb_count = 0;
+	memset(cb_fired, 0, sizeof(cb_fired));
+
+	/* Clamped to the end of the wheel, and cascaded along with it */
+	cb_deadline[0] = now + 3600ull * SECOND;
+	sw_timer_init(&cb_timer[0], record_fire);
+	sw_timer_arm(&cb_timer[0], (timestamp_t)cb_deadline[0]);
+
+	cb_deadline[1] = now + 200 * SECOND;
+	sw_timer_init(&cb_timer[1], record_fire);
+	sw_timer_arm(&cb_timer[1], (timestamp_t)cb_deadline[1]);
+	msleep(201000);
+	TEST_ASSERT(check_fired(1) == EC_SUCCESS);
+
+	/* A timer past the far one's slot is still the next deadline */
+	cb_deadline[2] = get_time().val + 100 * SECOND;
+	sw_timer_init(&cb_timer[2], record_fire);
+	sw_timer_arm(&cb_timer[2], (timestamp_t)cb_deadline[2]);
+	TEST_ASSERT(sw_timer_next_deadline() <= cb_deadline[2]);
+
+	msleep(101000);
+	TEST_ASSERT(check_fired(2) == EC_SUCCESS);
+	TEST_ASSERT(cb_fired_at[2] - cb_deadline[2] < MSEC);
+	TEST_EQ(cb_fired[0], 0, "%d");
+
+	sw_timer_cancel(&cb_timer[0]);
+
+	return EC_SUCCESS;
+}
+
+/*
+ * Each task runs several timers at "random" periods, all waking it with their
+ * own event bit.  Timers are re-armed from their previous deadline, so the
+ * number of expirations is exact.
+ */
+#define TASK_TIMERS 6
+
+static int tasks_done;
+static int tasks_failed;
+static uint32_t max_late_us;
+
+static int calculate_golden(uint32_t seed)
+{
+	int golden = 0;
+	uint32_t elapsed = PERIOD_US(seed);
+
+	while (elapsed < TEST_TIME) {
+		++golden;
+		seed = prng(seed);
+		elapsed += PERIOD_US(seed);
+	}
+
+	return golden;
+}
+
+int task_timers(void *seed)
+{
+	struct sw_timer timer[TASK_TIMERS];
+	uint32_t num[TASK_TIMERS];
+	int golden[TASK_TIMERS], cnt[TASK_TIMERS];
+	task_id_t id = task_get_current();
+	uint64_t start, deadline, late;
+	uint32_t armed = 0, events;
+	int i;
+
+	task_wait_event(-1);
+	start = get_time().val;
+
+	for (i = 0; i < TASK_TIMERS; i++) {
+		num[i] = prng((uint32_t)(uintptr_t)seed + i);
+		golden[i] = calculate_golden(num[i]);
+		cnt[i] = 0;
+		sw_timer_init_event(&timer[i], id, TASK_EVENT_CUSTOM_BIT(i));
+		sw_timer_arm(&timer[i], (timestamp_t)(start + PERIOD_US(num[i])));
+		armed |= BIT(i);
+	}
+
+	while (armed) {
+		events = task_wait_event(-1);
+
+		for (i = 0; i < TASK_TIMERS; i++) {
+			if (!(events & TASK_EVENT_CUSTOM_BIT(i)))
+				continue;
+
+			deadline = timer[i].deadline;
+			late = get_time().val - deadline;
+			if (get_time().val < deadline) {
+				ccprintf("Task %d timer %d fired early!\n",
+					 id, i);
+				tasks_failed++;
+			}
+			max_late_us = MAX(max_late_us, late);
+			cnt[i]++;
+
+			num[i] = prng(num[i]);
+			deadline += PERIOD_US(num[i]);
+			if (deadline - start < TEST_TIME)
+				sw_timer_arm(&timer[i], (timestamp_t)deadline);
+			else
+				armed &= ~BIT(i);
+		}
+	}
+
+	for (i = 0; i < TASK_TIMERS; i++) {
+		ccprintf("Task %d timer %d: Count=%d Golden=%d\n", id, i,
+			 cnt[i], golden[i]);
+		if (cnt[i] != golden[i])
+			tasks_failed++;
+	}
+	tasks_done++;
+
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
+
+static int test_task_timers(void)
+{
+	tasks_done = 0;
+	tasks_failed = 0;
+	max_late_us = 0;
+
+	task_wake(TASK_ID_TMRD);
+	task_wake(TASK_ID_TMRC);
+	task_wake(TASK_ID_TMRB);
+	task_wake(TASK_ID_TMRA);
+	usleep(TEST_TIME + SECOND);
+
+	ccprintf("Latest expiration: %d us late\n", max_late_us);
+	sw_timer_print_info();
+
+	TEST_EQ(tasks_done, 4, "%d");
+	TEST_EQ(tasks_failed, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+	wait_for_task_started();
+
+	RUN_TEST(test_expiry_order);
+	RUN_TEST(test_cancel_and_rearm);
+	RUN_TEST(test_long_deadlines);
+	RUN_TEST(test_far_timer_hides_none);
+	RUN_TEST(test_task_timers);
+
+	test_print_result();
+}
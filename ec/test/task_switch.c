@@ -0,0 +1,101 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Emulator scheduler wake ordering and task switch benchmark.
+ */
+#include "common.h"
+#include "console.h"
+#include "host_task.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#define PINGPONG_COUNT 20000
+
+static int pingpong_left;
+static task_id_t wake_order[3];
+static int wake_count;
+
+int task_sleeper(void *data)
+{
+	while (1) {
+		task_wait_event_mask(TASK_EVENT_WAKE, -1);
+		usleep((uintptr_t)data);
+		wake_order[wake_count++] = task_get_current();
+	}
+
+	return EC_SUCCESS;
+}
+
+int task_pingpong(void *data)
+{
+	task_id_t peer = task_get_current() == TASK_ID_PING ?
+		TASK_ID_PONG : TASK_ID_PING;
+
+	while (1) {
+		task_wait_event_mask(TASK_EVENT_WAKE, -1);
+		if (pingpong_left > 0) {
+			pingpong_left--;
+			task_wake(peer);
+		}
+	}
+
+	return EC_SUCCESS;
+}
+
+static int test_wake_order(void)
+{
+	/* Queue the longest sleep first so it sits deepest in the heap */
+	wake_count = 0;
+	task_wake(TASK_ID_SLEEPC);
+	task_wake(TASK_ID_SLEEPB);
+	task_wake(TASK_ID_SLEEPA);
+	usleep(50 * MSEC);
+
+	TEST_EQ(wake_count, 3, "%d");
+	TEST_EQ(wake_order[0], TASK_ID_SLEEPA, "%d");
+	TEST_EQ(wake_order[1], TASK_ID_SLEEPB, "%d");
+	TEST_EQ(wake_order[2], TASK_ID_SLEEPC, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_switch_rate(void)
+{
+	uint64_t switches;
+	timestamp_t t0, t1;
+
+	switches = task_get_switch_count();
+	t0 = test_get_wall_time();
+
+	pingpong_left = PINGPONG_COUNT;
+	task_wake(TASK_ID_PING);
+	/* Our own timeouts always expire first, so don't poll too often */
+	while (pingpong_left > 0)
+		msleep(10);
+
+	t1 = test_get_wall_time();
+	switches = task_get_switch_count() - switches;
+
+	/* do not check result, just as a benchmark */
+	ccprintf("%lld task switches in %lld us: %lld switches/s\n",
+		 (long long)switches, (long long)(t1.val - t0.val),
+		 (long long)(switches * SECOND / MAX(t1.val - t0.val, 1)));
+
+	TEST_ASSERT(switches >= PINGPONG_COUNT);
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+	wait_for_task_started();
+
+	RUN_TEST(test_wake_order);
+	RUN_TEST(test_switch_rate);
+
+	test_print_result();
+}
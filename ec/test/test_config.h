@@ -40,6 +40,10 @@
 #define CONFIG_BACKLIGHT_REQ_GPIO GPIO_PCH_BKLTEN
 #endif
 
+#ifdef TEST_FLASH
+#define CONFIG_HOSTCMD_FLASH_BLOCK_HASH
+#endif
+
 #ifdef TEST_FLASH_LOG
 #define CONFIG_CRC8
 #define CONFIG_FLASH_ERASED_VALUE32 (-1U)
@@ -49,6 +53,24 @@
 #define CONFIG_MALLOC
 #endif
 
+#ifdef TEST_HOOK_DEFERRED
+#undef CONFIG_HOOK_DEFERRED_SLACK_US
+#define CONFIG_HOOK_DEFERRED_SLACK_US 2000
+#endif
+
+#if defined(TEST_HOST_COMMAND) || defined(TEST_HOST_COMMAND_HASH)
+#define CONFIG_HOSTCMD_BATCH
+#endif
+
+#ifdef TEST_HOST_COMMAND_HASH
+#define CONFIG_HOSTCMD_HASH
+#define CONFIG_HOSTCMD_STATS
+#endif
+
+#ifdef TEST_HOST_COMMAND_SOCK
+#define CONFIG_HOSTCMD_SOCKET
+#endif
+
 #ifdef TEST_KB_8042
 #define CONFIG_KEYBOARD_PROTOCOL_8042
 #endif
@@ -228,11 +250,27 @@ enum sensor_id {
 
 #endif
 
+#ifdef TEST_CONSOLE_TOKENIZED
+#define CONFIG_CONSOLE_TOKENIZED
+#endif
+
 #ifdef TEST_CRC
 #define CONFIG_CRC8
 #define CONFIG_SW_CRC
 #endif
 
+#ifdef TEST_CRC_SLICE_BY_4
+#define CONFIG_CRC8
+#define CONFIG_SW_CRC
+#define CONFIG_SW_CRC_SLICE_BY_4
+#endif
+
+#ifdef TEST_CRC_SLICE_BY_8
+#define CONFIG_CRC8
+#define CONFIG_SW_CRC
+#define CONFIG_SW_CRC_SLICE_BY_8
+#endif
+
 #ifdef TEST_RSA
 #define CONFIG_RSA
 #ifdef CONFIG_RSA_EXPONENT_3
@@ -247,6 +285,32 @@ enum sensor_id {
 #define CONFIG_RWSIG_TYPE_RWSIG
 #endif
 
+#ifdef TEST_RSA_3072
+#define CONFIG_RSA
+#define CONFIG_RSA_KEY_SIZE 3072
+#define CONFIG_RWSIG_TYPE_RWSIG
+#endif
+
+#ifdef TEST_RSA3_3072
+#define CONFIG_RSA
+#define CONFIG_RSA_EXPONENT_3
+#define CONFIG_RSA_KEY_SIZE 3072
+#define CONFIG_RWSIG_TYPE_RWSIG
+#endif
+
+#ifdef TEST_RSA_OPTIMIZED
+#define CONFIG_RSA
+#define CONFIG_RSA_OPTIMIZED
+#define CONFIG_RWSIG_TYPE_RWSIG
+#endif
+
+#ifdef TEST_RSA3_OPTIMIZED
+#define CONFIG_RSA
+#define CONFIG_RSA_EXPONENT_3
+#define CONFIG_RSA_OPTIMIZED
+#define CONFIG_RWSIG_TYPE_RWSIG
+#endif
+
 #ifdef TEST_SHA256
 #define CONFIG_SHA256
 #endif
@@ -256,10 +320,35 @@ enum sensor_id {
 #define CONFIG_SHA256_UNROLLED
 #endif
 
+#ifdef TEST_SHA256_FULLY_UNROLLED
+#define CONFIG_SHA256
+#define CONFIG_SHA256_FULLY_UNROLLED
+#endif
+
+#ifdef TEST_SHA256_INTERLEAVED
+#define CONFIG_SHA256
+#define CONFIG_SHA256_UNROLLED
+#define CONFIG_SHA256_INTERLEAVED
+#endif
+
+#ifdef TEST_SHA256_X86_SHA_NI
+#define CONFIG_SHA256
+#define CONFIG_SHA256_X86_SHA_NI
+#endif
+
+#ifdef TEST_SHA256_VBOOT_HASH
+#define CONFIG_SHA256
+#define CONFIG_VBOOT_HASH
+#endif
+
 #ifdef TEST_SHMALLOC
 #define CONFIG_MALLOC
 #endif
 
+#ifdef TEST_SW_TIMER
+#define CONFIG_SW_TIMER
+#endif
+
 #ifdef TEST_SBS_CHARGING_V2
 #define CONFIG_BATTERY
 #define CONFIG_BATTERY_MOCK
@@ -333,6 +422,12 @@ int ncp15wb_calculate_temp(uint16_t adc);
 #define CONFIG_SW_CRC
 #endif
 
+#ifdef TEST_USB_UPDATE
+#define CONFIG_USB_UPDATE
+#define CONFIG_UPDATE_STREAM_WINDOW 4
+#define CONFIG_UPDATE_BLOCK_ENCODING
+#endif
+
 #if defined(TEST_USB_SM_FRAMEWORK_H3) || \
 	defined(TEST_USB_SM_FRAMEWORK_H2) || \
 	defined(TEST_USB_SM_FRAMEWORK_H1) || \
@@ -566,6 +661,17 @@ int ncp15wb_calculate_temp(uint16_t adc);
 #define CONFIG_HOSTCMD_RTC
 #endif
 
+#ifdef TEST_VBOOT_HASH
+#define CONFIG_SHA256
+#define CONFIG_VBOOT_HASH
+#endif
+
+#ifdef TEST_VBOOT_HASH_ADAPTIVE
+#define CONFIG_SHA256
+#define CONFIG_VBOOT_HASH
+#define CONFIG_VBOOT_HASH_ADAPTIVE
+#endif
+
 #ifdef TEST_VBOOT
 #define CONFIG_RWSIG
 #define CONFIG_SHA256
@@ -0,0 +1,263 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Stress the UART output buffer with a chargen stream, like
+ * util/uart_stress_tester.py does on real devices, against an emulated UART
+ * which is slower than the writer.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "host_command.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+/* The pattern of 'chargen' */
+static const char chargen_txt[] =
+	"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+#define CHARGEN_LEN (sizeof(chargen_txt) - 1)
+
+#define STREAM_LEN (16 * CONFIG_UART_TX_BUF_SIZE)
+
+/* Characters the emulated UART sends per interrupt, 0 for no limit */
+static volatile int uart_pace;
+
+static void uart_pace_isr(void)
+{
+	if (!uart_pace)
+		return;
+
+	test_set_uart_tx_quota(uart_pace);
+	uart_process_output();
+}
+
+void interrupt_generator(void)
+{
+	while (1) {
+		udelay(100);
+		task_trigger_test_interrupt(uart_pace_isr);
+	}
+}
+
+static void set_uart_pace(int pace)
+{
+	/* Not while the interrupt is changing the quota */
+	interrupt_disable();
+	uart_pace = pace;
+	test_set_uart_tx_quota(pace ? 0 : -1);
+	interrupt_enable();
+}
+
+/* Write the chargen stream from its start, in chunks of random sizes */
+static int write_stream(int wait, int *dropped_writes)
+{
+	char chunk[64];
+	int pos, len, i;
+
+	*dropped_writes = 0;
+	for (pos = 0; pos < STREAM_LEN; pos += len) {
+		len = MIN(prng_no_seed() % sizeof(chunk) + 1, STREAM_LEN - pos);
+		for (i = 0; i < len; i++)
+			chunk[i] = chargen_txt[(pos + i) % CHARGEN_LEN];
+
+		if (wait && uart_tx_wait(len) != EC_SUCCESS)
+			return EC_ERROR_TIMEOUT;
+		if (uart_put(chunk, len) != EC_SUCCESS)
+			(*dropped_writes)++;
+	}
+
+	return EC_SUCCESS;
+}
+
+static int test_blocking_writer(void)
+{
+	struct uart_tx_stats before, after;
+	const char *captured;
+	int dropped_writes;
+	int i, rv;
+
+	uart_flush_output();
+	uart_get_tx_stats(&before);
+
+	test_capture_console(1);
+	set_uart_pace(8);
+	rv = write_stream(1, &dropped_writes);
+	uart_flush_output();
+	set_uart_pace(0);
+	test_capture_console(0);
+
+	uart_get_tx_stats(&after);
+	TEST_EQ(rv, EC_SUCCESS, "%d");
+	TEST_EQ(dropped_writes, 0, "%d");
+	TEST_EQ(after.bytes_dropped - before.bytes_dropped, 0, "%d");
+	TEST_EQ(after.bytes_sent - before.bytes_sent, STREAM_LEN, "%d");
+	TEST_ASSERT(after.max_fill < CONFIG_UART_TX_BUF_SIZE);
+
+	/* Nothing lost, reordered or duplicated, as far as it was captured */
+	captured = test_get_captured_console();
+	TEST_ASSERT(strlen(captured) > CONFIG_UART_TX_BUF_SIZE);
+	for (i = 0; captured[i]; i++)
+		TEST_ASSERT(captured[i] == chargen_txt[i % CHARGEN_LEN]);
+
+	return EC_SUCCESS;
+}
+
+static int test_dropping_writer(void)
+{
+	struct uart_tx_stats before, after;
+	int dropped_writes;
+
+	uart_flush_output();
+	uart_get_tx_stats(&before);
+
+	test_capture_console(1);
+	set_uart_pace(8);
+	write_stream(0, &dropped_writes);
+	uart_flush_output();
+	set_uart_pace(0);
+	test_capture_console(0);
+
+	uart_get_tx_stats(&after);
+	ccprintf("%d writes dropped, %d bytes\n", dropped_writes,
+		 after.bytes_dropped - before.bytes_dropped);
+
+	TEST_ASSERT(dropped_writes > 0);
+	/* Every byte was either sent or counted as dropped */
+	TEST_EQ(after.bytes_sent - before.bytes_sent +
+		after.bytes_dropped - before.bytes_dropped, STREAM_LEN, "%d");
+	TEST_EQ(after.max_fill, CONFIG_UART_TX_BUF_SIZE - 1, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_newline_translation(void)
+{
+	static const char expected[] = "a\r\nb\r\nc\n42\r\nx\r\n";
+	struct uart_tx_stats before, after;
+
+	uart_flush_output();
+	uart_get_tx_stats(&before);
+
+	test_capture_console(1);
+	uart_puts("a\nb\n");
+	uart_put_raw("c\n", 2);
+	uart_printf("%d\n%s", 42, "x\n");
+	uart_flush_output();
+	test_capture_console(0);
+
+	uart_get_tx_stats(&after);
+	TEST_ASSERT(!strncmp(test_get_captured_console(), expected,
+			     sizeof(expected)));
+	TEST_EQ(after.bytes_sent - before.bytes_sent, (int)strlen(expected),
+		"%d");
+
+	return EC_SUCCESS;
+}
+
+static struct {
+	struct ec_response_console_read_v2 r;
+	char data[64];
+} read_resp;
+BUILD_ASSERT(offsetof(typeof(read_resp), data) ==
+	     sizeof(struct ec_response_console_read_v2));
+
+/* Read the console output after seq; returns the number of bytes */
+static int console_read_seq(uint32_t seq)
+{
+	struct ec_params_console_read_v2 p = { .seq = seq };
+	int rv;
+
+	memset(&read_resp, 0, sizeof(read_resp));
+	rv = test_send_host_command(EC_CMD_CONSOLE_READ, 2, &p, sizeof(p),
+				    &read_resp, sizeof(read_resp));
+	if (rv != EC_RES_SUCCESS)
+		return -1;
+
+	/* There are no nulls in console output */
+	return strnlen(read_resp.data, sizeof(read_resp.data));
+}
+
+/* Read all the console output after seq; returns the end of it */
+static uint32_t console_read_end(uint32_t seq)
+{
+	int len;
+
+	do {
+		len = console_read_seq(seq);
+		seq = read_resp.r.seq + len;
+	} while (len > 0 && (read_resp.r.flags & EC_CONSOLE_READ_MORE));
+
+	return seq;
+}
+
+static int test_console_read_seq(void)
+{
+	uint32_t seq, old;
+	int i;
+
+	/*
+	 * Only TEST_ASSERT() below, as the other checks print on success, and
+	 * that would be read back too.
+	 */
+	uart_flush_output();
+	seq = console_read_end(0);
+
+	/* Only the new output */
+	uart_puts("hello\n");
+	TEST_ASSERT(console_read_seq(seq) == 7);
+	TEST_ASSERT(read_resp.r.seq == seq);
+	TEST_ASSERT(read_resp.r.flags == 0);
+	TEST_ASSERT(!memcmp(read_resp.data, "hello\r\n", 7));
+
+	/* Nothing new */
+	seq += 7;
+	TEST_ASSERT(console_read_seq(seq) == 0);
+	TEST_ASSERT(read_resp.r.seq == seq);
+	TEST_ASSERT(read_resp.r.flags == 0);
+
+	/* More than fits in one response */
+	uart_puts("0123456789012345678901234567890123456789"
+		  "0123456789012345678901234567890123456789");
+	TEST_ASSERT(console_read_seq(seq) == sizeof(read_resp.data));
+	TEST_ASSERT(read_resp.r.flags == EC_CONSOLE_READ_MORE);
+	TEST_ASSERT(console_read_end(seq) == seq + 80);
+
+	/* Output which wrapped around is reported as a gap */
+	old = seq;
+	for (i = 0; i < CONFIG_UART_TX_BUF_SIZE / 8; i++) {
+		uart_puts("chargen ");
+		uart_flush_output();
+	}
+	seq = console_read_end(old);
+	TEST_ASSERT(console_read_seq(old) == sizeof(read_resp.data));
+	TEST_ASSERT(read_resp.r.flags ==
+		    (EC_CONSOLE_READ_GAP | EC_CONSOLE_READ_MORE));
+	TEST_ASSERT(read_resp.r.seq == seq - (CONFIG_UART_TX_BUF_SIZE - 1));
+
+	/* So is a seq from before a reboot */
+	TEST_ASSERT(console_read_seq(seq + 100) == sizeof(read_resp.data));
+	TEST_ASSERT(read_resp.r.flags ==
+		    (EC_CONSOLE_READ_GAP | EC_CONSOLE_READ_MORE));
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	/* Let the console task print its banner, it would skew the counts */
+	msleep(100);
+
+	RUN_TEST(test_blocking_writer);
+	RUN_TEST(test_dropping_writer);
+	RUN_TEST(test_newline_translation);
+	RUN_TEST(test_console_read_seq);
+
+	test_print_result();
+}
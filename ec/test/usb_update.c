@@ -0,0 +1,460 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test the USB update protocol, one block at a time, streamed, and with
+ * encoded blocks, with the test playing usb_updater2 at the other end of the
+ * update queues.
+ */
+
+#include "byteorder.h"
+#include "common.h"
+#include "console.h"
+#include "consumer.h"
+#include "queue.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "update_fw.h"
+#include "usb_descriptor.h"
+#include "util.h"
+
+#define PDU_SIZE CONFIG_UPDATE_PDU_SIZE
+#define IMAGE_SIZE (CONFIG_RW_SIZE / PDU_SIZE * PDU_SIZE)
+
+/*
+ * Times of the model the transfer rates are measured with, in emulator time:
+ * the host waits a full speed USB frame, which holds about a PDU, for each
+ * transfer in and for each PDU worth of data out, and each flash erase or
+ * write takes FLASH_WRITE_US.
+ */
+#define USB_FRAME_US 1000
+#define FLASH_WRITE_US 1000
+
+/* Window the host asks for, larger than the EC's */
+#define HOST_WINDOW 8
+
+/* Encodings the host asks for, one of which the EC does not know */
+#define HOST_ENCODINGS (UPDATE_BLOCK_ENCODINGS | BIT(7))
+
+extern struct queue const usb_to_update;
+extern struct queue const update_to_usb;
+
+static void update_test_written(struct consumer const *consumer, size_t count)
+{
+	task_wake(TASK_ID_TEST_RUNNER);
+}
+
+struct consumer const update_test_consumer = {
+	.queue = &update_to_usb,
+	.ops   = &((struct consumer_ops const) {
+		.written = update_test_written,
+	}),
+};
+
+static uint8_t image[IMAGE_SIZE];
+
+/* Bytes of the blocks sent since the start of the transfer, with headers */
+static int wire_bytes;
+
+/* Spend us of emulator time, which usleep() does not if events come in */
+static void model_delay(int us)
+{
+	task_wait_event_mask(TASK_EVENT_TIMER, us);
+}
+
+int flash_pre_op(void)
+{
+	model_delay(FLASH_WRITE_US);
+	return EC_SUCCESS;
+}
+
+static void send_packet(const void *data, int len)
+{
+	queue_add_units(&usb_to_update, data, len);
+}
+
+/*
+ * Read up to max_len bytes sent by the EC, waiting for at least min_len of
+ * them; returns the number of bytes read.
+ */
+static int recv_packet(void *data, int min_len, int max_len)
+{
+	timestamp_t deadline;
+
+	model_delay(USB_FRAME_US);
+
+	deadline.val = get_time().val + SECOND;
+	while (queue_count(&update_to_usb) < min_len &&
+	       !timestamp_expired(deadline, NULL))
+		task_wait_event(MSEC);
+
+	return queue_remove_units(&update_to_usb, data, max_len);
+}
+
+/* Drop what the EC sent, as usb_updater2 does before starting */
+static void flush_packets(void)
+{
+	queue_advance_head(&update_to_usb, queue_count(&update_to_usb));
+}
+
+/*
+ * Start an update, with a streaming start PDU if window or encodings are not
+ * 0; returns the response size.
+ */
+static int start_update(int window, int encodings,
+			struct first_response_pdu *rpdu)
+{
+	struct update_stream_start start;
+
+	wire_bytes = 0;
+	memset(&start, 0, sizeof(start));
+	if (window || encodings) {
+		start.header.block_size = htobe32(sizeof(start));
+		start.block_encodings = htobe16(encodings);
+		start.window = htobe16(window);
+		send_packet(&start, sizeof(start));
+	} else {
+		start.header.block_size = htobe32(sizeof(start.header));
+		send_packet(&start.header, sizeof(start.header));
+	}
+
+	memset(rpdu, 0, sizeof(*rpdu));
+	return recv_packet(rpdu, 1, sizeof(*rpdu));
+}
+
+static int send_done(void)
+{
+	uint32_t done = htobe32(UPDATE_DONE);
+	uint8_t resp;
+
+	send_packet(&done, sizeof(done));
+	if (recv_packet(&resp, 1, 1) != 1)
+		return -1;
+
+	return resp;
+}
+
+static void send_frame(uint32_t offset, const uint8_t *payload, int size,
+		       int encoding)
+{
+	struct update_frame_header ufh;
+	int i;
+
+	ufh.block_size = htobe32((sizeof(ufh) + size) |
+				 encoding << UPDATE_FRAME_ENCODING_SHIFT);
+	ufh.cmd.block_digest = 0;
+	ufh.cmd.block_base = htobe32(offset);
+	send_packet(&ufh, sizeof(ufh));
+
+	for (i = 0; i < size; i += USB_MAX_PACKET_SIZE)
+		send_packet(payload + i, MIN(size - i, USB_MAX_PACKET_SIZE));
+	wire_bytes += sizeof(ufh) + size;
+
+	model_delay(DIV_ROUND_UP(USB_FRAME_US * (sizeof(ufh) + size),
+				 PDU_SIZE));
+}
+
+/* Send a block, in the smallest of the encodings allowed */
+static void send_block(uint32_t offset, const uint8_t *data, int encodings)
+{
+	uint8_t payload[PDU_SIZE];
+	int encoding;
+	int size;
+
+	size = update_block_encode(encodings, data, PDU_SIZE, payload,
+				   &encoding);
+	send_frame(offset, payload, size, encoding);
+}
+
+/* Send each block and wait for its response; returns the first error */
+static int transfer_lockstep(uint32_t offset, const uint8_t *data, int size,
+			     int encodings)
+{
+	uint8_t resp;
+	int i;
+
+	for (i = 0; i < size; i += PDU_SIZE) {
+		send_block(offset + i, data + i, encodings);
+		if (recv_packet(&resp, 1, 1) != 1)
+			return UPDATE_GEN_ERROR;
+		if (resp)
+			return resp;
+	}
+
+	return UPDATE_SUCCESS;
+}
+
+/*
+ * Send the blocks with up to window of them in flight; returns the first
+ * error, and how many blocks were acknowledged in *blocks_done.
+ */
+static int transfer_streamed(uint32_t offset, const uint8_t *data, int size,
+			     int window, int encodings, int *blocks_done)
+{
+	struct update_stream_ack acks[USB_MAX_PACKET_SIZE /
+				      sizeof(struct update_stream_ack)];
+	int blocks = size / PDU_SIZE;
+	int sent = 0;
+	int len, i;
+
+	*blocks_done = 0;
+	while (*blocks_done < blocks) {
+		if (sent < blocks && sent - *blocks_done < window) {
+			send_block(offset + sent * PDU_SIZE,
+				   data + sent * PDU_SIZE, encodings);
+			sent++;
+			continue;
+		}
+
+		len = recv_packet(acks, sizeof(acks[0]), sizeof(acks));
+		if (len < sizeof(acks[0]))
+			return UPDATE_GEN_ERROR;
+
+		for (i = 0; i < len / sizeof(acks[0]); i++) {
+			/* Acks are cumulative, and never go back */
+			if (be32toh(acks[i].blocks_done) < *blocks_done)
+				return UPDATE_GEN_ERROR;
+			*blocks_done = be32toh(acks[i].blocks_done);
+			if (acks[i].return_value)
+				return be32toh(acks[i].return_value);
+		}
+	}
+
+	return UPDATE_SUCCESS;
+}
+
+static void fill_image(void)
+{
+	int i;
+
+	for (i = 0; i < IMAGE_SIZE; i++)
+		image[i] = prng_no_seed();
+}
+
+/*
+ * Something more like a firmware image: runs of random bytes and copies of
+ * earlier parts, followed by erased padding.
+ */
+static void fill_image_compressible(void)
+{
+	int end = IMAGE_SIZE * 3 / 4;
+	int i = 0;
+	int len, from;
+
+	while (i < end) {
+		len = MIN(4 + prng_no_seed() % 60, end - i);
+		if (i < PDU_SIZE || prng_no_seed() % 2) {
+			while (len--)
+				image[i++] = prng_no_seed();
+		} else {
+			from = prng_no_seed() % (i - len);
+			memcpy(image + i, image + from, len);
+			i += len;
+		}
+	}
+	memset(image + end, 0xff, IMAGE_SIZE - end);
+}
+
+static int rw_matches_image(void)
+{
+	return !memcmp((void *)(CONFIG_PROGRAM_MEMORY_BASE +
+				CONFIG_RW_MEM_OFF), image, IMAGE_SIZE);
+}
+
+static void print_rate(const char *name, timestamp_t start)
+{
+	int us = get_time().val - start.val;
+
+	ccprintf("%s: %d bytes (%d on the wire) in %d us, %d KiB/s\n", name,
+		 IMAGE_SIZE, wire_bytes, us,
+		 (int)((uint64_t)IMAGE_SIZE * SECOND / 1024 / us));
+}
+
+static int test_start(void)
+{
+	struct first_response_pdu rpdu;
+
+	flush_packets();
+	TEST_EQ(start_update(0, 0, &rpdu),
+		(int)offsetof(struct first_response_pdu,
+			      common.block_encodings), "%d");
+	TEST_EQ(be32toh(rpdu.return_value), 0, "%d");
+	TEST_EQ(be16toh(rpdu.header_type), UPDATE_HEADER_TYPE_COMMON, "%d");
+	TEST_EQ(be16toh(rpdu.protocol_version), UPDATE_PROTOCOL_VERSION, "%d");
+	TEST_EQ(be32toh(rpdu.common.maximum_pdu_size), PDU_SIZE, "%d");
+	TEST_EQ(be32toh(rpdu.common.offset), CONFIG_RW_MEM_OFF, "0x%x");
+	TEST_EQ(send_done(), 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_stream_start(void)
+{
+	struct first_response_pdu rpdu;
+
+	/* The EC picks the smaller window, and the encodings it knows */
+	TEST_EQ(start_update(HOST_WINDOW, HOST_ENCODINGS, &rpdu),
+		(int)sizeof(rpdu), "%d");
+	TEST_EQ(be32toh(rpdu.return_value), 0, "%d");
+	TEST_EQ(be16toh(rpdu.common.stream_window),
+		CONFIG_UPDATE_STREAM_WINDOW, "%d");
+	TEST_EQ(be16toh(rpdu.common.block_encodings), UPDATE_BLOCK_ENCODINGS,
+		"0x%x");
+	TEST_EQ(send_done(), 0, "%d");
+
+	TEST_EQ(start_update(2, 0, &rpdu), (int)sizeof(rpdu), "%d");
+	TEST_EQ(be16toh(rpdu.common.stream_window), 2, "%d");
+	TEST_EQ(be16toh(rpdu.common.block_encodings), 0, "0x%x");
+	TEST_EQ(send_done(), 0, "%d");
+
+	/* Encodings only, blocks still go one at a time */
+	TEST_EQ(start_update(0, BIT(UPDATE_BLOCK_FILL), &rpdu),
+		(int)sizeof(rpdu), "%d");
+	TEST_EQ(be16toh(rpdu.common.stream_window), 0, "%d");
+	TEST_EQ(be16toh(rpdu.common.block_encodings), BIT(UPDATE_BLOCK_FILL),
+		"0x%x");
+	TEST_EQ(send_done(), 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_lockstep(void)
+{
+	struct first_response_pdu rpdu;
+	timestamp_t start;
+
+	fill_image();
+	start = get_time();
+	start_update(0, 0, &rpdu);
+	TEST_EQ(transfer_lockstep(be32toh(rpdu.common.offset), image,
+				  IMAGE_SIZE, 0), UPDATE_SUCCESS, "%d");
+	TEST_EQ(send_done(), 0, "%d");
+	print_rate("one block at a time", start);
+
+	TEST_ASSERT(rw_matches_image());
+
+	return EC_SUCCESS;
+}
+
+static int test_streamed(void)
+{
+	struct first_response_pdu rpdu;
+	timestamp_t start;
+	int window, blocks_done;
+
+	fill_image();
+	start = get_time();
+	start_update(HOST_WINDOW, 0, &rpdu);
+	window = be16toh(rpdu.common.stream_window);
+	TEST_EQ(transfer_streamed(be32toh(rpdu.common.offset), image,
+				  IMAGE_SIZE, window, 0, &blocks_done),
+		UPDATE_SUCCESS, "%d");
+	TEST_EQ(blocks_done, IMAGE_SIZE / PDU_SIZE, "%d");
+	TEST_EQ(send_done(), 0, "%d");
+	print_rate("streamed", start);
+
+	TEST_ASSERT(rw_matches_image());
+
+	return EC_SUCCESS;
+}
+
+static int test_stream_error(void)
+{
+	struct first_response_pdu rpdu;
+	uint32_t offset;
+	int window, blocks_done;
+
+	fill_image();
+	start_update(HOST_WINDOW, 0, &rpdu);
+	window = be16toh(rpdu.common.stream_window);
+
+	/* The third block goes past the end of the section */
+	offset = be32toh(rpdu.common.offset) + CONFIG_RW_SIZE - 2 * PDU_SIZE;
+	TEST_EQ(transfer_streamed(offset, image, 4 * PDU_SIZE, window, 0,
+				  &blocks_done), UPDATE_BAD_ADDR, "%d");
+	TEST_EQ(blocks_done, 2, "%d");
+
+	/* The EC went back to waiting for a start */
+	flush_packets();
+	TEST_EQ(start_update(HOST_WINDOW, 0, &rpdu), (int)sizeof(rpdu), "%d");
+	TEST_EQ(be32toh(rpdu.return_value), 0, "%d");
+	TEST_EQ(send_done(), 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_encoded(void)
+{
+	struct first_response_pdu rpdu;
+	timestamp_t start;
+	int window, blocks_done;
+
+	fill_image_compressible();
+	start = get_time();
+	start_update(0, UPDATE_BLOCK_ENCODINGS, &rpdu);
+	TEST_EQ(transfer_lockstep(be32toh(rpdu.common.offset), image,
+				  IMAGE_SIZE, UPDATE_BLOCK_ENCODINGS),
+		UPDATE_SUCCESS, "%d");
+	TEST_EQ(send_done(), 0, "%d");
+	print_rate("encoded, one block at a time", start);
+	TEST_ASSERT(wire_bytes < IMAGE_SIZE * 3 / 4);
+	TEST_ASSERT(rw_matches_image());
+
+	fill_image_compressible();
+	start = get_time();
+	start_update(HOST_WINDOW, UPDATE_BLOCK_ENCODINGS, &rpdu);
+	window = be16toh(rpdu.common.stream_window);
+	TEST_EQ(transfer_streamed(be32toh(rpdu.common.offset), image,
+				  IMAGE_SIZE, window, UPDATE_BLOCK_ENCODINGS,
+				  &blocks_done), UPDATE_SUCCESS, "%d");
+	TEST_EQ(send_done(), 0, "%d");
+	print_rate("encoded, streamed", start);
+	TEST_ASSERT(rw_matches_image());
+
+	return EC_SUCCESS;
+}
+
+static int test_bad_encoding(void)
+{
+	struct first_response_pdu rpdu;
+	/* Copies from before the start of the block */
+	static const uint8_t bad_lz[] = { 0x00, 0xaa, UPDATE_LZ_MATCH, 0, 2 };
+	struct update_block_fill fill = {
+		.size = htobe16(PDU_SIZE),
+		.value = 0xff,
+	};
+	uint32_t offset;
+	uint8_t resp;
+
+	start_update(0, UPDATE_BLOCK_ENCODINGS, &rpdu);
+	offset = be32toh(rpdu.common.offset);
+	send_frame(offset, bad_lz, sizeof(bad_lz), UPDATE_BLOCK_LZ);
+	TEST_EQ(recv_packet(&resp, 1, 1), 1, "%d");
+	TEST_EQ(resp, UPDATE_DATA_ERROR, "%d");
+	TEST_EQ(send_done(), 0, "%d");
+
+	/* Encodings which were not negotiated are refused */
+	start_update(0, 0, &rpdu);
+	send_frame(offset, (const uint8_t *)&fill, sizeof(fill),
+		   UPDATE_BLOCK_FILL);
+	TEST_EQ(recv_packet(&resp, 1, 1), 1, "%d");
+	TEST_EQ(resp, UPDATE_GEN_ERROR, "%d");
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_start);
+	RUN_TEST(test_stream_start);
+	RUN_TEST(test_lockstep);
+	RUN_TEST(test_streamed);
+	RUN_TEST(test_stream_error);
+	RUN_TEST(test_encoded);
+	RUN_TEST(test_bad_encoding);
+
+	test_print_result();
+}
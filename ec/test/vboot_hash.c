@@ -0,0 +1,173 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test vboot hash computation against the emulated flash.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "flash.h"
+#include "sha256.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+#include "vboot_hash.h"
+
+#define HASH_OFFSET (CONFIG_EC_WRITABLE_STORAGE_OFF + CONFIG_RW_STORAGE_OFF)
+#define HASH_SIZE CONFIG_RW_SIZE
+
+static char pattern[CONFIG_FLASH_BANK_SIZE];
+
+static int vboot_hash_cmd(int cmd, uint32_t offset, uint32_t size,
+			  struct ec_response_vboot_hash_v1 *r)
+{
+	struct ec_params_vboot_hash p;
+
+	memset(&p, 0, sizeof(p));
+	p.cmd = cmd;
+	p.hash_type = EC_VBOOT_HASH_TYPE_SHA256;
+	p.offset = offset;
+	p.size = size;
+
+	return test_send_host_command(EC_CMD_VBOOT_HASH, 1, &p, sizeof(p),
+				      r, sizeof(*r));
+}
+
+/* Poll until no hash is in progress; returns the final status */
+static int wait_for_hash(struct ec_response_vboot_hash_v1 *r)
+{
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		if (vboot_hash_cmd(EC_VBOOT_HASH_GET, 0, 0, r) !=
+		    EC_RES_SUCCESS)
+			return -1;
+		if (r->hash.status != EC_VBOOT_HASH_STATUS_BUSY)
+			return r->hash.status;
+		msleep(1);
+	}
+
+	return -1;
+}
+
+static int test_hash_matches_flash(void)
+{
+	struct ec_response_vboot_hash_v1 r;
+	struct sha256_ctx ctx;
+	timestamp_t t0, t1;
+	uint8_t *expected;
+	int i;
+
+	for (i = 0; i < HASH_SIZE; i += sizeof(pattern))
+		TEST_ASSERT(flash_physical_write(HASH_OFFSET + i,
+						 sizeof(pattern), pattern) ==
+			    EC_SUCCESS);
+
+	SHA256_init(&ctx);
+	SHA256_update(&ctx, (const uint8_t *)(CONFIG_MAPPED_STORAGE_BASE +
+					      HASH_OFFSET), HASH_SIZE);
+	expected = SHA256_final(&ctx);
+
+	/* Let the hash started at boot finish */
+	wait_for_hash(&r);
+
+	t0 = test_get_wall_time();
+	TEST_ASSERT(vboot_hash_cmd(EC_VBOOT_HASH_START, HASH_OFFSET,
+				   HASH_SIZE, &r) == EC_RES_SUCCESS);
+	TEST_EQ(wait_for_hash(&r), EC_VBOOT_HASH_STATUS_DONE, "%d");
+	t1 = test_get_wall_time();
+
+	TEST_EQ(r.hash.offset, HASH_OFFSET, "0x%x");
+	TEST_EQ(r.hash.size, HASH_SIZE, "0x%x");
+	TEST_ASSERT_ARRAY_EQ(r.hash.hash_digest, expected,
+			     SHA256_DIGEST_SIZE);
+
+	ccprintf("hash %d bytes: %lld us end-to-end, %d us in EC "
+		 "(read %d us, hash %d us, %d chunks, last %d bytes)\n",
+		 HASH_SIZE, (long long)(t1.val - t0.val), r.total_us,
+		 r.read_us, r.hash_us, r.chunks, r.chunk_size);
+
+	TEST_ASSERT(r.chunks > 0);
+	TEST_ASSERT(r.hash_us + r.read_us <= r.total_us);
+#ifdef CONFIG_VBOOT_HASH_ADAPTIVE
+	/* Hashing 1 KB on the host is far below the budget, so it grows */
+	TEST_EQ(r.chunk_size, CONFIG_VBOOT_HASH_MAX_CHUNK_SIZE, "%d");
+	TEST_ASSERT(r.chunks < HASH_SIZE / 1024);
+#else
+	TEST_EQ(r.chunk_size, 1024, "%d");
+	TEST_EQ(r.chunks, HASH_SIZE / 1024, "%d");
+#endif
+
+	return EC_SUCCESS;
+}
+
+#ifdef CONFIG_VBOOT_HASH_ADAPTIVE
+static int test_chunk_size_reset(void)
+{
+	struct ec_response_vboot_hash_v1 r;
+
+	/* Grow the chunks to the maximum */
+	wait_for_hash(&r);
+	TEST_ASSERT(vboot_hash_cmd(EC_VBOOT_HASH_START, HASH_OFFSET,
+				   HASH_SIZE, &r) == EC_RES_SUCCESS);
+	TEST_EQ(wait_for_hash(&r), EC_VBOOT_HASH_STATUS_DONE, "%d");
+	TEST_EQ(r.chunk_size, CONFIG_VBOOT_HASH_MAX_CHUNK_SIZE, "%d");
+
+	/* A new hash starts over from 1 KB, so 2 KB takes two chunks */
+	TEST_ASSERT(vboot_hash_cmd(EC_VBOOT_HASH_START, HASH_OFFSET,
+				   2048, &r) == EC_RES_SUCCESS);
+	TEST_EQ(wait_for_hash(&r), EC_VBOOT_HASH_STATUS_DONE, "%d");
+	TEST_EQ(r.chunks, 2, "%d");
+
+	return EC_SUCCESS;
+}
+#endif
+
+static int test_hash_abort(void)
+{
+	struct ec_response_vboot_hash_v1 r;
+
+	wait_for_hash(&r);
+
+	TEST_ASSERT(vboot_hash_cmd(EC_VBOOT_HASH_START, HASH_OFFSET,
+				   HASH_SIZE, &r) == EC_RES_SUCCESS);
+	TEST_ASSERT(vboot_hash_cmd(EC_VBOOT_HASH_ABORT, 0, 0, &r) ==
+		    EC_RES_SUCCESS);
+	TEST_EQ(wait_for_hash(&r), EC_VBOOT_HASH_STATUS_NONE, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_get_rw_hash(void)
+{
+	struct ec_response_vboot_hash_v1 r;
+	const uint8_t *digest = NULL;
+
+	wait_for_hash(&r);
+
+	/* The blocking hash is complete when it returns */
+	TEST_EQ(vboot_get_rw_hash(&digest), EC_SUCCESS, "%d");
+	TEST_ASSERT(digest != NULL);
+	TEST_ASSERT(!vboot_hash_in_progress());
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	int i;
+
+	for (i = 0; i < sizeof(pattern); i++)
+		pattern[i] = i * 31 + (i >> 8);
+
+	RUN_TEST(test_hash_matches_flash);
+#ifdef CONFIG_VBOOT_HASH_ADAPTIVE
+	RUN_TEST(test_chunk_size_reset);
+#endif
+	RUN_TEST(test_hash_abort);
+	RUN_TEST(test_get_rw_hash);
+
+	test_print_result();
+}
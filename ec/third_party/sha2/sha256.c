@@ -67,12 +67,14 @@
 
 /* Macros used for loops unrolling */
 
-#define SHA256_SCR(i)						\
+#define SHA256_SCR_TO(s, i)					\
 	{							\
-		w[i] =  SHA256_F4(w[i -  2]) + w[i -  7]	\
-			+ SHA256_F3(w[i - 15]) + w[i - 16];	\
+		s[i] =  SHA256_F4(s[i -  2]) + s[i -  7]	\
+			+ SHA256_F3(s[i - 15]) + s[i - 16];	\
 	}
 
+#define SHA256_SCR(i) SHA256_SCR_TO(w, i)
+
 #define SHA256_EXP(a, b, c, d, e, f, g, h, j)				\
 	{								\
 		t1 = wv[h] + SHA256_F2(wv[e]) + CH(wv[e], wv[f], wv[g])	\
@@ -82,6 +84,32 @@
 		wv[h] = t1 + t2;					\
 	}
 
+#define SHA256_SCR8_TO(s, i)			\
+	{					\
+		SHA256_SCR_TO(s, (i));		\
+		SHA256_SCR_TO(s, (i) + 1);	\
+		SHA256_SCR_TO(s, (i) + 2);	\
+		SHA256_SCR_TO(s, (i) + 3);	\
+		SHA256_SCR_TO(s, (i) + 4);	\
+		SHA256_SCR_TO(s, (i) + 5);	\
+		SHA256_SCR_TO(s, (i) + 6);	\
+		SHA256_SCR_TO(s, (i) + 7);	\
+	}
+
+#define SHA256_SCR8(i) SHA256_SCR8_TO(w, i)
+
+#define SHA256_EXP8(j)						\
+	{							\
+		SHA256_EXP(0, 1, 2, 3, 4, 5, 6, 7, (j));	\
+		SHA256_EXP(7, 0, 1, 2, 3, 4, 5, 6, (j) + 1);	\
+		SHA256_EXP(6, 7, 0, 1, 2, 3, 4, 5, (j) + 2);	\
+		SHA256_EXP(5, 6, 7, 0, 1, 2, 3, 4, (j) + 3);	\
+		SHA256_EXP(4, 5, 6, 7, 0, 1, 2, 3, (j) + 4);	\
+		SHA256_EXP(3, 4, 5, 6, 7, 0, 1, 2, (j) + 5);	\
+		SHA256_EXP(2, 3, 4, 5, 6, 7, 0, 1, (j) + 6);	\
+		SHA256_EXP(1, 2, 3, 4, 5, 6, 7, 0, (j) + 7);	\
+	}
+
 static const uint32_t sha256_h0[8] = {
 	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
 	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
@@ -115,8 +143,172 @@ void SHA256_init(struct sha256_ctx *ctx)
 	ctx->tot_len = 0;
 }
 
-static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
-			     unsigned int block_nb)
+#ifdef CONFIG_SHA256_X86_SHA_NI
+#if !defined(__x86_64__) && !defined(__i386__)
+#error "CONFIG_SHA256_X86_SHA_NI requires an x86 host build"
+#endif
+#include <cpuid.h>
+#include <immintrin.h>
+
+/*
+ * Transform using the x86 SHA extensions. The state is kept as the ABEF and
+ * CDGH halves expected by sha256rnds2, and each loop iteration does four
+ * rounds while expanding the message schedule four words ahead.
+ */
+__attribute__((target("sha,sse4.1")))
+static void SHA256_transform_shani(uint32_t *h, const uint8_t *message,
+				   unsigned int block_nb)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, msg, tmp;
+	__m128i m[4];
+	int i, r;
+
+	tmp = _mm_loadu_si128((const __m128i *)&h[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&h[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);		/* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B);	/* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);	/* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);	/* CDGH */
+
+	for (i = 0; i < (int) block_nb; i++, message += SHA256_BLOCK_SIZE) {
+		abef = state0;
+		cdgh = state1;
+
+		for (r = 0; r < 4; r++)
+			m[r] = _mm_shuffle_epi8(_mm_loadu_si128(
+				(const __m128i *)(message + (r << 4))), bswap);
+
+		for (r = 0; r < 16; r++) {
+			msg = _mm_add_epi32(m[r & 3], _mm_loadu_si128(
+				(const __m128i *)&sha256_k[r << 2]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+			if (r >= 12)
+				continue;
+
+			/* w[4r + 16 .. 4r + 19], replacing w[4r .. 4r + 3] */
+			tmp = _mm_sha256msg1_epu32(m[r & 3], m[(r + 1) & 3]);
+			tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(
+				m[(r + 3) & 3], m[(r + 2) & 3], 4));
+			m[r & 3] = _mm_sha256msg2_epu32(tmp, m[(r + 3) & 3]);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);		/* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1);	/* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);	/* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);	/* HGFE */
+
+	_mm_storeu_si128((__m128i *)&h[0], state0);
+	_mm_storeu_si128((__m128i *)&h[4], state1);
+}
+
+/* CPUID.(EAX=7, ECX=0):EBX bit 29 advertises the SHA extensions */
+static int cpu_has_sha_ni(void)
+{
+	static int has_sha_ni = -1;
+	unsigned int eax, ebx, ecx, edx;
+
+	if (has_sha_ni < 0)
+		has_sha_ni = __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+			     (ebx & BIT(29));
+
+	return has_sha_ni;
+}
+#endif /* CONFIG_SHA256_X86_SHA_NI */
+
+/* Expand the message schedule for one block into w[] */
+static inline void SHA256_schedule(uint32_t *w, const uint8_t *sub_block)
+{
+	int j;
+
+	for (j = 0; j < 16; j++)
+		PACK32(&sub_block[j << 2], &w[j]);
+
+#if defined(CONFIG_SHA256_FULLY_UNROLLED)
+	SHA256_SCR8(16);
+	SHA256_SCR8(24);
+	SHA256_SCR8(32);
+	SHA256_SCR8(40);
+	SHA256_SCR8(48);
+	SHA256_SCR8(56);
+#elif defined(CONFIG_SHA256_UNROLLED)
+	for (j = 16; j < 64; j += 8)
+		SHA256_SCR8(j);
+#else
+	for (j = 16; j < 64; j++)
+		SHA256_SCR(j);
+#endif
+}
+
+#ifdef CONFIG_SHA256_INTERLEAVED
+/*
+ * Multi-block transform that expands the message schedule of block i + 1
+ * while running the rounds of block i. The schedule does not depend on the
+ * chaining state, so the two instruction streams are independent and can
+ * overlap on CPUs with more than one ALU. Needs two schedule buffers.
+ */
+static void SHA256_transform_sw(struct sha256_ctx *ctx,
+				const uint8_t *message, unsigned int block_nb)
+{
+	/* Note: this function requires a considerable amount of stack */
+	uint32_t sched[2][64];
+	uint32_t wv[8];
+	uint32_t t1, t2;
+	uint32_t *w, *w_next;
+	const uint8_t *next_block;
+	int i, j;
+
+	if (!block_nb)
+		return;
+
+	SHA256_schedule(sched[0], message);
+
+	for (i = 0; i < (int) block_nb; i++) {
+		w = sched[i & 1];
+		w_next = sched[(i + 1) & 1];
+		next_block = message + ((i + 1) << 6);
+
+		for (j = 0; j < 8; j++)
+			wv[j] = ctx->h[j];
+
+		if (i + 1 == (int) block_nb) {
+			for (j = 0; j < 64; j += 8)
+				SHA256_EXP8(j);
+		} else {
+			/* Rounds 0-15 load the next block's first 16 words */
+			for (j = 0; j < 16; j += 8) {
+				SHA256_EXP8(j);
+				PACK32(&next_block[j << 2], &w_next[j]);
+				PACK32(&next_block[(j + 1) << 2], &w_next[j + 1]);
+				PACK32(&next_block[(j + 2) << 2], &w_next[j + 2]);
+				PACK32(&next_block[(j + 3) << 2], &w_next[j + 3]);
+				PACK32(&next_block[(j + 4) << 2], &w_next[j + 4]);
+				PACK32(&next_block[(j + 5) << 2], &w_next[j + 5]);
+				PACK32(&next_block[(j + 6) << 2], &w_next[j + 6]);
+				PACK32(&next_block[(j + 7) << 2], &w_next[j + 7]);
+			}
+			/* Rounds 16-63 expand the rest of it */
+			for (j = 16; j < 64; j += 8) {
+				SHA256_EXP8(j);
+				SHA256_SCR8_TO(w_next, j);
+			}
+		}
+
+		for (j = 0; j < 8; j++)
+			ctx->h[j] += wv[j];
+	}
+}
+#else
+static void SHA256_transform_sw(struct sha256_ctx *ctx,
+				const uint8_t *message, unsigned int block_nb)
 {
 	/* Note: this function requires a considerable amount of stack */
 	uint32_t w[64];
@@ -128,39 +320,23 @@ static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 	for (i = 0; i < (int) block_nb; i++) {
 		sub_block = message + (i << 6);
 
-		for (j = 0; j < 16; j++)
-			PACK32(&sub_block[j << 2], &w[j]);
-
-#ifdef CONFIG_SHA256_UNROLLED
-		for (j = 16; j < 64; j += 8) {
-			SHA256_SCR(j);
-			SHA256_SCR(j+1);
-			SHA256_SCR(j+2);
-			SHA256_SCR(j+3);
-			SHA256_SCR(j+4);
-			SHA256_SCR(j+5);
-			SHA256_SCR(j+6);
-			SHA256_SCR(j+7);
-		}
-#else
-		for (j = 16; j < 64; j++)
-			SHA256_SCR(j);
-#endif
+		SHA256_schedule(w, sub_block);
 
 		for (j = 0; j < 8; j++)
 			wv[j] = ctx->h[j];
 
-#ifdef CONFIG_SHA256_UNROLLED
-		for (j = 0; j < 64; j += 8) {
-			SHA256_EXP(0, 1, 2, 3, 4, 5, 6, 7, j);
-			SHA256_EXP(7, 0, 1, 2, 3, 4, 5, 6, j+1);
-			SHA256_EXP(6, 7, 0, 1, 2, 3, 4, 5, j+2);
-			SHA256_EXP(5, 6, 7, 0, 1, 2, 3, 4, j+3);
-			SHA256_EXP(4, 5, 6, 7, 0, 1, 2, 3, j+4);
-			SHA256_EXP(3, 4, 5, 6, 7, 0, 1, 2, j+5);
-			SHA256_EXP(2, 3, 4, 5, 6, 7, 0, 1, j+6);
-			SHA256_EXP(1, 2, 3, 4, 5, 6, 7, 0, j+7);
-		}
+#if defined(CONFIG_SHA256_FULLY_UNROLLED)
+		SHA256_EXP8(0);
+		SHA256_EXP8(8);
+		SHA256_EXP8(16);
+		SHA256_EXP8(24);
+		SHA256_EXP8(32);
+		SHA256_EXP8(40);
+		SHA256_EXP8(48);
+		SHA256_EXP8(56);
+#elif defined(CONFIG_SHA256_UNROLLED)
+		for (j = 0; j < 64; j += 8)
+			SHA256_EXP8(j);
 #else
 		for (j = 0; j < 64; j++) {
 			t1 = wv[7] + SHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
@@ -181,6 +357,19 @@ static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 			ctx->h[j] += wv[j];
 	}
 }
+#endif /* CONFIG_SHA256_INTERLEAVED */
+
+static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
+			     unsigned int block_nb)
+{
+#ifdef CONFIG_SHA256_X86_SHA_NI
+	if (cpu_has_sha_ni()) {
+		SHA256_transform_shani(ctx->h, message, block_nb);
+		return;
+	}
+#endif
+	SHA256_transform_sw(ctx, message, block_nb);
+}
 
 void SHA256_update(struct sha256_ctx *ctx, const uint8_t *data, uint32_t len)
 {
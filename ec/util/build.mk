@@ -28,10 +28,13 @@ include util/private/build.mk
 endif
 
 comm-objs=$(util-lock-objs:%=lock/%) comm-host.o comm-dev.o
-comm-objs+=comm-lpc.o comm-i2c.o misc_util.o
+comm-objs+=comm-lpc.o comm-i2c.o comm-sock.o misc_util.o
 
 iteflash-objs = iteflash.o usb_if.o
 # ectool-objs=ectool.o ectool_keyscan.o ec_flash.o ec_panicinfo.o $(comm-objs)
+# ec_flash.c hashes flash blocks with OpenSSL
+# $(out)/util/ectool: HOST_CFLAGS+=$(shell $(HOST_PKG_CONFIG) --cflags openssl)
+# $(out)/util/ectool: HOST_LDFLAGS+=$(shell $(HOST_PKG_CONFIG) --libs openssl)
 # ectool_servo-objs=$(ectool-objs) comm-servo-spi.o
 ec_sb_firmware_update-objs=ec_sb_firmware_update.o $(comm-objs) misc_util.o
 ec_sb_firmware_update-objs+=powerd_lock.o
@@ -34,6 +34,7 @@ int comm_init_dev(const char *device_name) __attribute__((weak));
 int comm_init_lpc(void) __attribute__((weak));
 int comm_init_i2c(int i2c_bus) __attribute__((weak));
 int comm_init_servo_spi(const char *device_name) __attribute__((weak));
+int comm_init_sock(const char *device_name) __attribute__((weak));
 
 static int fake_readmem(int offset, int bytes, void *dest)
 {
@@ -94,6 +95,11 @@ int comm_init_alt(int interfaces, const char *device_name, int i2c_bus)
 	    !comm_init_servo_spi(device_name))
 		return 0;
 
+	/* EC emulator */
+	if ((interfaces & COMM_SOCK) && comm_init_sock &&
+	    !comm_init_sock(device_name))
+		return 0;
+
 	/* Do not fallback to other communication methods if target is not a
 	 * cros_ec device */
 	dev_is_cros_ec = !strcmp(CROS_EC_DEV_NAME, device_name);
@@ -0,0 +1,202 @@
+/* Copyright 2021 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+/*
+ * Transport sending host commands v3 to the EC emulator over a UNIX socket
+ * (see chip/host/host_command_sock.c), to run ectool without hardware.
+ *
+ * The socket path is passed in the 'name' parameter, or in
+ * $EC_HOSTCMD_SOCKET, e.g. :
+ * ectool --interface=sock --name=build/host/ec.exe.sock version
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "comm-host.h"
+#include "cros_ec_dev.h"
+
+#ifdef DEBUG
+#define debug(format, arg...) printf(format, ##arg)
+#else
+#define debug(...)
+#endif
+
+static int sock_fd = -1;
+
+static uint8_t sum_bytes(const void *data, int length)
+{
+	const uint8_t *bytes = data;
+	uint8_t sum = 0;
+
+	while (length--)
+		sum += *bytes++;
+
+	return sum;
+}
+
+/* Read all of buf; returns 0 on success */
+static int sock_read(void *buf, int len)
+{
+	uint8_t *p = buf;
+	int rv;
+
+	while (len) {
+		rv = read(sock_fd, p, len);
+		if (rv <= 0)
+			return -1;
+		p += rv;
+		len -= rv;
+	}
+
+	return 0;
+}
+
+static int send_request(int cmd, int version,
+			const void *outdata, int outsize)
+{
+	struct ec_host_request request;
+	struct iovec iov[2];
+	int len = sizeof(request) + outsize;
+	int rv;
+
+	request.struct_version = EC_HOST_REQUEST_VERSION;
+	request.checksum = 0;
+	request.command = cmd;
+	request.command_version = version;
+	request.reserved = 0;
+	request.data_len = outsize;
+	request.checksum = -(sum_bytes(&request, sizeof(request)) +
+			     sum_bytes(outdata, outsize));
+
+	/* Header and data in one go */
+	iov[0].iov_base = &request;
+	iov[0].iov_len = sizeof(request);
+	iov[1].iov_base = (void *)outdata;
+	iov[1].iov_len = outsize;
+
+	while (len) {
+		rv = writev(sock_fd, iov, 2);
+		if (rv <= 0)
+			return -EC_RES_ERROR;
+		len -= rv;
+
+		/* Short write; skip what went out */
+		if (rv >= iov[0].iov_len) {
+			rv -= iov[0].iov_len;
+			iov[0].iov_len = 0;
+			iov[1].iov_base = (uint8_t *)iov[1].iov_base + rv;
+			iov[1].iov_len -= rv;
+		} else {
+			iov[0].iov_base = (uint8_t *)iov[0].iov_base + rv;
+			iov[0].iov_len -= rv;
+		}
+	}
+
+	return 0;
+}
+
+static int get_response(uint8_t *bodydest, size_t bodylen)
+{
+	struct ec_host_response hdr;
+	uint8_t extra[64];
+	uint8_t sum;
+	int len, rv = 0;
+
+	if (sock_read(&hdr, sizeof(hdr)))
+		goto read_error;
+
+	/* Check the header */
+	if (hdr.struct_version != EC_HOST_RESPONSE_VERSION) {
+		fprintf(stderr, "response version %d (should be %d)\n",
+			hdr.struct_version,
+			EC_HOST_RESPONSE_VERSION);
+		return -EC_RES_ERROR;
+	}
+
+	len = MIN(hdr.data_len, bodylen);
+	if (sock_read(bodydest, len))
+		goto read_error;
+	sum = sum_bytes(&hdr, sizeof(hdr)) + sum_bytes(bodydest, len);
+
+	/* Drop what does not fit, but stay in step with the EC */
+	if (hdr.data_len > bodylen) {
+		debug("EC returned too much data.\n");
+		rv = -EC_RES_RESPONSE_TOO_BIG;
+	}
+	for (len = hdr.data_len - len; len; len -= MIN(len, sizeof(extra))) {
+		if (sock_read(extra, MIN(len, sizeof(extra))))
+			goto read_error;
+		sum += sum_bytes(extra, MIN(len, sizeof(extra)));
+	}
+
+	if (sum) {
+		fprintf(stderr, "Checksum invalid\n");
+		return -EC_RES_INVALID_CHECKSUM;
+	}
+	if (rv)
+		return rv;
+
+	return hdr.result ? -EECRESULT - hdr.result : hdr.data_len;
+
+read_error:
+	fprintf(stderr, "Read failed: %s\n", strerror(errno));
+	return -EC_RES_ERROR;
+}
+
+static int ec_command_sock(int cmd, int version,
+			   const void *outdata, int outsize,
+			   void *indata, int insize)
+{
+	int ret;
+
+	ret = send_request(cmd, version, outdata, outsize);
+	if (ret) {
+		fprintf(stderr, "Write failed: %s\n", strerror(errno));
+		return ret;
+	}
+
+	return get_response(indata, insize);
+}
+
+int comm_init_sock(const char *device_name)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	const char *path = getenv("EC_HOSTCMD_SOCKET");
+
+	/* if the user mentioned a device name, use it as the socket path */
+	if (strcmp(CROS_EC_DEV_NAME, device_name))
+		path = device_name;
+	if (!path || strlen(path) >= sizeof(addr.sun_path)) {
+		debug("No EC emulator socket\n");
+		return -EC_RES_ERROR;
+	}
+	strcpy(addr.sun_path, path);
+
+	sock_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock_fd < 0)
+		return -EC_RES_ERROR;
+
+	if (connect(sock_fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		debug("Can't connect to %s: %s\n", path, strerror(errno));
+		close(sock_fd);
+		sock_fd = -1;
+		return -EC_RES_ERROR;
+	}
+
+	ec_command_proto = ec_command_sock;
+	/* Set temporary size, will be updated later. */
+	ec_max_outsize = EC_PROTO2_MAX_PARAM_SIZE - 8;
+	ec_max_insize = EC_PROTO2_MAX_PARAM_SIZE;
+
+	return 0;
+}
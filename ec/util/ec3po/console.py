@@ -32,6 +32,7 @@ import six
 
 import interpreter
 import threadproc_shim
+import tokenized_log
 
 
 PROMPT = b'> '
@@ -138,6 +139,8 @@ class Console(object):
     raw_debug: Flag to indicate whether per interrupt data should be logged to
       debug
     output_line_log_buffer: buffer for lines coming from the EC to log to debug
+    tokenized_log: A tokenized_log.Decoder for the output of EC images built
+      with CONFIG_CONSOLE_TOKENIZED, or None to show the output as is.
   """
 
   def __init__(self, master_pty, user_pty, interface_pty, cmd_pipe, dbg_pipe,
@@ -186,6 +189,7 @@ class Console(object):
     self.look_buffer = b''
     self.raw_debug = False
     self.output_line_log_buffer = []
+    self.tokenized_log = None
 
   def __str__(self):
     """Show internal state of Console object as a string."""
@@ -1025,6 +1029,11 @@ def StartLoop(console, command_active, shutdown_pipe=None):
             console.logger.debug('ec3po console received EOF from dbg_pipe')
             continue_looping = False
           else:
+            if console.tokenized_log:
+              # Tokenized lines are held back until they are complete.
+              data = console.tokenized_log.Feed(data)
+              if not data:
+                continue
             if console.interrogation_mode == b'auto':
               # Search look buffer for enhanced EC image string.
               console.CheckBufferForEnhancedImage(data)
@@ -1103,6 +1112,10 @@ def main(argv):
   parser.add_argument('--log-level',
                       default='info',
                       help='info, debug, warning, error, or critical')
+  parser.add_argument('--elf',
+                      help=('ELF file of the EC image, to decode tokenized '
+                            'console output (CONFIG_CONSOLE_TOKENIZED).'))
+  tokenized_log.AddTimestampDigitsArgument(parser)
 
   # Parse arguments.
   opts = parser.parse_args(argv)
@@ -1153,6 +1166,12 @@ def main(argv):
   # Create a console.
   console = Console(master_pty, os.ttyname(user_pty), cmd_pipe_interactive,
                     dbg_pipe_interactive)
+  if opts.elf:
+    try:
+      console.tokenized_log = tokenized_log.Decoder(
+          tokenized_log.ReadLogStrings(opts.elf), opts.timestamp_digits)
+    except (IOError, tokenized_log.DecodeError) as e:
+      parser.error(str(e))
   # Start serving the console.
   v = threadproc_shim.Value(ctypes.c_bool, False)
   StartLoop(console, v)
@@ -0,0 +1,448 @@
+#!/usr/bin/env python
+# Copyright 2021 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Decoder for tokenized EC console output.
+
+With CONFIG_CONSOLE_TOKENIZED, the EC sends cprints() output as lines of the
+form '$' base64(token, time, argument types, arguments...), where the token is
+the offset of the format string in the .log_strings section of the EC ELF
+file.  This module turns those lines back into the text the EC would have
+printed, and passes anything else through unchanged.
+"""
+
+# Note: This is a py2/3 compatible file.
+
+from __future__ import print_function
+
+import argparse
+import base64
+import binascii
+import struct
+import sys
+
+import six
+
+
+LOG_STRINGS_SECTION = b'.log_strings'
+
+# Argument types, as in include/console.h.
+ARG_END = 0
+ARG_INT32 = 1
+ARG_INT64 = 2
+ARG_STRING = 3
+
+# Longest payload we wait for before giving up on a line.
+MAX_LINE = 256
+
+# What the EC prints for a bad format specifier.
+ERROR_STR = 'ERROR'
+
+# Fractional digits of the EC's timestamps: 6 with CONFIG_CONSOLE_VERBOSE,
+# 3 without.
+DEFAULT_TIMESTAMP_DIGITS = 3
+
+
+class DecodeError(Exception):
+  """Raised when a tokenized line cannot be parsed."""
+  pass
+
+
+def ReadLogStrings(elf_path):
+  """Reads the .log_strings section of an EC ELF file.
+
+  Args:
+    elf_path: Path to the ELF file the EC image was built from.
+
+  Returns:
+    A bytes object with the contents of the section.
+
+  Raises:
+    DecodeError: If the file is not an ELF file, or has no .log_strings.
+  """
+  with open(elf_path, 'rb') as f:
+    elf = f.read()
+
+  if elf[:4] != b'\x7fELF':
+    raise DecodeError('%s is not an ELF file' % elf_path)
+  is_64 = six.indexbytes(elf, 4) == 2
+  endian = '<' if six.indexbytes(elf, 5) == 1 else '>'
+
+  if is_64:
+    shoff, = struct.unpack_from(endian + 'Q', elf, 0x28)
+    shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH', elf, 0x3a)
+    shdr_fmt = endian + 'IIQQQQ'
+  else:
+    shoff, = struct.unpack_from(endian + 'I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH', elf, 0x2e)
+    shdr_fmt = endian + 'IIIIII'
+
+  # (name, type, flags, addr, offset, size) of every section.
+  sections = [struct.unpack_from(shdr_fmt, elf, shoff + i * shentsize)
+              for i in range(shnum)]
+  names_offset = sections[shstrndx][4]
+
+  for name, _, _, _, offset, size in sections:
+    start = names_offset + name
+    if elf[start:elf.index(b'\0', start)] == LOG_STRINGS_SECTION:
+      return elf[offset:offset + size]
+
+  raise DecodeError('%s has no %s section' %
+                    (elf_path, LOG_STRINGS_SECTION.decode()))
+
+
+def FormatTimestamp(us, digits=DEFAULT_TIMESTAMP_DIGITS):
+  """Formats a time in us the way the EC prints timestamps.
+
+  Args:
+    us: The time, in us.
+    digits: The number of fractional digits, 6 or 3.  With 3 the time is
+      truncated to ms, as on the EC.
+  """
+  scale = 10 ** (6 - digits)
+  return '%d.%0*d' % (us // 1000000, digits, us % 1000000 // scale)
+
+
+def FormatEcString(fmt, args, now, timestamp_digits=DEFAULT_TIMESTAMP_DIGITS):
+  """Formats a string the way the EC's vfnprintf() would.
+
+  Arguments which cannot be recovered off the EC (%ph and %pb buffers, %pT of
+  anything but PRINTF_TIMESTAMP_NOW, or arguments which did not fit in the
+  line) are printed as placeholders in angle brackets.
+
+  Args:
+    fmt: The format string.
+    args: A list of (type, value) pairs, one per argument.
+    now: The time of the line, in us, for %pT.
+    timestamp_digits: The number of fractional digits of %pT, see
+      FormatTimestamp().
+
+  Returns:
+    The formatted string.
+  """
+  out = []
+  args = iter(args)
+  i = 0
+
+  def NextArg():
+    return next(args, (ARG_END, None))
+
+  while i < len(fmt):
+    c = fmt[i]
+    i += 1
+    if c != '%':
+      out.append(c)
+      continue
+
+    c = fmt[i] if i < len(fmt) else ''
+    i += 1
+    if c in ('%', ''):
+      out.append('%')
+      continue
+
+    if c == 'c':
+      _, v = NextArg()
+      out.append(chr(v & 0xff) if isinstance(v, six.integer_types)
+                 else '<?>')
+      continue
+
+    left = sign_flag = pad_zero = False
+    if c == '-':
+      left = True
+      c, i = fmt[i:i + 1], i + 1
+    if c == '+':
+      sign_flag = True
+      c, i = fmt[i:i + 1], i + 1
+    if c == '0':
+      pad_zero = True
+      c, i = fmt[i:i + 1], i + 1
+
+    width = 0
+    if c == '*':
+      _, width = NextArg()
+      width = width or 0
+      c, i = fmt[i:i + 1], i + 1
+    else:
+      while c.isdigit():
+        width = width * 10 + int(c)
+        c, i = fmt[i:i + 1], i + 1
+
+    precision = -1
+    if c == '.':
+      c, i = fmt[i:i + 1], i + 1
+      if c == '*':
+        _, precision = NextArg()
+        precision = precision or 0
+        c, i = fmt[i:i + 1], i + 1
+      else:
+        precision = 0
+        while c.isdigit():
+          precision = precision * 10 + int(c)
+          c, i = fmt[i:i + 1], i + 1
+
+    if c == 's':
+      arg_type, v = NextArg()
+      if v is None:
+        s = '<?>'
+      elif arg_type == ARG_STRING:
+        s = v.decode('utf-8', 'replace')
+      else:
+        s = '(NULL)' if not v else '<string>'
+    else:
+      while c in ('l', 'z'):
+        c, i = fmt[i:i + 1], i + 1
+      base = 10
+      arg_type, v = NextArg()
+      is_64 = arg_type == ARG_INT64
+      s = None
+
+      if c == 'p':
+        spec, i = fmt[i:i + 1], i + 1
+        if spec == 'T':
+          if v == 0:
+            s = FormatTimestamp(now, timestamp_digits)
+          else:
+            s = '<timestamp>'
+        elif spec == 'P':
+          base = 16
+        elif v == 0:
+          # NULL buffers print nothing
+          continue
+        elif spec == 'h':
+          s = '<hex buffer>'
+        elif spec == 'b':
+          s = '<binary>'
+        else:
+          s = ERROR_STR
+
+      if s is not None:
+        pass
+      elif c not in ('d', 'i', 'u', 'x', 'X', 'p'):
+        s = ERROR_STR
+      elif not isinstance(v, six.integer_types):
+        s = '<?>'
+      else:
+        s = _FormatInt(v, c, is_64, base, sign_flag, precision)
+      precision = -1
+
+    if precision >= 0:
+      s = s[:precision]
+      width = min(width, precision)
+    pad = max(width - len(s), 0)
+    if left:
+      s += ' ' * pad
+    else:
+      s = ('0' if pad_zero else ' ') * pad + s
+    out.append(s)
+
+  return ''.join(out)
+
+
+def _FormatInt(v, c, is_64, base, sign_flag, precision):
+  """Formats an integer argument; see FormatEcString()."""
+  bits = 64 if is_64 else 32
+  v &= (1 << bits) - 1
+  if c in ('x', 'X'):
+    base = 16
+  sign = ''
+  if c in ('d', 'i'):
+    if v >> (bits - 1):
+      sign = '-'
+      v = (1 << bits) - v
+    elif sign_flag:
+      sign = '+'
+
+  if base == 10:
+    s = '%d' % v
+    if precision >= 0:
+      s = s.rjust(precision + 1, '0')
+      s = s[:len(s) - precision] + '.' + s[len(s) - precision:]
+  else:
+    frac = ''
+    for _ in range(max(precision, 0)):
+      v, digit = divmod(v, 10)
+      frac = '%d' % digit + frac
+    if precision >= 0:
+      frac = '.' + frac
+    s = ('%X' if c == 'X' else '%x') % v + frac
+
+  return sign + s
+
+
+class Decoder(object):
+  """Streaming decoder of tokenized EC console output.
+
+  Attributes:
+    log_strings: The contents of the .log_strings section of the EC image.
+    timestamp_digits: The number of fractional digits of timestamps.
+  """
+
+  def __init__(self, log_strings, timestamp_digits=DEFAULT_TIMESTAMP_DIGITS):
+    """Initializes a Decoder object.
+
+    Args:
+      log_strings: The contents of the .log_strings section of the EC image,
+        see ReadLogStrings().
+      timestamp_digits: The number of fractional digits the EC prints in
+        timestamps: 6 if it was built with CONFIG_CONSOLE_VERBOSE, else 3.
+    """
+    self.log_strings = log_strings
+    self.timestamp_digits = timestamp_digits
+    self._at_line_start = True
+    # Payload of a tokenized line seen so far, or None if not in one.
+    self._pending = None
+
+  def _GetFormat(self, token):
+    """Returns the format string of a token."""
+    if token >= len(self.log_strings):
+      raise DecodeError('token %d out of range' % token)
+    end = self.log_strings.index(b'\0', token)
+    return self.log_strings[token:end].decode('utf-8', 'replace')
+
+  def DecodePayload(self, payload):
+    """Decodes the base64 payload of a tokenized line.
+
+    Args:
+      payload: The line, without the leading '$' and trailing newline.
+
+    Returns:
+      The text the EC would have printed for it, without the newline.
+
+    Raises:
+      DecodeError: If the payload cannot be parsed.
+    """
+    try:
+      data = bytearray(base64.b64decode(payload))
+    except (binascii.Error, TypeError) as e:
+      raise DecodeError('bad base64: %s' % e)
+    pos = [0]
+
+    def GetVarint():
+      v = shift = 0
+      while True:
+        if pos[0] >= len(data):
+          raise DecodeError('truncated varint')
+        byte = data[pos[0]]
+        pos[0] += 1
+        v |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+          return v
+
+    token = GetVarint()
+    now = GetVarint()
+    types = GetVarint()
+
+    args = []
+    while types:
+      arg_type = types & 3
+      types >>= 2
+      if pos[0] >= len(data):
+        # Left out, as it did not fit
+        args.append((arg_type, None))
+      elif arg_type == ARG_STRING:
+        length = GetVarint()
+        args.append((arg_type, bytes(data[pos[0]:pos[0] + length])))
+        pos[0] += length
+      else:
+        v = GetVarint()
+        args.append((arg_type, (v >> 1) ^ -(v & 1)))
+
+    return '[%s %s]' % (FormatTimestamp(now, self.timestamp_digits),
+                        FormatEcString(self._GetFormat(token), args, now,
+                                       self.timestamp_digits))
+
+  def _DecodeLine(self, payload):
+    """Decodes a line, or returns it unchanged if it cannot be decoded."""
+    eol = b'\n'
+    if payload.endswith(b'\r'):
+      payload, eol = payload[:-1], b'\r\n'
+    try:
+      return self.DecodePayload(payload).encode('utf-8') + eol
+    except DecodeError:
+      return b'$' + payload + eol
+
+  def Feed(self, data):
+    """Decodes a chunk of console output.
+
+    Tokenized lines are held back until they are complete, everything else is
+    returned as soon as it is seen.
+
+    Args:
+      data: A bytes object of console output.
+
+    Returns:
+      A bytes object with the decoded output.
+    """
+    out = []
+    while data:
+      if self._pending is not None:
+        nl = data.find(b'\n')
+        if nl < 0:
+          self._pending += data
+          if len(self._pending) > MAX_LINE:
+            # Not one of ours after all
+            out.append(b'$' + self._pending)
+            self._pending = None
+            self._at_line_start = False
+          break
+        out.append(self._DecodeLine(self._pending + data[:nl]))
+        data = data[nl + 1:]
+        self._pending = None
+        self._at_line_start = True
+      elif self._at_line_start and data[:1] == b'$':
+        self._pending = b''
+        data = data[1:]
+      else:
+        nl = data.find(b'\n')
+        if nl < 0:
+          out.append(data)
+          self._at_line_start = False
+          break
+        out.append(data[:nl + 1])
+        data = data[nl + 1:]
+        self._at_line_start = True
+
+    return b''.join(out)
+
+
+def AddTimestampDigitsArgument(parser):
+  """Adds the --timestamp-digits option for a Decoder to an ArgumentParser."""
+  parser.add_argument('--timestamp-digits', type=int, choices=(3, 6),
+                      default=DEFAULT_TIMESTAMP_DIGITS,
+                      help=('Fractional digits of the EC timestamps: 6 if '
+                            'the EC was built with CONFIG_CONSOLE_VERBOSE, '
+                            'else 3 (default).'))
+
+
+def main(argv):
+  """Decodes tokenized EC console output from a file or stdin."""
+  parser = argparse.ArgumentParser(description=('Decode tokenized EC console '
+                                                'output.'))
+  parser.add_argument('elf',
+                      help='The ELF file the EC image was built from.')
+  parser.add_argument('input', nargs='?',
+                      help='Console log to decode; stdin if not given.')
+  AddTimestampDigitsArgument(parser)
+  opts = parser.parse_args(argv)
+
+  try:
+    decoder = Decoder(ReadLogStrings(opts.elf), opts.timestamp_digits)
+  except DecodeError as e:
+    parser.error(str(e))
+
+  stdin = getattr(sys.stdin, 'buffer', sys.stdin)
+  stdout = getattr(sys.stdout, 'buffer', sys.stdout)
+  infile = open(opts.input, 'rb') if opts.input else stdin
+  try:
+    for line in infile:
+      stdout.write(decoder.Feed(line))
+      stdout.flush()
+  finally:
+    if opts.input:
+      infile.close()
+
+
+if __name__ == '__main__':
+  main(sys.argv[1:])
@@ -0,0 +1,224 @@
+#!/usr/bin/env python
+# Copyright 2021 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Unit tests for the tokenized EC console output decoder."""
+
+# Note: This is a py2/3 compatible file.
+
+from __future__ import print_function
+
+import base64
+import struct
+import tempfile
+import unittest
+
+import six
+
+import tokenized_log
+from tokenized_log import ARG_INT32, ARG_INT64, ARG_STRING
+
+# Format strings, as they would be laid out in .log_strings.
+LOG_STRINGS = b'boot\0val %d %u %lld\0name %s %d\0[%pT] %ph\0'
+TOKEN_BOOT = 0
+TOKEN_VAL = LOG_STRINGS.index(b'val')
+TOKEN_NAME = LOG_STRINGS.index(b'name')
+TOKEN_TIME = LOG_STRINGS.index(b'[%pT]')
+
+
+def Varint(v):
+  """Encodes a varint like the EC does."""
+  out = bytearray()
+  while True:
+    out.append((v & 0x7f) | (0x80 if v >> 7 else 0))
+    v >>= 7
+    if not v:
+      return bytes(out)
+
+
+def Zigzag(v):
+  return (v << 1) ^ (v >> 63)
+
+
+def EncodeLine(token, now, args, eol=b'\r\n'):
+  """Encodes a tokenized line like cprints_tokenized() does.
+
+  Args:
+    token: Offset of the format string in LOG_STRINGS.
+    now: Time of the line in us.
+    args: A list of (type, value) pairs.
+    eol: The line ending.
+  """
+  types = 0
+  for n, (arg_type, _) in enumerate(args):
+    types |= arg_type << (2 * n)
+
+  data = Varint(token) + Varint(now) + Varint(types)
+  for arg_type, v in args:
+    if arg_type == ARG_STRING:
+      data += Varint(len(v)) + v
+    else:
+      data += Varint(Zigzag(v))
+
+  return b'$' + base64.b64encode(data) + eol
+
+
+class TestFormatEcString(unittest.TestCase):
+  """Test formatting strings the way the EC does."""
+
+  def CheckFormat(self, fmt, args, expected, timestamp_digits=3):
+    self.assertEqual(tokenized_log.FormatEcString(fmt, args, 1234567,
+                                                  timestamp_digits),
+                     expected)
+
+  def test_Integers(self):
+    self.CheckFormat('%d %u %x %X', [(ARG_INT32, -5), (ARG_INT32, -1),
+                                     (ARG_INT32, 0xbeef), (ARG_INT32, 0xbeef)],
+                     '-5 4294967295 beef BEEF')
+    self.CheckFormat('%lld %llu', [(ARG_INT64, -(1 << 40)),
+                                   (ARG_INT64, -1)],
+                     '-1099511627776 18446744073709551615')
+    self.CheckFormat('%+d %+d', [(ARG_INT32, 3), (ARG_INT32, -3)], '+3 -3')
+
+  def test_Padding(self):
+    self.CheckFormat('%08x|%-4d|%4d', [(ARG_INT32, 0x1234), (ARG_INT32, 7),
+                                       (ARG_INT32, 7)],
+                     '00001234|7   |   7')
+    self.CheckFormat('%*d', [(ARG_INT32, 5), (ARG_INT32, 42)], '   42')
+    self.CheckFormat('%.3s|%-6s|', [(ARG_STRING, b'abcdef'),
+                                    (ARG_STRING, b'ab')],
+                     'abc|ab    |')
+
+  def test_FixedPoint(self):
+    self.CheckFormat('%.3d %.6d', [(ARG_INT32, 12345), (ARG_INT32, 42)],
+                     '12.345 0.000042')
+    self.CheckFormat('%.2d', [(ARG_INT32, -150)], '-1.50')
+
+  def test_Pointers(self):
+    self.CheckFormat('%pT', [(ARG_INT32, 0)], '1.234')
+    self.CheckFormat('%pT', [(ARG_INT32, 0)], '1.234567', timestamp_digits=6)
+    self.CheckFormat('%pT', [(ARG_INT32, 0x20001000)], '<timestamp>')
+    self.CheckFormat('%pP', [(ARG_INT32, 0x20001000)], '20001000')
+    self.CheckFormat('[%ph]', [(ARG_INT32, 0x20001000)], '[<hex buffer>]')
+    self.CheckFormat('[%ph]', [(ARG_INT32, 0)], '[]')
+
+  def test_Missing(self):
+    self.CheckFormat('%d %s', [(ARG_INT32, 1)], '1 <?>')
+    self.CheckFormat('%s', [(ARG_STRING, None)], '<?>')
+    self.CheckFormat('%s', [(ARG_INT32, 0)], '(NULL)')
+
+  def test_Misc(self):
+    self.CheckFormat('100%% %c', [(ARG_INT32, ord('x'))], '100% x')
+    self.CheckFormat('%q', [(ARG_INT32, 1)], 'ERROR')
+
+
+class TestDecoder(unittest.TestCase):
+  """Test decoding tokenized console output."""
+
+  def setUp(self):
+    self.decoder = tokenized_log.Decoder(LOG_STRINGS)
+
+  def test_DecodeLine(self):
+    line = EncodeLine(TOKEN_VAL, 12345678, [(ARG_INT32, -5), (ARG_INT32, 300),
+                                            (ARG_INT64, -(1 << 40))])
+    self.assertEqual(self.decoder.Feed(line),
+                     b'[12.345 val -5 300 -1099511627776]\r\n')
+
+    line = EncodeLine(TOKEN_BOOT, 1, [], eol=b'\n')
+    self.assertEqual(self.decoder.Feed(line), b'[0.000 boot]\n')
+
+    line = EncodeLine(TOKEN_TIME, 2000000, [(ARG_INT32, 0), (ARG_INT32, 0)])
+    self.assertEqual(self.decoder.Feed(line), b'[2.000 [2.000] ]\r\n')
+
+  def test_VerboseTimestamps(self):
+    """With CONFIG_CONSOLE_VERBOSE the EC prints timestamps in us."""
+    decoder = tokenized_log.Decoder(LOG_STRINGS, timestamp_digits=6)
+
+    line = EncodeLine(TOKEN_BOOT, 1, [], eol=b'\n')
+    self.assertEqual(decoder.Feed(line), b'[0.000001 boot]\n')
+
+    line = EncodeLine(TOKEN_TIME, 2000123, [(ARG_INT32, 0), (ARG_INT32, 0)])
+    self.assertEqual(decoder.Feed(line), b'[2.000123 [2.000123] ]\r\n')
+
+  def test_TruncatedArguments(self):
+    # The integer after the string did not fit
+    line = EncodeLine(TOKEN_NAME, 0, [(ARG_STRING, b'ab'), (ARG_INT32, 1)])
+    data = base64.b64decode(line[1:-2])[:-1]
+    line = b'$' + base64.b64encode(data) + b'\r\n'
+    self.assertEqual(self.decoder.Feed(line), b'[0.000 name ab <?>]\r\n')
+
+  def test_Chunks(self):
+    """Tokenized lines may arrive in pieces, mixed with text."""
+    data = (b'> help\r\n' +
+            EncodeLine(TOKEN_NAME, 5, [(ARG_STRING, b'usb'),
+                                       (ARG_INT32, 2)]) +
+            b'text with a $ in it\r\n$not base64\r\n')
+    expected = (b'> help\r\n[0.000 name usb 2]\r\n'
+                b'text with a $ in it\r\n$not base64\r\n')
+
+    for size in (1, 3, 7, len(data)):
+      decoder = tokenized_log.Decoder(LOG_STRINGS)
+      out = b''
+      for i in range(0, len(data), size):
+        out += decoder.Feed(data[i:i + size])
+      self.assertEqual(out, expected)
+
+  def test_PartialText(self):
+    """Text without a newline is not held back."""
+    self.assertEqual(self.decoder.Feed(b'> '), b'> ')
+    # Not at the start of a line any more
+    self.assertEqual(self.decoder.Feed(b'$x\n'), b'$x\n')
+
+  def test_BadToken(self):
+    line = EncodeLine(len(LOG_STRINGS) + 10, 0, [])
+    self.assertEqual(self.decoder.Feed(line), line)
+
+
+class TestReadLogStrings(unittest.TestCase):
+  """Test reading .log_strings out of an ELF file."""
+
+  def MakeElf32(self, sections):
+    """Builds a little endian ELF32 file with only section headers.
+
+    Args:
+      sections: A list of (name, contents) pairs.
+    """
+    names = b'\0.shstrtab\0'
+    body = b''
+    headers = [struct.pack('<IIIIIIIIII', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)]
+    data_offset = 52
+    for name, contents in sections:
+      headers.append(struct.pack('<IIIIIIIIII', len(names), 1, 0, 0,
+                                 data_offset + len(body), len(contents),
+                                 0, 0, 1, 0))
+      names += name + b'\0'
+      body += contents
+    headers.append(struct.pack('<IIIIIIIIII', 1, 3, 0, 0,
+                               data_offset + len(body), len(names),
+                               0, 0, 1, 0))
+    body += names
+
+    ehdr = b'\x7fELF' + six.int2byte(1) + six.int2byte(1) + b'\0' * 10
+    ehdr += struct.pack('<HHIIIIIHHHHHH', 2, 40, 1, 0, 0,
+                        data_offset + len(body), 0, 52, 0, 0, 40,
+                        len(headers), len(headers) - 1)
+    return ehdr + body + b''.join(headers)
+
+  def test_ReadLogStrings(self):
+    with tempfile.NamedTemporaryFile() as f:
+      f.write(self.MakeElf32([(b'.text', b'\0' * 16),
+                              (b'.log_strings', LOG_STRINGS)]))
+      f.flush()
+      self.assertEqual(tokenized_log.ReadLogStrings(f.name), LOG_STRINGS)
+
+  def test_NoSection(self):
+    with tempfile.NamedTemporaryFile() as f:
+      f.write(self.MakeElf32([(b'.text', b'\0' * 16)]))
+      f.flush()
+      with self.assertRaises(tokenized_log.DecodeError):
+        tokenized_log.ReadLogStrings(f.name)
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -9,6 +9,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <openssl/sha.h>
+
 #include "comm-host.h"
 #include "misc_util.h"
 #include "timer.h"
@@ -132,15 +134,16 @@ static int get_flash_write_size(void)
 	return write_size;
 }
 
-int ec_flash_write(const uint8_t *buf, int offset, int size)
+/**
+ * @return Bytes of data to send per EC_CMD_FLASH_WRITE on success, negative
+ * on failure
+ */
+static int get_flash_write_step(void)
 {
-	struct ec_params_flash_write *p =
-		(struct ec_params_flash_write *)ec_outbuf;
 	int write_size;
-	int pdata_max_size = (int)(ec_max_outsize - sizeof(*p));
+	int pdata_max_size = (int)(ec_max_outsize -
+				   sizeof(struct ec_params_flash_write));
 	int step;
-	int rv;
-	int i;
 
 	/*
 	 * Determine whether we can use version 1 of the EC_CMD_FLASH_WRITE
@@ -168,8 +171,16 @@ int ec_flash_write(const uint8_t *buf, int offset, int size)
 		return -1;
 	}
 
-	/* Write data in chunks */
-	printf("Write size %d...\n", step);
+	return step;
+}
+
+static int flash_write_steps(const uint8_t *buf, int offset, int size,
+			     int step)
+{
+	struct ec_params_flash_write *p =
+		(struct ec_params_flash_write *)ec_outbuf;
+	int rv;
+	int i;
 
 	for (i = 0; i < size; i += step) {
 		p->offset = offset + i;
@@ -186,6 +197,20 @@ int ec_flash_write(const uint8_t *buf, int offset, int size)
 	return 0;
 }
 
+int ec_flash_write(const uint8_t *buf, int offset, int size)
+{
+	int step;
+
+	step = get_flash_write_step();
+	if (step < 0)
+		return step;
+
+	/* Write data in chunks */
+	printf("Write size %d...\n", step);
+
+	return flash_write_steps(buf, offset, size, step);
+}
+
 int ec_flash_erase(int offset, int size)
 {
 	struct ec_params_flash_erase p;
@@ -229,3 +254,305 @@ int ec_flash_erase_async(int offset, int size)
 	}
 	return rv;
 }
+
+/* Most banks to get from EC_CMD_FLASH_INFO version 2 */
+#define MAX_FLASH_BANKS 16
+
+/* Flash area whose erase blocks all have the same size */
+struct erase_region {
+	int offset;
+	int size;
+	int erase_size;
+};
+
+/* Erase block of the range being updated */
+struct flash_block {
+	int offset;
+	int size;
+	int changed;
+};
+
+/**
+ * Get how the flash is split into erase blocks.
+ *
+ * @param regions	Destination for up to MAX_FLASH_BANKS regions
+ * @param erased	Returns the value of erased flash bytes
+ * @return Number of regions on success, negative on failure
+ */
+static int get_erase_regions(struct erase_region *regions, uint8_t *erased)
+{
+	struct ec_params_flash_info_2 p = { 0 };
+	struct {
+		struct ec_response_flash_info_2 info;
+		struct ec_flash_bank banks[MAX_FLASH_BANKS];
+	} r2;
+	struct ec_response_flash_info_1 r1 = { 0 };
+	int offset = 0;
+	int rv;
+	int i;
+
+	if (!ec_cmd_version_supported(EC_CMD_FLASH_INFO, 2)) {
+		/* Version 0 leaves the flags at 0 */
+		if (ec_cmd_version_supported(EC_CMD_FLASH_INFO, 1))
+			rv = ec_command(EC_CMD_FLASH_INFO, 1, NULL, 0,
+					&r1, sizeof(r1));
+		else
+			rv = ec_command(EC_CMD_FLASH_INFO, 0, NULL, 0,
+					&r1, sizeof(struct ec_response_flash_info));
+		if (rv < 0)
+			return rv;
+
+		*erased = (r1.flags & EC_FLASH_INFO_ERASE_TO_0) ? 0 : 0xff;
+		regions[0].offset = 0;
+		regions[0].size = r1.flash_size;
+		regions[0].erase_size = r1.erase_block_size;
+		return 1;
+	}
+
+	p.num_banks_desc = MIN(MAX_FLASH_BANKS,
+			       (ec_max_insize - sizeof(r2.info)) /
+			       sizeof(r2.banks[0]));
+	rv = ec_command(EC_CMD_FLASH_INFO, 2, &p, sizeof(p), &r2,
+			sizeof(r2.info) + p.num_banks_desc * sizeof(r2.banks[0]));
+	if (rv < 0)
+		return rv;
+
+	*erased = (r2.info.flags & EC_FLASH_INFO_ERASE_TO_0) ? 0 : 0xff;
+	for (i = 0; i < r2.info.num_banks_desc && i < p.num_banks_desc; i++) {
+		regions[i].offset = offset;
+		regions[i].size = r2.banks[i].count << r2.banks[i].size_exp;
+		regions[i].erase_size = 1 << r2.banks[i].erase_size_exp;
+		offset += regions[i].size;
+	}
+
+	return i;
+}
+
+/**
+ * Split a flash range into erase blocks.
+ *
+ * @param offset	Start of the range, on an erase block boundary
+ * @param size		Size of the range; the last block may go past its end
+ * @param blocks	Returns the blocks, to be freed by the caller
+ * @param erased	Returns the value of erased flash bytes
+ * @return Number of blocks on success, negative on failure
+ */
+static int get_erase_blocks(int offset, int size, struct flash_block **blocks,
+			    uint8_t *erased)
+{
+	struct erase_region regions[MAX_FLASH_BANKS];
+	int num_regions;
+	int min_erase_size = INT32_MAX;
+	int count = 0;
+	int pos = offset;
+	int i;
+
+	num_regions = get_erase_regions(regions, erased);
+	if (num_regions < 0)
+		return num_regions;
+
+	for (i = 0; i < num_regions; i++) {
+		if (regions[i].erase_size <= 0) {
+			fprintf(stderr, "Bad erase block size %d\n",
+				regions[i].erase_size);
+			return -1;
+		}
+		min_erase_size = MIN(min_erase_size, regions[i].erase_size);
+	}
+
+	*blocks = calloc(size / min_erase_size + 1, sizeof(**blocks));
+	if (!*blocks) {
+		fprintf(stderr, "Unable to allocate buffer.\n");
+		return -1;
+	}
+
+	for (i = 0; i < num_regions && pos < offset + size; i++) {
+		const struct erase_region *r = &regions[i];
+
+		if (pos >= r->offset + r->size)
+			continue;
+		if ((pos - r->offset) % r->erase_size) {
+			fprintf(stderr, "Offset 0x%x is not on an erase block "
+				"boundary\n", pos);
+			free(*blocks);
+			return -1;
+		}
+
+		for (; pos < r->offset + r->size && pos < offset + size;
+		     pos += r->erase_size, count++) {
+			(*blocks)[count].offset = pos;
+			(*blocks)[count].size = r->erase_size;
+		}
+	}
+
+	if (pos < offset + size) {
+		fprintf(stderr, "Image goes past the end of flash\n");
+		free(*blocks);
+		return -1;
+	}
+
+	return count;
+}
+
+/*
+ * Hash a block the way the EC will once it is written: the image, then
+ * erased flash for the part of the last block past the end of the image.
+ */
+static int hash_image_block(const uint8_t *buf, int offset, int size,
+			    const struct flash_block *b, uint8_t erased,
+			    uint8_t *hash)
+{
+	int start = b->offset - offset;
+	int len = MIN(b->size, size - start);
+	uint8_t *data;
+
+	if (len == b->size) {
+		SHA256(buf + start, len, hash);
+		return 0;
+	}
+
+	data = malloc(b->size);
+	if (!data) {
+		fprintf(stderr, "Unable to allocate buffer.\n");
+		return -1;
+	}
+	memcpy(data, buf + start, len);
+	memset(data + len, erased, b->size - len);
+	SHA256(data, b->size, hash);
+	free(data);
+
+	return 0;
+}
+
+/**
+ * Mark the blocks whose hash on the EC differs from the image as changed.
+ *
+ * @return Number of changed blocks on success, negative on failure
+ */
+static int find_changed_blocks(const uint8_t *buf, int offset, int size,
+			       struct flash_block *blocks, int count,
+			       uint8_t erased)
+{
+	struct ec_params_flash_block_hash p;
+	struct ec_response_flash_block_hash *r = ec_inbuf;
+	uint8_t hash[SHA256_DIGEST_LENGTH];
+	int max_blocks = ec_max_insize / EC_FLASH_BLOCK_HASH_SIZE;
+	int changed = 0;
+	int rv;
+	int i, j, n;
+
+	for (i = 0; i < count; i += n) {
+		/* As many blocks of the same size as fit in a response */
+		for (n = 1; n < max_blocks && i + n < count &&
+			    blocks[i + n].size == blocks[i].size; n++)
+			;
+		p.offset = blocks[i].offset;
+		p.block_size = blocks[i].size;
+		p.num_blocks = n;
+
+		rv = ec_command(EC_CMD_FLASH_BLOCK_HASH, 0, &p, sizeof(p),
+				r, n * EC_FLASH_BLOCK_HASH_SIZE);
+		if (rv < 0) {
+			fprintf(stderr, "Hash error at offset %d\n", p.offset);
+			return rv;
+		}
+
+		/* The EC may have hashed fewer blocks */
+		n = rv / EC_FLASH_BLOCK_HASH_SIZE;
+		if (!n) {
+			fprintf(stderr, "No hash at offset %d\n", p.offset);
+			return -1;
+		}
+
+		for (j = i; j < i + n; j++) {
+			if (hash_image_block(buf, offset, size, &blocks[j],
+					     erased, hash))
+				return -1;
+			blocks[j].changed = !!memcmp(hash, r->hash[j - i],
+						     sizeof(hash));
+			changed += blocks[j].changed;
+		}
+	}
+
+	return changed;
+}
+
+static int next_changed_block(const struct flash_block *blocks, int count,
+			      int i)
+{
+	while (i < count && !blocks[i].changed)
+		i++;
+
+	return i;
+}
+
+/* Erase and write the changed blocks */
+static int write_changed_blocks(const uint8_t *buf, int offset, int size,
+				const struct flash_block *blocks, int count)
+{
+	int step;
+	int rv;
+	int i;
+
+	step = get_flash_write_step();
+	if (step < 0)
+		return step;
+
+	/*
+	 * Each erase has to finish before the block is written: the EC runs
+	 * deferred erases from the hooks task, and the flash controller cannot
+	 * erase one sector while programming another.
+	 */
+	for (i = next_changed_block(blocks, count, 0); i < count;
+	     i = next_changed_block(blocks, count, i + 1)) {
+		const struct flash_block *b = &blocks[i];
+		int start = b->offset - offset;
+
+		rv = ec_flash_erase(b->offset, b->size);
+		if (rv < 0) {
+			fprintf(stderr, "Erase error at offset %d\n",
+				b->offset);
+			return rv;
+		}
+
+		rv = flash_write_steps(buf + start, b->offset,
+				       MIN(b->size, size - start), step);
+		if (rv < 0)
+			return rv;
+	}
+
+	return 0;
+}
+
+int ec_flash_update(const uint8_t *buf, int offset, int size)
+{
+	struct flash_block *blocks;
+	uint8_t erased;
+	int count, changed;
+	int rv;
+	int i;
+
+	count = get_erase_blocks(offset, size, &blocks, &erased);
+	if (count < 0)
+		return count;
+
+	if (ec_cmd_version_supported(EC_CMD_FLASH_BLOCK_HASH, 0)) {
+		changed = find_changed_blocks(buf, offset, size, blocks,
+					      count, erased);
+		if (changed < 0) {
+			free(blocks);
+			return changed;
+		}
+	} else {
+		printf("EC cannot hash flash blocks, rewriting all.\n");
+		for (i = 0; i < count; i++)
+			blocks[i].changed = 1;
+		changed = count;
+	}
+
+	printf("%d of %d erase blocks changed.\n", changed, count);
+	rv = write_changed_blocks(buf, offset, size, blocks, count);
+
+	free(blocks);
+	return rv;
+}
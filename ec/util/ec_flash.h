@@ -59,4 +59,18 @@ int ec_flash_erase(int offset, int size);
  */
 int ec_flash_erase_async(int offset, int size);
 
+/**
+ * Update EC flash memory, only erasing and writing the erase blocks which
+ * differ from the source buffer.
+ *
+ * The rest of the last erase block, past the end of the buffer, is erased.
+ *
+ * @param buf		Source buffer
+ * @param offset	Offset in EC flash to write, on an erase block boundary
+ * @param size		Number of bytes to write
+ *
+ * @return 0 if success, negative if error.
+ */
+int ec_flash_update(const uint8_t *buf, int offset, int size);
+
 #endif
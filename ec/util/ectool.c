@@ -29,6 +29,7 @@
 #include "lightbar.h"
 #include "lock/gec_lock.h"
 #include "misc_util.h"
+#include "motion_sense_fifo_compact.h"
 #include "panic.h"
 #include "usb_pd.h"
 
@@ -72,6 +73,8 @@ const char help_str[] =
 	"      Turn on automatic fan speed control.\n"
 	"  backlight <enabled>\n"
 	"      Enable/disable LCD backlight\n"
+	"  batch [count]\n"
+	"      Measure commands/sec, one at a time and batched\n"
 	"  battery\n"
 	"      Prints battery info\n"
 	"  batterycutoff [at-shutdown]\n"
@@ -96,8 +99,9 @@ const char help_str[] =
 	"      Prints chip info\n"
 	"  cmdversions <cmd>\n"
 	"      Prints supported version mask for a command number\n"
-	"  console\n"
-	"      Prints the last output to the EC debug console\n"
+	"  console [--follow]\n"
+	"      Prints the last output to the EC debug console, and with\n"
+	"      --follow, keeps printing new output as it comes\n"
 	"  cec\n"
 	"      Read or write CEC messages and settings\n"
 	"  echash [CMDS]\n"
@@ -140,6 +144,8 @@ const char help_str[] =
 	"      Prints or sets EC flash protection state\n"
 	"  flashread <offset> <size> <outfile>\n"
 	"      Reads from EC flash to a file\n"
+	"  flashupdate <offset> <infile>\n"
+	"      Erases and writes the EC flash blocks which differ from a file\n"
 	"  flashwrite <offset> <infile>\n"
 	"      Writes to EC flash from a file\n"
 	"  forcelidopen <enable>\n"
@@ -170,6 +176,8 @@ const char help_str[] =
 	"      Checks for basic communication with EC\n"
 	"  hibdelay [sec]\n"
 	"      Set the delay before going into hibernation\n"
+	"  hostcmdstats [clear]\n"
+	"      Show host command call counts and latencies, busiest first\n"
 	"  hostsleepstate\n"
 	"      Report host sleep state to the EC\n"
 	"  hostevent\n"
@@ -381,13 +389,15 @@ int parse_bool(const char *s, int *dest)
 
 void print_help(const char *prog, int print_cmds)
 {
-	printf("Usage: %s [--dev=n] [--interface=dev|i2c|lpc] [--i2c_bus=n]",
-	       prog);
+	printf("Usage: %s [--dev=n] [--interface=dev|i2c|lpc|sock] "
+	       "[--i2c_bus=n]", prog);
 	printf("[--name=cros_ec|cros_fp|cros_pd|cros_scp|cros_ish] [--ascii] ");
 	printf("<command> [params]\n\n");
 	printf("  --i2c_bus=n  Specifies the number of an I2C bus to use. For\n"
 	       "               example, to use /dev/i2c-7, pass --i2c_bus=7.\n"
 	       "               Implies --interface=i2c.\n\n");
+	printf("  --interface=sock  Talks to the EC emulator, on the socket\n"
+	       "               given by --name or $EC_HOSTCMD_SOCKET.\n\n");
 	if (print_cmds)
 		puts(help_str);
 	else
@@ -532,6 +542,136 @@ int cmd_hello(int argc, char *argv[])
 	return 0;
 }
 
+static uint64_t batch_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int batch_check_hello(const struct ec_response_hello *r)
+{
+	if (r->out_data != 0xa1b2c3d4) {
+		fprintf(stderr, "Expected response 0x%08x, got 0x%08x\n",
+			0xa1b2c3d4, r->out_data);
+		return -1;
+	}
+	return 0;
+}
+
+int cmd_batch(int argc, char *argv[])
+{
+	struct ec_params_hello p = { .in_data = 0xa0b0c0d0 };
+	struct ec_response_hello r;
+	struct ec_response_get_features features;
+	struct ec_params_batch *b;
+	struct ec_response_batch *br = ec_inbuf;
+	struct ec_host_request *req;
+	const struct ec_host_response *resp;
+	const int entry_size = EC_BATCH_ENTRY_SIZE(*req, sizeof(p));
+	int count = 1000, per_batch, done, rv, i, j;
+	uint64_t single_us, batch_us;
+	uint8_t csum;
+	char *e;
+
+	if (argc > 1) {
+		count = strtol(argv[1], &e, 0);
+		if ((e && *e) || count <= 0) {
+			fprintf(stderr, "Bad count.\n");
+			return -1;
+		}
+	}
+
+	single_us = batch_time_us();
+	for (i = 0; i < count; i++) {
+		rv = ec_command(EC_CMD_HELLO, 0, &p, sizeof(p), &r, sizeof(r));
+		if (rv < 0)
+			return rv;
+		if (batch_check_hello(&r))
+			return -1;
+	}
+	single_us = batch_time_us() - single_us + 1;
+	printf("%d commands one at a time: %.0f commands/s\n", count,
+	       count * 1e6 / single_us);
+
+	rv = ec_command(EC_CMD_GET_FEATURES, 0, NULL, 0,
+			&features, sizeof(features));
+	if (rv < 0)
+		return rv;
+	if (!(features.flags[1] & EC_FEATURE_MASK_1(EC_FEATURE_HOST_BATCH))) {
+		fprintf(stderr, "EC does not support batched commands.\n");
+		return -1;
+	}
+
+	/* As many hellos as fit in both directions */
+	per_batch = MIN((ec_max_outsize - (int)sizeof(*b)) / entry_size,
+			(ec_max_insize - (int)sizeof(*br)) / entry_size);
+	per_batch = MIN(per_batch, UINT8_MAX);
+	if (per_batch <= 0) {
+		fprintf(stderr, "Transport too small to batch commands.\n");
+		return -1;
+	}
+
+	b = calloc(1, sizeof(*b) + per_batch * entry_size);
+	if (!b) {
+		fprintf(stderr, "Unable to allocate buffer.\n");
+		return -1;
+	}
+	for (i = 0; i < per_batch; i++) {
+		req = (struct ec_host_request *)(b->requests + i * entry_size);
+		req->struct_version = EC_HOST_REQUEST_VERSION;
+		req->command = EC_CMD_HELLO;
+		req->data_len = sizeof(p);
+		memcpy(req + 1, &p, sizeof(p));
+		for (csum = 0, j = 0; j < sizeof(*req) + sizeof(p); j++)
+			csum += ((uint8_t *)req)[j];
+		req->checksum = -csum;
+	}
+
+	batch_us = batch_time_us();
+	for (done = 0; done < count; done += b->count) {
+		b->count = MIN(per_batch, count - done);
+		rv = ec_command(EC_CMD_BATCH, 0, b,
+				sizeof(*b) + b->count * entry_size,
+				ec_inbuf, ec_max_insize);
+		if (rv < 0)
+			break;
+		if (br->count != b->count) {
+			fprintf(stderr, "Batch ran %d of %d commands\n",
+				br->count, b->count);
+			rv = -1;
+			break;
+		}
+		resp = (const struct ec_host_response *)br->responses;
+		for (i = 0; i < br->count; i++) {
+			if (resp->result != EC_RES_SUCCESS) {
+				fprintf(stderr, "Batched command %d failed: "
+					"%d\n", i, resp->result);
+				rv = -1;
+				break;
+			}
+			rv = batch_check_hello((const void *)(resp + 1));
+			if (rv)
+				break;
+			resp = (const void *)((const uint8_t *)resp +
+				EC_BATCH_ENTRY_SIZE(*resp, resp->data_len));
+		}
+		if (rv < 0)
+			break;
+	}
+	free(b);
+	if (rv < 0)
+		return rv;
+	batch_us = batch_time_us() - batch_us + 1;
+
+	printf("%d commands in batches of %d: %.0f commands/s (%.1fx)\n",
+	       count, per_batch, count * 1e6 / batch_us,
+	       (double)single_us / batch_us);
+
+	return 0;
+}
+
 int cmd_hibdelay(int argc, char *argv[])
 {
 	struct ec_params_hibernation_delay p;
@@ -750,6 +890,117 @@ int cmd_hostsleepstate(int argc, char *argv[])
 	return 0;
 }
 
+/* Rough total time spent in a host command, from its latency histogram */
+static uint64_t hostcmd_stats_total_us(const struct ec_hostcmd_stats_entry *e)
+{
+	uint64_t total = e->histogram[0];
+	int i;
+
+	/* Count each call as the middle of its bucket */
+	for (i = 1; i < EC_HOSTCMD_STATS_BUCKETS; i++)
+		total += (uint64_t)e->histogram[i] * (3 << (i - 1));
+
+	return total;
+}
+
+static int hostcmd_stats_compare(const void *a, const void *b)
+{
+	uint64_t ta = hostcmd_stats_total_us(a);
+	uint64_t tb = hostcmd_stats_total_us(b);
+
+	return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+/* Upper bound, in us, of the bucket holding the given percentile */
+static unsigned int hostcmd_stats_percentile(
+	const struct ec_hostcmd_stats_entry *e, int percent)
+{
+	unsigned int calls = 0, sum = 0;
+	int i;
+
+	for (i = 0; i < EC_HOSTCMD_STATS_BUCKETS; i++)
+		calls += e->histogram[i];
+
+	for (i = 0; i < EC_HOSTCMD_STATS_BUCKETS - 1; i++) {
+		sum += e->histogram[i];
+		if (sum * 100 >= calls * percent)
+			break;
+	}
+
+	return 2 << i;
+}
+
+int cmd_hostcmd_stats(int argc, char *argv[])
+{
+	struct ec_params_hostcmd_stats p = { 0 };
+	struct ec_response_hostcmd_stats *r = ec_inbuf;
+	struct ec_hostcmd_stats_entry *entries = NULL, *e;
+	int count = 0, total = 0, rv, i, last;
+
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "clear"))) {
+		fprintf(stderr, "Usage: %s [clear]\n", argv[0]);
+		return -1;
+	}
+	if (argc == 2)
+		p.flags = EC_HOSTCMD_STATS_FLAG_CLEAR;
+
+	do {
+		rv = ec_command(EC_CMD_HOSTCMD_STATS, 0, &p, sizeof(p),
+				ec_inbuf, ec_max_insize);
+		if (rv < 0) {
+			fprintf(stderr, "Error reading host command stats: "
+				"%d\n", rv);
+			free(entries);
+			return rv;
+		}
+		if (rv < (int)sizeof(*r) ||
+		    r->count > (rv - sizeof(*r)) / sizeof(r->entries[0])) {
+			fprintf(stderr, "Bad host command stats response.\n");
+			free(entries);
+			return -1;
+		}
+		if (!entries) {
+			total = r->total;
+			entries = calloc(total, sizeof(*entries));
+			if (!entries) {
+				fprintf(stderr, "Unable to allocate buffer.\n");
+				return -1;
+			}
+		} else if (r->total != total) {
+			fprintf(stderr, "Host commands changed while reading "
+				"stats.\n");
+			free(entries);
+			return -1;
+		}
+
+		for (i = 0; i < r->count && p.offset + i < total; i++)
+			if (r->entries[i].count)
+				entries[count++] = r->entries[i];
+		p.offset += r->count;
+	} while (r->count && p.offset < total);
+
+	qsort(entries, count, sizeof(*entries), hostcmd_stats_compare);
+
+	printf("Command      Calls   ~Time ms  p50 us  p99 us  "
+	       "Calls per log2 us bucket\n");
+	for (e = entries; e < entries + count; e++) {
+		printf("0x%04x  %10u  %9.1f  %6u  %6u ", e->command, e->count,
+		       hostcmd_stats_total_us(e) / 1000.0,
+		       hostcmd_stats_percentile(e, 50),
+		       hostcmd_stats_percentile(e, 99));
+
+		for (last = EC_HOSTCMD_STATS_BUCKETS - 1; last > 0; last--)
+			if (e->histogram[last])
+				break;
+		for (i = 0; i <= last; i++)
+			printf(" %u", e->histogram[i]);
+		printf("\n");
+	}
+
+	free(entries);
+	return 0;
+}
+
 int cmd_test(int argc, char *argv[])
 {
 	struct ec_params_test_protocol p = {
@@ -864,6 +1115,7 @@ static const char * const ec_feature_names[] = {
 		"Host-controlled Type-C mode entry",
 	[EC_FEATURE_TYPEC_MUX_REQUIRE_AP_ACK] =
 		"AP ack for Type-C mux configuration",
+	[EC_FEATURE_HOST_BATCH] = "Batched host commands",
 };
 
 int cmd_inventory(int argc, char *argv[])
@@ -1465,6 +1717,43 @@ int cmd_flash_write(int argc, char *argv[])
 	return 0;
 }
 
+int cmd_flash_update(int argc, char *argv[])
+{
+	int offset, size;
+	int rv;
+	char *e;
+	char *buf;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <offset> <filename>\n", argv[0]);
+		return -1;
+	}
+
+	offset = strtol(argv[1], &e, 0);
+	if ((e && *e) || offset < 0 || offset > MAX_FLASH_SIZE) {
+		fprintf(stderr, "Bad offset.\n");
+		return -1;
+	}
+
+	/* Read the input file */
+	buf = read_file(argv[2], &size);
+	if (!buf)
+		return -1;
+
+	printf("Updating from offset %d...\n", offset);
+
+	/* Only erase and write the blocks which changed */
+	rv = ec_flash_update((const uint8_t *)buf, offset, size);
+
+	free(buf);
+
+	if (rv < 0)
+		return rv;
+
+	printf("done.\n");
+	return 0;
+}
+
 int cmd_flash_erase(int argc, char *argv[])
 {
 	int offset, size;
@@ -4985,6 +5274,7 @@ static const struct {
 	ST_BOTH_SIZES(sensor_scale),
 	ST_BOTH_SIZES(online_calib_read),
 	ST_BOTH_SIZES(get_activity),
+	ST_BOTH_SIZES(fifo_read_compact),
 };
 BUILD_ASSERT(ARRAY_SIZE(ms_command_sizes) == MOTIONSENSE_NUM_CMDS);
 
@@ -5014,6 +5304,8 @@ static int ms_help(const char *cmd)
 	printf("  %s fifo_int_enable [0/1]        - enable/disable/get fifo "
 		"interrupt status\n", cmd);
 	printf("  %s fifo_read MAX_DATA           - read fifo data\n", cmd);
+	printf("  %s fifo_read_compact MAX_DATA   - read fifo data, using "
+		"the compact format\n", cmd);
 	printf("  %s fifo_flush NUM               - trigger fifo interrupt\n",
 		cmd);
 	printf("  %s list_activities              - list supported "
@@ -5051,6 +5343,23 @@ static void motionsense_display_activities(uint32_t activities)
 		       MOTIONSENSE_ACTIVITY_BODY_DETECTION);
 }
 
+static void motionsense_print_fifo_vector(
+	const struct ec_response_motion_sensor_data *vector)
+{
+	if (vector->flags & (MOTIONSENSE_SENSOR_FLAG_TIMESTAMP |
+			     MOTIONSENSE_SENSOR_FLAG_FLUSH)) {
+		printf("Timestamp:%" PRIx32 "%s\n",
+		       vector->timestamp,
+		       (vector->flags & MOTIONSENSE_SENSOR_FLAG_FLUSH ?
+			" - Flush" : ""));
+	} else {
+		printf("Sensor %d: %d\t%d\t%d (as uint16: %u\t%u\t%u)\n",
+		       vector->sensor_num,
+		       vector->data[0], vector->data[1], vector->data[2],
+		       vector->data[0], vector->data[1], vector->data[2]);
+	}
+}
+
 static int cmd_motionsense(int argc, char **argv)
 {
 	int i, rv, status_only = (argc == 2);
@@ -5508,7 +5817,6 @@ static int cmd_motionsense(int argc, char **argv)
 		}
 		while (fifo_read_buffer.number_data != 0 &&
 		       print_data < max_data) {
-			struct ec_response_motion_sensor_data *vector;
 			param.cmd = MOTIONSENSE_CMD_FIFO_READ;
 			param.fifo_read.max_data_vector =
 				MIN(ARRAY_SIZE(fifo_read_buffer.data),
@@ -5522,29 +5830,52 @@ static int cmd_motionsense(int argc, char **argv)
 				return rv;
 
 			print_data += fifo_read_buffer.number_data;
-			for (i = 0; i < fifo_read_buffer.number_data; i++) {
-				vector = &fifo_read_buffer.data[i];
-				if (vector->flags &
-					(MOTIONSENSE_SENSOR_FLAG_TIMESTAMP |
-					 MOTIONSENSE_SENSOR_FLAG_FLUSH)) {
-
-					printf("Timestamp:%" PRIx32 "%s\n",
-						vector->timestamp,
-						(vector->flags &
-						 MOTIONSENSE_SENSOR_FLAG_FLUSH ?
-						 " - Flush" : ""));
-				} else {
-					printf("Sensor %d: %d\t%d\t%d "
-					       "(as uint16: %u\t%u\t%u)\n",
-						vector->sensor_num,
-						vector->data[0],
-						vector->data[1],
-						vector->data[2],
-						vector->data[0],
-						vector->data[1],
-						vector->data[2]);
-				}
+			for (i = 0; i < fifo_read_buffer.number_data; i++)
+				motionsense_print_fifo_vector(
+					&fifo_read_buffer.data[i]);
+		}
+		return 0;
+	}
+
+	if (argc == 3 && !strcasecmp(argv[1], "fifo_read_compact")) {
+		struct ec_response_motion_sense_fifo_compact *compact =
+			ec_inbuf;
+		struct ec_response_motion_sensor_data vectors[512];
+		int print_data = 0,  max_data = strtol(argv[2], &e, 0);
+		int number_data = -1;
+
+		if (e && *e) {
+			fprintf(stderr, "Bad %s arg.\n", argv[2]);
+			return -1;
+		}
+		while (number_data != 0 && print_data < max_data) {
+			param.cmd = MOTIONSENSE_CMD_FIFO_READ_COMPACT;
+			param.fifo_read_compact.max_data_vector =
+				MIN(ARRAY_SIZE(vectors), max_data - print_data);
+
+			rv = ec_command(EC_CMD_MOTION_SENSE_CMD, 2,
+					&param,
+					ms_command_sizes[param.cmd].outsize,
+					compact, ec_max_insize);
+			if (rv < 0)
+				return rv;
+			if (rv < (int)sizeof(*compact) ||
+			    compact->size > rv - sizeof(*compact)) {
+				fprintf(stderr, "Bad compact fifo size.\n");
+				return -1;
 			}
+
+			number_data = motion_sense_fifo_decode_compact(
+				compact->data, compact->size, vectors,
+				ARRAY_SIZE(vectors));
+			if (number_data != compact->number_data) {
+				fprintf(stderr, "Bad compact fifo data.\n");
+				return -1;
+			}
+
+			print_data += number_data;
+			for (i = 0; i < number_data; i++)
+				motionsense_print_fifo_vector(&vectors[i]);
 		}
 		return 0;
 	}
@@ -8552,11 +8883,64 @@ int cmd_rtc_get_alarm(int argc, char *argv[])
 	return 0;
 }
 
+/* Time between polls for new EC console output */
+#define CONSOLE_FOLLOW_POLL_US 100000
+
+static int cmd_console_follow(void)
+{
+	struct ec_params_console_read_v2 p = { .seq = 0 };
+	struct ec_response_console_read_v2 *r = ec_inbuf;
+	int first = 1;
+	int rv, len;
+
+	if (!ec_cmd_version_supported(EC_CMD_CONSOLE_READ, 2)) {
+		fprintf(stderr, "EC does not support --follow\n");
+		return -1;
+	}
+
+	while (1) {
+		rv = ec_command(EC_CMD_CONSOLE_READ, 2, &p, sizeof(p),
+				ec_inbuf, ec_max_insize);
+		if (rv < 0)
+			return rv;
+		if (rv < (int)sizeof(*r)) {
+			fprintf(stderr, "Response too short\n");
+			return -1;
+		}
+		len = rv - sizeof(*r);
+
+		/* Whatever came before the first read is not news */
+		if ((r->flags & EC_CONSOLE_READ_GAP) && !first) {
+			if (r->seq < p.seq)
+				printf("\n[EC rebooted]\n");
+			else
+				printf("\n[%u bytes of EC output lost]\n",
+				       r->seq - p.seq);
+		}
+		first = 0;
+
+		fwrite(r->data, 1, len, stdout);
+		fflush(stdout);
+		p.seq = r->seq + len;
+
+		if (!(r->flags & EC_CONSOLE_READ_MORE))
+			usleep(CONSOLE_FOLLOW_POLL_US);
+	}
+}
+
 int cmd_console(int argc, char *argv[])
 {
 	char *out = (char *)ec_inbuf;
 	int rv;
 
+	if (argc > 1) {
+		if (strcmp(argv[1], "--follow")) {
+			fprintf(stderr, "Usage: %s [--follow]\n", argv[0]);
+			return -1;
+		}
+		return cmd_console_follow();
+	}
+
 	/* Snapshot the EC console */
 	rv = ec_command(EC_CMD_CONSOLE_SNAPSHOT, 0, NULL, 0, NULL, 0);
 	if (rv < 0)
@@ -10294,6 +10678,7 @@ const struct command commands[] = {
 	{"apreset", cmd_apreset},
 	{"autofanctrl", cmd_thermal_auto_fan_ctrl},
 	{"backlight", cmd_lcd_backlight},
+	{"batch", cmd_batch},
 	{"battery", cmd_battery},
 	{"batterycutoff", cmd_battery_cut_off},
 	{"batteryparam", cmd_battery_vendor_param},
@@ -10325,6 +10710,7 @@ const struct command commands[] = {
 	{"flasheraseasync", cmd_flash_erase},
 	{"flashprotect", cmd_flash_protect},
 	{"flashread", cmd_flash_read},
+	{"flashupdate", cmd_flash_update},
 	{"flashwrite", cmd_flash_write},
 	{"flashinfo", cmd_flash_info},
 	{"flashspiinfo", cmd_flash_spi_info},
@@ -10343,6 +10729,7 @@ const struct command commands[] = {
 	{"hangdetect", cmd_hang_detect},
 	{"hello", cmd_hello},
 	{"hibdelay", cmd_hibdelay},
+	{"hostcmdstats", cmd_hostcmd_stats},
 	{"hostevent", cmd_hostevent},
 	{"hostsleepstate", cmd_hostsleepstate},
 	{"locatechip", cmd_locate_chip},
@@ -10468,6 +10855,8 @@ int main(int argc, char *argv[])
 				interfaces = COMM_I2C;
 			} else if (!strcasecmp(optarg, "servo")) {
 				interfaces = COMM_SERVO;
+			} else if (!strcasecmp(optarg, "sock")) {
+				interfaces = COMM_SOCK;
 			} else {
 				fprintf(stderr, "Invalid --interface\n");
 				parse_error = 1;
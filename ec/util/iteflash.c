@@ -76,6 +76,10 @@
 /* Size for FTDI outgoing buffer */
 #define FTDI_CMD_BUF_SIZE (1<<12)
 
+/* Most I2C transactions queued in a batch, and most page data read by one */
+#define I2C_BATCH_MAX_XFERS	64
+#define I2C_BATCH_READ_SIZE	(1<<12)
+
 /* Reset Status */
 #define RSTS_VCCDO_PW_ON	0x40
 #define RSTS_VFSPIPG		0x20
@@ -114,6 +118,7 @@ struct iteflash_config {
 	int debug;  /* boolean */
 	int disable_watchdog;  /* boolean */
 	int disable_protect_path;  /* boolean */
+	int batch;  /* boolean */
 	int block_write_size;
 	int usb_interface;
 	int usb_vid;
@@ -134,6 +139,7 @@ struct common_hnd {
 		int i2c_dev_fd;
 		struct usb_endpoint uep;
 		struct ftdi_context *ftdi_hnd;
+		struct fake_dbgr *fake;
 	};
 };
 
@@ -142,6 +148,24 @@ struct cmds {
 	uint8_t cmd;
 };
 
+/* One I2C transaction, as for i2c_byte_transfer() */
+struct i2c_xfer {
+	uint8_t addr;
+	uint8_t write;
+	int numbytes;
+	uint8_t *data;
+};
+
+/*
+ * I2C transactions queued to go out in as few round trips to the adapter as
+ * the interface allows.  Single bytes written are kept in the batch itself.
+ */
+struct i2c_batch {
+	int count;
+	struct i2c_xfer xfers[I2C_BATCH_MAX_XFERS];
+	uint8_t bytes[I2C_BATCH_MAX_XFERS];
+};
+
 /* For all callback return values, zero indicates success, non-zero failure. */
 struct i2c_interface {
 	/* Optional, may be NULL. */
@@ -157,6 +181,14 @@ struct i2c_interface {
 	/* Required, must not be NULL. */
 	int (*byte_transfer)(struct common_hnd *chnd, uint8_t addr,
 		uint8_t *data, int write, int numbytes);
+	/*
+	 * Optional, may be NULL: sends count transactions in one round trip,
+	 * stopping at the first one to fail.
+	 */
+	int (*batch_transfer)(struct common_hnd *chnd, struct i2c_xfer *xfers,
+		int count);
+	/* Required if batch_transfer is set, must be positive. */
+	int max_batch_xfers;
 	/* Required, must be positive. */
 	int default_block_write_size;
 };
@@ -199,21 +231,13 @@ static inline int i2c_byte_transfer(struct common_hnd *chnd, uint8_t addr,
 		numbytes);
 }
 
-static int linux_i2c_byte_transfer(struct common_hnd *chnd, uint8_t addr,
-				   uint8_t *data, int write, int numbytes)
+static int linux_i2c_transfer(struct common_hnd *chnd, struct i2c_msg *msgs,
+			      int nmsgs)
 {
-	static const int nmsgs = 1;
 	int ret, extra_int;
-	struct i2c_msg i2cmsg = {};
 	struct i2c_rdwr_ioctl_data msgset = {};
 
-	i2cmsg.addr = addr;
-	if (!write)
-		i2cmsg.flags |= I2C_M_RD;
-	i2cmsg.buf = data;
-	i2cmsg.len = numbytes;
-
-	msgset.msgs = &i2cmsg;
+	msgset.msgs = msgs;
 	msgset.nmsgs = nmsgs;
 
 	ret = ioctl(chnd->i2c_dev_fd, I2C_RDWR, &msgset);
@@ -233,6 +257,38 @@ static int linux_i2c_byte_transfer(struct common_hnd *chnd, uint8_t addr,
 	return ret;
 }
 
+static int linux_i2c_byte_transfer(struct common_hnd *chnd, uint8_t addr,
+				   uint8_t *data, int write, int numbytes)
+{
+	struct i2c_msg i2cmsg = {};
+
+	i2cmsg.addr = addr;
+	if (!write)
+		i2cmsg.flags |= I2C_M_RD;
+	i2cmsg.buf = data;
+	i2cmsg.len = numbytes;
+
+	return linux_i2c_transfer(chnd, &i2cmsg, 1);
+}
+
+/* The messages go out in one I2C_RDWR, with repeated STARTs between them. */
+static int linux_i2c_batch_transfer(struct common_hnd *chnd,
+				    struct i2c_xfer *xfers, int count)
+{
+	struct i2c_msg i2cmsgs[I2C_RDWR_IOCTL_MAX_MSGS] = {};
+	int i;
+
+	for (i = 0; i < count; i++) {
+		i2cmsgs[i].addr = xfers[i].addr;
+		if (!xfers[i].write)
+			i2cmsgs[i].flags |= I2C_M_RD;
+		i2cmsgs[i].buf = xfers[i].data;
+		i2cmsgs[i].len = xfers[i].numbytes;
+	}
+
+	return linux_i2c_transfer(chnd, i2cmsgs, count);
+}
+
 static int i2c_add_send_byte(struct ftdi_context *ftdi, uint8_t *buf,
 			     uint8_t *ptr, uint8_t *tbuf, int tcnt, int debug)
 {
@@ -509,6 +565,81 @@ static int i2c_read_byte(struct common_hnd *chnd, uint8_t cmd, uint8_t *data)
 	return 0;
 }
 
+static void i2c_batch_init(struct i2c_batch *batch)
+{
+	batch->count = 0;
+}
+
+/* Room left in the batch, in transactions */
+static int i2c_batch_room(struct i2c_batch *batch)
+{
+	return I2C_BATCH_MAX_XFERS - batch->count;
+}
+
+/* Queue a transaction; data must stay valid until the batch is sent. */
+static void i2c_batch_add(struct i2c_batch *batch, uint8_t addr,
+			  uint8_t *data, int write, int numbytes)
+{
+	struct i2c_xfer *xfer = &batch->xfers[batch->count++];
+
+	xfer->addr = addr;
+	xfer->write = write;
+	xfer->numbytes = numbytes;
+	xfer->data = data;
+}
+
+static void i2c_batch_add_byte(struct i2c_batch *batch, uint8_t addr,
+			       uint8_t data)
+{
+	uint8_t *b = &batch->bytes[batch->count];
+
+	*b = data;
+	i2c_batch_add(batch, addr, b, 1, 1);
+}
+
+/* Queue i2c_write_byte() */
+static void i2c_batch_write_byte(struct i2c_batch *batch, uint8_t cmd,
+				 uint8_t data)
+{
+	i2c_batch_add_byte(batch, I2C_CMD_ADDR, cmd);
+	i2c_batch_add_byte(batch, I2C_DATA_ADDR, data);
+}
+
+/*
+ * Send the queued transactions, and empty the batch.  They go out one at a
+ * time unless --batch is given and the interface has batch_transfer.
+ */
+static int i2c_batch_send(struct common_hnd *chnd, struct i2c_batch *batch)
+{
+	const struct i2c_interface *i2c_if = chnd->conf.i2c_if;
+	struct i2c_xfer *xfer = batch->xfers;
+	int remaining = batch->count;
+	int ret = 0;
+	int cnt;
+
+	batch->count = 0;
+	while (remaining) {
+		if (i2c_if->batch_transfer && chnd->conf.batch) {
+			if (exit_requested)
+				return -EIO;
+			cnt = (remaining > i2c_if->max_batch_xfers) ?
+				i2c_if->max_batch_xfers : remaining;
+			ret = i2c_if->batch_transfer(chnd, xfer, cnt);
+		} else {
+			cnt = 1;
+			ret = i2c_byte_transfer(chnd, xfer->addr, xfer->data,
+						xfer->write, xfer->numbytes);
+		}
+		if (ret < 0)
+			return -EIO;
+
+		xfer += cnt;
+		remaining -= cnt;
+	}
+
+	return 0;
+}
+
 /* Configure I2C MUX to choose EC Prog channel */
 static int config_i2c_mux(struct common_hnd *chnd, uint8_t cmd)
 {
@@ -814,18 +945,25 @@ static int dbgr_stop_ec(struct common_hnd *chnd)
 	return ret;
 }
 
+/* Queue a SPI Flash generic command, short version */
+static void spi_batch_command_short(struct i2c_batch *batch, uint8_t cmd)
+{
+	i2c_batch_write_byte(batch, 0x05, 0xfe);
+	i2c_batch_write_byte(batch, 0x08, 0x00);
+	i2c_batch_write_byte(batch, 0x05, 0xfd);
+	i2c_batch_write_byte(batch, 0x08, cmd);
+}
+
 /* SPI Flash generic command, short version */
 static int spi_flash_command_short(struct common_hnd *chnd,
 				   uint8_t cmd, char *desc)
 {
-	int ret = 0;
-
-	ret |= i2c_write_byte(chnd, 0x05, 0xfe);
-	ret |= i2c_write_byte(chnd, 0x08, 0x00);
-	ret |= i2c_write_byte(chnd, 0x05, 0xfd);
-	ret |= i2c_write_byte(chnd, 0x08, cmd);
+	struct i2c_batch batch;
+	int ret;
 
-	ret = (ret ? -EIO : 0);
+	i2c_batch_init(&batch);
+	spi_batch_command_short(&batch, cmd);
+	ret = i2c_batch_send(chnd, &batch);
 	if (ret < 0)
 		fprintf(stderr, "Flash CMD %s FAILED (%d)\n", desc, ret);
 
@@ -1135,34 +1273,40 @@ static void draw_spinner(uint32_t remaining, uint32_t size)
 	windex %= sizeof(wheel);
 }
 
-/* Note: this function must be called in follow mode */
-static int spi_send_cmd_fast_read(struct common_hnd *chnd, uint32_t addr)
-{
-	int ret = 0;
-	uint8_t cmd = 0x9;
+/* Transactions queued by spi_batch_fast_read() */
+#define SPI_FAST_READ_XFERS	17
 
+/* Queue a fast read; the batch must be sent in follow mode */
+static void spi_batch_fast_read(struct i2c_batch *batch, uint32_t addr)
+{
 	/* Fast Read command */
-	ret = spi_flash_command_short(chnd, SPI_CMD_FAST_READ, "fast read");
+	spi_batch_command_short(batch, SPI_CMD_FAST_READ);
 	/* Send address */
-	ret |= i2c_write_byte(chnd, 0x08, ((addr >> 16) & 0xff)); /* addr_h */
-	ret |= i2c_write_byte(chnd, 0x08, ((addr >> 8) & 0xff));  /* addr_m */
-	ret |= i2c_write_byte(chnd, 0x08, (addr & 0xff));         /* addr_l */
+	i2c_batch_write_byte(batch, 0x08, ((addr >> 16) & 0xff)); /* addr_h */
+	i2c_batch_write_byte(batch, 0x08, ((addr >> 8) & 0xff));  /* addr_m */
+	i2c_batch_write_byte(batch, 0x08, (addr & 0xff));         /* addr_l */
 	/* fake byte */
-	ret |= i2c_write_byte(chnd, 0x08, 0x00);
+	i2c_batch_write_byte(batch, 0x08, 0x00);
 	/* use i2c block read command */
-	ret |= i2c_byte_transfer(chnd, I2C_CMD_ADDR, &cmd, 1, 1);
-	if (ret < 0)
-		fprintf(stderr, "Send fast read command failed\n");
-
-	return ret;
+	i2c_batch_add_byte(batch, I2C_CMD_ADDR, 0x9);
 }
 
+/*
+ * Read size bytes at address into buffer.  The page reads are queued up to
+ * I2C_BATCH_READ_SIZE at a time.
+ *
+ * If expected is not NULL, each batch read is compared with it as it comes
+ * in, and the read stops at the first difference.
+ */
 static int command_read_pages(struct common_hnd *chnd, uint32_t address,
-			      uint32_t size, uint8_t *buffer)
+			      uint32_t size, uint8_t *buffer,
+			      const uint8_t *expected)
 {
 	int res = -EIO;
 	uint32_t remaining = size;
-	int cnt;
+	uint32_t queued = 0;
+	struct i2c_batch batch;
+	int cnt, i;
 
 	if (address & 0xFF) {
 		fprintf(stderr, "page read requested at non-page boundary: "
@@ -1173,29 +1317,47 @@ static int command_read_pages(struct common_hnd *chnd, uint32_t address,
 	if (spi_flash_follow_mode(chnd, "fast read") < 0)
 		goto failed_read;
 
-	if (spi_send_cmd_fast_read(chnd, address) < 0)
-		goto failed_read;
+	i2c_batch_init(&batch);
+	spi_batch_fast_read(&batch, address);
 
 	while (remaining) {
 		cnt = (remaining > PAGE_SIZE) ? PAGE_SIZE : remaining;
-		draw_spinner(remaining, size);
 
-		/* read page data */
-		res = i2c_byte_transfer(chnd, I2C_BLOCK_ADDR, buffer, 0, cnt);
-		if (res < 0) {
-			fprintf(stderr, "page data read failed\n");
-			goto failed_read;
-		}
+		/* queue page data read */
+		i2c_batch_add(&batch, I2C_BLOCK_ADDR, buffer + queued, 0, cnt);
 
 		address += cnt;
 		remaining -= cnt;
-		buffer += cnt;
+		queued += cnt;
 
 		/* We need to resend fast read command at 256KB boundary. */
-		if (!(address % 0x40000) && remaining) {
-			if (spi_send_cmd_fast_read(chnd, address) < 0)
-				goto failed_read;
+		if (!(address % 0x40000) && remaining)
+			spi_batch_fast_read(&batch, address);
+
+		if (remaining && queued < I2C_BATCH_READ_SIZE &&
+		    i2c_batch_room(&batch) > SPI_FAST_READ_XFERS)
+			continue;
+
+		draw_spinner(remaining + queued, size);
+		if (i2c_batch_send(chnd, &batch) < 0) {
+			fprintf(stderr, "page data read failed\n");
+			goto failed_read;
 		}
+
+		if (expected && memcmp(buffer, expected, queued)) {
+			for (i = 0; buffer[i] == expected[i]; i++)
+				;
+			fprintf(stderr, "\nmismatch at 0x%X: "
+				"0x%02x instead of 0x%02x\n",
+				address - queued + i,
+				buffer[i], expected[i]);
+			goto failed_read;
+		}
+
+		buffer += queued;
+		if (expected)
+			expected += queued;
+		queued = 0;
 	}
 	/* No error so far */
 	res = size;
@@ -1302,49 +1464,52 @@ failed_write:
 }
 
 /*
- * Test for spi page program command
+ * Page program command.  Write enable, the program, and the first read of the
+ * status register go out in one batch, so most pages take one round trip.
  */
 static int command_write_pages3(struct common_hnd *chnd, uint32_t address,
 				uint32_t size, uint8_t *buffer)
 {
-	int ret = 0;
-	uint8_t addr_H, addr_M, addr_L;
+	struct i2c_batch batch;
+	uint8_t reg = 0xff;
 
-	/* SMB_SPI_Flash_Write_Enable */
-	if (spi_flash_command_short(chnd, SPI_CMD_WRITE_ENABLE,
-		"SPI Command Write Enable") < 0) {
-		ret = -EIO;
-		goto failed_write;
+	i2c_batch_init(&batch);
+	spi_batch_command_short(&batch, SPI_CMD_WRITE_ENABLE);
+	spi_batch_command_short(&batch, SPI_CMD_PAGE_PROGRAM);
+	i2c_batch_add_byte(&batch, I2C_DATA_ADDR, (address >> 16) & 0xFF);
+	i2c_batch_add_byte(&batch, I2C_DATA_ADDR, (address >> 8) & 0xFF);
+	i2c_batch_add_byte(&batch, I2C_DATA_ADDR, address & 0xFF);
+	i2c_batch_add(&batch, I2C_BLOCK_ADDR, buffer, 1, size);
+	spi_batch_command_short(&batch, SPI_CMD_READ_STATUS);
+	i2c_batch_add(&batch, I2C_DATA_ADDR, &reg, 0, 1);
+	if (i2c_batch_send(chnd, &batch) < 0) {
+		fprintf(stderr, "Page Program FAILED\n");
+		return -EIO;
 	}
 
-	if (spi_flash_command_short(chnd, SPI_CMD_PAGE_PROGRAM,
-		"SPI_CMD_PAGE_PROGRAM") < 0) {
-		ret = -EIO;
-		goto failed_write;
+	/* Wait until not busy */
+	while (reg & 0x01) {
+		if (i2c_byte_transfer(chnd, I2C_DATA_ADDR, &reg, 0, 1) < 0) {
+			fprintf(stderr, "Flash polling busy cleared FAILED\n");
+			return -EIO;
+		}
 	}
 
-	addr_H = (address >> 16) & 0xFF;
-	addr_M = (address >> 8) & 0xFF;
-	addr_L = address & 0xFF;
+	return 0;
+}
 
-	ret = i2c_byte_transfer(chnd, I2C_DATA_ADDR, &addr_H, 1, 1);
-	ret |= i2c_byte_transfer(chnd, I2C_DATA_ADDR, &addr_M, 1, 1);
-	ret |= i2c_byte_transfer(chnd, I2C_DATA_ADDR, &addr_L, 1, 1);
-	ret |= i2c_byte_transfer(chnd, I2C_BLOCK_ADDR, buffer, 1, size);
-	if (ret < 0)
-		goto failed_write;
+/* Return non-zero if the whole buffer is 0xFF */
+static int is_erased(const uint8_t *buffer, int size)
+{
+	int i;
 
-	/* Wait until not busy */
-	if (spi_poll_busy(chnd, "Page Program") < 0)
-		ret = -EIO;
+	for (i = 0; i < size; i++)
+		if (buffer[i] != 0xFF)
+			return 0;
 
-	/* No error so far */
-failed_write:
-	return ret;
+	return 1;
 }
 
-
-
 static int command_erase(struct common_hnd *chnd, uint32_t len, uint32_t off)
 {
 	int res = -EIO;
@@ -1550,7 +1715,7 @@ static int read_flash(struct common_hnd *chnd)
 	}
 
 	printf("Reading %zd bytes at %#08zx\n", size, offset);
-	res = command_read_pages(chnd, offset, size, buffer);
+	res = command_read_pages(chnd, offset, size, buffer, NULL);
 	if (res > 0) {
 		if (fwrite(buffer, res, 1, hnd) != 1)
 			fprintf(stderr, "Cannot write %s\n", filename);
@@ -1750,7 +1915,7 @@ static int write_flash3(struct common_hnd *chnd, const char *filename,
 	int block_write_size = chnd->conf.block_write_size;
 	FILE *hnd;
 	int size = chnd->flash_size;
-	int cnt;
+	int cnt, skipped = 0;
 	uint8_t *buf = malloc(size);
 
 	if (!buf) {
@@ -1789,7 +1954,14 @@ static int write_flash3(struct common_hnd *chnd, const char *filename,
 
 	while (res) {
 		cnt = (res > block_write_size) ? block_write_size : res;
-		if (command_write_pages3(chnd, offset, cnt, &buf[offset]) < 0) {
+		/*
+		 * Programming can only clear bits, so blocks of 0xFF would not
+		 * change the flash whether it was erased or not.
+		 */
+		if (is_erased(&buf[offset], cnt)) {
+			skipped += cnt;
+		} else if (command_write_pages3(chnd, offset, cnt,
+						&buf[offset]) < 0) {
 			ret = -EIO;
 			goto failed_write;
 		}
@@ -1807,14 +1979,20 @@ failed_write:
 	if (ret < 0)
 		fprintf(stderr, "%s: Error writing to flash\n", __func__);
 	else
-		printf("\n\rWriting Done.\n");
+		printf("\n\rWriting Done, skipped %d bytes of 0xFF.\n",
+			skipped);
 
 	return ret;
 }
 
 
 
-/* Return zero on success, a non-zero value on failures. */
+/*
+ * Return zero on success, a non-zero value on failures.
+ *
+ * Only the bytes of the file are read back, and they are compared batch by
+ * batch as they come in.
+ */
 static int verify_flash(struct common_hnd *chnd, const char *filename,
 			uint32_t offset)
 {
@@ -1852,9 +2030,9 @@ static int verify_flash(struct common_hnd *chnd, const char *filename,
 	fclose(hnd);
 
 	printf("Verify %d bytes at 0x%08x\n", file_size, offset);
-	res = command_read_pages(chnd, offset, chnd->flash_size, buffer2);
+	res = command_read_pages(chnd, offset, file_size, buffer2, buffer);
 	if (res > 0)
-		res = memcmp(buffer, buffer2, file_size);
+		res = 0;
 
 	printf("\n\rVerify %s\n", res ? "Failed!" : "Done.");
 
@@ -1972,10 +2150,284 @@ static int ftdi_i2c_interface_shutdown(struct common_hnd *chnd)
 	return 0;
 }
 
+/*
+ * The fake interface emulates the DBGR of a chip with a KGD flash in memory,
+ * so that flashing can be run and timed without hardware.  The time is
+ * modeled, not measured: a round trip to the adapter for every transfer call,
+ * the bits on a 400kHz bus, and the flash being busy after programs and
+ * erases.
+ */
+#define FAKE_CHIP_ID_H		0x83
+#define FAKE_CHIP_ID_L		0x20
+#define FAKE_CHIP_VER		0x83	/* DX, 512KB */
+#define FAKE_FLASH_SIZE		(512 * 1024)
+
+#define FAKE_ROUND_TRIP_NS	1000000ULL	/* USB I2C adapter */
+#define FAKE_BIT_NS		(1000000000ULL / FTDI_I2C_FREQ)
+#define FAKE_PAGE_PROGRAM_NS	700000ULL
+#define FAKE_SECTOR_ERASE_NS	45000000ULL
+#define FAKE_CHIP_ERASE_NS	3000000000ULL
+
+struct fake_dbgr {
+	uint8_t *flash;
+	uint8_t reg;		/* Selected by a write to I2C_CMD_ADDR */
+	int cs_low;		/* boolean */
+	int spi_count;		/* SPI bytes since CS# went low */
+	uint8_t spi_cmd;
+	uint32_t spi_addr;
+	int write_enabled;	/* boolean */
+	uint64_t busy_until_ns;
+	/* Statistics */
+	uint64_t time_ns;
+	uint64_t bytes;
+	int round_trips;
+	int xfers;
+	int programs;
+};
+
+static const uint8_t fake_flash_id[] = {0xEF, 0x40, 0x13};
+
+static void fake_set_busy(struct fake_dbgr *fake, uint64_t busy_ns)
+{
+	fake->busy_until_ns = fake->time_ns + busy_ns;
+	fake->write_enabled = 0;
+}
+
+static void fake_spi_write(struct fake_dbgr *fake, uint8_t data)
+{
+	int n = fake->spi_count++;
+	uint32_t addr;
+
+	if (!fake->cs_low)
+		return;
+
+	if (!n) {
+		/* Only the status can be read while the flash is busy */
+		if (fake->time_ns < fake->busy_until_ns &&
+		    data != SPI_CMD_READ_STATUS)
+			data = 0;
+
+		fake->spi_cmd = data;
+		fake->spi_addr = 0;
+		if (data == SPI_CMD_WRITE_ENABLE) {
+			fake->write_enabled = 1;
+		} else if (data == SPI_CMD_WRITE_DISABLE) {
+			fake->write_enabled = 0;
+		} else if (data == SPI_CMD_CHIP_ERASE && fake->write_enabled) {
+			memset(fake->flash, 0xff, FAKE_FLASH_SIZE);
+			fake_set_busy(fake, FAKE_CHIP_ERASE_NS);
+		}
+		return;
+	}
+
+	switch (fake->spi_cmd) {
+	case SPI_CMD_FAST_READ:
+	case SPI_CMD_PAGE_PROGRAM:
+	case SPI_CMD_SECTOR_ERASE_4K:
+		if (n <= 3) {
+			fake->spi_addr = ((fake->spi_addr << 8) | data) &
+				(FAKE_FLASH_SIZE - 1);
+		} else if (fake->spi_cmd == SPI_CMD_PAGE_PROGRAM &&
+			   fake->write_enabled) {
+			/* Programs wrap around within the page */
+			addr = (fake->spi_addr & ~(PAGE_SIZE - 1)) |
+				((fake->spi_addr + n - 4) & (PAGE_SIZE - 1));
+			fake->flash[addr] &= data;
+		}
+		if (n == 3 && fake->spi_cmd == SPI_CMD_SECTOR_ERASE_4K &&
+		    fake->write_enabled) {
+			addr = fake->spi_addr & ~0xfff;
+			memset(fake->flash + addr, 0xff, 0x1000);
+			fake_set_busy(fake, FAKE_SECTOR_ERASE_NS);
+		}
+		break;
+	}
+}
+
+static uint8_t fake_spi_read(struct fake_dbgr *fake)
+{
+	int n = fake->spi_count++;
+	uint32_t addr;
+
+	if (!fake->cs_low || !n)
+		return 0xff;
+
+	switch (fake->spi_cmd) {
+	case SPI_CMD_READ_STATUS:
+		return (fake->time_ns < fake->busy_until_ns ? 0x01 : 0) |
+			(fake->write_enabled ? 0x02 : 0);
+	case SPI_CMD_RDID:
+		return (n <= sizeof(fake_flash_id)) ?
+			fake_flash_id[n - 1] : 0xff;
+	case SPI_CMD_FAST_READ:
+		/* Command, address, and the fake byte first */
+		if (n < 5)
+			return 0xff;
+		/* The address wraps at 256KB, hence the fast read resends */
+		addr = fake->spi_addr;
+		fake->spi_addr = (addr & ~0x3ffff) | ((addr + 1) & 0x3ffff);
+		return fake->flash[addr];
+	default:
+		return 0xff;
+	}
+}
+
+/* CS# going high ends the SPI command */
+static void fake_spi_end(struct fake_dbgr *fake)
+{
+	if (fake->cs_low && fake->spi_cmd == SPI_CMD_PAGE_PROGRAM &&
+	    fake->write_enabled && fake->spi_count > 4) {
+		fake_set_busy(fake, FAKE_PAGE_PROGRAM_NS);
+		fake->programs++;
+	}
+	fake->cs_low = 0;
+}
+
+static void fake_write_reg(struct fake_dbgr *fake, uint8_t data)
+{
+	switch (fake->reg) {
+	case 0x05:
+		if (data == 0xfd) {
+			fake->cs_low = 1;
+			fake->spi_count = 0;
+		} else {
+			fake_spi_end(fake);
+		}
+		break;
+	case 0x08:
+		fake_spi_write(fake, data);
+		break;
+	}
+}
+
+static uint8_t fake_read_reg(struct fake_dbgr *fake)
+{
+	switch (fake->reg) {
+	case 0x00:
+		return FAKE_CHIP_ID_H;
+	case 0x01:
+		return FAKE_CHIP_ID_L;
+	case 0x02:
+		return FAKE_CHIP_VER;
+	case 0x08:
+		return fake_spi_read(fake);
+	default:
+		return 0;
+	}
+}
+
+static int fake_i2c_xfer(struct fake_dbgr *fake, struct i2c_xfer *xfer)
+{
+	uint8_t *b = xfer->data;
+	int i;
+
+	/* START, the address and data bytes with their ACK bits, STOP */
+	fake->time_ns += (2 + 9 * (1 + xfer->numbytes)) * FAKE_BIT_NS;
+	fake->bytes += xfer->numbytes;
+	fake->xfers++;
+
+	for (i = 0; i < xfer->numbytes; i++, b++) {
+		switch (xfer->addr) {
+		case I2C_CMD_ADDR:
+			if (xfer->write)
+				fake->reg = *b;
+			break;
+		case I2C_DATA_ADDR:
+			if (xfer->write)
+				fake_write_reg(fake, *b);
+			else
+				*b = fake_read_reg(fake);
+			break;
+		case I2C_BLOCK_ADDR:
+			if (xfer->write)
+				fake_spi_write(fake, *b);
+			else
+				*b = fake_spi_read(fake);
+			break;
+		case I2C_MUX_CMD_ADDR:
+			break;
+		default:
+			return -ENXIO;
+		}
+	}
+
+	return 0;
+}
+
+static int fake_i2c_batch_transfer(struct common_hnd *chnd,
+				   struct i2c_xfer *xfers, int count)
+{
+	struct fake_dbgr *fake = chnd->fake;
+	int i, ret;
+
+	fake->round_trips++;
+	fake->time_ns += FAKE_ROUND_TRIP_NS;
+	for (i = 0; i < count; i++) {
+		ret = fake_i2c_xfer(fake, &xfers[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int fake_i2c_byte_transfer(struct common_hnd *chnd, uint8_t addr,
+				  uint8_t *data, int write, int numbytes)
+{
+	struct i2c_xfer xfer = {
+		.addr = addr,
+		.write = write,
+		.numbytes = numbytes,
+		.data = data,
+	};
+
+	return fake_i2c_batch_transfer(chnd, &xfer, 1);
+}
+
+static int fake_i2c_interface_init(struct common_hnd *chnd)
+{
+	chnd->fake = calloc(1, sizeof(*chnd->fake));
+	if (!chnd->fake)
+		return -ENOMEM;
+
+	chnd->fake->flash = malloc(FAKE_FLASH_SIZE);
+	if (!chnd->fake->flash) {
+		null_and_free((void **)&chnd->fake);
+		return -ENOMEM;
+	}
+	memset(chnd->fake->flash, 0xff, FAKE_FLASH_SIZE);
+
+	printf("Using a fake DBGR with %d kB of erased flash\n",
+		FAKE_FLASH_SIZE / 1024);
+	return 0;
+}
+
+static int fake_i2c_interface_shutdown(struct common_hnd *chnd)
+{
+	struct fake_dbgr *fake = chnd->fake;
+
+	printf("Fake I2C: %d round trips, %d transactions, %llu bytes, "
+		"%d page programs, %.3f s\n", fake->round_trips, fake->xfers,
+		(unsigned long long)fake->bytes, fake->programs,
+		fake->time_ns / 1e9);
+
+	free(fake->flash);
+	null_and_free((void **)&chnd->fake);
+	return 0;
+}
+
+/* The chip is always ready to talk to */
+static int fake_send_special_waveform(struct common_hnd *chnd)
+{
+	return 0;
+}
+
 static const struct i2c_interface linux_i2c_interface = {
 	.interface_init = linux_i2c_interface_init,
 	.interface_shutdown = linux_i2c_interface_shutdown,
 	.byte_transfer = linux_i2c_byte_transfer,
+	.batch_transfer = linux_i2c_batch_transfer,
+	.max_batch_xfers = I2C_RDWR_IOCTL_MAX_MSGS,
 	/*
 	 * 254 bytes is the largest size that works with Servo Micro as of
 	 * 2018-11-30. Odd numbers up to 255 result in corruption, and 256 or
@@ -2009,6 +2461,17 @@ static const struct i2c_interface ftdi_i2c_interface = {
 	.default_block_write_size = FTDI_BLOCK_WRITE_SIZE,
 };
 
+/* Batched and sized like the Linux interface with a Servo Micro. */
+static const struct i2c_interface fake_i2c_interface = {
+	.interface_init = fake_i2c_interface_init,
+	.interface_shutdown = fake_i2c_interface_shutdown,
+	.send_special_waveform = fake_send_special_waveform,
+	.byte_transfer = fake_i2c_byte_transfer,
+	.batch_transfer = fake_i2c_batch_transfer,
+	.max_batch_xfers = I2C_RDWR_IOCTL_MAX_MSGS,
+	.default_block_write_size = 128,
+};
+
 static int post_waveform_work(struct common_hnd *chnd)
 {
 	int ret;
@@ -2047,6 +2510,7 @@ static int strdup_with_errmsg(const char *source, char **dest, const char *name)
 }
 
 static const struct option longopts[] = {
+	{"batch", 0, 0, 'B'},
 	{"block-write-size", 1, 0, 'b'},
 	{"debug", 0, 0, 'd'},
 	{"erase", 0, 0, 'e'},
@@ -2070,14 +2534,17 @@ static const struct option longopts[] = {
 static void display_usage(const char *program)
 {
 	fprintf(stderr, "Usage: %s [-d] [-v <VID>] [-p <PID>] \\\n"
-		"\t[-c <linux|ccd|ftdi>] [-D /dev/i2c-<N>] [-i <1|2>] [-S] \\\n"
-		"\t[-s <serial>] [-e] [-r <file>] [-W <0|1|false|true>] \\\n"
-		"\t[-w <file>] [-R base[:size]] [-m] [-b <size>]\n",
+		"\t[-c <linux|ccd|ftdi|fake>] [-D /dev/i2c-<N>] [-i <1|2>] \\\n"
+		"\t[-S] [-s <serial>] [-e] [-r <file>] \\\n"
+		"\t[-W <0|1|false|true>] [-w <file>] [-R base[:size]] [-m] \\\n"
+		"\t[-b <size>] [-n]\n",
 		program);
 	fprintf(stderr, "-d, --debug : Output debug traces.\n");
 	fprintf(stderr, "-e, --erase : Erase all the flash content.\n");
-	fprintf(stderr, "-c, --i2c-interface <linux|ccd|ftdi> : I2C interface "
-			"to use\n");
+	fprintf(stderr, "-c, --i2c-interface <linux|ccd|ftdi|fake> : I2C "
+			"interface to use;\n"
+			"\tfake emulates a chip in memory, and reports the "
+			"modeled time\n");
 	fprintf(stderr, "-D, --i2c-dev-path /dev/i2c-<N> : Path to "
 			"Linux i2c-dev file e.g. /dev/i2c-5;\n"
 			"\tonly applicable with --i2c-interface=linux\n");
@@ -2088,6 +2555,9 @@ static void display_usage(const char *program)
 		"\tyou are not using servod.\n");
 	fprintf(stderr, "-b, --block-write-size <size> : Perform writes in\n"
 		"\tblocks of this many bytes.\n");
+	fprintf(stderr, "-B, --batch : Send several I2C transactions in one\n"
+		"\ttransfer, joined by repeated STARTs.  Only for adapters\n"
+		"\twhich handle that, with --i2c-interface=linux or fake.\n");
 	fprintf(stderr, "-p, --product <0x1234> : USB product ID\n");
 	fprintf(stderr, "-R, --range base[:size] : Allow to read or write"
 		" just a slice\n"
@@ -2150,9 +2620,12 @@ static int parse_parameters(int argc, char **argv, struct iteflash_config *conf)
 	int opt, idx, ret = 0;
 
 	while (!ret &&
-	       (opt = getopt_long(argc, argv, "?b:c:D:dehi:mp:R:r:s:uv:W:w:Zz",
+	       (opt = getopt_long(argc, argv, "?Bb:c:D:dehi:mp:R:r:s:uv:W:w:Zz",
 				  longopts, &idx)) != -1) {
 		switch (opt) {
+		case 'B':
+			conf->batch = 1;
+			break;
 		case 'b':
 			conf->block_write_size = strtol(optarg, NULL, 10);
 			break;
@@ -2163,6 +2636,8 @@ static int parse_parameters(int argc, char **argv, struct iteflash_config *conf)
 				conf->i2c_if = &ccd_i2c_interface;
 			} else if (!strcasecmp(optarg, "ftdi")) {
 				conf->i2c_if = &ftdi_i2c_interface;
+			} else if (!strcasecmp(optarg, "fake")) {
+				conf->i2c_if = &fake_i2c_interface;
 			} else {
 				fprintf(stderr, "Unexpected -c / "
 					"--i2c-interface value: %s\n", optarg);